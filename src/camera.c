@@ -108,6 +108,9 @@ void control_camera(first_person_camera_t* camera, GLFWwindow* window) {
 	double elapsed_time = (last_time == 0.0) ? 0.0 : (now - last_time);
 	float time_delta = (float)elapsed_time;
 	last_time = now;
+	// Long pauses (e.g. while the application waits for input) should not
+	// turn into a leap
+	time_delta = (time_delta > 0.1f) ? 0.1f : time_delta;
 	// Modify the speed
 	float final_speed = camera->speed;
 	final_speed *= (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) ? 10.0f : 1.0f;
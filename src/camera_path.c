@@ -0,0 +1,239 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "main.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! The value of the first four bytes of each camera path file
+#define CAMERA_PATH_FILE_MARKER 0xca3e7a
+//! The file format version
+#define CAMERA_PATH_FILE_VERSION 1
+
+
+//! Makes sure that memory for at least the given number of poses (with
+//! lights and timings) is allocated
+void reserve_camera_path_poses(camera_path_t* path, uint32_t pose_count) {
+	if (pose_count <= path->pose_capacity)
+		return;
+	uint32_t capacity = (path->pose_capacity > 0) ? path->pose_capacity : 256;
+	while (capacity < pose_count) capacity *= 2;
+	path->poses = realloc(path->poses, sizeof(camera_path_pose_t) * capacity);
+	path->lights = realloc(path->lights, sizeof(camera_path_light_t) * path->light_count * capacity);
+	path->timings = realloc(path->timings, sizeof(camera_path_timing_t) * capacity);
+	path->pose_capacity = capacity;
+}
+
+
+void start_camera_path_recording(camera_path_t* path, const scene_specification_t* scene) {
+	destroy_camera_path(path);
+	path->light_count = scene->polygonal_light_count;
+	path->state = camera_path_state_recording;
+	path->start_time = glfwGetTime();
+}
+
+
+int save_camera_path(camera_path_t* path, const char* file_path) {
+	path->state = camera_path_state_idle;
+	FILE* file = fopen(file_path, "wb");
+	if (!file) {
+		printf("Failed to save a camera path. Please check path and permissions: %s\n", file_path);
+		return 1;
+	}
+	uint32_t header[4] = { CAMERA_PATH_FILE_MARKER, CAMERA_PATH_FILE_VERSION, path->pose_count, path->light_count };
+	int result = fwrite(header, sizeof(header), 1, file) != 1
+		|| fwrite(path->poses, sizeof(camera_path_pose_t), path->pose_count, file) != path->pose_count
+		|| fwrite(path->lights, sizeof(camera_path_light_t), path->pose_count * path->light_count, file) != path->pose_count * path->light_count;
+	fclose(file);
+	if (result)
+		printf("Failed to write the camera path to %s.\n", file_path);
+	else
+		printf("Saved a camera path with %u frames to %s.\n", path->pose_count, file_path);
+	return result;
+}
+
+
+int start_camera_path_playback(camera_path_t* path, const char* file_path, const scene_specification_t* scene) {
+	destroy_camera_path(path);
+	FILE* file = fopen(file_path, "rb");
+	if (!file) {
+		printf("Failed to load a camera path. Please check path and permissions: %s\n", file_path);
+		return 1;
+	}
+	uint32_t header[4] = { 0, 0, 0, 0 };
+	if (fread(header, sizeof(header), 1, file) != 1
+		|| header[0] != CAMERA_PATH_FILE_MARKER
+		|| header[1] != CAMERA_PATH_FILE_VERSION)
+	{
+		printf("The file %s is not a valid camera path.\n", file_path);
+		fclose(file);
+		return 1;
+	}
+	if (header[3] != scene->polygonal_light_count) {
+		printf("The camera path at %s has %u polygonal lights but the scene has %u. Please quick load the matching lights.\n", file_path, header[3], scene->polygonal_light_count);
+		fclose(file);
+		return 1;
+	}
+	path->light_count = header[3];
+	reserve_camera_path_poses(path, header[2]);
+	path->pose_count = header[2];
+	if (fread(path->poses, sizeof(camera_path_pose_t), path->pose_count, file) != path->pose_count
+		|| fread(path->lights, sizeof(camera_path_light_t), path->pose_count * path->light_count, file) != path->pose_count * path->light_count)
+	{
+		printf("The camera path at %s is truncated.\n", file_path);
+		fclose(file);
+		destroy_camera_path(path);
+		return 1;
+	}
+	fclose(file);
+	if (path->pose_count > 0)
+		memset(path->timings, 0, sizeof(camera_path_timing_t) * path->pose_count);
+	path->state = camera_path_state_playing;
+	printf("Playing a camera path with %u frames from %s.\n", path->pose_count, file_path);
+	return 0;
+}
+
+
+VkBool32 advance_camera_path(camera_path_t* path, scene_specification_t* scene, uint32_t drain_frame_count) {
+	path->current_frame = 0;
+	if (path->state == camera_path_state_recording) {
+		if (scene->polygonal_light_count != path->light_count) {
+			printf("The number of polygonal lights has changed. Recording of the camera path stops.\n");
+			path->state = camera_path_state_idle;
+			return VK_FALSE;
+		}
+		reserve_camera_path_poses(path, path->pose_count + 1);
+		camera_path_pose_t* pose = &path->poses[path->pose_count];
+		pose->time = (float) (glfwGetTime() - path->start_time);
+		pose->light_animation_time = scene->light_animation_time;
+		pose->camera = scene->camera;
+		// Mouse rotation state must not carry over into playback
+		pose->camera.rotate_camera = 0;
+		for (uint32_t i = 0; i != path->light_count; ++i) {
+			const polygonal_light_t* light = &scene->polygonal_lights[i];
+			camera_path_light_t* state = &path->lights[path->pose_count * path->light_count + i];
+			memcpy(state->rotation_angles, light->rotation_angles, sizeof(state->rotation_angles));
+			memcpy(state->translation, light->translation, sizeof(state->translation));
+			memcpy(state->radiant_flux, light->radiant_flux, sizeof(state->radiant_flux));
+			state->scaling_x = light->scaling_x;
+			state->scaling_y = light->scaling_y;
+		}
+		++path->pose_count;
+		return VK_FALSE;
+	}
+	else if (path->state == camera_path_state_playing) {
+		// Attribute the time since the previous frame started to that frame
+		double now = glfwGetTime();
+		if (path->next_frame > 0 && path->next_frame <= path->pose_count)
+			path->timings[path->next_frame - 1].frame_time = (float) (now - path->previous_frame_start_time);
+		path->previous_frame_start_time = now;
+		// Keep the last pose while frames in flight finish, then stop
+		if (path->next_frame >= path->pose_count + drain_frame_count || scene->polygonal_light_count != path->light_count) {
+			path->state = camera_path_state_idle;
+			return VK_TRUE;
+		}
+		if (path->next_frame < path->pose_count) {
+			const camera_path_pose_t* pose = &path->poses[path->next_frame];
+			scene->camera = pose->camera;
+			scene->light_animation_time = pose->light_animation_time;
+			for (uint32_t i = 0; i != path->light_count; ++i) {
+				polygonal_light_t* light = &scene->polygonal_lights[i];
+				const camera_path_light_t* state = &path->lights[path->next_frame * path->light_count + i];
+				memcpy(light->rotation_angles, state->rotation_angles, sizeof(state->rotation_angles));
+				memcpy(light->translation, state->translation, sizeof(state->translation));
+				memcpy(light->radiant_flux, state->radiant_flux, sizeof(state->radiant_flux));
+				light->scaling_x = state->scaling_x;
+				light->scaling_y = state->scaling_y;
+			}
+			path->current_frame = path->next_frame + 1;
+		}
+		++path->next_frame;
+	}
+	return VK_FALSE;
+}
+
+
+void report_camera_path_timings(const camera_path_t* path, const char* timings_path) {
+	if (path->pose_count == 0) {
+		printf("The camera path is empty.\n");
+		return;
+	}
+	// Write all timings in milliseconds
+	FILE* file = fopen(timings_path, "w");
+	if (file) {
+		fprintf(file, "frame,path_time,camera_x,camera_y,camera_z,frame_time,cpu_time,geometry_pass_time,shading_pass_time,acceleration_structure_update_time\n");
+		for (uint32_t i = 0; i != path->pose_count; ++i) {
+			const camera_path_pose_t* pose = &path->poses[i];
+			const camera_path_timing_t* timing = &path->timings[i];
+			fprintf(file, "%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", i, pose->time,
+				pose->camera.position_world_space[0], pose->camera.position_world_space[1], pose->camera.position_world_space[2],
+				timing->frame_time * 1000.0f, timing->cpu_time * 1000.0f, timing->geometry_pass_time * 1000.0f,
+				timing->shading_pass_time * 1000.0f, timing->acceleration_structure_update_time * 1000.0f);
+		}
+		fclose(file);
+		printf("Wrote timings of %u frames to %s.\n", path->pose_count, timings_path);
+	}
+	else
+		printf("Failed to write camera path timings. Please check path and permissions: %s\n", timings_path);
+	// Average GPU and CPU times per segment
+	uint32_t segment_count = (path->pose_count + CAMERA_PATH_SEGMENT_FRAME_COUNT - 1) / CAMERA_PATH_SEGMENT_FRAME_COUNT;
+	float* gpu_times = malloc(sizeof(float) * segment_count);
+	float* cpu_times = malloc(sizeof(float) * segment_count);
+	float total_gpu_time = 0.0f, total_cpu_time = 0.0f, total_frame_time = 0.0f;
+	for (uint32_t i = 0; i != segment_count; ++i) {
+		uint32_t begin = i * CAMERA_PATH_SEGMENT_FRAME_COUNT;
+		uint32_t end = begin + CAMERA_PATH_SEGMENT_FRAME_COUNT;
+		end = (end < path->pose_count) ? end : path->pose_count;
+		gpu_times[i] = cpu_times[i] = 0.0f;
+		for (uint32_t j = begin; j != end; ++j) {
+			const camera_path_timing_t* timing = &path->timings[j];
+			gpu_times[i] += timing->geometry_pass_time + timing->shading_pass_time + timing->acceleration_structure_update_time;
+			cpu_times[i] += timing->cpu_time;
+			total_frame_time += timing->frame_time;
+		}
+		total_gpu_time += gpu_times[i];
+		total_cpu_time += cpu_times[i];
+		gpu_times[i] /= (float) (end - begin);
+		cpu_times[i] /= (float) (end - begin);
+	}
+	float rcp_pose_count = 1.0f / (float) path->pose_count;
+	printf("Camera path averages: %.3f ms frame time, %.3f ms GPU, %.3f ms CPU.\n",
+		total_frame_time * rcp_pose_count * 1000.0f, total_gpu_time * rcp_pose_count * 1000.0f, total_cpu_time * rcp_pose_count * 1000.0f);
+	// Report the slowest segments in terms of GPU time
+	printf("Slowest segments of %u frames:\n", CAMERA_PATH_SEGMENT_FRAME_COUNT);
+	for (uint32_t i = 0; i != CAMERA_PATH_REPORTED_SEGMENT_COUNT && i != segment_count; ++i) {
+		uint32_t slowest = 0;
+		for (uint32_t j = 1; j != segment_count; ++j)
+			if (gpu_times[j] > gpu_times[slowest])
+				slowest = j;
+		const camera_path_pose_t* pose = &path->poses[slowest * CAMERA_PATH_SEGMENT_FRAME_COUNT];
+		printf("Frames %u+: %.3f ms GPU, %.3f ms CPU, camera at (%.2f, %.2f, %.2f) at %.2f s.\n",
+			slowest * CAMERA_PATH_SEGMENT_FRAME_COUNT, gpu_times[slowest] * 1000.0f, cpu_times[slowest] * 1000.0f,
+			pose->camera.position_world_space[0], pose->camera.position_world_space[1], pose->camera.position_world_space[2], pose->time);
+		gpu_times[slowest] = -1.0f;
+	}
+	free(gpu_times);
+	free(cpu_times);
+}
+
+
+void destroy_camera_path(camera_path_t* path) {
+	free(path->poses);
+	free(path->lights);
+	free(path->timings);
+	memset(path, 0, sizeof(*path));
+}
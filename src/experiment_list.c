@@ -515,6 +515,132 @@ void create_experiment_list(experiment_list_t* list) {
 		++count;
 	}
 
+	// A generated scene, whose geometry takes roughly ten times the size of
+	// the pool for streamed geometry. Create it using:
+	// scene_generator grid data/stress_grid -triangles 50000000
+	// vks_opt data/stress_grid.vks data/stress_grid_streamed.vks -chunk_size 16384 -lod_levels 3
+	if (VK_FALSE) {
+		render_settings_t settings_base = {
+			.exposure_factor = 8.0f, .roughness_factor = 1.0f, .sample_count = 1,
+			.sampling_strategies = sampling_strategies_diffuse_only,
+			.polygon_sampling_technique = sample_polygon_projected_solid_angle,
+			.error_min_exponent = -7.0f,
+			.noise_type = noise_type_ahmed, .animate_noise = VK_FALSE,
+			.trace_shadow_rays = VK_FALSE, .show_polygonal_lights = VK_TRUE,
+			.select_lods = VK_TRUE, .lod_pixel_error = 1.0f, .cull_chunks = VK_TRUE,
+			.geometry_pool_size = 256,
+		};
+		experiment_t stress_base = {
+			.scene_index = scene_streaming_stress_test,
+			.width = 1920, .height = 1080,
+			.render_settings = settings_base
+		};
+		experiments[count] = stress_base;
+		experiments[count].screenshot_path = copy_string("data/experiments/streaming_stress_test_256_mib_%.3f.png");
+		++count;
+		// Without streaming for comparison
+		experiments[count] = stress_base;
+		experiments[count].screenshot_path = copy_string("data/experiments/streaming_stress_test_resident_%.3f.png");
+		experiments[count].render_settings.geometry_pool_size = 0;
+		++count;
+	}
+
+	// Compares filtering of material textures with ray differentials and
+	// different anisotropy to isotropic filtering with ray cones in Bistro
+	if (VK_FALSE) {
+		render_settings_t settings_base = {
+			.exposure_factor = 8.0f, .roughness_factor = 1.0f, .sample_count = 1,
+			.sampling_strategies = sampling_strategies_diffuse_specular_mis,
+			.mis_heuristic = mis_heuristic_optimal_clamped,
+			.polygon_sampling_technique = sample_polygon_projected_solid_angle,
+			.error_min_exponent = -7.0f,
+			.noise_type = noise_type_ahmed, .animate_noise = VK_FALSE,
+			.trace_shadow_rays = VK_TRUE, .show_polygonal_lights = VK_TRUE,
+			.max_anisotropy = 16,
+		};
+		experiment_t bistro_base = {
+			.scene_index = scene_bistro_outside,
+			.width = 1920, .height = 1080,
+			.render_settings = settings_base
+		};
+		uint32_t anisotropies[] = { 16, 4, 1 };
+		for (uint32_t i = 0; i != COUNT_OF(anisotropies); ++i) {
+			experiments[count] = bistro_base;
+			experiments[count].screenshot_path = format_uint("data/experiments/bistro_texture_filtering_anisotropy_%u_%%.3f.png", anisotropies[i]);
+			experiments[count].render_settings.max_anisotropy = anisotropies[i];
+			++count;
+		}
+		experiments[count] = bistro_base;
+		experiments[count].screenshot_path = copy_string("data/experiments/bistro_texture_filtering_ray_cones_%.3f.png");
+		experiments[count].render_settings.ray_cone_texture_lod = VK_TRUE;
+		++count;
+	}
+
+	// Measures the per-frame cost of updating the acceleration structure of
+	// Bistro, i.e. what animated instances or deforming geometry would cost
+	if (VK_FALSE) {
+		render_settings_t settings_base = {
+			.exposure_factor = 8.0f, .roughness_factor = 1.0f, .sample_count = 1,
+			.sampling_strategies = sampling_strategies_diffuse_specular_mis,
+			.mis_heuristic = mis_heuristic_optimal_clamped,
+			.polygon_sampling_technique = sample_polygon_projected_solid_angle,
+			.error_min_exponent = -7.0f,
+			.noise_type = noise_type_ahmed, .animate_noise = VK_FALSE,
+			.trace_shadow_rays = VK_TRUE, .show_polygonal_lights = VK_TRUE,
+			.max_anisotropy = 16, .full_rebuild_interval = 64,
+		};
+		experiment_t bistro_base = {
+			.scene_index = scene_bistro_outside,
+			.width = 1920, .height = 1080,
+			.render_settings = settings_base
+		};
+		const char* update_names[] = { "static", "top_level", "refit" };
+		for (uint32_t i = 0; i != acceleration_structure_update_count; ++i) {
+			experiments[count] = bistro_base;
+			const char* path_pieces[] = { "data/experiments/bistro_acceleration_structure_update_", update_names[i], "_%.3f.png" };
+			experiments[count].screenshot_path = concatenate_strings(COUNT_OF(path_pieces), path_pieces);
+			experiments[count].render_settings.acceleration_structure_update = (acceleration_structure_update_t) i;
+			++count;
+		}
+		// Rebuild the bottom level from scratch each frame
+		experiments[count] = bistro_base;
+		experiments[count].screenshot_path = copy_string("data/experiments/bistro_acceleration_structure_update_rebuild_%.3f.png");
+		experiments[count].render_settings.acceleration_structure_update = acceleration_structure_update_refit;
+		experiments[count].render_settings.full_rebuild_interval = 0;
+		++count;
+	}
+
+	// Compares shading of distant lights as point lights for different
+	// thresholds on the subtended solid angle to the full polygon sampling
+	// technique in Bistro. The first screenshot is the reference for errors.
+	if (VK_FALSE) {
+		render_settings_t settings_base = {
+			.exposure_factor = 8.0f, .roughness_factor = 1.0f, .sample_count = 1,
+			.sampling_strategies = sampling_strategies_diffuse_specular_mis,
+			.mis_heuristic = mis_heuristic_optimal_clamped,
+			.polygon_sampling_technique = sample_polygon_projected_solid_angle,
+			.error_min_exponent = -7.0f,
+			.noise_type = noise_type_ahmed, .animate_noise = VK_FALSE,
+			.trace_shadow_rays = VK_TRUE, .show_polygonal_lights = VK_TRUE,
+			.max_anisotropy = 16,
+		};
+		experiment_t bistro_base = {
+			.scene_index = scene_bistro_outside,
+			.width = 1920, .height = 1080,
+			.render_settings = settings_base
+		};
+		float solid_angles[] = { 0.0f, 1.0e-4f, 1.0e-3f, 1.0e-2f };
+		for (uint32_t i = 0; i != COUNT_OF(solid_angles); ++i) {
+			experiments[count] = bistro_base;
+			char* solid_angle = format_float("%.0e", solid_angles[i]);
+			const char* path_pieces[] = { "data/experiments/bistro_light_lod_", solid_angle, "_%.3f.png" };
+			experiments[count].screenshot_path = concatenate_strings(COUNT_OF(path_pieces), path_pieces);
+			free(solid_angle);
+			experiments[count].render_settings.light_lod_solid_angle = solid_angles[i];
+			++count;
+		}
+	}
+
 	// Update the file ending for HDR screenshots
 	if (take_hdr_screenshots) {
 		for (uint32_t i = 0; i != count; ++i) {
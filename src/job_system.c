@@ -0,0 +1,412 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "job_system.h"
+#include "tool_threads.h"
+#include <string.h>
+
+
+//! A mutex along with a condition variable (if needed)
+typedef struct job_lock_s {
+#ifdef _WIN32
+	CRITICAL_SECTION mutex;
+	CONDITION_VARIABLE condition;
+#else
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;
+#endif
+} job_lock_t;
+
+
+void create_job_lock(job_lock_t* lock) {
+#ifdef _WIN32
+	InitializeCriticalSection(&lock->mutex);
+	InitializeConditionVariable(&lock->condition);
+#else
+	pthread_mutex_init(&lock->mutex, NULL);
+	pthread_cond_init(&lock->condition, NULL);
+#endif
+}
+
+
+void destroy_job_lock(job_lock_t* lock) {
+#ifdef _WIN32
+	DeleteCriticalSection(&lock->mutex);
+#else
+	pthread_mutex_destroy(&lock->mutex);
+	pthread_cond_destroy(&lock->condition);
+#endif
+}
+
+
+void acquire_job_lock(job_lock_t* lock) {
+#ifdef _WIN32
+	EnterCriticalSection(&lock->mutex);
+#else
+	pthread_mutex_lock(&lock->mutex);
+#endif
+}
+
+
+void release_job_lock(job_lock_t* lock) {
+#ifdef _WIN32
+	LeaveCriticalSection(&lock->mutex);
+#else
+	pthread_mutex_unlock(&lock->mutex);
+#endif
+}
+
+
+//! Releases the lock, waits for a signal and acquires it again
+void wait_for_job_lock(job_lock_t* lock) {
+#ifdef _WIN32
+	SleepConditionVariableCS(&lock->condition, &lock->mutex, INFINITE);
+#else
+	pthread_cond_wait(&lock->condition, &lock->mutex);
+#endif
+}
+
+
+//! Wakes all threads waiting in wait_for_job_lock()
+void signal_job_lock(job_lock_t* lock) {
+#ifdef _WIN32
+	WakeAllConditionVariable(&lock->condition);
+#else
+	pthread_cond_broadcast(&lock->condition);
+#endif
+}
+
+
+/*! The ready jobs of one thread. The owner pushes and pops at the end, other
+	threads steal at the beginning. Since each job gets pushed once, room for
+	all jobs of the graph suffices and indices never wrap around.*/
+typedef struct job_deque_s {
+	job_lock_t lock;
+	//! Indices of jobs in the graph
+	uint32_t* entries;
+	//! The range of valid entries
+	uint32_t begin, end;
+} job_deque_t;
+
+
+//! State shared by all threads while run_job_graph() executes
+typedef struct job_scheduler_s {
+	job_graph_t* graph;
+	//! One deque per thread
+	uint32_t thread_count;
+	job_deque_t* deques;
+	/*! Protects dependency counters, remaining_count and pushes to deques.
+		Idle threads wait on its condition variable.*/
+	job_lock_t lock;
+	//! The number of jobs that have not finished yet
+	uint32_t remaining_count;
+} job_scheduler_t;
+
+
+//! The argument of a single thread in run_job_graph()
+typedef struct job_worker_s {
+	job_scheduler_t* scheduler;
+	uint32_t thread_index;
+} job_worker_t;
+
+
+uint32_t add_job(job_graph_t* graph, job_function_t function, void* argument) {
+	if (graph->job_count == graph->job_capacity) {
+		graph->job_capacity = (graph->job_capacity > 0) ? (2 * graph->job_capacity) : 16;
+		graph->jobs = realloc(graph->jobs, sizeof(job_t) * graph->job_capacity);
+	}
+	job_t job = { .function = function, .argument = argument };
+	graph->jobs[graph->job_count] = job;
+	return graph->job_count++;
+}
+
+
+void add_job_dependency(job_graph_t* graph, uint32_t job, uint32_t prerequisite) {
+	if (prerequisite >= job) {
+		printf("Job %u cannot depend on job %u, which was added later. The dependency is ignored.\n", job, prerequisite);
+		return;
+	}
+	job_t* source = &graph->jobs[prerequisite];
+	source->dependents = realloc(source->dependents, sizeof(uint32_t) * (source->dependent_count + 1));
+	source->dependents[source->dependent_count] = job;
+	++source->dependent_count;
+	++graph->jobs[job].pending_count;
+}
+
+
+//! Appends a job to the given deque. The caller must hold the lock of the
+//! scheduler (or be the only running thread).
+void push_job(job_deque_t* deque, uint32_t job) {
+	acquire_job_lock(&deque->lock);
+	deque->entries[deque->end] = job;
+	++deque->end;
+	release_job_lock(&deque->lock);
+}
+
+
+//! Takes the most recently added job (if own is true) or the oldest job
+//! from the given deque
+//! \return 1 if a job was taken, 0 if the deque is empty.
+int take_job(job_deque_t* deque, int own, uint32_t* job) {
+	int result = 0;
+	acquire_job_lock(&deque->lock);
+	if (deque->begin != deque->end) {
+		if (own) {
+			--deque->end;
+			(*job) = deque->entries[deque->end];
+		}
+		else {
+			(*job) = deque->entries[deque->begin];
+			++deque->begin;
+		}
+		result = 1;
+	}
+	release_job_lock(&deque->lock);
+	return result;
+}
+
+
+//! Executes the given job and makes dependents ready
+void execute_job(job_scheduler_t* scheduler, uint32_t thread_index, uint32_t job_index) {
+	job_t* job = &scheduler->graph->jobs[job_index];
+	job->result = job->prerequisite_failed ? 1 : job->function(job->argument);
+	acquire_job_lock(&scheduler->lock);
+	for (uint32_t i = 0; i != job->dependent_count; ++i) {
+		job_t* dependent = &scheduler->graph->jobs[job->dependents[i]];
+		dependent->prerequisite_failed |= (job->result != 0);
+		--dependent->pending_count;
+		if (dependent->pending_count == 0)
+			push_job(&scheduler->deques[thread_index], job->dependents[i]);
+	}
+	--scheduler->remaining_count;
+	// Idle threads may steal new jobs or they may have to exit
+	if (job->dependent_count > 0 || scheduler->remaining_count == 0)
+		signal_job_lock(&scheduler->lock);
+	release_job_lock(&scheduler->lock);
+}
+
+
+//! The loop run by each thread until all jobs of the graph are done
+void run_job_worker(void* argument) {
+	job_worker_t* worker = (job_worker_t*) argument;
+	job_scheduler_t* scheduler = worker->scheduler;
+	while (1) {
+		// Work on own jobs first, then steal from others
+		uint32_t job;
+		int found = take_job(&scheduler->deques[worker->thread_index], 1, &job);
+		for (uint32_t i = 1; i != scheduler->thread_count && !found; ++i)
+			found = take_job(&scheduler->deques[(worker->thread_index + i) % scheduler->thread_count], 0, &job);
+		if (found) {
+			execute_job(scheduler, worker->thread_index, job);
+			continue;
+		}
+		// Sleep until there is something to steal or everything is done.
+		// Pushes happen under the lock of the scheduler, so no signal gets
+		// lost.
+		acquire_job_lock(&scheduler->lock);
+		int any_ready = 0;
+		for (uint32_t i = 0; i != scheduler->thread_count && !any_ready; ++i) {
+			job_deque_t* deque = &scheduler->deques[i];
+			acquire_job_lock(&deque->lock);
+			any_ready = (deque->begin != deque->end);
+			release_job_lock(&deque->lock);
+		}
+		int done = (scheduler->remaining_count == 0);
+		if (!any_ready && !done)
+			wait_for_job_lock(&scheduler->lock);
+		release_job_lock(&scheduler->lock);
+		if (done)
+			break;
+	}
+}
+
+
+int run_job_graph(job_graph_t* graph, uint32_t thread_count) {
+	if (graph->job_count == 0)
+		return 0;
+	if (thread_count == 0)
+		thread_count = get_hardware_thread_count();
+	if (thread_count > graph->job_count)
+		thread_count = graph->job_count;
+	// Create the scheduler and one deque per thread
+	job_scheduler_t scheduler = {
+		.graph = graph,
+		.thread_count = thread_count,
+		.remaining_count = graph->job_count,
+	};
+	create_job_lock(&scheduler.lock);
+	scheduler.deques = malloc(sizeof(job_deque_t) * thread_count);
+	job_worker_t* workers = malloc(sizeof(job_worker_t) * thread_count);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		job_deque_t* deque = &scheduler.deques[i];
+		memset(deque, 0, sizeof(*deque));
+		create_job_lock(&deque->lock);
+		deque->entries = malloc(sizeof(uint32_t) * graph->job_count);
+		workers[i].scheduler = &scheduler;
+		workers[i].thread_index = i;
+	}
+	// Distribute jobs without prerequisites round robin
+	uint32_t ready_count = 0;
+	for (uint32_t i = 0; i != graph->job_count; ++i) {
+		if (graph->jobs[i].pending_count == 0) {
+			push_job(&scheduler.deques[ready_count % thread_count], i);
+			++ready_count;
+		}
+	}
+	run_in_parallel(thread_count, run_job_worker, workers, sizeof(job_worker_t));
+	// Clean up and gather results
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		destroy_job_lock(&scheduler.deques[i].lock);
+		free(scheduler.deques[i].entries);
+	}
+	free(scheduler.deques);
+	free(workers);
+	destroy_job_lock(&scheduler.lock);
+	int result = 0;
+	for (uint32_t i = 0; i != graph->job_count; ++i)
+		result |= (graph->jobs[i].result != 0);
+	return result;
+}
+
+
+void create_retry_job_graph(job_graph_t* retry_graph, const job_graph_t* graph) {
+	memset(retry_graph, 0, sizeof(*retry_graph));
+	// Failed jobs keep their order, so prerequisites still come first
+	uint32_t* retry_indices = malloc(sizeof(uint32_t) * graph->job_count);
+	for (uint32_t i = 0; i != graph->job_count; ++i)
+		if (graph->jobs[i].result != 0)
+			retry_indices[i] = add_job(retry_graph, graph->jobs[i].function, graph->jobs[i].argument);
+	// Dependents of failed jobs have failed too
+	for (uint32_t i = 0; i != graph->job_count; ++i)
+		if (graph->jobs[i].result != 0)
+			for (uint32_t j = 0; j != graph->jobs[i].dependent_count; ++j)
+				add_job_dependency(retry_graph, retry_indices[graph->jobs[i].dependents[j]], retry_indices[i]);
+	free(retry_indices);
+}
+
+
+void destroy_job_graph(job_graph_t* graph) {
+	for (uint32_t i = 0; i != graph->job_count; ++i)
+		free(graph->jobs[i].dependents);
+	free(graph->jobs);
+	memset(graph, 0, sizeof(*graph));
+}
+
+
+//! A function handed to a job thread by run_on_job_thread()
+typedef struct job_thread_call_s {
+	job_function_t function;
+	void* argument;
+	//! The return value of the function
+	int result;
+	//! Set once the function has returned
+	int done;
+	//! The call that was handed over next or NULL
+	struct job_thread_call_s* next;
+} job_thread_call_t;
+
+
+struct job_thread_s {
+	//! The started thread and whether starting it succeeded
+	tool_thread_t thread;
+	int started;
+	/*! Protects everything below. The thread waits on its condition variable
+		for calls, callers wait on it for the result.*/
+	job_lock_t lock;
+	//! A queue of calls that have not run yet. last_call points to the next
+	//! member of its last entry or to first_call.
+	job_thread_call_t* first_call;
+	job_thread_call_t** last_call;
+	//! Set by destroy_job_thread()
+	int stop;
+};
+
+
+//! The loop run by a job thread until it is stopped
+void run_job_thread(void* argument) {
+	job_thread_t* thread = (job_thread_t*) argument;
+	acquire_job_lock(&thread->lock);
+	while (1) {
+		while (!thread->first_call && !thread->stop)
+			wait_for_job_lock(&thread->lock);
+		if (!thread->first_call)
+			break;
+		job_thread_call_t* call = thread->first_call;
+		thread->first_call = call->next;
+		if (!thread->first_call)
+			thread->last_call = &thread->first_call;
+		release_job_lock(&thread->lock);
+		call->result = call->function(call->argument);
+		acquire_job_lock(&thread->lock);
+		call->done = 1;
+		signal_job_lock(&thread->lock);
+	}
+	release_job_lock(&thread->lock);
+}
+
+
+job_thread_t* create_job_thread(void) {
+	job_thread_t* thread = malloc(sizeof(job_thread_t));
+	memset(thread, 0, sizeof(*thread));
+	create_job_lock(&thread->lock);
+	thread->last_call = &thread->first_call;
+	thread->thread.function = run_job_thread;
+	thread->thread.argument = thread;
+#ifdef _WIN32
+	thread->thread.handle = CreateThread(NULL, 0, tool_thread_entry, &thread->thread, 0, NULL);
+	thread->started = (thread->thread.handle != NULL);
+#else
+	thread->started = (pthread_create(&thread->thread.handle, NULL, tool_thread_entry, &thread->thread) == 0);
+#endif
+	return thread;
+}
+
+
+int run_on_job_thread(job_thread_t* thread, job_function_t function, void* argument) {
+	job_thread_call_t call = { .function = function, .argument = argument };
+	acquire_job_lock(&thread->lock);
+	// Without a thread, the lock still serializes the calls
+	if (!thread->started) {
+		call.result = function(argument);
+		release_job_lock(&thread->lock);
+		return call.result;
+	}
+	(*thread->last_call) = &call;
+	thread->last_call = &call.next;
+	signal_job_lock(&thread->lock);
+	while (!call.done)
+		wait_for_job_lock(&thread->lock);
+	release_job_lock(&thread->lock);
+	return call.result;
+}
+
+
+void destroy_job_thread(job_thread_t* thread) {
+	if (thread->started) {
+		acquire_job_lock(&thread->lock);
+		thread->stop = 1;
+		signal_job_lock(&thread->lock);
+		release_job_lock(&thread->lock);
+#ifdef _WIN32
+		WaitForSingleObject(thread->thread.handle, INFINITE);
+		CloseHandle(thread->thread.handle);
+#else
+		pthread_join(thread->thread.handle, NULL);
+#endif
+	}
+	destroy_job_lock(&thread->lock);
+	free(thread);
+}
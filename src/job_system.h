@@ -0,0 +1,103 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+#include <stdint.h>
+
+
+//! Signature of functions that can be run as jobs. They return 0 on success.
+typedef int (*job_function_t)(void* argument);
+
+
+//! A single job in a job graph along with its dependencies
+typedef struct job_s {
+	//! The function to invoke and its argument
+	job_function_t function;
+	void* argument;
+	//! The return value of the function once the job has finished. If a
+	//! prerequisite failed, the function is not invoked and this is 1.
+	int result;
+	//! The number of prerequisites that have not finished yet. The job
+	//! becomes ready to run once this reaches zero.
+	uint32_t pending_count;
+	//! Whether any prerequisite has failed
+	int prerequisite_failed;
+	//! The number of jobs that depend on this one and their indices
+	uint32_t dependent_count;
+	uint32_t* dependents;
+} job_t;
+
+
+/*! A directed acyclic graph of jobs. run_job_graph() executes it on a pool of
+	threads. Each thread owns a deque of ready jobs, works on its most
+	recently added job and steals the oldest jobs of other threads once its
+	own deque is empty. Jobs whose prerequisites have all finished get added
+	to the deque of the thread that finished the last of them.*/
+typedef struct job_graph_s {
+	//! The number of jobs and the number of jobs for which memory has been
+	//! allocated
+	uint32_t job_count, job_capacity;
+	//! Array of job_count jobs
+	job_t* jobs;
+} job_graph_t;
+
+
+//! Adds a job, which invokes the given function with the given argument, to
+//! the given graph (which may be zero-initialized) and returns its index
+uint32_t add_job(job_graph_t* graph, job_function_t function, void* argument);
+
+/*! Makes sure that the job with index job only runs once the job with index
+	prerequisite has finished successfully. The prerequisite has to be added
+	to the graph before the job, which rules out cycles.*/
+void add_job_dependency(job_graph_t* graph, uint32_t job, uint32_t prerequisite);
+
+/*! Runs all jobs of the given graph and returns once all of them have
+	finished. The calling thread participates.
+	\param thread_count The number of threads to use (including the calling
+		one). Zero means one per hardware thread.
+	\return 0 if all jobs have returned 0.*/
+int run_job_graph(job_graph_t* graph, uint32_t thread_count);
+
+/*! After run_job_graph() has failed, this function fills retry_graph with
+	all jobs of graph that failed or did not run because a prerequisite
+	failed, along with the dependencies among them. Running it attempts the
+	failed part of the work once more.
+	\param retry_graph Output. Destroy it using destroy_job_graph().
+	\param graph A graph that has been run.*/
+void create_retry_job_graph(job_graph_t* retry_graph, const job_graph_t* graph);
+
+//! Frees memory and zeros the object
+void destroy_job_graph(job_graph_t* graph);
+
+
+/*! An opaque thread that runs functions handed over by other threads one
+	after the other. It serializes access to a resource that does not allow
+	concurrent use, e.g. a queue, and callers never wait for more than the
+	functions that run before their own.*/
+typedef struct job_thread_s job_thread_t;
+
+//! Starts a job thread. Destroy it using destroy_job_thread().
+job_thread_t* create_job_thread(void);
+
+/*! Hands the given function to the given job thread and blocks until it has
+	returned. Any number of threads may call this at once. If the job thread
+	could not be started, the calling thread runs the function.
+	\return The return value of the function.*/
+int run_on_job_thread(job_thread_t* thread, job_function_t function, void* argument);
+
+//! Lets the given job thread finish, joins it and frees it. No calls to
+//! run_on_job_thread() may be pending.
+void destroy_job_thread(job_thread_t* thread);
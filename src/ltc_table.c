@@ -24,6 +24,7 @@ int load_ltc_table(ltc_table_t* table, const device_t* device, const char* direc
 	memset(table, 0, sizeof(*table));
 	table->fresnel_count = fresnel_count;
 	buffers_t staging;
+	memset(&staging, 0, sizeof(staging));
 	uint16_t* staging_data[2];
 	uint32_t channel_counts[2] = { 4, 2 };
 	uint32_t slice_sizes[2];
@@ -17,13 +17,16 @@
 #include "main.h"
 #include "math_utilities.h"
 #include "string_utilities.h"
+#include "job_system.h"
 #include "frame_timer.h"
 #include "user_interface.h"
 #include "textures.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
+#include "baked_visibility_format.h"
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 
 /*! GLFW callbacks do not support passing a user-defined pointer. Thus, we have
@@ -41,6 +44,7 @@ const char* const g_scene_paths[][4] = {
 	{"Attic", "data/attic.vks", "data/attic_textures", "data/quicksaves/attic.save"},
 	{"Bistro inside", "data/Bistro_inside.vks", "data/Bistro_textures", "data/quicksaves/Bistro_inside.save"},
 	{"Bistro outside", "data/Bistro_outside.vks", "data/Bistro_textures", "data/quicksaves/Bistro_outside.save"},
+	{"Streaming stress test", "data/stress_grid_streamed.vks", "data/stress_grid_textures", "data/stress_grid.save"},
 };
 
 
@@ -72,6 +76,12 @@ void quick_save(scene_specification_t* scene) {
 		fwrite(null_pointers, sizeof(float*), 2, file);
 		fwrite(light->vertices_plane_space, sizeof(float), 4 * light->vertex_count, file);
 	}
+	// Keyframes go to the end such that older files remain readable
+	for (uint32_t i = 0; i != scene->polygonal_light_count; ++i) {
+		polygonal_light_t* light = &scene->polygonal_lights[i];
+		fwrite(&light->keyframe_count, sizeof(uint32_t), 1, file);
+		fwrite(light->keyframes, sizeof(polygonal_light_keyframe_t), light->keyframe_count, file);
+	}
 	fclose(file);
 }
 
@@ -111,7 +121,7 @@ void quick_load(scene_specification_t* scene, application_updates_t* updates) {
 		if (path_size) {
 			light->texture_file_path = malloc(sizeof(char) * path_size);
 			fread(light->texture_file_path, sizeof(char), path_size, file);
-			if (i < old_polygonal_light_count && old_polygonal_lights[i].texture_file_path != NULL && strcmp(light->texture_file_path, old_polygonal_lights[i].texture_file_path) != 0)
+			if (updates && i < old_polygonal_light_count && old_polygonal_lights[i].texture_file_path != NULL && strcmp(light->texture_file_path, old_polygonal_lights[i].texture_file_path) != 0)
 				updates->update_light_textures = VK_TRUE;
 		}
 		// Read NULL pointers for backward compatibility
@@ -120,13 +130,30 @@ void quick_load(scene_specification_t* scene, application_updates_t* updates) {
 		// Allocate and read vertex locations
 		set_polygonal_light_vertex_count(light, light->vertex_count);
 		fread(light->vertices_plane_space, sizeof(float), 4 * light->vertex_count, file);
+		light->keyframe_count = 0;
+		light->keyframes = NULL;
+	}
+	// Read keyframes (if any, older files do not have them)
+	VkBool32 keyframes_changed = VK_FALSE;
+	for (uint32_t i = 0; i != scene->polygonal_light_count; ++i) {
+		polygonal_light_t* light = &scene->polygonal_lights[i];
+		uint32_t keyframe_count = 0;
+		if (fread(&keyframe_count, sizeof(uint32_t), 1, file) == 1 && keyframe_count > 0) {
+			light->keyframes = malloc(sizeof(polygonal_light_keyframe_t) * keyframe_count);
+			light->keyframe_count = (uint32_t) fread(light->keyframes, sizeof(polygonal_light_keyframe_t), keyframe_count, file);
+		}
+		keyframes_changed |= light->keyframe_count > 0;
 	}
+	for (uint32_t i = 0; i != old_polygonal_light_count; ++i)
+		keyframes_changed |= old_polygonal_lights[i].keyframe_count > 0;
 	for (uint32_t i = 0; i != old_polygonal_light_count; ++i)
 		destroy_polygonal_light(&old_polygonal_lights[i]);
 	free(old_polygonal_lights);
 	fclose(file);
-	if (updates)
+	if (updates) {
 		updates->update_light_count |= old_polygonal_light_count != scene->polygonal_light_count || vertex_count_changed;
+		updates->update_light_animation |= keyframes_changed;
+	}
 }
 
 
@@ -241,121 +268,172 @@ void specify_default_render_settings(render_settings_t* settings) {
 	settings->error_min_exponent = -7.0f;
 	// This setting will be disabled if the device is unable to trace rays
 	settings->trace_shadow_rays = VK_TRUE;
+	settings->use_baked_visibility = VK_FALSE;
+	settings->ray_cone_texture_lod = VK_FALSE;
+	settings->max_anisotropy = 16;
+	settings->acceleration_structure_update = acceleration_structure_update_none;
+	settings->full_rebuild_interval = 64;
+	settings->pack_material_textures = VK_FALSE;
+	settings->interleave_mesh_attributes = VK_FALSE;
+	settings->compress_geometry = VK_FALSE;
+	settings->select_lods = VK_TRUE;
+	settings->lod_pixel_error = 1.0f;
+	settings->cull_chunks = VK_TRUE;
+	settings->geometry_pool_size = 0;
+	settings->texture_pool_size = 0;
 	settings->show_polygonal_lights = VK_TRUE;
+	settings->animate_lights = VK_TRUE;
 	settings->noise_type = noise_type_ahmed;
 	settings->animate_noise = VK_TRUE;
 	settings->v_sync = VK_TRUE;
+	settings->render_on_demand = VK_TRUE;
 	settings->show_gui = VK_TRUE;
 }
 
 
-//! Frees objects and zeros
-void destroy_render_targets(render_targets_t* render_targets, const device_t* device) {
-	destroy_images(&render_targets->targets_allocation, device);
-	memset(render_targets, 0, sizeof(*render_targets));
-}
-
-//! Creates render targets and associated objects
-int create_render_targets(render_targets_t* targets, const device_t* device, const swapchain_t* swapchain) {
-	memset(targets, 0, sizeof(*targets));
-	VkFormat color_format = VK_FORMAT_R8G8B8A8_UNORM;
-	if (swapchain->format == VK_FORMAT_A2R10G10B10_UNORM_PACK32 || swapchain->format == VK_FORMAT_A2B10G10R10_UNORM_PACK32)
-		color_format = VK_FORMAT_A2R10G10B10_UNORM_PACK32;
-	image_request_t image_requests[] = {
-		{// depth buffer
-			.image_info = {
-				.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-				.imageType = VK_IMAGE_TYPE_2D,
-				.format = VK_FORMAT_D32_SFLOAT,
-				.extent = {swapchain->extent.width, swapchain->extent.height, 1},
-				.mipLevels = 1, .arrayLayers = 1, .samples = 1,
-				.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
-			},
-			.view_info = {
-				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-				.viewType = VK_IMAGE_VIEW_TYPE_2D,
-				.subresourceRange = {
-					.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT
-				}
-			}
-		},
-		{// visibility buffer
-			.image_info = {
-				.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-				.imageType = VK_IMAGE_TYPE_2D,
-				.format = VK_FORMAT_R32_UINT,
-				.extent = {swapchain->extent.width, swapchain->extent.height, 1},
-				.mipLevels = 1, .arrayLayers = 1, .samples = 1,
-				.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT
-			},
-			.view_info = {
-				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-				.viewType = VK_IMAGE_VIEW_TYPE_2D,
-				.subresourceRange = {
-					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT
-				}
-			}
-		},
-	};
-	targets->target_count = COUNT_OF(image_requests);
-	targets->duplicate_count = swapchain->image_count;
-	// Duplicate the requests per swapchain image
-	image_request_t* all_requests = malloc(sizeof(image_requests) * targets->duplicate_count);
-	for (uint32_t i = 0; i != targets->duplicate_count; ++i) {
-		memcpy(all_requests + i * targets->target_count, image_requests, sizeof(image_requests));
-	}
-	if (create_images(&targets->targets_allocation, device, all_requests,
-		targets->target_count * targets->duplicate_count, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
-	{
-		printf("Failed to create render targets.\n");
-		free(all_requests);
-		destroy_render_targets(targets, device);
-		return 1;
-	}
-	free(all_requests);
-	targets->targets = (void*) targets->targets_allocation.images;
-	return 0;
-}
-
-
 //! Frees objects and zeros
 void destroy_constant_buffers(constant_buffers_t* constant_buffers, const device_t* device) {
 	if (constant_buffers->data)
 		vkUnmapMemory(device->device, constant_buffers->buffers.memory);
+	if (constant_buffers->light_data)
+		vkUnmapMemory(device->device, constant_buffers->light_buffers.memory);
 	destroy_buffers(&constant_buffers->buffers, device);
+	destroy_buffers(&constant_buffers->light_buffers, device);
+	free(constant_buffers->light_hashes);
 	memset(constant_buffers, 0, sizeof(*constant_buffers));
 }
 
-//! Allocates constant buffers and maps their memory
+//! Allocates constant buffers and light buffers and maps their memory
 int create_constant_buffers(constant_buffers_t* constant_buffers, const device_t* device, const swapchain_t* swapchain, const scene_specification_t* scene_specification, const render_settings_t* render_settings) {
 	memset(constant_buffers, 0, sizeof(*constant_buffers));
-	// Compute the total size for the constant buffer
-	size_t size = sizeof(per_frame_constants_t);
+	// Compute the size for the light buffer
 	size_t polygonal_light_size = POLYGONAL_LIGHT_FIXED_CONSTANT_BUFFER_SIZE + sizeof(float) * (12 * get_max_polygonal_light_vertex_count(scene_specification) - 8);
-	size += scene_specification->polygonal_light_count * polygonal_light_size;
-	if (scene_specification->polygonal_light_count == 0) size += polygonal_light_size;
-	// Create one constant buffer per swapchain image
+	size_t light_size = scene_specification->polygonal_light_count * polygonal_light_size;
+	if (scene_specification->polygonal_light_count == 0) light_size += polygonal_light_size;
+	// Create one constant buffer and one light buffer per swapchain image.
+	// The light animation pass writes to the light buffers.
 	VkBufferCreateInfo constant_buffer_info = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-		.size = size,
+		.size = sizeof(per_frame_constants_t),
 		.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
 	};
-	VkBufferCreateInfo* constant_buffer_infos = malloc(sizeof(VkBufferCreateInfo) * swapchain->image_count);
-	for (uint32_t i = 0; i != swapchain->image_count; ++i)
-		constant_buffer_infos[i] = constant_buffer_info;
-	if (create_aligned_buffers(&constant_buffers->buffers, device, constant_buffer_infos, swapchain->image_count, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, device->physical_device_properties.limits.nonCoherentAtomSize)) {
+	VkBufferCreateInfo light_buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = light_size,
+		.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+	};
+	VkBufferCreateInfo* buffer_infos = malloc(sizeof(VkBufferCreateInfo) * 2 * swapchain->image_count);
+	for (uint32_t i = 0; i != swapchain->image_count; ++i) {
+		buffer_infos[i] = constant_buffer_info;
+		buffer_infos[swapchain->image_count + i] = light_buffer_info;
+	}
+	VkDeviceSize atom_size = device->physical_device_properties.limits.nonCoherentAtomSize;
+	if (create_aligned_buffers(&constant_buffers->buffers, device, buffer_infos, swapchain->image_count, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, atom_size)
+		|| create_aligned_buffers(&constant_buffers->light_buffers, device, buffer_infos + swapchain->image_count, swapchain->image_count, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, atom_size))
+	{
 		printf("Failed to create constant buffers.\n");
-		free(constant_buffer_infos);
+		free(buffer_infos);
 		destroy_constant_buffers(constant_buffers, device);
 		return 1;
 	}
-	free(constant_buffer_infos);
+	free(buffer_infos);
 	// Map the complete memory
-    if (vkMapMemory(device->device, constant_buffers->buffers.memory, 0, constant_buffers->buffers.size, 0, &constant_buffers->data)) {
+	if (vkMapMemory(device->device, constant_buffers->buffers.memory, 0, constant_buffers->buffers.size, 0, &constant_buffers->data)
+		|| vkMapMemory(device->device, constant_buffers->light_buffers.memory, 0, constant_buffers->light_buffers.size, 0, &constant_buffers->light_data))
+	{
 		printf("Failed to map constant buffers.\n");
 		destroy_constant_buffers(constant_buffers, device);
 		return 1;
 	}
+	// Light buffers get written before their first use
+	constant_buffers->light_hashes = malloc(sizeof(uint64_t) * swapchain->image_count);
+	memset(constant_buffers->light_hashes, 0, sizeof(uint64_t) * swapchain->image_count);
+	return 0;
+}
+
+
+//! Frees objects and zeros
+void destroy_stream_buffers(stream_buffers_t* stream_buffers, const device_t* device) {
+	if (stream_buffers->feedback_data) vkUnmapMemory(device->device, stream_buffers->feedback.memory);
+	if (stream_buffers->staging_data) vkUnmapMemory(device->device, stream_buffers->staging.memory);
+	if (stream_buffers->texture_feedback_data) vkUnmapMemory(device->device, stream_buffers->texture_feedback.memory);
+	destroy_buffers(&stream_buffers->feedback, device);
+	destroy_buffers(&stream_buffers->staging, device);
+	destroy_buffers(&stream_buffers->texture_feedback, device);
+	free(stream_buffers->upload_counts);
+	free(stream_buffers->upload_slots);
+	memset(stream_buffers, 0, sizeof(*stream_buffers));
+}
+
+/*! Creates feedback and staging buffers for each swapchain image if the
+	geometry of the given scene is streamed and feedback buffers if its
+	textures are streamed. Otherwise, the object remains empty.*/
+int create_stream_buffers(stream_buffers_t* stream_buffers, const device_t* device, const swapchain_t* swapchain, const scene_t* scene) {
+	memset(stream_buffers, 0, sizeof(*stream_buffers));
+	const geometry_stream_t* stream = &scene->stream;
+	VkBufferCreateInfo* buffer_infos = malloc(sizeof(VkBufferCreateInfo) * swapchain->image_count);
+	int result = 0;
+	if (scene->materials.stream.texture_count > 0) {
+		VkBufferCreateInfo texture_feedback_info = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = sizeof(uint32_t) * scene->materials.material_count,
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+		};
+		for (uint32_t i = 0; i != swapchain->image_count; ++i)
+			buffer_infos[i] = texture_feedback_info;
+		result = create_aligned_buffers(&stream_buffers->texture_feedback, device, buffer_infos, swapchain->image_count,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, device->physical_device_properties.limits.nonCoherentAtomSize)
+			|| vkMapMemory(device->device, stream_buffers->texture_feedback.memory, 0, stream_buffers->texture_feedback.size, 0, &stream_buffers->texture_feedback_data);
+		if (result) {
+			printf("Failed to create feedback buffers for texture streaming.\n");
+			free(buffer_infos);
+			destroy_stream_buffers(stream_buffers, device);
+			return 1;
+		}
+	}
+	if (!stream->file) {
+		free(buffer_infos);
+		return 0;
+	}
+	// Upload a few MiB per frame, but at least one chunk
+	VkDeviceSize slot_size = (sizeof(uint32_t) * 2 * 3 + sizeof(uint16_t) * 4 * 3 + sizeof(uint8_t)) * stream->slot_triangle_count;
+	stream_buffers->upload_budget = (uint32_t) ((8 * 1024 * 1024) / slot_size);
+	if (stream_buffers->upload_budget == 0) stream_buffers->upload_budget = 1;
+	VkBufferCreateInfo feedback_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = sizeof(uint32_t) * (scene->mesh.triangle_count / STREAM_PAGE_TRIANGLE_COUNT),
+		.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	};
+	VkBufferCreateInfo staging_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = stream_buffers->upload_budget * slot_size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+	};
+	for (uint32_t i = 0; i != swapchain->image_count; ++i)
+		buffer_infos[i] = feedback_info;
+	// The CPU reads feedback, so it should be cached
+	result = create_aligned_buffers(&stream_buffers->feedback, device, buffer_infos, swapchain->image_count,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, device->physical_device_properties.limits.nonCoherentAtomSize);
+	for (uint32_t i = 0; i != swapchain->image_count; ++i)
+		buffer_infos[i] = staging_info;
+	result = result || create_buffers(&stream_buffers->staging, device, buffer_infos, swapchain->image_count,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	free(buffer_infos);
+	if (result) {
+		printf("Failed to create feedback and staging buffers for geometry streaming.\n");
+		destroy_stream_buffers(stream_buffers, device);
+		return 1;
+	}
+	if (vkMapMemory(device->device, stream_buffers->feedback.memory, 0, stream_buffers->feedback.size, 0, &stream_buffers->feedback_data)
+		|| vkMapMemory(device->device, stream_buffers->staging.memory, 0, stream_buffers->staging.size, 0, &stream_buffers->staging_data))
+	{
+		printf("Failed to map feedback and staging buffers for geometry streaming.\n");
+		destroy_stream_buffers(stream_buffers, device);
+		return 1;
+	}
+	stream_buffers->upload_counts = malloc(sizeof(uint32_t) * swapchain->image_count);
+	memset(stream_buffers->upload_counts, 0, sizeof(uint32_t) * swapchain->image_count);
+	stream_buffers->upload_slots = malloc(sizeof(uint32_t) * swapchain->image_count * stream_buffers->upload_budget);
 	return 0;
 }
 
@@ -417,6 +495,220 @@ int create_and_assign_light_textures(images_t* light_textures, const device_t* d
 }
 
 
+//! Frees objects and zeros
+void destroy_baked_visibility(baked_visibility_t* baked_visibility, const device_t* device) {
+	destroy_buffers(&baked_visibility->buffer, device);
+	memset(baked_visibility, 0, sizeof(*baked_visibility));
+}
+
+/*! Loads visibility that has been baked for the current scene and lights (if
+	enabled and available). A missing or outdated file is not an error, the
+	object just remains empty.*/
+int create_baked_visibility(baked_visibility_t* baked_visibility, const device_t* device, const scene_t* scene, const scene_specification_t* scene_specification, const render_settings_t* render_settings) {
+	memset(baked_visibility, 0, sizeof(*baked_visibility));
+	uint32_t light_count = scene_specification->polygonal_light_count;
+	// Streamed geometry does not preserve triangle indices and animated lights
+	// move away from where they were baked
+	if (!render_settings->use_baked_visibility || scene->stream.file || light_count == 0)
+		return 0;
+	for (uint32_t i = 0; i != light_count; ++i)
+		if (scene_specification->polygonal_lights[i].keyframe_count > 0)
+			return 0;
+	const char* path_pieces[] = { scene_specification->quick_save_path, ".vis" };
+	char* file_path = concatenate_strings(COUNT_OF(path_pieces), path_pieces);
+	FILE* file = fopen(file_path, "rb");
+	if (!file) {
+		printf("No baked visibility found at %s. Run the visibility_baker tool to create it.\n", file_path);
+		free(file_path);
+		return 0;
+	}
+	baked_visibility_header_t header;
+	uint64_t light_hash = get_polygonal_light_geometry_hash(scene_specification->polygonal_lights, light_count);
+	if (read_baked_visibility_header(file, &header)
+		|| header.triangle_count != scene->mesh.triangle_count
+		|| header.light_count != light_count
+		|| header.light_hash != light_hash)
+	{
+		printf("The baked visibility at %s does not match the current scene and lights. Shadow rays are traced everywhere.\n", file_path);
+		fclose(file);
+		free(file_path);
+		return 0;
+	}
+	// Read the data into a staging buffer and copy it to the device
+	VkBufferCreateInfo staging_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = sizeof(uint32_t) * header.triangle_count * light_count,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+	};
+	VkBufferCreateInfo buffer_info = staging_info;
+	buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	buffers_t staging;
+	void* staging_data;
+	if (create_buffers(&staging, device, &staging_info, 1, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		|| vkMapMemory(device->device, staging.memory, 0, staging.size, 0, &staging_data))
+	{
+		printf("Failed to create a staging buffer for baked visibility.\n");
+		destroy_buffers(&staging, device);
+		fclose(file);
+		free(file_path);
+		return 1;
+	}
+	size_t entry_count = (size_t) (header.triangle_count * light_count);
+	int read_result = fread(staging_data, sizeof(uint32_t), entry_count, file) != entry_count;
+	vkUnmapMemory(device->device, staging.memory);
+	fclose(file);
+	if (read_result) {
+		printf("Failed to read baked visibility from %s. Shadow rays are traced everywhere.\n", file_path);
+		destroy_buffers(&staging, device);
+		free(file_path);
+		return 0;
+	}
+	free(file_path);
+	VkBufferCopy region = { .size = staging_info.size };
+	int result = create_buffers(&baked_visibility->buffer, device, &buffer_info, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		|| copy_buffers(device, 1, &staging.buffers[0].buffer, &baked_visibility->buffer.buffers[0].buffer, &region);
+	destroy_buffers(&staging, device);
+	if (result) {
+		printf("Failed to upload baked visibility to the device.\n");
+		destroy_baked_visibility(baked_visibility, device);
+		return 1;
+	}
+	baked_visibility->triangle_count = header.triangle_count;
+	baked_visibility->light_hash = light_hash;
+	return 0;
+}
+
+
+//! Frees objects and zeros
+void destroy_light_animation_pass(light_animation_pass_t* pass, const device_t* device) {
+	destroy_pipeline_with_bindings(&pass->pipeline, device);
+	destroy_shader(&pass->compute_shader, device);
+	destroy_buffers(&pass->tracks, device);
+	memset(pass, 0, sizeof(*pass));
+}
+
+/*! Uploads the keyframes of all polygonal lights and creates the compute
+	pipeline that evaluates them. If no light has keyframes, the pass remains
+	empty.*/
+int create_light_animation_pass(light_animation_pass_t* pass, const device_t* device, const swapchain_t* swapchain, const constant_buffers_t* constant_buffers, const scene_specification_t* scene_specification) {
+	memset(pass, 0, sizeof(*pass));
+	uint32_t light_count = scene_specification->polygonal_light_count;
+	uint32_t keyframe_count = 0;
+	for (uint32_t i = 0; i != light_count; ++i) {
+		keyframe_count += scene_specification->polygonal_lights[i].keyframe_count;
+		pass->animated_light_count += (scene_specification->polygonal_lights[i].keyframe_count > 0) ? 1 : 0;
+	}
+	if (pass->animated_light_count == 0)
+		return 0;
+	// Create buffers for tracks and keyframes
+	VkBufferCreateInfo buffer_infos[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = sizeof(uint32_t) * 2 * light_count,
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = sizeof(polygonal_light_keyframe_t) * keyframe_count,
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+		},
+	};
+	if (create_buffers(&pass->tracks, device, buffer_infos, 2, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+		printf("Failed to create buffers for keyframes of polygonal lights.\n");
+		destroy_light_animation_pass(pass, device);
+		return 1;
+	}
+	// Write tracks and keyframes
+	void* data;
+	if (vkMapMemory(device->device, pass->tracks.memory, 0, pass->tracks.size, 0, &data)) {
+		printf("Failed to map buffers for keyframes of polygonal lights.\n");
+		destroy_light_animation_pass(pass, device);
+		return 1;
+	}
+	uint32_t* tracks = (uint32_t*) (((char*) data) + pass->tracks.buffers[0].offset);
+	polygonal_light_keyframe_t* keyframes = (polygonal_light_keyframe_t*) (((char*) data) + pass->tracks.buffers[1].offset);
+	uint32_t keyframe_index = 0;
+	for (uint32_t i = 0; i != light_count; ++i) {
+		const polygonal_light_t* light = &scene_specification->polygonal_lights[i];
+		tracks[2 * i + 0] = keyframe_index;
+		tracks[2 * i + 1] = light->keyframe_count;
+		memcpy(keyframes + keyframe_index, light->keyframes, sizeof(polygonal_light_keyframe_t) * light->keyframe_count);
+		keyframe_index += light->keyframe_count;
+	}
+	vkUnmapMemory(device->device, pass->tracks.memory);
+	// Create one descriptor set per swapchain image
+	VkDescriptorSetLayoutBinding bindings[4];
+	memset(bindings, 0, sizeof(bindings));
+	for (uint32_t i = 0; i != COUNT_OF(bindings); ++i)
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptor_set_request_t set_request = {
+		.stage_flags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.min_descriptor_count = 1,
+		.binding_count = COUNT_OF(bindings),
+		.bindings = bindings,
+	};
+	if (create_descriptor_sets(&pass->pipeline, device, &set_request, swapchain->image_count)) {
+		printf("Failed to create descriptor sets for the light animation pass.\n");
+		destroy_light_animation_pass(pass, device);
+		return 1;
+	}
+	for (uint32_t i = 0; i != swapchain->image_count; ++i) {
+		VkDescriptorBufferInfo constant_buffer_info = { .buffer = constant_buffers->buffers.buffers[i].buffer, .range = constant_buffers->buffers.buffers[i].size };
+		VkDescriptorBufferInfo track_info = { .buffer = pass->tracks.buffers[0].buffer, .range = VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo keyframe_info = { .buffer = pass->tracks.buffers[1].buffer, .range = VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo light_info = { .buffer = constant_buffers->light_buffers.buffers[i].buffer, .range = constant_buffers->light_buffers.buffers[i].size };
+		VkWriteDescriptorSet writes[4] = {
+			{ .dstSet = pass->pipeline.descriptor_sets[i], .dstBinding = 0, .pBufferInfo = &constant_buffer_info },
+			{ .dstSet = pass->pipeline.descriptor_sets[i], .dstBinding = 1, .pBufferInfo = &track_info },
+			{ .dstSet = pass->pipeline.descriptor_sets[i], .dstBinding = 2, .pBufferInfo = &keyframe_info },
+			{ .dstSet = pass->pipeline.descriptor_sets[i], .dstBinding = 3, .pBufferInfo = &light_info },
+		};
+		complete_descriptor_set_write(COUNT_OF(writes), writes, &set_request);
+		vkUpdateDescriptorSets(device->device, COUNT_OF(writes), writes, 0, NULL);
+	}
+	// Compile the compute shader
+	char* defines[] = {
+		format_uint("POLYGONAL_LIGHT_COUNT=%u", light_count),
+		format_uint("POLYGONAL_LIGHT_ARRAY_SIZE=%u", light_count),
+		format_uint("MAX_POLYGONAL_LIGHT_VERTEX_COUNT=%u", get_max_polygonal_light_vertex_count(scene_specification)),
+	};
+	shader_request_t shader_request = {
+		.shader_file_path = "src/shaders/animate_lights.comp.glsl",
+		.include_path = "src/shaders",
+		.entry_point = "main",
+		.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+		.define_count = COUNT_OF(defines),
+		.defines = defines
+	};
+	int compile_result = compile_glsl_shader(&pass->compute_shader, device, &shader_request);
+	for (uint32_t i = 0; i != COUNT_OF(defines); ++i)
+		free(defines[i]);
+	if (compile_result) {
+		printf("Failed to compile the compute shader for the light animation pass.\n");
+		destroy_light_animation_pass(pass, device);
+		return 1;
+	}
+	// Create the pipeline
+	VkComputePipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = pass->compute_shader.module,
+			.pName = "main",
+		},
+		.layout = pass->pipeline.pipeline_layout,
+	};
+	if (vkCreateComputePipelines(device->device, NULL, 1, &pipeline_info, NULL, &pass->pipeline.pipeline)) {
+		printf("Failed to create a compute pipeline for the light animation pass.\n");
+		destroy_light_animation_pass(pass, device);
+		return 1;
+	}
+	return 0;
+}
+
+
 //! Frees objects and zeros
 void destroy_geometry_pass(geometry_pass_t* pass, const device_t* device) {
 	destroy_pipeline_with_bindings(&pass->pipeline, device);
@@ -427,19 +719,24 @@ void destroy_geometry_pass(geometry_pass_t* pass, const device_t* device) {
 
 //! Creates Vulkan objects for the geometry pass
 int create_geometry_pass(geometry_pass_t* pass, const device_t* device, const swapchain_t* swapchain,
-	const scene_t* scene, const constant_buffers_t* constant_buffers, const render_targets_t* render_targets, const render_pass_t* render_pass)
+	const scene_t* scene, const constant_buffers_t* constant_buffers, const render_pass_t* render_pass)
 {
 	memset(pass, 0, sizeof(*pass));
 	pipeline_with_bindings_t* pipeline = &pass->pipeline;
-	// Create a pipeline layout for the geometry pass
-	VkDescriptorSetLayoutBinding layout_binding = {
-		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+	pass->compressed_geometry = (scene->mesh.meshlets.buffer_count > 0);
+	// Create a pipeline layout for the geometry pass. Compressed geometry is
+	// read from storage buffers.
+	VkDescriptorSetLayoutBinding layout_bindings[] = {
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
 	};
 	descriptor_set_request_t set_request = {
 		.stage_flags = VK_SHADER_STAGE_VERTEX_BIT,
 		.min_descriptor_count = 1,
-		.binding_count = 1,
-		.bindings = &layout_binding,
+		.binding_count = pass->compressed_geometry ? COUNT_OF(layout_bindings) : 1,
+		.bindings = layout_bindings,
 	};
 	if (create_descriptor_sets(pipeline, device, &set_request, swapchain->image_count)) {
 		printf("Failed to create a descriptor set for the geometry pass.\n");
@@ -447,24 +744,40 @@ int create_geometry_pass(geometry_pass_t* pass, const device_t* device, const sw
 		return 1;
 	}
 	// Write to the descriptor set
-	VkDescriptorBufferInfo descriptor_buffer_info = {.offset = 0};
-	VkWriteDescriptorSet descriptor_set_write = {
-		.dstBinding = 0, .pBufferInfo = &descriptor_buffer_info
-	};
-	complete_descriptor_set_write(1, &descriptor_set_write, &set_request);
+	VkDescriptorBufferInfo descriptor_buffer_infos[4] = {{.offset = 0}};
+	if (pass->compressed_geometry) {
+		const buffer_t* meshlet_buffers = scene->mesh.meshlets.buffers;
+		const meshlet_buffer_type_t types[3] = { meshlet_buffer_type_meshlets, meshlet_buffer_type_positions, meshlet_buffer_type_triangles };
+		for (uint32_t i = 0; i != 3; ++i) {
+			descriptor_buffer_infos[i + 1].buffer = meshlet_buffers[types[i]].buffer;
+			descriptor_buffer_infos[i + 1].range = meshlet_buffers[types[i]].size;
+		}
+	}
+	VkWriteDescriptorSet descriptor_set_writes[4];
+	for (uint32_t i = 0; i != set_request.binding_count; ++i) {
+		VkWriteDescriptorSet write = { .dstBinding = i, .pBufferInfo = &descriptor_buffer_infos[i] };
+		descriptor_set_writes[i] = write;
+	}
+	complete_descriptor_set_write(set_request.binding_count, descriptor_set_writes, &set_request);
 	for (uint32_t i = 0; i != swapchain->image_count; ++i) {
-		descriptor_buffer_info.buffer = constant_buffers->buffers.buffers[i].buffer;
-		descriptor_buffer_info.range = constant_buffers->buffers.buffers[i].size;
-		descriptor_set_write.dstSet = pipeline->descriptor_sets[i];
-		vkUpdateDescriptorSets(device->device, 1, &descriptor_set_write, 0, NULL);
+		descriptor_buffer_infos[0].buffer = constant_buffers->buffers.buffers[i].buffer;
+		descriptor_buffer_infos[0].range = constant_buffers->buffers.buffers[i].size;
+		for (uint32_t j = 0; j != set_request.binding_count; ++j)
+			descriptor_set_writes[j].dstSet = pipeline->descriptor_sets[i];
+		vkUpdateDescriptorSets(device->device, set_request.binding_count, descriptor_set_writes, 0, NULL);
 	}
 
 	// Compile a vertex and fragment shader
+	char* vertex_defines[] = {
+		format_uint("COMPRESSED_GEOMETRY=%u", pass->compressed_geometry),
+	};
 	shader_request_t vertex_shader_request = {
 		.shader_file_path = "src/shaders/visibility_pass.vert.glsl",
 		.include_path = "src/shaders",
 		.entry_point = "main",
-		.stage = VK_SHADER_STAGE_VERTEX_BIT
+		.stage = VK_SHADER_STAGE_VERTEX_BIT,
+		.define_count = COUNT_OF(vertex_defines),
+		.defines = vertex_defines
 	};
 	shader_request_t fragment_shader_request = {
 		.shader_file_path = "src/shaders/visibility_pass.frag.glsl",
@@ -472,12 +785,15 @@ int create_geometry_pass(geometry_pass_t* pass, const device_t* device, const sw
 		.entry_point = "main",
 		.stage = VK_SHADER_STAGE_FRAGMENT_BIT
 	};
-	if (compile_glsl_shader_with_second_chance(&pass->vertex_shader, device, &vertex_shader_request)) {
+	int compile_result = compile_glsl_shader(&pass->vertex_shader, device, &vertex_shader_request);
+	for (uint32_t i = 0; i != COUNT_OF(vertex_defines); ++i)
+		free(vertex_defines[i]);
+	if (compile_result) {
 		printf("Failed to compile the vertex shader for the geometry pass.\n");
 		destroy_geometry_pass(pass, device);
 		return 1;
 	}
-	if (compile_glsl_shader_with_second_chance(&pass->fragment_shader, device, &fragment_shader_request)) {
+	if (compile_glsl_shader(&pass->fragment_shader, device, &fragment_shader_request)) {
 		printf("Failed to compile the fragment shader for the geometry pass.\n");
 		destroy_geometry_pass(pass, device);
 		return 1;
@@ -488,9 +804,9 @@ int create_geometry_pass(geometry_pass_t* pass, const device_t* device, const sw
 	VkVertexInputAttributeDescription vertex_attribute = {.location = 0, .binding = 0, .format = VK_FORMAT_R32G32_UINT, .offset = 0};
 	VkPipelineVertexInputStateCreateInfo vertex_input_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.vertexBindingDescriptionCount = 1,
+		.vertexBindingDescriptionCount = pass->compressed_geometry ? 0 : 1,
 		.pVertexBindingDescriptions = &vertex_binding,
-		.vertexAttributeDescriptionCount = 1,
+		.vertexAttributeDescriptionCount = pass->compressed_geometry ? 0 : 1,
 		.pVertexAttributeDescriptions = &vertex_attribute
 	};
 	VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {
@@ -572,8 +888,8 @@ int create_geometry_pass(geometry_pass_t* pass, const device_t* device, const sw
 		.pDepthStencilState = &depth_stencil_info,
 		.stageCount = 2,
 		.pStages = shader_stages,
-		.renderPass = render_pass->render_pass,
-		.subpass = 0
+		.renderPass = render_pass->graph.render_pass,
+		.subpass = render_pass->graph.subpass_indices[frame_pass_geometry]
 	};
 	if (vkCreateGraphicsPipelines(device->device, NULL, 1, &pipeline_info, NULL, &pass->pipeline.pipeline)) {
 		printf("Failed to create a graphics pipeline for the geometry pass.\n");
@@ -586,150 +902,189 @@ int create_geometry_pass(geometry_pass_t* pass, const device_t* device, const sw
 
 //! Frees objects and zeros
 void destroy_shading_pass(shading_pass_t* pass, const device_t* device) {
+	for (uint32_t i = 0; i != MAX_COMPARISON_CONFIG_COUNT; ++i) {
+		if (pass->comparison_pipelines[i])
+			vkDestroyPipeline(device->device, pass->comparison_pipelines[i], NULL);
+		destroy_shader(&pass->comparison_shaders[i], device);
+	}
 	destroy_pipeline_with_bindings(&pass->pipeline, device);
 	destroy_shader(&pass->vertex_shader, device);
 	destroy_shader(&pass->fragment_shader, device);
 	if (pass->light_texture_sampler)
 		vkDestroySampler(device->device, pass->light_texture_sampler, NULL);
+	if (pass->material_texture_sampler)
+		vkDestroySampler(device->device, pass->material_texture_sampler, NULL);
 	memset(pass, 0, sizeof(*pass));
 }
 
-//! Creates Vulkan objects for the shading pass
-int create_shading_pass(shading_pass_t* pass, application_t* app)
-{
-	memset(pass, 0, sizeof(*pass));
-	// Get lots of short-hands
+/*! Writes all descriptors of the shading pass that depend on the loaded scene,
+	i.e. mesh buffers, the acceleration structure, material textures in the
+	bindless texture array and the buffer that locates material textures
+	therein. Since the texture array is partially bound and
+	allows updates after binding, this does not require recreation of the
+	pipeline.
+	\return 0 on success.*/
+int write_shading_pass_scene_descriptors(shading_pass_t* pass, application_t* app) {
 	const device_t* device = &app->device;
-	const swapchain_t* swapchain = &app->swapchain;
 	const scene_t* scene = &app->scene;
-	const constant_buffers_t* constant_buffers = &app->constant_buffers;
-	const render_targets_t* render_targets = &app->render_targets;
-	const noise_table_t* noise_table = &app->noise_table;
-	const ltc_table_t* ltc_table = &app->ltc_table;
-	pipeline_with_bindings_t* pipeline = &pass->pipeline;
-	// Are we tracing rays?
-	pass->use_ray_tracing = app->render_settings.trace_shadow_rays && app->device.ray_tracing_supported;
-	// Create a sampler for light textures
-	VkSamplerCreateInfo sampler_info = {
-		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-		.magFilter = VK_FILTER_LINEAR, .minFilter = VK_FILTER_LINEAR,
-		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-		.anisotropyEnable = VK_FALSE, .maxAnisotropy = 1,
-		.minLod = 0.0f, .maxLod = 3.4e38f,
-		// This is the way to go for theta-phi parametrizations
-		.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-	};
-	if (vkCreateSampler(device->device, &sampler_info, NULL, &pass->light_texture_sampler)) {
-		printf("Failed to create a sampler for light textures in the shading pass.\n");
-		destroy_shading_pass(pass, device);
+	uint32_t material_texture_count;
+	VkDescriptorImageInfo* material_texture_infos = get_materials_descriptor_infos(&material_texture_count, &scene->materials, pass->material_texture_sampler);
+	if (material_texture_count > BINDLESS_TEXTURE_COUNT - LIGHT_TEXTURE_SLOT_COUNT) {
+		printf("The scene uses %u images for material textures but the shading pass only has %u slots for them.\n",
+			material_texture_count, BINDLESS_TEXTURE_COUNT - LIGHT_TEXTURE_SLOT_COUNT);
+		free(material_texture_infos);
 		return 1;
 	}
-	// Create descriptor sets for the shading pass
-	uint32_t light_texture_count = app->light_textures.image_count;
-	VkDescriptorSetLayoutBinding layout_bindings[] = {
-		{ .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER },
-		{ .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER },
-		{ .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER },
-		{ .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER },
-		{ .descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT },
-		{ .binding = 5},
-		{ .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE },
-		{ .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 2 },
-		{ .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = light_texture_count },
-		{ .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR },
-	};
-	get_materials_descriptor_layout(&layout_bindings[5], 5, &scene->materials);
-	uint32_t binding_count = COUNT_OF(layout_bindings) - (pass->use_ray_tracing ? 0 : 1);
-	descriptor_set_request_t set_request = {
-		.stage_flags = VK_SHADER_STAGE_FRAGMENT_BIT,
-		.min_descriptor_count = 1,
-		.binding_count = binding_count,
-		.bindings = layout_bindings,
-	};
-	if (create_descriptor_sets(pipeline, device, &set_request, app->swapchain.image_count)) {
-		printf("Failed to allocate descriptor sets for the shading pass.\n");
-		destroy_shading_pass(pass, device);
-		return 1;
+	VkWriteDescriptorSet descriptor_set_writes[mesh_buffer_count + meshlet_buffer_count + 4];
+	memset(descriptor_set_writes, 0, sizeof(descriptor_set_writes));
+	uint32_t write_count = 0;
+	for (uint32_t i = 0; i != mesh_buffer_count; ++i) {
+		VkWriteDescriptorSet write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstBinding = i + 1, .descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,
+			.pTexelBufferView = &scene->mesh.buffer_views[i]
+		};
+		descriptor_set_writes[write_count++] = write;
 	}
-	// Write to the descriptor sets
-	VkDescriptorBufferInfo constant_buffer_info = {.offset = 0};
-	VkDescriptorImageInfo visibility_buffer_info = {
-		.imageLayout = VK_IMAGE_LAYOUT_GENERAL
-	};
-	VkDescriptorImageInfo render_target_info = {
-		.imageLayout = VK_IMAGE_LAYOUT_GENERAL
-	};
-	VkDescriptorImageInfo noise_info = {
-		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		.imageView = noise_table->noise_array.images[0].view
-	};
-	VkDescriptorImageInfo ltc_table_infos[2] = {
-		{
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			.imageView = ltc_table->texture_arrays.images[0].view,
-			.sampler = ltc_table->sampler
-		},
-		{
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			.imageView = ltc_table->texture_arrays.images[1].view,
-			.sampler = ltc_table->sampler
-		}
-	};
-	VkWriteDescriptorSet descriptor_set_writes[COUNT_OF(layout_bindings)] = {
-		{ .dstBinding = 0, .pBufferInfo = &constant_buffer_info },
-		{ .dstBinding = 4, .pImageInfo = &visibility_buffer_info },
-		{ .dstBinding = 6, .pImageInfo = &noise_info },
-		{ .dstBinding = 7, .pImageInfo = ltc_table_infos },
-		{ .dstBinding = 8 },
-		{ .dstBinding = 5 },
-	};
-	VkDescriptorImageInfo* light_texture_writes = malloc(sizeof(VkDescriptorImageInfo) * light_texture_count);
-	for (uint32_t i = 0; i != light_texture_count; ++i) {
-		light_texture_writes[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		light_texture_writes[i].imageView = app->light_textures.images[i].view;
-		light_texture_writes[i].sampler = pass->light_texture_sampler;
+	if (material_texture_count > 0) {
+		VkWriteDescriptorSet write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstBinding = 5, .dstArrayElement = LIGHT_TEXTURE_SLOT_COUNT,
+			.descriptorCount = material_texture_count,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = material_texture_infos
+		};
+		descriptor_set_writes[write_count++] = write;
+	}
+	VkDescriptorBufferInfo texture_slots_info = {
+		.buffer = scene->materials.texture_slots.buffers[0].buffer,
+		.range = VK_WHOLE_SIZE
+	};
+	VkWriteDescriptorSet texture_slots_write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstBinding = 8, .descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.pBufferInfo = &texture_slots_info
+	};
+	descriptor_set_writes[write_count++] = texture_slots_write;
+	VkDescriptorBufferInfo triangle_records_info = { .range = VK_WHOLE_SIZE };
+	if (scene->mesh.triangle_records.buffer_count > 0) {
+		triangle_records_info.buffer = scene->mesh.triangle_records.buffers[0].buffer;
+		VkWriteDescriptorSet write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstBinding = 9, .descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &triangle_records_info
+		};
+		descriptor_set_writes[write_count++] = write;
 	}
-	descriptor_set_writes[4].pImageInfo = light_texture_writes;
-	uint32_t material_write_index = 5;
-	descriptor_set_writes[material_write_index].pImageInfo = get_materials_descriptor_infos(&descriptor_set_writes[material_write_index].descriptorCount, &scene->materials);
-	for (uint32_t i = 0; i != mesh_buffer_count; ++i) {
+	VkDescriptorBufferInfo meshlet_infos[meshlet_buffer_count];
+	for (uint32_t i = 0; i != scene->mesh.meshlets.buffer_count; ++i) {
+		meshlet_infos[i].buffer = scene->mesh.meshlets.buffers[i].buffer;
+		meshlet_infos[i].offset = 0;
+		meshlet_infos[i].range = VK_WHOLE_SIZE;
 		VkWriteDescriptorSet write = {
-			.dstBinding = i + 1, .pTexelBufferView = &scene->mesh.buffer_views[i]
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstBinding = 10 + i, .descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &meshlet_infos[i]
 		};
-		descriptor_set_writes[material_write_index + 1 + i] = write;
+		descriptor_set_writes[write_count++] = write;
 	}
 	VkWriteDescriptorSetAccelerationStructureKHR acceleration_structure_info = {
 		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
 		.accelerationStructureCount = 1,
-		.pAccelerationStructures = &app->scene.acceleration_structure.top_level
-	};
-	VkWriteDescriptorSet acceleration_structure_write = {
-		.dstBinding = 9, .pNext = &acceleration_structure_info
+		.pAccelerationStructures = &scene->acceleration_structure.top_level
 	};
-	descriptor_set_writes[material_write_index + 1 + mesh_buffer_count] = acceleration_structure_write;
-	complete_descriptor_set_write(binding_count, descriptor_set_writes, &set_request);
-	for (uint32_t i = 0; i != swapchain->image_count; ++i) {
-		constant_buffer_info.buffer = constant_buffers->buffers.buffers[i].buffer;
-		constant_buffer_info.range = constant_buffers->buffers.buffers[i].size;
-		visibility_buffer_info.imageView = render_targets->targets[i].visibility_buffer.view;
-		for (uint32_t j = 0; j != COUNT_OF(descriptor_set_writes); ++j)
-			descriptor_set_writes[j].dstSet = pipeline->descriptor_sets[i];
-		vkUpdateDescriptorSets(device->device, binding_count, descriptor_set_writes, 0, NULL);
+	if (pass->use_ray_tracing) {
+		VkWriteDescriptorSet write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = &acceleration_structure_info,
+			.dstBinding = 17, .descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR
+		};
+		descriptor_set_writes[write_count++] = write;
+	}
+	for (uint32_t i = 0; i != app->swapchain.image_count; ++i) {
+		for (uint32_t j = 0; j != write_count; ++j)
+			descriptor_set_writes[j].dstSet = pass->pipeline.descriptor_sets[i];
+		vkUpdateDescriptorSets(device->device, write_count, descriptor_set_writes, 0, NULL);
+	}
+	free(material_texture_infos);
+	return 0;
+}
+
+
+/*! Writes the currently loaded light textures into the first slots of the
+	bindless texture array of the shading pass. Polygonal lights index this
+	array directly using their texture index. This function can be invoked
+	without recreating the pipeline when light textures change.
+	\return 0 on success.*/
+int write_shading_pass_light_texture_descriptors(shading_pass_t* pass, application_t* app) {
+	const device_t* device = &app->device;
+	uint32_t light_texture_count = app->light_textures.image_count;
+	if (light_texture_count > LIGHT_TEXTURE_SLOT_COUNT) {
+		printf("There are %u light textures but the shading pass only has %u slots for them.\n", light_texture_count, LIGHT_TEXTURE_SLOT_COUNT);
+		return 1;
+	}
+	VkDescriptorImageInfo* light_texture_infos = malloc(sizeof(VkDescriptorImageInfo) * light_texture_count);
+	for (uint32_t i = 0; i != light_texture_count; ++i) {
+		light_texture_infos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		light_texture_infos[i].imageView = app->light_textures.images[i].view;
+		light_texture_infos[i].sampler = pass->light_texture_sampler;
+	}
+	VkWriteDescriptorSet descriptor_set_write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstBinding = 5, .dstArrayElement = 0,
+		.descriptorCount = light_texture_count,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = light_texture_infos
+	};
+	for (uint32_t i = 0; i != app->swapchain.image_count && light_texture_count > 0; ++i) {
+		descriptor_set_write.dstSet = pass->pipeline.descriptor_sets[i];
+		vkUpdateDescriptorSets(device->device, 1, &descriptor_set_write, 0, NULL);
 	}
-	free(light_texture_writes);
-	free((void*) descriptor_set_writes[material_write_index].pImageInfo);
+	free(light_texture_infos);
+	return 0;
+}
 
+
+//! Returns the number of configurations that the shading pass compares for
+//! the given settings or 0 if comparison mode is disabled
+uint32_t get_shading_pass_comparison_count(const render_settings_t* settings) {
+	return (settings->comparison_count < MAX_COMPARISON_CONFIG_COUNT) ? settings->comparison_count : MAX_COMPARISON_CONFIG_COUNT;
+}
+
+
+/*! Compiles a fragment shader for the shading pass with the given sampling
+	settings and creates a graphics pipeline that uses it. The pipeline only
+	shades pixels inside the given scissor rectangle.
+	\param pipeline, fragment_shader Output objects. The caller is responsible
+		for destroying them, even on failure.
+	\param pass The shading pass with descriptor sets, a pipeline layout and
+		a vertex shader.
+	\param spirv_path_suffix Forwarded to shader_request_t. Pipelines that
+		are created concurrently need distinct suffixes.
+	\return 0 on success.*/
+int create_shading_pass_pipeline(VkPipeline* pipeline, shader_t* fragment_shader, const shading_pass_t* pass, application_t* app, const comparison_config_t* config, VkRect2D scissor, char* spirv_path_suffix) {
+	const device_t* device = &app->device;
+	const swapchain_t* swapchain = &app->swapchain;
+	// Apply the configuration
+	render_settings_t settings = app->render_settings;
+	settings.sampling_strategies = config->sampling_strategies;
+	settings.mis_heuristic = config->mis_heuristic;
+	settings.polygon_sampling_technique = config->polygon_sampling_technique;
+	settings.sample_count = config->sample_count;
 	// Prepare defines for the shader
-	sampling_strategies_t sampling_strategies = app->render_settings.sampling_strategies;
-	mis_heuristic_t mis_heuristic = app->render_settings.mis_heuristic;
-	sample_polygon_technique_t polygon_technique = app->render_settings.polygon_sampling_technique;
-	error_display_t error_display = app->render_settings.error_display;
+	sampling_strategies_t sampling_strategies = settings.sampling_strategies;
+	mis_heuristic_t mis_heuristic = settings.mis_heuristic;
+	sample_polygon_technique_t polygon_technique = settings.polygon_sampling_technique;
+	error_display_t error_display = settings.error_display;
 	VkBool32 output_linear_rgb = swapchain->format == VK_FORMAT_R8G8B8A8_SRGB || swapchain->format == VK_FORMAT_B8G8R8A8_SRGB;
 	uint32_t min_polygonal_light_vertex_count = get_min_polygonal_light_vertex_count(&app->scene_specification);
 	uint32_t max_polygonal_light_vertex_count = get_max_polygonal_light_vertex_count(&app->scene_specification);
-	uint32_t max_polygon_vertex_count = get_max_polygon_vertex_count(&app->scene_specification, &app->render_settings);
+	uint32_t max_polygon_vertex_count = get_max_polygon_vertex_count(&app->scene_specification, &settings);
 	uint32_t error_index = 0;
 	VkBool32 error_display_diffuse = VK_FALSE;
 	VkBool32 error_display_specular = VK_FALSE;
@@ -750,18 +1105,26 @@ int create_shading_pass(shading_pass_t* pass, application_t* app)
 		break;
 	};
 	char* defines[] = {
-		format_uint("MATERIAL_COUNT=%u", (uint32_t) scene->materials.material_count),
+		format_uint("MATERIAL_TEXTURE_SLOT_OFFSET=%u", LIGHT_TEXTURE_SLOT_COUNT),
 		format_uint("POLYGONAL_LIGHT_COUNT=%u", app->scene_specification.polygonal_light_count),
 		format_uint("POLYGONAL_LIGHT_ARRAY_SIZE=%u", (app->scene_specification.polygonal_light_count > 0) ? app->scene_specification.polygonal_light_count : 1),
 		format_uint("POLYGONAL_LIGHT_COUNT_CLAMPED=%u", (app->scene_specification.polygonal_light_count < 33) ? app->scene_specification.polygonal_light_count : 33),
-		format_uint("LIGHT_TEXTURE_COUNT=%u", app->light_textures.image_count),
 		format_uint("MIN_POLYGON_VERTEX_COUNT_BEFORE_CLIPPING=%u", min_polygonal_light_vertex_count),
 		format_uint("MAX_POLYGONAL_LIGHT_VERTEX_COUNT=%u", max_polygonal_light_vertex_count),
 		format_uint("MAX_POLYGON_VERTEX_COUNT=%u", max_polygon_vertex_count),
-		format_uint("SAMPLE_COUNT=%u", app->render_settings.sample_count),
-		format_uint("SAMPLE_COUNT_CLAMPED=%u", (app->render_settings.sample_count < 33) ? app->render_settings.sample_count : 33),
+		format_uint("SAMPLE_COUNT=%u", settings.sample_count),
+		format_uint("SAMPLE_COUNT_CLAMPED=%u", (settings.sample_count < 33) ? settings.sample_count : 33),
 		format_uint("TRACE_SHADOW_RAYS=%u", pass->use_ray_tracing),
-		format_uint("SHOW_POLYGONAL_LIGHTS=%u", app->render_settings.show_polygonal_lights),
+		format_uint("BAKED_VISIBILITY=%u", pass->use_baked_visibility),
+		format_uint("BAKED_VISIBILITY_TRIANGLE_COUNT=%u", (uint32_t) app->baked_visibility.triangle_count),
+		format_uint("INTERLEAVED_MESH_ATTRIBUTES=%u", app->scene.mesh.triangle_records.buffer_count > 0),
+		format_uint("COMPRESSED_GEOMETRY=%u", app->scene.mesh.meshlets.buffer_count > 0),
+		format_uint("STREAM_GEOMETRY=%u", app->stream_buffers.feedback.buffer_count > 0),
+		format_uint("STREAM_TEXTURES=%u", app->stream_buffers.texture_feedback.buffer_count > 0),
+		format_uint("TEXTURE_FEEDBACK_LOG2_RESOLUTION=%u", TEXTURE_FEEDBACK_LOG2_RESOLUTION),
+		format_uint("RAY_CONE_TEXTURE_LOD=%u", settings.ray_cone_texture_lod),
+		format_float("MAX_ANISOTROPY=%f", pass->max_anisotropy),
+		format_uint("SHOW_POLYGONAL_LIGHTS=%u", settings.show_polygonal_lights),
 		format_uint("SAMPLING_STRATEGIES_DIFFUSE_ONLY=%u", sampling_strategies == sampling_strategies_diffuse_only),
 		format_uint("SAMPLING_STRATEGIES_DIFFUSE_GGX_MIS=%u", sampling_strategies == sampling_strategies_diffuse_ggx_mis),
 		format_uint("SAMPLING_STRATEGIES_DIFFUSE_SPECULAR_SEPARATELY=%u", sampling_strategies == sampling_strategies_diffuse_specular_separately),
@@ -797,26 +1160,14 @@ int create_shading_pass(shading_pass_t* pass, application_t* app)
 		.entry_point = "main",
 		.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
 		.define_count = COUNT_OF(defines),
-		.defines = defines
+		.defines = defines,
+		.spirv_path_suffix = spirv_path_suffix
 	};
-	int compile_result = compile_glsl_shader_with_second_chance(&pass->fragment_shader, device, &fragment_shader_request);
+	int compile_result = compile_glsl_shader(fragment_shader, device, &fragment_shader_request);
 	for (uint32_t i = 0; i != COUNT_OF(defines); ++i)
 		free(defines[i]);
 	if (compile_result) {
 		printf("Failed to compile the fragment shader for the shading pass.\n");
-		destroy_shading_pass(pass, device);
-		return 1;
-	}
-	// Compile a vertex shader
-	shader_request_t vertex_shader_request = {
-		.shader_file_path = "src/shaders/shading_pass.vert.glsl",
-		.include_path = "src/shaders",
-		.entry_point = "main",
-		.stage = VK_SHADER_STAGE_VERTEX_BIT
-	};
-	if (compile_glsl_shader_with_second_chance(&pass->vertex_shader, device, &vertex_shader_request)) {
-		printf("Failed to compile the vertex shader for the shading pass.\n");
-		destroy_shading_pass(pass, device);
 		return 1;
 	}
 
@@ -860,7 +1211,6 @@ int create_shading_pass(shading_pass_t* pass, application_t* app)
 		.width = (float) swapchain->extent.width, .height = (float) swapchain->extent.height,
 		.minDepth = 0.0f, .maxDepth = 1.0f
 	};
-	VkRect2D scissor = {.extent = swapchain->extent};
 	VkPipelineViewportStateCreateInfo viewport_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
 		.viewportCount = 1, .pViewports = &viewport,
@@ -882,37 +1232,292 @@ int create_shading_pass(shading_pass_t* pass, application_t* app)
 			.pName = "main"
 		},
 		{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-			.module = pass->fragment_shader.module,
-			.pName = "main"
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = fragment_shader->module,
+			.pName = "main"
+		}
+	};
+	VkGraphicsPipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.layout = pass->pipeline.pipeline_layout,
+		.pVertexInputState = &vertex_input_info,
+		.pInputAssemblyState = &input_assembly_info,
+		.pRasterizationState = &raster_info,
+		.pColorBlendState = &blend_info,
+		.pTessellationState = NULL,
+		.pMultisampleState = &multi_sample_info,
+		.pDynamicState = NULL,
+		.pViewportState = &viewport_info,
+		.pDepthStencilState = &depth_stencil_info,
+		.stageCount = 2, .pStages = shader_stages,
+		.renderPass = app->render_pass.graph.render_pass,
+		.subpass = app->render_pass.graph.subpass_indices[frame_pass_shading]
+	};
+	if (vkCreateGraphicsPipelines(device->device, NULL, 1, &pipeline_info, NULL, pipeline)) {
+		printf("Failed to create a graphics pipeline for the shading pass.\n");
+		// The job that failed may run again
+		destroy_shader(fragment_shader, device);
+		return 1;
+	}
+	return 0;
+}
+
+
+
+/*! Creates Vulkan objects for the shading pass except for the pipelines that
+	create_shading_pass_strip_pipeline() creates afterwards*/
+int create_shading_pass_resources(shading_pass_t* pass, application_t* app)
+{
+	memset(pass, 0, sizeof(*pass));
+	// Get lots of short-hands
+	const device_t* device = &app->device;
+	const swapchain_t* swapchain = &app->swapchain;
+	const constant_buffers_t* constant_buffers = &app->constant_buffers;
+	const noise_table_t* noise_table = &app->noise_table;
+	const ltc_table_t* ltc_table = &app->ltc_table;
+	pipeline_with_bindings_t* pipeline = &pass->pipeline;
+	// Are we tracing rays?
+	pass->use_ray_tracing = app->render_settings.trace_shadow_rays && app->device.ray_tracing_supported && app->scene.acceleration_structure.top_level;
+	// Create a sampler for light textures
+	VkSamplerCreateInfo sampler_info = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_LINEAR, .minFilter = VK_FILTER_LINEAR,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+		.anisotropyEnable = VK_FALSE, .maxAnisotropy = 1,
+		.minLod = 0.0f, .maxLod = 3.4e38f,
+		// This is the way to go for theta-phi parametrizations
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+	};
+	if (vkCreateSampler(device->device, &sampler_info, NULL, &pass->light_texture_sampler)) {
+		printf("Failed to create a sampler for light textures in the shading pass.\n");
+		destroy_shading_pass(pass, device);
+		return 1;
+	}
+	// Create a sampler for material textures with the requested anisotropy
+	float max_anisotropy = (app->render_settings.max_anisotropy > 0) ? (float) app->render_settings.max_anisotropy : 16.0f;
+	float device_max_anisotropy = device->physical_device_properties.limits.maxSamplerAnisotropy;
+	max_anisotropy = (max_anisotropy < device_max_anisotropy) ? max_anisotropy : device_max_anisotropy;
+	pass->max_anisotropy = max_anisotropy;
+	VkSamplerCreateInfo material_sampler_info = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_LINEAR, .minFilter = VK_FILTER_LINEAR,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+		.anisotropyEnable = max_anisotropy > 1.0f, .maxAnisotropy = max_anisotropy,
+		.minLod = 0.0f, .maxLod = 3.4e38f
+	};
+	if (vkCreateSampler(device->device, &material_sampler_info, NULL, &pass->material_texture_sampler)) {
+		printf("Failed to create a sampler for material textures in the shading pass.\n");
+		destroy_shading_pass(pass, device);
+		return 1;
+	}
+	// Create descriptor sets for the shading pass. Binding 5 is a bindless
+	// array for material and light textures, which is written independently
+	// of the pipeline.
+	VkPhysicalDeviceDescriptorIndexingProperties indexing_properties = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES,
+	};
+	VkPhysicalDeviceProperties2 device_properties = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &indexing_properties,
+	};
+	vkGetPhysicalDeviceProperties2(device->physical_device, &device_properties);
+	if (indexing_properties.maxPerStageDescriptorUpdateAfterBindSamplers < BINDLESS_TEXTURE_COUNT + 2
+		|| indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages < BINDLESS_TEXTURE_COUNT + 3)
+	{
+		printf("The device does not support the %u textures needed for the bindless texture array of the shading pass.\n", BINDLESS_TEXTURE_COUNT);
+		destroy_shading_pass(pass, device);
+		return 1;
+	}
+	VkDescriptorSetLayoutBinding layout_bindings[] = {
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = BINDLESS_TEXTURE_COUNT },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 2 },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR },
+		{ .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+	};
+	VkDescriptorBindingFlags binding_flags[COUNT_OF(layout_bindings)] = {
+		[5] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+	};
+	// Baked visibility is only useful along with ray tracing
+	pass->use_baked_visibility = pass->use_ray_tracing && app->baked_visibility.buffer.buffer_count > 0;
+	uint32_t binding_count = COUNT_OF(layout_bindings) - (pass->use_ray_tracing ? (pass->use_baked_visibility ? 0 : 1) : 2);
+	descriptor_set_request_t set_request = {
+		.stage_flags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.min_descriptor_count = 1,
+		.binding_count = binding_count,
+		.bindings = layout_bindings,
+		.binding_flags = binding_flags,
+	};
+	if (create_descriptor_sets(pipeline, device, &set_request, app->swapchain.image_count)) {
+		printf("Failed to allocate descriptor sets for the shading pass.\n");
+		destroy_shading_pass(pass, device);
+		return 1;
+	}
+	// Write to the descriptor sets
+	VkDescriptorBufferInfo constant_buffer_info = {.offset = 0};
+	VkDescriptorBufferInfo light_buffer_info = {.offset = 0};
+	VkDescriptorImageInfo visibility_buffer_info = {
+		.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+	};
+	VkDescriptorImageInfo render_target_info = {
+		.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+	};
+	VkDescriptorImageInfo noise_info = {
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.imageView = noise_table->noise_array.images[0].view
+	};
+	VkDescriptorImageInfo ltc_table_infos[2] = {
+		{
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			.imageView = ltc_table->texture_arrays.images[0].view,
+			.sampler = ltc_table->sampler
+		},
+		{
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			.imageView = ltc_table->texture_arrays.images[1].view,
+			.sampler = ltc_table->sampler
 		}
 	};
-	VkGraphicsPipelineCreateInfo pipeline_info = {
-		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-		.layout = pipeline->pipeline_layout,
-		.pVertexInputState = &vertex_input_info,
-		.pInputAssemblyState = &input_assembly_info,
-		.pRasterizationState = &raster_info,
-		.pColorBlendState = &blend_info,
-		.pTessellationState = NULL,
-		.pMultisampleState = &multi_sample_info,
-		.pDynamicState = NULL,
-		.pViewportState = &viewport_info,
-		.pDepthStencilState = &depth_stencil_info,
-		.stageCount = 2, .pStages = shader_stages,
-		.renderPass = app->render_pass.render_pass,
-		.subpass = 1
+	VkWriteDescriptorSet descriptor_set_writes[] = {
+		{ .dstBinding = 0, .pBufferInfo = &constant_buffer_info },
+		{ .dstBinding = 4, .pImageInfo = &visibility_buffer_info },
+		{ .dstBinding = 6, .pImageInfo = &noise_info },
+		{ .dstBinding = 7, .pImageInfo = ltc_table_infos },
+		{ .dstBinding = 16, .pBufferInfo = &light_buffer_info },
 	};
-	if (vkCreateGraphicsPipelines(device->device, NULL, 1, &pipeline_info, NULL, &pipeline->pipeline)) {
-		printf("Failed to create a graphics pipeline for the shading pass.\n");
+	complete_descriptor_set_write(COUNT_OF(descriptor_set_writes), descriptor_set_writes, &set_request);
+	for (uint32_t i = 0; i != swapchain->image_count; ++i) {
+		constant_buffer_info.buffer = constant_buffers->buffers.buffers[i].buffer;
+		constant_buffer_info.range = constant_buffers->buffers.buffers[i].size;
+		light_buffer_info.buffer = constant_buffers->light_buffers.buffers[i].buffer;
+		light_buffer_info.range = constant_buffers->light_buffers.buffers[i].size;
+		visibility_buffer_info.imageView = get_render_graph_view(&app->render_pass.graph, frame_attachment_visibility_buffer, i);
+		for (uint32_t j = 0; j != COUNT_OF(descriptor_set_writes); ++j)
+			descriptor_set_writes[j].dstSet = pipeline->descriptor_sets[i];
+		vkUpdateDescriptorSets(device->device, COUNT_OF(descriptor_set_writes), descriptor_set_writes, 0, NULL);
+	}
+	// Bind buffers for visibility feedback if the scene is streamed
+	const stream_buffers_t* stream_buffers = &app->stream_buffers;
+	for (uint32_t i = 0; i != stream_buffers->feedback.buffer_count; ++i) {
+		VkDescriptorBufferInfo feedback_info = {
+			.buffer = stream_buffers->feedback.buffers[i].buffer,
+			.range = stream_buffers->feedback.buffers[i].size
+		};
+		VkWriteDescriptorSet feedback_write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = pipeline->descriptor_sets[i],
+			.dstBinding = 14, .descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &feedback_info
+		};
+		vkUpdateDescriptorSets(device->device, 1, &feedback_write, 0, NULL);
+	}
+	// Bind buffers for mipmap feedback if textures are streamed
+	for (uint32_t i = 0; i != stream_buffers->texture_feedback.buffer_count; ++i) {
+		VkDescriptorBufferInfo feedback_info = {
+			.buffer = stream_buffers->texture_feedback.buffers[i].buffer,
+			.range = stream_buffers->texture_feedback.buffers[i].size
+		};
+		VkWriteDescriptorSet feedback_write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = pipeline->descriptor_sets[i],
+			.dstBinding = 15, .descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &feedback_info
+		};
+		vkUpdateDescriptorSets(device->device, 1, &feedback_write, 0, NULL);
+	}
+	// Bind baked visibility
+	if (pass->use_baked_visibility) {
+		VkDescriptorBufferInfo baked_visibility_info = {
+			.buffer = app->baked_visibility.buffer.buffers[0].buffer,
+			.range = VK_WHOLE_SIZE
+		};
+		VkWriteDescriptorSet baked_visibility_write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstBinding = 18, .descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &baked_visibility_info
+		};
+		for (uint32_t i = 0; i != swapchain->image_count; ++i) {
+			baked_visibility_write.dstSet = pipeline->descriptor_sets[i];
+			vkUpdateDescriptorSets(device->device, 1, &baked_visibility_write, 0, NULL);
+		}
+	}
+	// Write descriptors that depend on the scene and light textures
+	if (write_shading_pass_scene_descriptors(pass, app)
+		|| write_shading_pass_light_texture_descriptors(pass, app))
+	{
+		destroy_shading_pass(pass, device);
+		return 1;
+	}
+
+	// Compile a vertex shader
+	shader_request_t vertex_shader_request = {
+		.shader_file_path = "src/shaders/shading_pass.vert.glsl",
+		.include_path = "src/shaders",
+		.entry_point = "main",
+		.stage = VK_SHADER_STAGE_VERTEX_BIT
+	};
+	if (compile_glsl_shader(&pass->vertex_shader, device, &vertex_shader_request)) {
+		printf("Failed to compile the vertex shader for the shading pass.\n");
 		destroy_shading_pass(pass, device);
 		return 1;
 	}
+	// In comparison mode, each configuration gets its own pipeline, which
+	// shades one vertical strip of the screen
+	pass->comparison_count = get_shading_pass_comparison_count(&app->render_settings);
 	return 0;
 }
 
 
+/*! Creates one pipeline of the shading pass after
+	create_shading_pass_resources(). Pipelines for different indices can be
+	created concurrently.
+	\param index The index of the compared configuration or 0 if comparison
+		mode is disabled.
+	\return 0 on success.*/
+int create_shading_pass_strip_pipeline(shading_pass_t* pass, application_t* app, uint32_t index) {
+	const swapchain_t* swapchain = &app->swapchain;
+	if (pass->comparison_count > 0) {
+		uint32_t strip_begin = swapchain->extent.width * index / pass->comparison_count;
+		uint32_t strip_end = swapchain->extent.width * (index + 1) / pass->comparison_count;
+		VkRect2D strip = { .offset = { (int32_t) strip_begin, 0 }, .extent = { strip_end - strip_begin, swapchain->extent.height } };
+		char* spirv_path_suffix = format_uint(".comparison_%u.spv", index);
+		int result = create_shading_pass_pipeline(&pass->comparison_pipelines[index], &pass->comparison_shaders[index], pass, app, &app->render_settings.comparison_configs[index], strip, spirv_path_suffix);
+		free(spirv_path_suffix);
+		return result;
+	}
+	else {
+		comparison_config_t config = {
+			.sampling_strategies = app->render_settings.sampling_strategies,
+			.mis_heuristic = app->render_settings.mis_heuristic,
+			.polygon_sampling_technique = app->render_settings.polygon_sampling_technique,
+			.sample_count = app->render_settings.sample_count,
+		};
+		VkRect2D scissor = { .extent = swapchain->extent };
+		return create_shading_pass_pipeline(&pass->pipeline.pipeline, &pass->fragment_shader, pass, app, &config, scissor, NULL);
+	}
+}
+
+
 //! Frees objects and zeros
 void destroy_interface_pass(interface_pass_t* pass, const device_t* device) {
 	for (uint32_t i = 0; i != pass->frame_count; ++i)
@@ -928,7 +1533,7 @@ void destroy_interface_pass(interface_pass_t* pass, const device_t* device) {
 }
 
 //! Creates the pass for rendering a user interface
-int create_interface_pass(interface_pass_t* pass, const device_t* device, imgui_handle_t imgui, const swapchain_t* swapchain, const render_targets_t* render_targets, const render_pass_t* render_pass) {
+int create_interface_pass(interface_pass_t* pass, const device_t* device, imgui_handle_t imgui, const swapchain_t* swapchain, const render_pass_t* render_pass) {
 	memset(pass, 0, sizeof(*pass));
 	// Create geometry buffers and map memory
 	uint32_t imgui_quad_count = 0xFFFF;
@@ -999,8 +1604,8 @@ int create_interface_pass(interface_pass_t* pass, const device_t* device, imgui_
 		.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
 		.define_count = COUNT_OF(gui_defines), .defines = gui_defines
 	};
-	if (compile_glsl_shader_with_second_chance(&pass->vertex_shader, device, &gui_vertex_request)
-		|| compile_glsl_shader_with_second_chance(&pass->fragment_shader, device, &gui_fragment_request))
+	if (compile_glsl_shader(&pass->vertex_shader, device, &gui_vertex_request)
+		|| compile_glsl_shader(&pass->fragment_shader, device, &gui_fragment_request))
 	{
 		printf("Failed to compile shaders for the GUI rendering.\n");
 		destroy_interface_pass(pass, device);
@@ -1201,8 +1806,8 @@ int create_interface_pass(interface_pass_t* pass, const device_t* device, imgui_
 		.pDepthStencilState = &depth_stencil_info,
 		.pDynamicState = &dynamic_state,
 		.stageCount = 2, .pStages = shader_stages,
-		.renderPass = render_pass->render_pass,
-		.subpass = 2,
+		.renderPass = render_pass->graph.render_pass,
+		.subpass = render_pass->graph.subpass_indices[frame_pass_interface],
 	};
 	if (vkCreateGraphicsPipelines(device->device, NULL, 1, &pipeline_info, NULL, &pipeline->pipeline)) {
 		printf("Failed to create a graphics pipeline for the transfer pass.\n");
@@ -1215,134 +1820,68 @@ int create_interface_pass(interface_pass_t* pass, const device_t* device, imgui_
 
 //! Frees objects and zeros
 void destroy_render_pass(render_pass_t* pass, const device_t* device) {
-	for (uint32_t i = 0; i != pass->framebuffer_count; ++i)
-		if (pass->framebuffers[i])
-			vkDestroyFramebuffer(device->device, pass->framebuffers[i], NULL);
-	free(pass->framebuffers);
-	if (pass->render_pass) vkDestroyRenderPass(device->device, pass->render_pass, NULL);
+	destroy_render_graph(&pass->graph, device);
 	memset(pass, 0, sizeof(*pass));
 }
 
 
-//! Creates the render pass that renders a complete frame
-int create_render_pass(render_pass_t* pass, const device_t* device, const swapchain_t* swapchain, const render_targets_t* render_targets) {
+/*! Creates the render pass that renders a complete frame. Passes only declare
+	which attachments they access. Subpasses, dependencies, attachment images
+	and framebuffers are derived from that by the render graph.*/
+int create_render_pass(render_pass_t* pass, const device_t* device, const swapchain_t* swapchain) {
 	memset(pass, 0, sizeof(*pass));
-	// Create the render pass
-	VkAttachmentDescription attachments[] = {
-		{ // 0 - Depth buffer
-			.format = render_targets->targets[0].depth_buffer.image_info.format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+	render_graph_attachment_t attachments[frame_attachment_count] = {
+		[frame_attachment_depth_buffer] = {
+			.format = VK_FORMAT_D32_SFLOAT,
+			.clear = VK_TRUE, .clear_value = {.depthStencil = {.depth = 1.0f}},
 		},
-		{ // 1 - Visibility buffer
-			.format = render_targets->targets[0].visibility_buffer.image_info.format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_GENERAL
+		[frame_attachment_visibility_buffer] = {
+			.format = VK_FORMAT_R32_UINT,
+			.clear = VK_TRUE, .clear_value = {.color = {.uint32 = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}}},
 		},
-		{ // 2 - Swapchain image
+		[frame_attachment_swapchain] = {
 			.format = swapchain->format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+			.external = VK_TRUE,
+			.final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
 		},
 	};
-	VkAttachmentReference depth_reference = {.attachment = 0, .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
-	VkAttachmentReference visibility_output_reference = {.attachment = 1, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-	VkAttachmentReference visibility_input_reference = {.attachment = 1, .layout = VK_IMAGE_LAYOUT_GENERAL};
-	VkAttachmentReference swapchain_output_reference = {.attachment = 2, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-	VkSubpassDescription subpasses[] = {
-		{ // 0 - visibility pass
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.pDepthStencilAttachment = &depth_reference,
-			.colorAttachmentCount = 1, .pColorAttachments = &visibility_output_reference,
-		},
-		{ // 1 - shading pass
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.inputAttachmentCount = 1, .pInputAttachments = &visibility_input_reference,
-			.colorAttachmentCount = 1, .pColorAttachments = &swapchain_output_reference,
-		},
-		{ // 2 - interface pass
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.inputAttachmentCount = 0,
-			.colorAttachmentCount = 1, .pColorAttachments = &swapchain_output_reference,
-		},
+	render_graph_access_t geometry_accesses[] = {
+		{ frame_attachment_depth_buffer, render_graph_usage_depth },
+		{ frame_attachment_visibility_buffer, render_graph_usage_color },
+	};
+	render_graph_access_t shading_accesses[] = {
+		{ frame_attachment_visibility_buffer, render_graph_usage_input },
+		{ frame_attachment_swapchain, render_graph_usage_color },
 	};
-	VkSubpassDependency dependencies[] = {
-		{ // Swapchain image has been acquired
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 1,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = 0,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+	render_graph_access_t interface_accesses[] = {
+		{ frame_attachment_swapchain, render_graph_usage_color },
+	};
+	// The shading pass writes feedback buffers, so it must not be culled
+	render_graph_pass_t passes[frame_pass_count] = {
+		[frame_pass_geometry] = {
+			.name = "geometry",
+			.access_count = COUNT_OF(geometry_accesses), .accesses = geometry_accesses,
 		},
-		{ // Visibility buffer has been drawn
-			.srcSubpass = 0,
-			.dstSubpass = 1,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+		[frame_pass_shading] = {
+			.name = "shading",
+			.access_count = COUNT_OF(shading_accesses), .accesses = shading_accesses,
+			.keep = VK_TRUE,
 		},
-		{ // The shading pass has finished drawing
-			.srcSubpass = 1,
-			.dstSubpass = 2,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		[frame_pass_interface] = {
+			.name = "interface",
+			.access_count = COUNT_OF(interface_accesses), .accesses = interface_accesses,
 		},
 	};
-	VkRenderPassCreateInfo renderpass_info = {
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-		.attachmentCount = COUNT_OF(attachments), .pAttachments = attachments,
-		.subpassCount = COUNT_OF(subpasses), .pSubpasses = subpasses,
-		.dependencyCount = COUNT_OF(dependencies), .pDependencies = dependencies
+	const VkImageView* external_views[frame_attachment_count] = {
+		[frame_attachment_swapchain] = swapchain->image_views,
 	};
-	if (vkCreateRenderPass(device->device, &renderpass_info, NULL, &pass->render_pass)) {
-		printf("Failed to create a render pass for the geometry pass.\n");
+	if (create_render_graph(&pass->graph, device, swapchain->extent, swapchain->image_count,
+		frame_attachment_count, attachments, frame_pass_count, passes, external_views))
+	{
+		printf("Failed to create the render pass that renders a frame.\n");
 		destroy_render_pass(pass, device);
 		return 1;
 	}
-
-	// Create one framebuffer per swapchain image
-	VkImageView framebuffer_attachments[3];
-	VkFramebufferCreateInfo framebuffer_info = {
-		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-		.renderPass = pass->render_pass,
-		.attachmentCount = COUNT_OF(framebuffer_attachments),
-		.pAttachments = framebuffer_attachments,
-		.width = swapchain->extent.width,
-		.height = swapchain->extent.height,
-		.layers = 1
-	};
-	pass->framebuffer_count = swapchain->image_count;
-	pass->framebuffers = malloc(sizeof(VkFramebuffer) * pass->framebuffer_count);
-	memset(pass->framebuffers, 0, sizeof(VkFramebuffer) * pass->framebuffer_count);
-	for (uint32_t i = 0; i != pass->framebuffer_count; ++i) {
-		framebuffer_attachments[0] = render_targets->targets[i].depth_buffer.view;
-		framebuffer_attachments[1] = render_targets->targets[i].visibility_buffer.view;
-		framebuffer_attachments[2] = swapchain->image_views[i];
-		if (vkCreateFramebuffer(device->device, &framebuffer_info, NULL, &pass->framebuffers[i])) {
-			printf("Failed to create a framebuffer for the main render pass.\n");
-			destroy_render_pass(pass, device);
-			return 1;
-		}
-	}
 	return 0;
 }
 
@@ -1389,6 +1928,302 @@ int render_gui(VkCommandBuffer cmd, application_t* app, uint32_t swapchain_index
 }
 
 
+//! \return The squared distance between the given point and the bounding box
+//! of the given chunk (0 inside)
+float get_chunk_squared_distance(const mesh_chunk_t* chunk, const float point[3]) {
+	float squared_distance = 0.0f;
+	for (uint32_t i = 0; i != 3; ++i) {
+		float offset = fmaxf(0.0f, fmaxf(chunk->box_min[i] - point[i], point[i] - chunk->box_max[i]));
+		squared_distance += offset * offset;
+	}
+	return squared_distance;
+}
+
+
+/*! Extracts the six planes of the view frustum from the given matrix. A
+	point p is inside the frustum, if dot(plane, (p, 1)) >= 0 for all planes.*/
+void get_frustum_planes(float planes[6][4], const float world_to_projection_space[4][4]) {
+	for (uint32_t i = 0; i != 3; ++i) {
+		for (uint32_t j = 0; j != 4; ++j) {
+			planes[2 * i + 0][j] = world_to_projection_space[3][j] + world_to_projection_space[i][j];
+			planes[2 * i + 1][j] = world_to_projection_space[3][j] - world_to_projection_space[i][j];
+		}
+	}
+}
+
+
+//! \return VK_TRUE if the bounding box of the given chunk is completely
+//!		outside of one of the given frustum planes
+VkBool32 is_chunk_outside_frustum(const mesh_chunk_t* chunk, const float planes[6][4]) {
+	VkBool32 outside = VK_FALSE;
+	for (uint32_t i = 0; i != 6; ++i) {
+		// Test the corner of the box that is farthest inside
+		float distance = planes[i][3];
+		for (uint32_t j = 0; j != 3; ++j)
+			distance += planes[i][j] * ((planes[i][j] > 0.0f) ? chunk->box_max[j] : chunk->box_min[j]);
+		outside |= (distance < 0.0f);
+	}
+	return outside;
+}
+
+
+//! Comparison function for qsort() on uint64_t
+int compare_uint64(const void* lhs, const void* rhs) {
+	uint64_t lhs_value = *(const uint64_t*) lhs;
+	uint64_t rhs_value = *(const uint64_t*) rhs;
+	return (lhs_value > rhs_value) - (lhs_value < rhs_value);
+}
+
+
+/*! Drives streaming of geometry for the frame that is about to be recorded
+	for the given swapchain image. It reads visibility feedback of the
+	previous frame that used this image, picks chunks that should become
+	resident, reads them from the scene file into the staging buffer and
+	assigns slots to them. record_stream_uploads() records the copies.
+	\param read_feedback Whether the feedback buffer holds results of a
+		previous frame.
+	\return 0 on success.*/
+int update_geometry_stream(application_t* app, uint32_t swapchain_index, VkBool32 read_feedback) {
+	geometry_stream_t* stream = &app->scene.stream;
+	stream_buffers_t* stream_buffers = &app->stream_buffers;
+	const device_t* device = &app->device;
+	++stream->frame_index;
+	// Mark chunks as needed if they were visible at full resolution or
+	// through a proxy that is not good enough
+	if (read_feedback) {
+		VkMappedMemoryRange feedback_range = {
+			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+			.memory = stream_buffers->feedback.memory,
+			.offset = stream_buffers->feedback.buffers[swapchain_index].offset,
+			.size = get_mapped_memory_range_size(device, &stream_buffers->feedback, swapchain_index)
+		};
+		vkInvalidateMappedMemoryRanges(device->device, 1, &feedback_range);
+		const uint32_t* feedback = (const uint32_t*) (((const char*) stream_buffers->feedback_data) + feedback_range.offset);
+		uint64_t page_count = app->scene.mesh.triangle_count / STREAM_PAGE_TRIANGLE_COUNT;
+		uint64_t proxy_page_count = stream->proxy_triangle_count / STREAM_PAGE_TRIANGLE_COUNT;
+		uint64_t slot_page_count = stream->slot_triangle_count / STREAM_PAGE_TRIANGLE_COUNT;
+		for (uint64_t i = 0; i != page_count; ++i) {
+			if (!feedback[i])
+				continue;
+			uint32_t chunk_index = (i < proxy_page_count) ? stream->proxy_page_chunks[i] : stream->slot_chunks[(i - proxy_page_count) / slot_page_count];
+			if (chunk_index == UINT32_MAX)
+				continue;
+			streamed_chunk_t* chunk = &stream->chunks[chunk_index];
+			if (i >= proxy_page_count || !chunk->proxy_sufficient)
+				chunk->last_needed_frame = stream->frame_index;
+		}
+	}
+	// Sort needed chunks that are not resident by distance to the camera
+	const float* camera_position = app->scene_specification.camera.position_world_space;
+	uint64_t request_count = 0;
+	uint64_t* requests = malloc(sizeof(uint64_t) * app->scene.chunk_count);
+	for (uint64_t i = 0; i != app->scene.chunk_count; ++i) {
+		const streamed_chunk_t* chunk = &stream->chunks[i];
+		if (chunk->slot_index == UINT32_MAX && chunk->last_needed_frame == stream->frame_index) {
+			// Non-negative floats compare like their bits
+			float distance = get_chunk_squared_distance(&app->scene.chunks[i], camera_position);
+			uint32_t distance_bits;
+			memcpy(&distance_bits, &distance, sizeof(distance_bits));
+			requests[request_count++] = (((uint64_t) distance_bits) << 32) | i;
+		}
+	}
+	qsort(requests, request_count, sizeof(uint64_t), compare_uint64);
+	// Assign slots as long as the budget allows. Empty slots are used first.
+	// Otherwise, the chunk that has not been needed for the longest time gets
+	// evicted, unless frames that are still in flight may need it.
+	const uint64_t triangle_sizes[mesh_buffer_count] = { sizeof(uint32_t) * 2 * 3, sizeof(uint16_t) * 4 * 3, sizeof(uint8_t) };
+	uint32_t* upload_slots = &stream_buffers->upload_slots[swapchain_index * stream_buffers->upload_budget];
+	char* staging_data = ((char*) stream_buffers->staging_data) + stream_buffers->staging.buffers[swapchain_index].offset;
+	uint32_t upload_count = 0;
+	int result = 0;
+	for (uint64_t i = 0; i != request_count && upload_count != stream_buffers->upload_budget; ++i) {
+		uint32_t chunk_index = (uint32_t) requests[i];
+		uint32_t slot_index = UINT32_MAX;
+		uint32_t oldest_age = app->frame_queue.frame_count;
+		for (uint32_t j = 0; j != stream->slot_count; ++j) {
+			uint32_t resident_index = stream->slot_chunks[j];
+			if (resident_index == UINT32_MAX) {
+				slot_index = j;
+				break;
+			}
+			uint32_t age = stream->frame_index - stream->chunks[resident_index].last_needed_frame;
+			if (age > oldest_age) {
+				oldest_age = age;
+				slot_index = j;
+			}
+		}
+		if (slot_index == UINT32_MAX)
+			break;
+		// Read the chunk into the staging buffer
+		const mesh_chunk_t* chunk = &app->scene.chunks[chunk_index];
+		void* destinations[mesh_buffer_count];
+		for (uint32_t j = 0; j != mesh_buffer_count; ++j) {
+			destinations[j] = staging_data;
+			staging_data += triangle_sizes[j] * stream->slot_triangle_count;
+		}
+		if (read_streamed_triangles(stream, chunk->first_triangle, chunk->triangle_count, destinations)) {
+			result = 1;
+			break;
+		}
+		// Evict the old chunk and make the new one resident
+		uint32_t evicted_index = stream->slot_chunks[slot_index];
+		if (evicted_index != UINT32_MAX)
+			stream->chunks[evicted_index].slot_index = UINT32_MAX;
+		else
+			++stream->resident_count;
+		stream->slot_chunks[slot_index] = chunk_index;
+		stream->chunks[chunk_index].slot_index = slot_index;
+		upload_slots[upload_count++] = slot_index;
+	}
+	stream_buffers->upload_counts[swapchain_index] = upload_count;
+	free(requests);
+	return result;
+}
+
+
+/*! Reads mipmap feedback of the previous frame that used the given swapchain
+	image and passes it to update_texture_stream(). If images of material
+	textures change, the descriptors of the shading pass get updated.
+	\param read_feedback Whether the feedback buffer holds results of a
+		previous frame.
+	\return 0 on success.*/
+int update_texture_residency(application_t* app, uint32_t swapchain_index, VkBool32 read_feedback) {
+	const stream_buffers_t* stream_buffers = &app->stream_buffers;
+	const device_t* device = &app->device;
+	const uint32_t* feedback = NULL;
+	if (read_feedback) {
+		VkMappedMemoryRange feedback_range = {
+			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+			.memory = stream_buffers->texture_feedback.memory,
+			.offset = stream_buffers->texture_feedback.buffers[swapchain_index].offset,
+			.size = get_mapped_memory_range_size(device, &stream_buffers->texture_feedback, swapchain_index)
+		};
+		vkInvalidateMappedMemoryRanges(device->device, 1, &feedback_range);
+		feedback = (const uint32_t*) (((const char*) stream_buffers->texture_feedback_data) + feedback_range.offset);
+	}
+	VkBool32 changed;
+	if (update_texture_stream(&app->scene.materials, device, feedback, &changed))
+		return 1;
+	// Loading textures has waited for the queue to become idle, so no
+	// descriptor set is in use
+	return changed && write_shading_pass_scene_descriptors(&app->shading_pass, app);
+}
+
+
+/*! Records commands that reset the feedback buffers of the given swapchain
+	image and copy chunks that update_geometry_stream() has staged into their
+	slots.*/
+void record_stream_uploads(VkCommandBuffer cmd, const application_t* app, uint32_t swapchain_index) {
+	const stream_buffers_t* stream_buffers = &app->stream_buffers;
+	const geometry_stream_t* stream = &app->scene.stream;
+	if (stream_buffers->feedback.buffer_count > 0) {
+		const buffer_t* feedback = &stream_buffers->feedback.buffers[swapchain_index];
+		vkCmdFillBuffer(cmd, feedback->buffer, 0, feedback->size, 0);
+	}
+	if (stream_buffers->texture_feedback.buffer_count > 0) {
+		const buffer_t* feedback = &stream_buffers->texture_feedback.buffers[swapchain_index];
+		vkCmdFillBuffer(cmd, feedback->buffer, 0, feedback->size, 0xFFFFFFFF);
+	}
+	// Previous frames may still be drawing from slots that get overwritten
+	uint32_t upload_count = stream->file ? stream_buffers->upload_counts[swapchain_index] : 0;
+	if (upload_count > 0)
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+	const uint64_t triangle_sizes[mesh_buffer_count] = { sizeof(uint32_t) * 2 * 3, sizeof(uint16_t) * 4 * 3, sizeof(uint8_t) };
+	VkDeviceSize source_offset = 0;
+	for (uint32_t i = 0; i != upload_count; ++i) {
+		uint32_t slot_index = stream_buffers->upload_slots[swapchain_index * stream_buffers->upload_budget + i];
+		uint64_t first_triangle = stream->proxy_triangle_count + slot_index * stream->slot_triangle_count;
+		uint64_t triangle_count = app->scene.chunks[stream->slot_chunks[slot_index]].triangle_count;
+		for (uint32_t j = 0; j != mesh_buffer_count; ++j) {
+			VkBufferCopy region = {
+				.srcOffset = source_offset,
+				.dstOffset = triangle_sizes[j] * first_triangle,
+				.size = triangle_sizes[j] * triangle_count
+			};
+			vkCmdCopyBuffer(cmd, stream_buffers->staging.buffers[swapchain_index].buffer, app->scene.mesh.buffers[j].buffer, 1, &region);
+			source_offset += triangle_sizes[j] * stream->slot_triangle_count;
+		}
+	}
+	// Make the reset feedback and the new chunks visible to the render pass
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+
+/*! Records draw calls for all triangles of the scene in the geometry pass. If
+	the scene provides levels of detail and their selection is enabled, each
+	chunk uses its coarsest level whose error projects to at most
+	render_settings_t.lod_pixel_error pixels. For streamed scenes, chunks that
+	are not resident use their proxy. If render_settings_t.cull_chunks is
+	enabled, chunks whose bounding box is outside the view frustum are
+	skipped. Draws for consecutive triangle ranges get merged.
+	\return The number of drawn triangles.*/
+uint64_t record_geometry_draws(VkCommandBuffer cmd, application_t* app) {
+	scene_t* scene = &app->scene;
+	geometry_stream_t* stream = &scene->stream;
+	VkBool32 select_lods = app->render_settings.select_lods && scene->lod_level_count > 0 && !app->geometry_pass.compressed_geometry;
+	VkBool32 cull_chunks = app->render_settings.cull_chunks && scene->chunk_count > 0;
+	app->geometry_pass.culled_chunk_count = 0;
+	if (!select_lods && !cull_chunks && !stream->file) {
+		vkCmdDraw(cmd, (uint32_t) scene->mesh.triangle_count * 3, 1, 0, 0);
+		return scene->mesh.triangle_count;
+	}
+	// An error of one world space unit at distance one covers this many pixels
+	const first_person_camera_t* camera = &app->scene_specification.camera;
+	float pixels_per_unit = (float) app->swapchain.extent.height / (2.0f * tanf(0.5f * camera->vertical_fov));
+	float world_to_projection_space[4][4], frustum_planes[6][4];
+	get_world_to_projection_space(world_to_projection_space, camera, get_aspect_ratio(&app->swapchain));
+	get_frustum_planes(frustum_planes, world_to_projection_space);
+	uint64_t drawn_count = 0, range_begin = 0, range_end = 0;
+	for (uint64_t i = 0; i != scene->chunk_count; ++i) {
+		const mesh_chunk_t* chunk = &scene->chunks[i];
+		if (cull_chunks && is_chunk_outside_frustum(chunk, frustum_planes)) {
+			++app->geometry_pass.culled_chunk_count;
+			continue;
+		}
+		// Use the distance from the camera to the bounding box of the chunk
+		float distance = sqrtf(get_chunk_squared_distance(chunk, camera->position_world_space));
+		float max_error = app->render_settings.lod_pixel_error * distance / pixels_per_unit;
+		uint64_t first_triangle = chunk->first_triangle, triangle_count = chunk->triangle_count;
+		if (stream->file) {
+			// Use the proxy if it is good enough or if there is nothing else
+			streamed_chunk_t* streamed = &stream->chunks[i];
+			streamed->proxy_sufficient = app->render_settings.select_lods && streamed->proxy_error <= max_error;
+			if (streamed->slot_index == UINT32_MAX || streamed->proxy_sufficient) {
+				first_triangle = streamed->proxy_first_triangle;
+				triangle_count = streamed->proxy_triangle_count;
+			}
+			else
+				first_triangle = stream->proxy_triangle_count + streamed->slot_index * stream->slot_triangle_count;
+		}
+		else if (select_lods) {
+			// Errors grow monotonically with the level
+			const mesh_chunk_lod_t* lods = &scene->chunk_lods[i * scene->lod_level_count];
+			for (uint32_t j = 0; j != scene->lod_level_count && lods[j].error <= max_error; ++j) {
+				first_triangle = lods[j].first_triangle;
+				triangle_count = lods[j].triangle_count;
+			}
+		}
+		if (first_triangle != range_end) {
+			if (range_end > range_begin)
+				vkCmdDraw(cmd, (uint32_t) (3 * (range_end - range_begin)), 1, (uint32_t) (3 * range_begin), 0);
+			range_begin = first_triangle;
+		}
+		range_end = first_triangle + triangle_count;
+		drawn_count += triangle_count;
+	}
+	if (range_end > range_begin)
+		vkCmdDraw(cmd, (uint32_t) (3 * (range_end - range_begin)), 1, (uint32_t) (3 * range_begin), 0);
+	return drawn_count;
+}
+
+
 /*! This function records commands for rendering a frame to the given swapchain
 	image into the given command buffer
 	\return 0 on success.*/
@@ -1403,19 +2238,43 @@ int record_render_frame_commands(VkCommandBuffer cmd, application_t* app, uint32
 		printf("Failed to begin using a command buffer for rendering the scene.\n");
 		return 1;
 	}
+	VkQueryPool timestamps = app->frame_queue.timestamps;
+	if (timestamps)
+		vkCmdResetQueryPool(cmd, timestamps, FRAME_TIMESTAMP_COUNT * swapchain_index, FRAME_TIMESTAMP_COUNT);
+	// Upload streamed geometry and reset feedback
+	if (app->scene.stream.file || app->scene.materials.stream.texture_count > 0)
+		record_stream_uploads(cmd, app, swapchain_index);
+	// Update the acceleration structure as though the scene were animated
+	if (timestamps)
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, FRAME_TIMESTAMP_COUNT * swapchain_index + 3);
+	if (app->scene.acceleration_structure.updatable && app->render_settings.acceleration_structure_update != acceleration_structure_update_none)
+		record_acceleration_structure_update(cmd, &app->scene.acceleration_structure, device, &app->scene.mesh,
+			app->render_settings.acceleration_structure_update == acceleration_structure_update_refit, app->render_settings.full_rebuild_interval);
+	if (timestamps)
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, FRAME_TIMESTAMP_COUNT * swapchain_index + 4);
+	// Evaluate keyframes of animated lights in the light buffer
+	const light_animation_pass_t* light_animation = &app->light_animation_pass;
+	if (light_animation->animated_light_count > 0) {
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, light_animation->pipeline.pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+			light_animation->pipeline.pipeline_layout, 0, 1, &light_animation->pipeline.descriptor_sets[swapchain_index], 0, NULL);
+		vkCmdDispatch(cmd, (app->scene_specification.polygonal_light_count + 63) / 64, 1, 1);
+		VkMemoryBarrier light_barrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+		};
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &light_barrier, 0, NULL, 0, NULL);
+	}
 	// Begin the render pass that renders the whole frame
-	VkClearValue clear_values[] = {
-		{.depthStencil = {.depth = 1.0f}},
-		{.color = {.uint32 = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}}},
-		{.color = {.uint32 = {0, 0, 0, 0}}},
-	};
+	const render_graph_t* graph = &app->render_pass.graph;
 	VkRenderPassBeginInfo render_pass_begin = {
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-		.renderPass = app->render_pass.render_pass,
-		.framebuffer = app->render_pass.framebuffers[swapchain_index],
+		.renderPass = graph->render_pass,
+		.framebuffer = graph->framebuffers[swapchain_index],
 		.renderArea.offset = {0, 0},
 		.renderArea.extent = app->swapchain.extent,
-		.clearValueCount = COUNT_OF(clear_values), .pClearValues = clear_values
+		.clearValueCount = graph->physical_attachment_count, .pClearValues = graph->clear_values
 	};
 	vkCmdBeginRenderPass(cmd, &render_pass_begin, VK_SUBPASS_CONTENTS_INLINE);
 	// Render the scene to the visibility buffer
@@ -1423,15 +2282,37 @@ int record_render_frame_commands(VkCommandBuffer cmd, application_t* app, uint32
 	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, 
 		app->geometry_pass.pipeline.pipeline_layout, 0, 1, &app->geometry_pass.pipeline.descriptor_sets[swapchain_index], 0, NULL);
 	const VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(cmd, 0, 1, &app->scene.mesh.positions.buffer, offsets);
-	vkCmdDraw(cmd, (uint32_t)app->scene.mesh.triangle_count * 3, 1, 0, 0);
-	// Run the shading pass
+	if (!app->geometry_pass.compressed_geometry)
+		vkCmdBindVertexBuffers(cmd, 0, 1, &app->scene.mesh.positions.buffer, offsets);
+	if (timestamps)
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, FRAME_TIMESTAMP_COUNT * swapchain_index + 0);
+	app->geometry_pass.drawn_triangle_count = record_geometry_draws(cmd, app);
+	if (timestamps)
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, FRAME_TIMESTAMP_COUNT * swapchain_index + 1);
+	// Run the shading pass, possibly once per compared configuration with
+	// a timestamp after each of them
+	const shading_pass_t* shading_pass = &app->shading_pass;
 	vkCmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, app->shading_pass.pipeline.pipeline);
 	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-		app->shading_pass.pipeline.pipeline_layout, 0, 1, &app->shading_pass.pipeline.descriptor_sets[swapchain_index], 0, NULL);
+		shading_pass->pipeline.pipeline_layout, 0, 1, &shading_pass->pipeline.descriptor_sets[swapchain_index], 0, NULL);
 	vkCmdBindVertexBuffers(cmd, 0, 1, &app->scene.mesh.triangle.buffer, offsets);
-	vkCmdDraw(cmd, 3, 1, 0, 0);
+	for (uint32_t i = 0; i != shading_pass->comparison_count; ++i) {
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shading_pass->comparison_pipelines[i]);
+		vkCmdDraw(cmd, 3, 1, 0, 0);
+		if (timestamps)
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, FRAME_TIMESTAMP_COUNT * swapchain_index + 5 + i);
+	}
+	if (shading_pass->comparison_count == 0) {
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shading_pass->pipeline.pipeline);
+		vkCmdDraw(cmd, 3, 1, 0, 0);
+	}
+	if (timestamps) {
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, FRAME_TIMESTAMP_COUNT * swapchain_index + 2);
+		// Unused timestamps are written anyway, such that results for all
+		// of them become available
+		for (uint32_t i = shading_pass->comparison_count; i != MAX_COMPARISON_CONFIG_COUNT; ++i)
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, FRAME_TIMESTAMP_COUNT * swapchain_index + 5 + i);
+	}
 	// Run the interface pass
 	vkCmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
 	if (app->render_settings.show_gui && !app->screenshot.path_hdr) {
@@ -1442,6 +2323,15 @@ int record_render_frame_commands(VkCommandBuffer cmd, application_t* app, uint32
 	}
 	// The frame is rendered completely
 	vkCmdEndRenderPass(cmd);
+	// The CPU reads feedback for streaming once the frame is finished
+	if (app->scene.stream.file || app->scene.materials.stream.texture_count > 0) {
+		VkMemoryBarrier feedback_barrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT
+		};
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &feedback_barrier, 0, NULL, 0, NULL);
+	}
 
 	// Finish recording
 	if (vkEndCommandBuffer(cmd)) {
@@ -1485,6 +2375,8 @@ void destroy_frame_queue(frame_queue_t* queue, const device_t* device) {
 		if (queue->syncs)
 			destroy_frame_sync(&queue->syncs[i], device);
 	}
+	if (queue->timestamps)
+		vkDestroyQueryPool(device->device, queue->timestamps, NULL);
 	free(queue->workloads);
 	free(queue->syncs);
 	memset(queue, 0, sizeof(*queue));
@@ -1527,6 +2419,19 @@ int create_frame_queue(frame_queue_t* queue, const device_t* device, const swapc
 			return 1;
 		}
 	}
+	// Create queries for timing of the geometry and shading pass if supported
+	if (device->physical_device_properties.limits.timestampComputeAndGraphics) {
+		VkQueryPoolCreateInfo query_info = {
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = FRAME_TIMESTAMP_COUNT * queue->frame_count
+		};
+		if (vkCreateQueryPool(device->device, &query_info, NULL, &queue->timestamps)) {
+			printf("Failed to create a query pool for timestamps.\n");
+			destroy_frame_queue(queue, device);
+			return 1;
+		}
+	}
 	return 0;
 }
 
@@ -1779,14 +2684,18 @@ void destroy_application(application_t* app) {
 	destroy_interface_pass(&app->interface_pass, &app->device);
 	destroy_shading_pass(&app->shading_pass, &app->device);
 	destroy_geometry_pass(&app->geometry_pass, &app->device);
+	destroy_light_animation_pass(&app->light_animation_pass, &app->device);
+	destroy_baked_visibility(&app->baked_visibility, &app->device);
 	destroy_render_pass(&app->render_pass, &app->device);
-	destroy_render_targets(&app->render_targets, &app->device);
 	destroy_light_textures(&app->light_textures, &app->device);
+	destroy_stream_buffers(&app->stream_buffers, &app->device);
 	destroy_constant_buffers(&app->constant_buffers, &app->device);
 	destroy_noise_table(&app->noise_table, &app->device);
 	destroy_ltc_table(&app->ltc_table, &app->device);
 	destroy_scene(&app->scene, &app->device);
 	destroy_experiment_list(&app->experiment_list);
+	destroy_camera_path(&app->camera_path);
+	if (app->benchmark.report) fclose(app->benchmark.report);
 	destroy_scene_specification(&app->scene_specification);
 	destroy_swapchain(&app->swapchain, &app->device);
 	destroy_vulkan_device(&app->device);
@@ -1798,6 +2707,129 @@ void destroy_application(application_t* app) {
 void glfw_framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
 
+//! Job that loads the noise table of the given application_t
+int load_noise_table_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return load_noise_table(&app->noise_table, &app->device, get_default_noise_resolution(app->render_settings.noise_type), app->render_settings.noise_type);
+}
+
+
+//! Job that loads the LTC table of the given application_t
+int load_ltc_table_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return load_ltc_table(&app->ltc_table, &app->device, "data/ggx_ltc_fit", 51);
+}
+
+
+//! Job that loads the scene of the given application_t
+int load_scene_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return load_scene(&app->scene, &app->device, app->scene_specification.file_path, app->scene_specification.texture_path, VK_TRUE, app->render_settings.acceleration_structure_update != acceleration_structure_update_none, app->render_settings.pack_material_textures, app->render_settings.interleave_mesh_attributes, app->render_settings.compress_geometry,
+		(VkDeviceSize) app->render_settings.geometry_pool_size * 1024 * 1024, (VkDeviceSize) app->render_settings.texture_pool_size * 1024 * 1024);
+}
+
+
+//! Job that creates the render pass of the given application_t
+int create_render_pass_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return create_render_pass(&app->render_pass, &app->device, &app->swapchain);
+}
+
+
+//! Job that creates the constant buffers of the given application_t
+int create_constant_buffers_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return create_constant_buffers(&app->constant_buffers, &app->device, &app->swapchain, &app->scene_specification, &app->render_settings);
+}
+
+
+//! Job that loads light textures of the given application_t. It is the only
+//! job that writes to the scene specification.
+int create_light_textures_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return create_and_assign_light_textures(&app->light_textures, &app->device, &app->scene_specification);
+}
+
+
+//! Job that creates the stream buffers of the given application_t
+int create_stream_buffers_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return create_stream_buffers(&app->stream_buffers, &app->device, &app->swapchain, &app->scene);
+}
+
+
+//! Job that loads baked visibility for the given application_t
+int create_baked_visibility_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return create_baked_visibility(&app->baked_visibility, &app->device, &app->scene, &app->scene_specification, &app->render_settings);
+}
+
+
+//! Job that creates the light animation pass of the given application_t
+int create_light_animation_pass_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return create_light_animation_pass(&app->light_animation_pass, &app->device, &app->swapchain, &app->constant_buffers, &app->scene_specification);
+}
+
+
+//! Job that creates the geometry pass of the given application_t
+int create_geometry_pass_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return create_geometry_pass(&app->geometry_pass, &app->device, &app->swapchain, &app->scene, &app->constant_buffers, &app->render_pass);
+}
+
+
+//! Job that creates the shading pass of the given application_t without its
+//! pipelines
+int create_shading_pass_resources_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return create_shading_pass_resources(&app->shading_pass, app);
+}
+
+
+//! The argument of create_shading_pass_strip_pipeline_job()
+typedef struct shading_pass_pipeline_job_s {
+	application_t* app;
+	uint32_t index;
+} shading_pass_pipeline_job_t;
+
+
+//! Job that creates one pipeline of the shading pass, given a
+//! shading_pass_pipeline_job_t
+int create_shading_pass_strip_pipeline_job(void* argument) {
+	shading_pass_pipeline_job_t* job = (shading_pass_pipeline_job_t*) argument;
+	return create_shading_pass_strip_pipeline(&job->app->shading_pass, job->app, job->index);
+}
+
+
+//! Job that creates the interface pass of the given application_t
+int create_interface_pass_job(void* argument) {
+	application_t* app = (application_t*) argument;
+	return create_interface_pass(&app->interface_pass, &app->device, app->imgui, &app->swapchain, &app->render_pass);
+}
+
+
+/*! Runs the given job graph. Jobs do not ask for input when they fail (e.g.
+	because a shader does not compile). Instead, this function asks on the
+	main thread whether failed jobs should be run again and repeats that until
+	they succeed or the user declines.
+	\return 0 if all jobs have succeeded eventually.*/
+int run_job_graph_with_second_chance(job_graph_t* graph, uint32_t thread_count) {
+	int result = run_job_graph(graph, thread_count);
+	job_graph_t failed_jobs;
+	memset(&failed_jobs, 0, sizeof(failed_jobs));
+	while (result && ask_to_try_again()) {
+		job_graph_t retry_jobs;
+		create_retry_job_graph(&retry_jobs, (failed_jobs.job_count > 0) ? &failed_jobs : graph);
+		destroy_job_graph(&failed_jobs);
+		result = run_job_graph(&retry_jobs, thread_count);
+		failed_jobs = retry_jobs;
+	}
+	destroy_job_graph(&failed_jobs);
+	return result;
+}
+
+
 /*! Repeats all initialization procedures that need to be performed to
 	implement the given update.
 	\return 0 on success.*/
@@ -1805,6 +2837,18 @@ int update_application(application_t* app, const application_updates_t* update_i
 	application_updates_t update = *update_in;
 	// Perform a quick save if requested
 	if (update.quick_save) quick_save(&app->scene_specification);
+	// Start or stop recording of a camera path or start its playback
+	if (update.record_camera_path || update.play_camera_path) {
+		const char* path_pieces[] = { app->scene_specification.quick_save_path, ".path" };
+		char* path_file_path = concatenate_strings(COUNT_OF(path_pieces), path_pieces);
+		if (update.record_camera_path && app->camera_path.state == camera_path_state_recording)
+			save_camera_path(&app->camera_path, path_file_path);
+		else if (update.record_camera_path)
+			start_camera_path_recording(&app->camera_path, &app->scene_specification);
+		else
+			start_camera_path_playback(&app->camera_path, path_file_path, &app->scene_specification);
+		free(path_file_path);
+	}
 	// Check if a window resize is requested
 	uint32_t width = (update.window_width != 0) ? update.window_width : app->swapchain.extent.width;
 	uint32_t height = (update.window_height != 0) ? update.window_height : app->swapchain.extent.height;
@@ -1814,8 +2858,8 @@ int update_application(application_t* app, const application_updates_t* update_i
 	}
 	// Return early, if there is nothing to update
 	if (!update.startup && !update.recreate_swapchain && !update.reload_shaders
-		&& !update.quick_load && !update.update_light_count && !update.update_light_textures
-		&& !update.reload_scene && !update.change_shading && !update.regenerate_noise)
+		&& !update.quick_load && !update.update_light_count && !update.update_light_textures && !update.update_light_animation
+		&& !update.reload_scene && !update.change_shading && !update.regenerate_noise && !update.reload_baked_visibility)
 		return 0;
 	// Perform a quick load
 	if (update.quick_load)
@@ -1825,11 +2869,20 @@ int update_application(application_t* app, const application_updates_t* update_i
 	VkBool32 noise = update.startup | update.regenerate_noise;
 	VkBool32 ltc_table = update.startup;
 	VkBool32 scene = update.startup | update.reload_scene;
-	VkBool32 render_targets = update.startup;
 	VkBool32 render_pass = update.startup;
 	VkBool32 constant_buffers = update.startup | update.update_light_count | update.change_shading;
 	VkBool32 light_textures = update.startup | update.reload_scene | update.update_light_count | update.update_light_textures;
-	VkBool32 geometry_pass = update.startup | update.reload_shaders;
+	// Only streamed scenes need stream buffers
+	VkBool32 stream_buffers = scene & ((app->stream_buffers.feedback.buffer_count > 0) | (app->stream_buffers.texture_feedback.buffer_count > 0)
+		| (app->render_settings.geometry_pool_size > 0) | (app->render_settings.texture_pool_size > 0));
+	// Baked visibility is only valid for specific static lights. If it is
+	// disabled, it stays empty and does not need updates.
+	VkBool32 baked_visibility = update.startup | update.reload_baked_visibility
+		| ((update.quick_load | update.update_light_count | update.update_light_animation) & app->render_settings.use_baked_visibility);
+	VkBool32 light_animation_pass = update.startup | update.update_light_animation | update.reload_shaders;
+	// With compressed geometry, the geometry pass binds buffers of the scene
+	VkBool32 geometry_pass = update.startup | update.reload_shaders
+		| (scene & (app->geometry_pass.compressed_geometry | app->render_settings.compress_geometry));
 	VkBool32 shading_pass = update.startup | update.change_shading | update.reload_shaders;
 	VkBool32 interface_pass = update.startup | update.reload_shaders;
 	VkBool32 frame_queue = update.startup;
@@ -1837,12 +2890,14 @@ int update_application(application_t* app, const application_updates_t* update_i
 	// create functions)
 	uint32_t max_dependency_path_length = 16;
 	for (uint32_t i = 0; i != max_dependency_path_length; ++i) {
-		render_targets |= swapchain;
-		render_pass |= swapchain | render_targets;
+		render_pass |= swapchain;
 		constant_buffers |= swapchain;
-		geometry_pass |= swapchain | scene | constant_buffers | render_targets;
-		shading_pass |= swapchain | noise | ltc_table | scene | render_targets | constant_buffers | light_textures | geometry_pass | shading_pass | interface_pass | frame_queue;
-		interface_pass |= swapchain | render_targets;
+		stream_buffers |= swapchain;
+		baked_visibility |= scene & app->render_settings.use_baked_visibility;
+		light_animation_pass |= swapchain | constant_buffers;
+		geometry_pass |= swapchain | constant_buffers | render_pass;
+		shading_pass |= swapchain | noise | ltc_table | render_pass | constant_buffers | stream_buffers | baked_visibility | geometry_pass | shading_pass | interface_pass | frame_queue;
+		interface_pass |= swapchain | render_pass;
 		frame_queue |= swapchain;
 	}
 	// Tear down everything that needs to be reinitialized in reverse order
@@ -1851,10 +2906,12 @@ int update_application(application_t* app, const application_updates_t* update_i
 	if (interface_pass) destroy_interface_pass(&app->interface_pass, &app->device);
 	if (shading_pass) destroy_shading_pass(&app->shading_pass, &app->device);
 	if (geometry_pass) destroy_geometry_pass(&app->geometry_pass, &app->device);
+	if (light_animation_pass) destroy_light_animation_pass(&app->light_animation_pass, &app->device);
+	if (baked_visibility) destroy_baked_visibility(&app->baked_visibility, &app->device);
 	if (light_textures) destroy_light_textures(&app->light_textures, &app->device);
+	if (stream_buffers) destroy_stream_buffers(&app->stream_buffers, &app->device);
 	if (constant_buffers) destroy_constant_buffers(&app->constant_buffers, &app->device);
 	if (render_pass) destroy_render_pass(&app->render_pass, &app->device);
-	if (render_targets) destroy_render_targets(&app->render_targets, &app->device);
 	if (scene) destroy_scene(&app->scene, &app->device);
 	if (ltc_table) destroy_ltc_table(&app->ltc_table, &app->device);
 	if (noise) destroy_noise_table(&app->noise_table, &app->device);
@@ -1869,18 +2926,67 @@ int update_application(application_t* app, const application_updates_t* update_i
 			return 1;
 		}
 	}
-	// Rebuild everything else
-	if (   (noise && load_noise_table(&app->noise_table, &app->device, get_default_noise_resolution(app->render_settings.noise_type), app->render_settings.noise_type))
-		|| (ltc_table && load_ltc_table(&app->ltc_table, &app->device, "data/ggx_ltc_fit", 51))
-		|| (scene && load_scene(&app->scene, &app->device, app->scene_specification.file_path, app->scene_specification.texture_path, VK_TRUE))
-		|| (render_targets && create_render_targets(&app->render_targets, &app->device, &app->swapchain))
-		|| (render_pass && create_render_pass(&app->render_pass, &app->device, &app->swapchain, &app->render_targets))
-		|| (constant_buffers && create_constant_buffers(&app->constant_buffers, &app->device, &app->swapchain, &app->scene_specification, &app->render_settings))
-		|| (light_textures && create_and_assign_light_textures(&app->light_textures, &app->device, &app->scene_specification))
-		|| (geometry_pass && create_geometry_pass(&app->geometry_pass, &app->device, &app->swapchain, &app->scene, &app->constant_buffers, &app->render_targets, &app->render_pass))
-		|| (shading_pass && create_shading_pass(&app->shading_pass, app))
-		|| (interface_pass && create_interface_pass(&app->interface_pass, &app->device, app->imgui, &app->swapchain, &app->render_targets, &app->render_pass))
-		|| (frame_queue && create_frame_queue(&app->frame_queue, &app->device, &app->swapchain)))
+	// Rebuild everything else and time loading and pass creation separately.
+	// Loading mostly reads files and decodes data, so independent resources
+	// load in parallel jobs. Only their submissions to the queue take turns on
+	// the submit thread of the device, uploads overlap.
+	double load_start_time = glfwGetTime();
+	job_graph_t load_jobs;
+	memset(&load_jobs, 0, sizeof(load_jobs));
+	if (noise) add_job(&load_jobs, load_noise_table_job, app);
+	if (ltc_table) add_job(&load_jobs, load_ltc_table_job, app);
+	uint32_t scene_job = scene ? add_job(&load_jobs, load_scene_job, app) : 0;
+	if (render_pass) add_job(&load_jobs, create_render_pass_job, app);
+	// Light textures write to the scene specification, which others read
+	uint32_t light_textures_job = light_textures ? add_job(&load_jobs, create_light_textures_job, app) : 0;
+	if (constant_buffers) {
+		uint32_t job = add_job(&load_jobs, create_constant_buffers_job, app);
+		if (light_textures) add_job_dependency(&load_jobs, job, light_textures_job);
+	}
+	if (stream_buffers) {
+		uint32_t job = add_job(&load_jobs, create_stream_buffers_job, app);
+		if (scene) add_job_dependency(&load_jobs, job, scene_job);
+	}
+	if (baked_visibility) {
+		uint32_t job = add_job(&load_jobs, create_baked_visibility_job, app);
+		if (scene) add_job_dependency(&load_jobs, job, scene_job);
+		if (light_textures) add_job_dependency(&load_jobs, job, light_textures_job);
+	}
+	// Failed jobs free what they have created, so they can simply run again
+	int load_result = run_job_graph_with_second_chance(&load_jobs, app->job_thread_count);
+	destroy_job_graph(&load_jobs);
+	if (load_result)
+		return 1;
+	// Creating passes mostly waits for the shader compiler. Passes do not
+	// depend on one another, so they are created by parallel jobs and the
+	// pipelines of the shading pass wait for its remaining objects.
+	double compile_start_time = glfwGetTime();
+	job_graph_t pass_jobs;
+	memset(&pass_jobs, 0, sizeof(pass_jobs));
+	if (light_animation_pass) add_job(&pass_jobs, create_light_animation_pass_job, app);
+	if (geometry_pass) add_job(&pass_jobs, create_geometry_pass_job, app);
+	shading_pass_pipeline_job_t pipeline_jobs[MAX_COMPARISON_CONFIG_COUNT];
+	if (shading_pass) {
+		uint32_t resources_job = add_job(&pass_jobs, create_shading_pass_resources_job, app);
+		uint32_t pipeline_count = get_shading_pass_comparison_count(&app->render_settings);
+		pipeline_count = (pipeline_count > 0) ? pipeline_count : 1;
+		for (uint32_t i = 0; i != pipeline_count; ++i) {
+			pipeline_jobs[i].app = app;
+			pipeline_jobs[i].index = i;
+			add_job_dependency(&pass_jobs, add_job(&pass_jobs, create_shading_pass_strip_pipeline_job, &pipeline_jobs[i]), resources_job);
+		}
+	}
+	if (interface_pass) add_job(&pass_jobs, create_interface_pass_job, app);
+	int pass_result = run_job_graph_with_second_chance(&pass_jobs, app->job_thread_count);
+	destroy_job_graph(&pass_jobs);
+	if (pass_result || (frame_queue && create_frame_queue(&app->frame_queue, &app->device, &app->swapchain)))
+		return 1;
+	app->benchmark.load_time = compile_start_time - load_start_time;
+	app->benchmark.compile_time = glfwGetTime() - compile_start_time;
+	// The scene and light textures only enter the shading pass through
+	// descriptors. If it has not been recreated anyway, update these.
+	if (   (!shading_pass && scene && write_shading_pass_scene_descriptors(&app->shading_pass, app))
+		|| (!shading_pass && light_textures && write_shading_pass_light_texture_descriptors(&app->shading_pass, app)))
 		return 1;
 	return 0;
 }
@@ -1892,9 +2998,16 @@ int update_application(application_t* app, const application_updates_t* update_i
 		that should be used for the initial configuration instead of the
 		default configuration. An invalid index implies the default.
 	\param v_sync_override Lets you force v-sync on or off.
+	\param scene_paths NULL or paths of a scene file, its texture directory
+		and its quicksave, which replace the scene of the experiment or the
+		default scene.
+	\param job_thread_count The number of threads used to load resources and
+		to create passes or 0 to use all hardware threads.
+	\param window_extent The initial size of the window in pixels.
 	\return 0 on success.*/
-int startup_application(application_t* app, int experiment_index, bool_override_t v_sync_override) {
+int startup_application(application_t* app, int experiment_index, bool_override_t v_sync_override, const char* const* scene_paths, uint32_t job_thread_count, VkExtent2D window_extent) {
 	memset(app, 0, sizeof(*app));
+	app->job_thread_count = job_thread_count;
 	g_glfw_application = app;
 	const char application_display_name[] = "Vulkan renderer";
 	const char application_internal_name[] = "vulkan_renderer";
@@ -1917,15 +3030,26 @@ int startup_application(application_t* app, int experiment_index, bool_override_
 		quick_load(&app->scene_specification, NULL);
 		// Set render settings
 		app->render_settings = experiment->render_settings;
-		if (v_sync_override != bool_override_none) app->render_settings.v_sync = v_sync_override;
 	}
 	else {
 		specify_default_scene(&app->scene_specification);
 		specify_default_render_settings(&app->render_settings);
 	}
+	// Use the scene from the command line (if any)
+	if (scene_paths) {
+		scene_specification_t* scene = &app->scene_specification;
+		free(scene->file_path);
+		free(scene->texture_path);
+		free(scene->quick_save_path);
+		scene->file_path = copy_string(scene_paths[0]);
+		scene->texture_path = copy_string(scene_paths[1]);
+		scene->quick_save_path = copy_string(scene_paths[2]);
+		quick_load(scene, NULL);
+	}
+	if (v_sync_override != bool_override_none) app->render_settings.v_sync = v_sync_override;
 	app->render_settings.trace_shadow_rays &= app->device.ray_tracing_supported;
 	// Create the swapchain
-	if (create_or_resize_swapchain(&app->swapchain, &app->device, VK_FALSE, application_display_name, 1920, 1080, app->render_settings.v_sync)) {
+	if (create_or_resize_swapchain(&app->swapchain, &app->device, VK_FALSE, application_display_name, window_extent.width, window_extent.height, app->render_settings.v_sync)) {
 		destroy_application(app);
 		return 1;
 	}
@@ -1943,6 +3067,67 @@ int startup_application(application_t* app, int experiment_index, bool_override_
 }
 
 
+//! Writes a line with the given metric name and a time in seconds to the
+//! benchmark report, converting the time to milliseconds
+void write_benchmark_metric(benchmark_t* benchmark, const char* name, double time) {
+	fprintf(benchmark->report, "%s,%.4f\n", name, time * 1000.0);
+}
+
+
+//! Like write_benchmark_metric() but the name is a format string consuming the
+//! index of the current technique
+void write_technique_benchmark_metric(benchmark_t* benchmark, const char* name_format, double time) {
+	char* name = format_uint(name_format, benchmark->technique);
+	write_benchmark_metric(benchmark, name, time);
+	free(name);
+}
+
+
+/*! In benchmark mode, this function switches through polygon sampling
+	techniques, accumulates timings of the previous frame and writes averages
+	to the report once enough frames have been measured.
+	\return 1 if all benchmarks have finished and the application should
+		shut down.*/
+int advance_benchmark(benchmark_t* benchmark, application_updates_t* updates, render_settings_t* render_settings, const frame_queue_t* queue) {
+	if (!benchmark->report)
+		return 0;
+	double now = glfwGetTime();
+	if (benchmark->frame_index == 0) {
+		// Switch to the next technique or finish
+		if (benchmark->technique >= sample_polygon_count) {
+			fclose(benchmark->report);
+			benchmark->report = NULL;
+			printf("Benchmarks have finished. Shutting down.\n");
+			return 1;
+		}
+		render_settings->polygon_sampling_technique = (sample_polygon_technique_t) benchmark->technique;
+		updates->change_shading = VK_TRUE;
+		benchmark->frame_time = benchmark->cpu_time = benchmark->gpu_time = 0.0;
+	}
+	else if (benchmark->frame_index == 1) {
+		// The previous frame has applied the switch
+		write_technique_benchmark_metric(benchmark, "compile_time_technique_%u", benchmark->compile_time);
+	}
+	else if (benchmark->frame_index > BENCHMARK_WARMUP_FRAME_COUNT) {
+		benchmark->frame_time += now - benchmark->previous_frame_start_time;
+		benchmark->cpu_time += queue->cpu_time;
+		benchmark->gpu_time += queue->geometry_pass_time + queue->shading_pass_time + queue->acceleration_structure_update_time;
+	}
+	benchmark->previous_frame_start_time = now;
+	++benchmark->frame_index;
+	// Report averages and move on to the next technique
+	if (benchmark->frame_index > BENCHMARK_WARMUP_FRAME_COUNT + BENCHMARK_FRAME_COUNT) {
+		write_technique_benchmark_metric(benchmark, "frame_time_technique_%u", benchmark->frame_time / BENCHMARK_FRAME_COUNT);
+		write_technique_benchmark_metric(benchmark, "cpu_time_technique_%u", benchmark->cpu_time / BENCHMARK_FRAME_COUNT);
+		write_technique_benchmark_metric(benchmark, "gpu_time_technique_%u", benchmark->gpu_time / BENCHMARK_FRAME_COUNT);
+		fflush(benchmark->report);
+		++benchmark->technique;
+		benchmark->frame_index = 0;
+	}
+	return 0;
+}
+
+
 //!	Checks if it is time to complete an experiment and to prepare the next one
 //! and updates settings accordingly
 void advance_experiments(screenshot_t* screenshot, application_updates_t* updates, experiment_list_t* list, scene_specification_t* scene, render_settings_t* render_settings) {
@@ -1989,6 +3174,13 @@ void advance_experiments(screenshot_t* screenshot, application_updates_t* update
 			updates->recreate_swapchain = VK_TRUE;
 		if (render_settings->noise_type != list->experiment->render_settings.noise_type)
 			updates->regenerate_noise = VK_TRUE;
+		if (render_settings->pack_material_textures != list->experiment->render_settings.pack_material_textures
+			|| render_settings->interleave_mesh_attributes != list->experiment->render_settings.interleave_mesh_attributes
+			|| render_settings->compress_geometry != list->experiment->render_settings.compress_geometry
+			|| render_settings->geometry_pool_size != list->experiment->render_settings.geometry_pool_size
+			|| render_settings->texture_pool_size != list->experiment->render_settings.texture_pool_size
+			|| (render_settings->acceleration_structure_update == acceleration_structure_update_none) != (list->experiment->render_settings.acceleration_structure_update == acceleration_structure_update_none))
+			updates->reload_scene = VK_TRUE;
 		updates->change_shading = VK_TRUE;
 		(*render_settings) = list->experiment->render_settings;
 		// Proceed
@@ -2053,6 +3245,56 @@ VkBool32 key_pressed(GLFWwindow* window, int key) {
 }
 
 
+/*! Compares the state of the application to that in the previous frame and
+	counts for how many frames nothing has changed. Some states, e.g. running
+	experiments or streaming, always count as a change.
+	\param updates The updates that have been applied in the current frame.*/
+void update_idle_detector(idle_detector_t* detector, application_t* app, const application_updates_t* updates) {
+	// Compare the camera and lights, including their animation
+	const scene_specification_t* scene = &app->scene_specification;
+	uint64_t light_hash = get_polygonal_light_hash(scene->polygonal_lights, scene->polygonal_light_count);
+	VkBool32 changed = (memcmp(&detector->previous_camera, &scene->camera, sizeof(scene->camera)) != 0);
+	changed |= (detector->previous_light_hash != light_hash);
+	changed |= (detector->previous_light_animation_time != scene->light_animation_time);
+	detector->previous_camera = scene->camera;
+	detector->previous_light_hash = light_hash;
+	detector->previous_light_animation_time = scene->light_animation_time;
+	// The cursor position enters the constant buffer
+	double cursor_position[2];
+	glfwGetCursorPos(app->swapchain.window, &cursor_position[0], &cursor_position[1]);
+	int32_t cursor_pixel[2] = { (int32_t) cursor_position[0], (int32_t) cursor_position[1] };
+	changed |= (detector->previous_cursor_position[0] != cursor_pixel[0] || detector->previous_cursor_position[1] != cursor_pixel[1]);
+	detector->previous_cursor_position[0] = cursor_pixel[0];
+	detector->previous_cursor_position[1] = cursor_pixel[1];
+	// Compare render settings
+	changed |= (memcmp(&detector->previous_settings, &app->render_settings, sizeof(app->render_settings)) != 0);
+	detector->previous_settings = app->render_settings;
+	// Any update counts as a change
+	application_updates_t no_updates;
+	memset(&no_updates, 0, sizeof(no_updates));
+	changed |= (memcmp(&no_updates, updates, sizeof(no_updates)) != 0);
+	// Some work has to continue over many frames
+	const screenshot_t* screenshot = &app->screenshot;
+	changed |= (app->experiment_list.next <= app->experiment_list.count);
+	changed |= (screenshot->path_png || screenshot->path_jpg || screenshot->path_hdr || screenshot->frame_bits != 0);
+	changed |= (app->stream_buffers.feedback.buffer_count > 0 || app->stream_buffers.texture_feedback.buffer_count > 0);
+	changed |= (app->render_settings.acceleration_structure_update != acceleration_structure_update_none);
+	changed |= (app->camera_path.state != camera_path_state_idle);
+	changed |= (app->benchmark.report != NULL);
+	changed |= !app->render_settings.render_on_demand;
+	// Animated noise does not count. It freezes while rendering is paused
+	// and resumes with the next input.
+	detector->unchanged_frame_count = changed ? 0 : (detector->unchanged_frame_count + 1);
+}
+
+
+//! Returns VK_TRUE iff nothing has changed for long enough that rendering
+//! can pause until new input arrives
+VkBool32 is_idle(const idle_detector_t* detector) {
+	return detector->unchanged_frame_count >= RENDER_ON_DEMAND_FRAME_COUNT;
+}
+
+
 /*! Implements user input and scene updates. Invoke this once per frame.
 	\return 0 if the application should keep running, 1 if it needs to end.*/
 int handle_frame_input(application_t* app) {
@@ -2096,8 +3338,18 @@ int handle_frame_input(application_t* app) {
 		app->frame_queue.recreate_swapchain = VK_FALSE;
 		updates.recreate_swapchain = VK_TRUE;
 	}
+	// Baked visibility is outdated once a light has been moved or reshaped
+	if (app->baked_visibility.buffer.buffer_count > 0
+		&& get_polygonal_light_geometry_hash(app->scene_specification.polygonal_lights, app->scene_specification.polygonal_light_count) != app->baked_visibility.light_hash)
+	{
+		printf("Polygonal lights have changed. Discarding baked visibility.\n");
+		updates.reload_baked_visibility = VK_TRUE;
+	}
 	// Cycle through experiments (if they are ongoing)
 	advance_experiments(&app->screenshot, &updates, &app->experiment_list, &app->scene_specification, &app->render_settings);
+	// Cycle through benchmarks (if they are running)
+	if (advance_benchmark(&app->benchmark, &updates, &app->render_settings, &app->frame_queue))
+		return 1;
 	// Handle updates
 	if (update_application(app, &updates)) {
 		printf("Failed to apply changed settings. Shutting down.\n");
@@ -2105,6 +3357,22 @@ int handle_frame_input(application_t* app) {
 	}
 	// Update the camera
 	control_camera(&app->scene_specification.camera, app->swapchain.window);
+	// Advance keyframed animations of lights (if there are any)
+	if (app->render_settings.animate_lights && app->light_animation_pass.animated_light_count > 0)
+		app->scene_specification.light_animation_time += get_frame_time();
+	// Record or play a camera path. Playback overrides the camera and lights.
+	if (advance_camera_path(&app->camera_path, &app->scene_specification, app->swapchain.image_count + 1)) {
+		const char* timings_pieces[] = { app->scene_specification.quick_save_path, ".path.csv" };
+		char* timings_path = concatenate_strings(COUNT_OF(timings_pieces), timings_pieces);
+		report_camera_path_timings(&app->camera_path, timings_path);
+		free(timings_path);
+		if (app->camera_path.exit_after_playback) {
+			printf("Camera path playback finished. Shutting down.\n");
+			return 1;
+		}
+	}
+	// Find out whether anything has changed
+	update_idle_detector(&app->idle_detector, app, &updates);
 	return 0;
 }
 
@@ -2128,6 +3396,8 @@ void write_constants(void* data, application_t* app) {
 		.exposure_factor = app->render_settings.exposure_factor,
 		.roughness_factor = app->render_settings.roughness_factor,
 		.frame_bits = app->screenshot.frame_bits,
+		.light_animation_time = app->scene_specification.light_animation_time,
+		.light_lod_solid_angle = app->render_settings.light_lod_solid_angle,
 	};
 	set_noise_constants(constants.noise_resolution_mask, &constants.noise_texture_index_mask, constants.noise_random_numbers, &app->noise_table, app->render_settings.animate_noise && (app->screenshot.frame_bits == 0));
 	get_world_to_projection_space(constants.world_to_projection_space, camera, get_aspect_ratio(&app->swapchain));
@@ -2156,15 +3426,23 @@ void write_constants(void* data, application_t* app) {
 			for (uint32_t k = 0; k != 4; ++k)
 				constants.pixel_to_ray_direction_world_space[i][j] += projection_to_world_space_no_translation[i][k] * pixel_to_ray_direction_projection_space[k][j];
 	memcpy(data, &constants, sizeof(constants));
-	size_t offset = sizeof(per_frame_constants_t);
-	// Write polygonal lights
+}
+
+
+/*! Writes all polygonal lights to the given memory location in the layout of
+	g_polygonal_lights in shared_constants.glsl. Invoke this only after lights
+	have changed (see get_polygonal_light_hash()).*/
+void write_polygonal_lights(void* data, application_t* app) {
+	// Ensure that texture indices are up to date
+	create_and_assign_light_textures(NULL, &app->device, &app->scene_specification);
+	size_t offset = 0;
 	uint32_t max_vertex_count = get_max_polygonal_light_vertex_count(&app->scene_specification);
 	for (uint32_t i = 0; i != app->scene_specification.polygonal_light_count; ++i) {
 		polygonal_light_t* light = &app->scene_specification.polygonal_lights[i];
-		// Ensure that redundant attributes (including the texture index) are
-		// up to date
-		update_polygonal_light(light);
-		create_and_assign_light_textures(NULL, &app->device, &app->scene_specification);
+		// Ensure that redundant attributes are up to date. For animated
+		// lights, the light animation pass computes them on the GPU.
+		if (light->keyframe_count == 0)
+			update_polygonal_light(light);
 		// Write fixed-size data
 		memcpy(((char*) data) + offset, light, POLYGONAL_LIGHT_FIXED_CONSTANT_BUFFER_SIZE);
 		offset += POLYGONAL_LIGHT_FIXED_CONSTANT_BUFFER_SIZE;
@@ -2206,6 +3484,7 @@ int render_frame(application_t* app) {
 		return 1;
 	}
 	frame_workload_t* workload = &queue->workloads[swapchain_index];
+	VkBool32 workload_used = workload->used;
 	// Perform GPU-CPU synchronization to be sure that resources that we are
 	// going to overwrite now are no longer used for rendering
 	if (workload->used) {
@@ -2221,17 +3500,65 @@ int render_frame(application_t* app) {
 			printf("Failed to reset a fence for reuse in upcoming frames.\n");
 			return 1;
 		}
+		// Now the timestamps of the previous use of this workload are available
+		uint64_t timestamps[FRAME_TIMESTAMP_COUNT];
+		if (queue->timestamps && vkGetQueryPoolResults(app->device.device, queue->timestamps, FRAME_TIMESTAMP_COUNT * swapchain_index, FRAME_TIMESTAMP_COUNT,
+			sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			float timestamp_period = app->device.physical_device_properties.limits.timestampPeriod * 1.0e-9f;
+			queue->geometry_pass_time = (float) (timestamps[1] - timestamps[0]) * timestamp_period;
+			queue->shading_pass_time = (float) (timestamps[2] - timestamps[1]) * timestamp_period;
+			queue->acceleration_structure_update_time = (float) (timestamps[4] - timestamps[3]) * timestamp_period;
+			for (uint32_t i = 0; i != MAX_COMPARISON_CONFIG_COUNT; ++i)
+				queue->comparison_times[i] = (float) (timestamps[5 + i] - timestamps[(i > 0) ? (4 + i) : 1]) * timestamp_period;
+		}
+		// Attribute these timings to the frame of a camera path that used
+		// this workload
+		camera_path_t* path = &app->camera_path;
+		if (workload->camera_path_frame > 0 && workload->camera_path_frame <= path->pose_count && path->state == camera_path_state_playing) {
+			camera_path_timing_t* timing = &path->timings[workload->camera_path_frame - 1];
+			timing->geometry_pass_time = queue->geometry_pass_time;
+			timing->shading_pass_time = queue->shading_pass_time;
+			timing->acceleration_structure_update_time = queue->acceleration_structure_update_time;
+		}
 	}
 	workload->used = VK_TRUE;
+	workload->camera_path_frame = app->camera_path.current_frame;
+	double cpu_start_time = glfwGetTime();
+	// Decide which geometry to stream in
+	if (app->scene.stream.file && update_geometry_stream(app, swapchain_index, workload_used)) {
+		printf("Failed to stream geometry.\n");
+		return 1;
+	}
+	// Decide which mipmaps of material textures should be resident
+	if (app->scene.materials.stream.texture_count > 0 && update_texture_residency(app, swapchain_index, workload_used)) {
+		printf("Failed to stream textures.\n");
+		return 1;
+	}
 	// Update the constant buffer
-	write_constants((char*) app->constant_buffers.data + app->constant_buffers.buffers.buffers[swapchain_index].offset, app);
+	constant_buffers_t* constant_buffers = &app->constant_buffers;
+	write_constants((char*) constant_buffers->data + constant_buffers->buffers.buffers[swapchain_index].offset, app);
 	VkMappedMemoryRange constant_range = {
 		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-		.memory = app->constant_buffers.buffers.memory,
-		.size = get_mapped_memory_range_size(&app->device, &app->constant_buffers.buffers, swapchain_index),
-		.offset = app->constant_buffers.buffers.buffers[swapchain_index].offset
+		.memory = constant_buffers->buffers.memory,
+		.size = get_mapped_memory_range_size(&app->device, &constant_buffers->buffers, swapchain_index),
+		.offset = constant_buffers->buffers.buffers[swapchain_index].offset
 	};
 	vkFlushMappedMemoryRanges(app->device.device, 1, &constant_range);
+	// Update the light buffer if lights have been edited since it was last
+	// written
+	uint64_t light_hash = get_polygonal_light_hash(app->scene_specification.polygonal_lights, app->scene_specification.polygonal_light_count);
+	if (constant_buffers->light_hashes[swapchain_index] != light_hash) {
+		write_polygonal_lights((char*) constant_buffers->light_data + constant_buffers->light_buffers.buffers[swapchain_index].offset, app);
+		VkMappedMemoryRange light_range = {
+			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+			.memory = constant_buffers->light_buffers.memory,
+			.size = get_mapped_memory_range_size(&app->device, &constant_buffers->light_buffers, swapchain_index),
+			.offset = constant_buffers->light_buffers.buffers[swapchain_index].offset
+		};
+		vkFlushMappedMemoryRanges(app->device.device, 1, &light_range);
+		constant_buffers->light_hashes[swapchain_index] = light_hash;
+	}
 	// Record the command buffer for rendering
 	if (record_render_frame_commands(workload->command_buffer, app, swapchain_index)) {
 		printf("Failed to record a command buffer for rendering the scene.\n");
@@ -2251,6 +3578,9 @@ int render_frame(application_t* app) {
 		printf("Failed to submit the command buffer for rendering a frame to the queue.\n");
 		return 1;
 	}
+	queue->cpu_time = (float) (glfwGetTime() - cpu_start_time);
+	if (app->camera_path.current_frame > 0)
+		app->camera_path.timings[app->camera_path.current_frame - 1].cpu_time = queue->cpu_time;
 	// Take a screenshot if requested
 	implement_screenshot(&app->screenshot, &app->swapchain, &app->device, swapchain_index);
 	// Present the image in the window
@@ -2274,6 +3604,11 @@ int main(int argc, char** argv) {
 	int experiment = -1;
 	bool_override_t v_sync_override = bool_override_none;
 	bool_override_t gui_override = bool_override_none;
+	VkBool32 play_camera_path = VK_FALSE;
+	const char* benchmark_report_path = NULL;
+	const char* const* scene_paths = NULL;
+	uint32_t job_thread_count = 0;
+	VkExtent2D window_extent = { 1920, 1080 };
 	for (int i = 1; i < argc; ++i) {
 		const char* arg = argv[i];
 		if (arg[0] == '-' && arg[1] == 'e') sscanf(arg + 2, "%d", &experiment);
@@ -2281,20 +3616,63 @@ int main(int argc, char** argv) {
 		if (strcmp(arg, "-v_sync") == 0) v_sync_override = bool_override_true;
 		if (strcmp(arg, "-no_gui") == 0) gui_override = bool_override_false;
 		if (strcmp(arg, "-gui") == 0) gui_override = bool_override_true;
+		if (strcmp(arg, "-play_path") == 0) play_camera_path = VK_TRUE;
+		if (strcmp(arg, "-benchmark") == 0 && i + 1 < argc) benchmark_report_path = argv[++i];
+		if (strcmp(arg, "-job_threads") == 0 && i + 1 < argc) sscanf(argv[++i], "%u", &job_thread_count);
+		if (strcmp(arg, "-resolution") == 0 && i + 2 < argc) {
+			sscanf(argv[i + 1], "%u", &window_extent.width);
+			sscanf(argv[i + 2], "%u", &window_extent.height);
+			i += 2;
+		}
+		if (strcmp(arg, "-scene") == 0 && i + 3 < argc) {
+			scene_paths = (const char* const*) &argv[i + 1];
+			i += 3;
+		}
 	}
+	// Benchmarks must not be limited by the refresh rate
+	if (benchmark_report_path) v_sync_override = bool_override_false;
 	// Start the application
 	application_t app;
-	if (startup_application(&app, experiment, v_sync_override)) {
+	if (startup_application(&app, experiment, v_sync_override, scene_paths, job_thread_count, window_extent)) {
 		printf("Application startup has failed.\n");
 		return 1;
 	}
 	if (gui_override != bool_override_none) app.render_settings.show_gui = gui_override;
+	// In benchmark mode, the camera path of the quicksave is played once
+	if (play_camera_path) {
+		const char* path_pieces[] = { app.scene_specification.quick_save_path, ".path" };
+		char* path_file_path = concatenate_strings(COUNT_OF(path_pieces), path_pieces);
+		int result = start_camera_path_playback(&app.camera_path, path_file_path, &app.scene_specification);
+		free(path_file_path);
+		if (result) {
+			destroy_application(&app);
+			return 1;
+		}
+		app.camera_path.exit_after_playback = VK_TRUE;
+	}
+	// In benchmark mode, report startup timings and cycle through techniques
+	if (benchmark_report_path) {
+		app.benchmark.report = fopen(benchmark_report_path, "w");
+		if (!app.benchmark.report) {
+			printf("Failed to open the benchmark report. Please check path and permissions: %s\n", benchmark_report_path);
+			destroy_application(&app);
+			return 1;
+		}
+		write_benchmark_metric(&app.benchmark, "startup_load_time", app.benchmark.load_time);
+		write_benchmark_metric(&app.benchmark, "startup_compile_time", app.benchmark.compile_time);
+	}
 	// Main loop
 	while (!glfwWindowShouldClose(app.swapchain.window)) {
 		glfwPollEvents();
 		// Check whether the window is minimized
 		if (app.swapchain.swapchain) {
 			if (handle_frame_input(&app)) break;
+			// If nothing has changed for a while, sleep until there is input
+			if (is_idle(&app.idle_detector)) {
+				glfwWaitEvents();
+				app.idle_detector.unchanged_frame_count = 0;
+				continue;
+			}
 			if (render_frame(&app)) break;
 		}
 	}
@@ -22,6 +22,8 @@
 #include "ltc_table.h"
 #include "scene.h"
 #include "imgui_vulkan.h"
+#include "render_graph.h"
+#include <stdio.h>
 
 
 /*! Holds all information that characterizes the scene (geometry, materials,
@@ -39,6 +41,9 @@ typedef struct scene_specification_s {
 	uint32_t polygonal_light_count;
 	//! The polygonal lights illuminating the scene
 	polygonal_light_t* polygonal_lights;
+	//! The time in seconds at which keyframes of polygonal lights are
+	//! evaluated (see polygonal_light_t.keyframes)
+	float light_animation_time;
 } scene_specification_t;
 
 //! Available methods to combine diffuse and specular samples
@@ -117,6 +122,33 @@ typedef enum error_display_e {
 	error_display_count
 } error_display_t;
 
+
+//! Ways in which the acceleration structure can be updated each frame
+typedef enum acceleration_structure_update_e {
+	//! The acceleration structure is built once when the scene is loaded
+	acceleration_structure_update_none,
+	//! The top level is rebuilt each frame, as needed for moving instances
+	acceleration_structure_update_top_level,
+	//! The bottom level is refit each frame before the top level gets
+	//! rebuilt, as needed for deforming geometry
+	acceleration_structure_update_refit,
+	//! The number of different update modes
+	acceleration_structure_update_count,
+} acceleration_structure_update_t;
+
+//! The maximal number of configurations that can be compared side by side
+#define MAX_COMPARISON_CONFIG_COUNT 4
+
+//! The sampling settings that may differ between configurations that are
+//! compared side by side (see render_settings_t.comparison_count)
+typedef struct comparison_config_s {
+	//! See the equally named members of render_settings_t
+	sampling_strategies_t sampling_strategies;
+	mis_heuristic_t mis_heuristic;
+	sample_polygon_technique_t polygon_sampling_technique;
+	uint32_t sample_count;
+} comparison_config_t;
+
 //! Either defines a boolean value or leaves it undefined
 typedef enum bool_override_e {
 	bool_override_false = 0,
@@ -150,8 +182,72 @@ typedef struct render_settings_s {
 	VkBool32 animate_noise;
 	//! Whether ray traced shadows should be used
 	VkBool32 trace_shadow_rays;
+	/*! Whether shadow rays should be skipped where visibility baked by the
+		visibility_baker tool is conclusive (see baked_visibility_t, requires
+		static lights and a matching file next to the quicksave)*/
+	VkBool32 use_baked_visibility;
+	//! Whether the shading pass should select mipmaps of material textures
+	//! using ray cones and filter isotropically instead of filtering
+	//! anisotropically with derivatives from ray differentials
+	VkBool32 ray_cone_texture_lod;
+	//! The maximal anisotropy when filtering material textures with ray
+	//! differentials (1 to 16) or 0 to use 16
+	uint32_t max_anisotropy;
+	/*! How the acceleration structure is updated each frame. Since scenes are
+		static, updates reproduce the current state, which makes their cost
+		measurable (requires reloading the scene to enable or disable).*/
+	acceleration_structure_update_t acceleration_structure_update;
+	//! The number of refits after which the bottom level of the acceleration
+	//! structure is rebuilt from scratch
+	uint32_t full_rebuild_interval;
+	//! Whether material textures of equal format and resolution should be
+	//! packed into texture arrays (requires reloading the scene)
+	VkBool32 pack_material_textures;
+	//! Whether the shading pass should load all attributes of a triangle from
+	//! a single record (see mesh_t.triangle_records, requires reloading the
+	//! scene)
+	VkBool32 interleave_mesh_attributes;
+	//! Whether the geometry and shading pass should decode compressed
+	//! geometry (see mesh_t.meshlets, requires reloading the scene and a scene
+	//! file written by vks_opt -meshlets 1)
+	VkBool32 compress_geometry;
+	//! Whether the geometry pass should use simplified levels of detail for
+	//! chunks (if the scene file provides them, see scene_t.chunk_lods)
+	VkBool32 select_lods;
+	//! Each chunk uses the coarsest level of detail whose error projects to
+	//! at most this many pixels
+	float lod_pixel_error;
+	/*! Polygonal lights that subtend a smaller solid angle (in steradians) at
+		a shading point are shaded as point lights at their centroid with a
+		single shadow ray instead of the polygon sampling technique. 0
+		disables this level of detail for lights.*/
+	float light_lod_solid_angle;
+	//! Whether the geometry pass should skip chunks whose bounding box is
+	//! outside the view frustum (see scene_t.chunks)
+	VkBool32 cull_chunks;
+	/*! The size in MiB of the pool of device memory for streamed geometry or
+		0 to load the whole mesh (see geometry_stream_t, requires reloading
+		the scene and a scene file written by vks_opt -lod_levels)*/
+	uint32_t geometry_pool_size;
+	/*! The size in MiB of device memory targeted for material textures or 0
+		to load all of their mipmaps (see texture_stream_t, requires
+		reloading the scene)*/
+	uint32_t texture_pool_size;
 	//! Whether light sources should be rendered
 	VkBool32 show_polygonal_lights;
+	//! Whether the time for keyframed animations of polygonal lights should
+	//! advance with the frame time
+	VkBool32 animate_lights;
+	/*! If this is not zero, the screen is split into this many vertical
+		strips and each of them is shaded with the respective entry of
+		comparison_configs instead of the sampling settings above. All strips
+		share one geometry pass and get timed separately.*/
+	uint32_t comparison_count;
+	comparison_config_t comparison_configs[MAX_COMPARISON_CONFIG_COUNT];
+	/*! Whether the application should stop rendering and wait for input once
+		nothing has changed for RENDER_ON_DEMAND_FRAME_COUNT frames (see
+		idle_detector_t)*/
+	VkBool32 render_on_demand;
 	//! Whether the user interface should be rendered
 	VkBool32 show_gui;
 	//! Whether vertical synchronization should be used (caps frame rate)
@@ -170,6 +266,7 @@ typedef enum scene_index_e {
 	scene_attic,
 	scene_bistro_inside,
 	scene_bistro_outside,
+	scene_streaming_stress_test,
 	scene_count
 } scene_index_t;
 
@@ -238,32 +335,30 @@ typedef struct experiment_list_s {
 } experiment_list_t;
 
 
-/*! Provides convenient access to all render targets used by this application,
-	except for swapchain images. These render targets are duplicated per
-	swapchain image, to enable overlapping execution of work between frames.*/
-typedef struct render_targets_s {
-	//! The number of held render targets per swapchain image, i.e. the number
-	//! of entries in the union below
-	uint32_t target_count;
-	//! The number of duplicates for each target, i.e. the number of swapchain
-	//! images when the render targets were allocated
-	uint32_t duplicate_count;
-	//! Images for all allocated render targets (not including the swapchain)
-	images_t targets_allocation;
-	//! This union provides convenient access to all render targets, either as
-	//! array or by name. The pointer is a pointer to an array of length
-	//! duplicate_count.
-	union {
-		struct {
-			//! The depth buffer used in the geometry pass
-			image_t depth_buffer;
-			//! The visibility buffer, which stores a primitive index per pixel
-			image_t visibility_buffer;
-		};
-		//! Array of all render targets available from this object
-		image_t targets[2];
-	}* targets;
-} render_targets_t;
+//! Passes of the render graph that renders a frame in the order of execution
+typedef enum frame_pass_e {
+	//! Rasterizes the scene into the visibility buffer
+	frame_pass_geometry,
+	//! Shades the visibility buffer and writes to the swapchain image
+	frame_pass_shading,
+	//! Draws the user interface on top
+	frame_pass_interface,
+	//! The number of passes
+	frame_pass_count,
+} frame_pass_t;
+
+
+//! Attachments of the render graph that renders a frame
+typedef enum frame_attachment_e {
+	//! The depth buffer used in the geometry pass
+	frame_attachment_depth_buffer,
+	//! The visibility buffer, which stores a primitive index per pixel
+	frame_attachment_visibility_buffer,
+	//! The swapchain image (provided externally)
+	frame_attachment_swapchain,
+	//! The number of attachments
+	frame_attachment_count,
+} frame_attachment_t;
 
 
 //! Keeps track of all constant buffers used in this application
@@ -272,9 +367,49 @@ typedef struct constant_buffers_s {
 	buffers_t buffers;
 	//! Pointer where the data of constant_buffer is mapped
 	void* data;
+	/*! One storage buffer per swapchain image holding all polygonal lights.
+		Unlike the constant buffer, it is only rewritten after lights have
+		been edited (see light_hashes).*/
+	buffers_t light_buffers;
+	//! Pointer where the data of light_buffers is mapped
+	void* light_data;
+	//! For each swapchain image the result of get_polygonal_light_hash() for
+	//! the lights in its light buffer or 0 if it has not been written yet
+	uint64_t* light_hashes;
 } constant_buffers_t;
 
 
+/*! Host-visible buffers that drive streaming of geometry (see
+	geometry_stream_t) and textures (see texture_stream_t). Members for either
+	of them are empty if it is not streamed.*/
+typedef struct stream_buffers_s {
+	/*! One buffer per swapchain image with one uint per page of the mesh
+		buffers. The shading pass sets entries of visible pages to 1.*/
+	buffers_t feedback;
+	//! One buffer per swapchain image with room for upload_budget chunks,
+	//! which are uploaded by the commands of the frame
+	buffers_t staging;
+	//! Pointer to the mapped memory of feedback
+	void* feedback_data;
+	//! Pointer to the mapped memory of staging
+	void* staging_data;
+	/*! One buffer per swapchain image with one uint per material. The
+		shading pass writes the finest mipmap that it needs for the textures
+		of the material using atomicMin() (see update_texture_stream()).*/
+	buffers_t texture_feedback;
+	//! Pointer to the mapped memory of texture_feedback
+	void* texture_feedback_data;
+	//! The maximal number of chunks that are uploaded in one frame
+	uint32_t upload_budget;
+	//! For each swapchain image, the number of chunks that have been staged
+	//! for upload in its next frame
+	uint32_t* upload_counts;
+	//! For each swapchain image, upload_budget entries with the indices of
+	//! slots that receive the staged chunks
+	uint32_t* upload_slots;
+} stream_buffers_t;
+
+
 //! The sub pass that produces the visibility buffer by rasterizing all
 //! geometry once
 typedef struct geometry_pass_s {
@@ -282,23 +417,90 @@ typedef struct geometry_pass_s {
 	pipeline_with_bindings_t pipeline;
 	//! The used vertex and fragment shader
 	shader_t vertex_shader, fragment_shader;
+	//! 1 if the vertex shader decodes positions from mesh_t.meshlets instead
+	//! of using a vertex buffer
+	VkBool32 compressed_geometry;
+	//! The number of triangles drawn in the most recently recorded frame
+	uint64_t drawn_triangle_count;
+	//! The number of chunks that were culled in the most recently recorded
+	//! frame
+	uint64_t culled_chunk_count;
 } geometry_pass_t;
 
 
+//! The number of descriptors in the bindless texture array of the shading
+//! pass. Slots that are not in use are left unwritten.
+#define BINDLESS_TEXTURE_COUNT 4096
+//! The number of slots at the start of the bindless texture array that are
+//! reserved for light textures. Material textures follow.
+#define LIGHT_TEXTURE_SLOT_COUNT 256
+
+
 //! The sub pass that renders a screen filling triangle to perform deferred
 //! shading in a fragment shader, possibly with ray queries for shadows
 typedef struct shading_pass_s {
 	//! 1 if the shading pass uses ray queries for shadows
 	VkBool32 use_ray_tracing;
+	//! 1 if the shading pass skips shadow rays using baked_visibility_t
+	VkBool32 use_baked_visibility;
 	//! Pipeline state and bindings for the shading pass
 	pipeline_with_bindings_t pipeline;
 	//! The vertex and fragment shader that implements the shading pass
 	shader_t vertex_shader, fragment_shader;
 	//! The sampler for light textures
 	VkSampler light_texture_sampler;
+	//! The sampler for material textures, which implements the anisotropy
+	//! limit in render_settings_t.max_anisotropy
+	VkSampler material_texture_sampler;
+	//! The maximal anisotropy of material_texture_sampler
+	float max_anisotropy;
+	/*! The number of compared configurations (see
+		render_settings_t.comparison_count) or 0. If it is not 0, the shading
+		pass uses one fragment shader and pipeline per configuration instead
+		of fragment_shader and pipeline.pipeline. They share the descriptor
+		sets and the pipeline layout of pipeline.*/
+	uint32_t comparison_count;
+	shader_t comparison_shaders[MAX_COMPARISON_CONFIG_COUNT];
+	VkPipeline comparison_pipelines[MAX_COMPARISON_CONFIG_COUNT];
 } shading_pass_t;
 
 
+/*! A compute pass that runs before the render pass and evaluates keyframed
+	animations of polygonal lights. It writes transformed lights directly into
+	the light buffer of the current frame (see constant_buffers_t).
+	\see animate_lights.comp.glsl */
+typedef struct light_animation_pass_s {
+	//! The number of lights with keyframes. If it is zero, all other members
+	//! are empty and no work is done.
+	uint32_t animated_light_count;
+	//! Host-visible storage buffers with one pair of uints (index of the first
+	//! keyframe, keyframe count) per polygonal light and all keyframes
+	buffers_t tracks;
+	//! The compute shader that animates lights
+	shader_t compute_shader;
+	//! One descriptor set per swapchain image binding its constant buffer and
+	//! light buffer
+	pipeline_with_bindings_t pipeline;
+} light_animation_pass_t;
+
+
+/*! Visibility between the triangles of the scene and the polygonal lights as
+	baked by the visibility_baker tool into a file next to the quicksave (see
+	baked_visibility_format.h). The shading pass skips lights that are
+	occluded from all three vertices of a triangle and traces no shadow rays
+	towards lights that are visible from all of them. If the file is missing or
+	does not match the scene and lights, all members are empty.*/
+typedef struct baked_visibility_s {
+	//! A device-local storage buffer with one uint per triangle and light
+	buffers_t buffer;
+	//! The number of triangles covered by the buffer. Others (e.g. levels of
+	//! detail) always trace shadow rays.
+	uint64_t triangle_count;
+	//! The result of get_polygonal_light_geometry_hash() for the baked lights
+	uint64_t light_hash;
+} baked_visibility_t;
+
+
 //! The sub pass that renders the user interface on top of the shaded frame
 typedef struct interface_pass_s {
 	//! Buffers holding all geometry for the interface pass. They are
@@ -336,15 +538,13 @@ typedef struct interface_pass_s {
 } interface_pass_t;
 
 
-//! The render pass that renders a complete frame
+/*! The render pass that renders a complete frame. It is derived from a
+	render graph with the passes in frame_pass_t and the attachments in
+	frame_attachment_t. Attachments are duplicated per swapchain image.*/
 typedef struct render_pass_s {
-	//! Number of held framebuffers (= swapchain images)
-	uint32_t framebuffer_count;
-	//! A framebuffer per swapchain image with the depth buffer (0), the
-	//! visibility buffer (1) and the swapchain image (2) attached
-	VkFramebuffer* framebuffers;
-	//! The render pass that encompasses all subpasses for rendering a frame
-	VkRenderPass render_pass;
+	//! The render graph providing the render pass, subpass indices and
+	//! framebuffers
+	render_graph_t graph;
 } render_pass_t;
 
 
@@ -367,8 +567,14 @@ typedef struct frame_workload_s {
 	//! Signaled once all drawing has finished. Used to synchronize CPU and GPU
 	//! execution by waiting for this fence before reusing this workload
 	VkFence drawing_finished_fence;
+	//! The value of camera_path_t.current_frame when this workload was last
+	//! submitted, such that its timings can be attributed to that frame
+	uint32_t camera_path_frame;
 } frame_workload_t;
 
+//! The number of timestamps that are written per frame
+#define FRAME_TIMESTAMP_COUNT (5 + MAX_COMPARISON_CONFIG_COUNT)
+
 //! Handles a command buffer for each swapchain image and corresponding
 //! synchronization objects
 typedef struct frame_queue_s {
@@ -383,6 +589,22 @@ typedef struct frame_queue_s {
 	frame_sync_t* syncs;
 	//! Index of the most recent entry of syncs that was used for rendering
 	uint32_t sync_index;
+	/*! FRAME_TIMESTAMP_COUNT timestamps per workload, which enclose the
+		geometry pass, the shading pass, the update of the acceleration
+		structure and each compared configuration in the shading pass, or NULL
+		if the device does not support timestamps*/
+	VkQueryPool timestamps;
+	//! The time in seconds that the GPU spent on the geometry pass, the
+	//! shading pass and the update of the acceleration structure in the most
+	//! recent frame for which timestamps are available
+	float geometry_pass_time, shading_pass_time, acceleration_structure_update_time;
+	//! The time in seconds that the GPU spent shading with each compared
+	//! configuration (see shading_pass_t.comparison_count)
+	float comparison_times[MAX_COMPARISON_CONFIG_COUNT];
+	//! The time in seconds that the CPU spent on preparing, recording and
+	//! submitting commands for the most recent frame (without waiting for
+	//! the GPU)
+	float cpu_time;
 	//! Set if rendering of the previous frame encountered an exception that
 	//! may indicate that the swapchain needs to be resized or if vsync is
 	//! being switched
@@ -440,6 +662,8 @@ typedef struct application_updates_s {
 	//! The number of light sources in the scene or the number of vertices in a
 	//! polygonal light source has changed
 	VkBool32 update_light_count;
+	//! Keyframes of a polygonal light source have been added or removed
+	VkBool32 update_light_animation;
 	//! A texture of a polygonal light source has changed
 	VkBool32 update_light_textures;
 	//! The scene itself has changed
@@ -449,11 +673,166 @@ typedef struct application_updates_s {
 	//! The noise table needs to be recreated (usually transition between white
 	//! and blue noise)
 	VkBool32 regenerate_noise;
+	//! Baked visibility has been enabled or disabled or has become outdated
+	VkBool32 reload_baked_visibility;
 	//! The current camera and lights should be stored to / loaded from a file
 	VkBool32 quick_save, quick_load;
+	//! Recording of a camera path should start or stop and the recorded path
+	//! should be saved
+	VkBool32 record_camera_path;
+	//! The camera path of the quicksave should be played back
+	VkBool32 play_camera_path;
 } application_updates_t;
 
 
+//! The number of frames that are rendered after the last change before the
+//! application waits for input (if render_on_demand is enabled). It covers
+//! all swapchain images and lets the user interface settle.
+#define RENDER_ON_DEMAND_FRAME_COUNT 4
+
+
+/*! Keeps track of whether anything that affects the rendered image has
+	changed recently. Changes are detected by comparing the camera, the
+	polygonal lights, the cursor position and render settings with those of
+	the previous frame. Animated noise is not a change, so it stands still
+	while rendering is paused.*/
+typedef struct idle_detector_s {
+	//! The camera in the previous frame
+	first_person_camera_t previous_camera;
+	//! The result of get_polygonal_light_hash() in the previous frame
+	uint64_t previous_light_hash;
+	//! The value of scene_specification_t.light_animation_time in the
+	//! previous frame
+	float previous_light_animation_time;
+	//! The cursor position in pixels in the previous frame
+	int32_t previous_cursor_position[2];
+	//! The render settings in the previous frame
+	render_settings_t previous_settings;
+	//! The number of consecutive frames in which nothing has changed
+	uint32_t unchanged_frame_count;
+} idle_detector_t;
+
+
+//! The state of a polygonal light in one frame of a camera path. It includes
+//! everything that the user interface changes without reallocations.
+typedef struct camera_path_light_s {
+	float rotation_angles[3];
+	float translation[3];
+	float radiant_flux[3];
+	float scaling_x, scaling_y;
+} camera_path_light_t;
+
+
+//! One frame of a camera path
+typedef struct camera_path_pose_s {
+	//! The time in seconds since recording started
+	float time;
+	//! The value of scene_specification_t.light_animation_time
+	float light_animation_time;
+	//! The camera used for this frame
+	first_person_camera_t camera;
+} camera_path_pose_t;
+
+
+//! Timings of one frame during playback of a camera path
+typedef struct camera_path_timing_s {
+	//! The time in seconds between the start of this frame and the next one
+	float frame_time;
+	//! The time in seconds that the CPU spent on preparing and recording
+	//! commands for this frame (without waiting for the GPU)
+	float cpu_time;
+	//! GPU timings in seconds (see frame_queue_t)
+	float geometry_pass_time, shading_pass_time, acceleration_structure_update_time;
+} camera_path_timing_t;
+
+
+//! What is being done with a camera path
+typedef enum camera_path_state_e {
+	camera_path_state_idle,
+	//! Each frame appends a pose
+	camera_path_state_recording,
+	//! Each frame applies the next pose and timings get recorded
+	camera_path_state_playing,
+} camera_path_state_t;
+
+
+//! The number of consecutive frames of a camera path that are grouped into a
+//! segment to report the slowest parts of the path
+#define CAMERA_PATH_SEGMENT_FRAME_COUNT 30
+
+//! The number of segments that are reported after playback of a camera path
+#define CAMERA_PATH_REPORTED_SEGMENT_COUNT 5
+
+
+/*! A camera path records camera poses and states of polygonal lights once per
+	frame. Playing it back applies one pose per frame regardless of timings,
+	so that benchmarks render the same sequence of frames each time. The file
+	path is the path of the quicksave followed by ".path" and timings of a
+	playback are written to the same path followed by ".csv".*/
+typedef struct camera_path_s {
+	//! Whether the path is being recorded, played or neither
+	camera_path_state_t state;
+	//! The number of frames in the path and the number of entries for which
+	//! poses (and timings) have been allocated
+	uint32_t pose_count, pose_capacity;
+	//! The number of polygonal lights in each frame
+	uint32_t light_count;
+	//! pose_capacity poses
+	camera_path_pose_t* poses;
+	//! light_count light states per pose, ordered by pose first
+	camera_path_light_t* lights;
+	//! pose_count timings, which are filled during playback
+	camera_path_timing_t* timings;
+	//! During playback, the index of the next frame of the path. Once it
+	//! exceeds pose_count, the remaining timings of frames in flight arrive.
+	uint32_t next_frame;
+	//! 1 + the index of the frame of the path being prepared for rendering
+	//! now or 0 if no such frame exists
+	uint32_t current_frame;
+	//! The value of glfwGetTime() when recording started or when the
+	//! previous frame of playback started
+	double start_time, previous_frame_start_time;
+	//! Whether the application should shut down after playback
+	VkBool32 exit_after_playback;
+} camera_path_t;
+
+
+//! The number of frames rendered with each technique in benchmark mode before
+//! timings are measured. It covers frames in flight and pipeline warm-up.
+#define BENCHMARK_WARMUP_FRAME_COUNT 16
+
+//! The number of frames over which timings are averaged for each technique in
+//! benchmark mode
+#define BENCHMARK_FRAME_COUNT 64
+
+
+/*! Benchmark mode (command line option -benchmark <report path>) turns off
+	v-sync and measures the time to load the scene and to compile shaders at
+	startup. Optionally, -scene <file> <texture directory> <quicksave> picks a
+	scene such as the one that the benchmark tests generate. Afterwards, it
+	renders a fixed number of frames with each polygon sampling technique and
+	measures compile and frame times. All results go to a *.csv file with one
+	line "name,milliseconds" per metric, which the benchmark_compare tool
+	checks against a baseline. Then the application shuts down.*/
+typedef struct benchmark_s {
+	//! The report that is being written or NULL if benchmarks do not run
+	FILE* report;
+	//! The time in seconds that the most recent call to update_application()
+	//! spent on loading resources and on creating passes (including shader
+	//! compilation), respectively. Updated whether benchmarks run or not.
+	double load_time, compile_time;
+	//! The polygon sampling technique currently being benchmarked
+	uint32_t technique;
+	//! The number of frames rendered with the current technique so far
+	uint32_t frame_index;
+	//! Sums of frame times, CPU times and GPU times in seconds over the
+	//! measured frames of the current technique
+	double frame_time, cpu_time, gpu_time;
+	//! The value of glfwGetTime() at the start of the previous frame
+	double previous_frame_start_time;
+} benchmark_t;
+
+
 /*! Bundles together all information needed to run this application.*/
 typedef struct application_s {
 	device_t device;
@@ -467,9 +846,11 @@ typedef struct application_s {
 	scene_t scene;
 	noise_table_t noise_table;
 	ltc_table_t ltc_table;
-	render_targets_t render_targets;
 	constant_buffers_t constant_buffers;
+	stream_buffers_t stream_buffers;
 	images_t light_textures;
+	baked_visibility_t baked_visibility;
+	light_animation_pass_t light_animation_pass;
 	geometry_pass_t geometry_pass;
 	shading_pass_t shading_pass;
 	interface_pass_t interface_pass;
@@ -477,6 +858,12 @@ typedef struct application_s {
 	frame_queue_t frame_queue;
 	screenshot_t screenshot;
 	experiment_list_t experiment_list;
+	idle_detector_t idle_detector;
+	camera_path_t camera_path;
+	benchmark_t benchmark;
+	//! The number of threads used to load resources and to create passes (see
+	//! run_job_graph())
+	uint32_t job_thread_count;
 } application_t;
 
 
@@ -499,7 +886,8 @@ typedef struct per_frame_constants_s {
 	uint32_t noise_resolution_mask[2];
 	uint32_t noise_texture_index_mask;
 	uint32_t frame_bits;
-	uint32_t padding_3[2];
+	float light_animation_time;
+	float light_lod_solid_angle;
 	uint32_t noise_random_numbers[4];
 	ltc_constants_t ltc_constants;
 } per_frame_constants_t;
@@ -512,3 +900,31 @@ void create_experiment_list(experiment_list_t* list);
 
 //! Frees memory of the given experiment list
 void destroy_experiment_list(experiment_list_t* list);
+
+
+//! Starts recording a new camera path, discarding the previous one. Defined
+//! in camera_path.c.
+void start_camera_path_recording(camera_path_t* path, const scene_specification_t* scene);
+
+//! Stops recording and writes the camera path to the given file.
+//! \return 0 on success.
+int save_camera_path(camera_path_t* path, const char* file_path);
+
+/*! Loads a camera path from the given file and starts playing it. The number
+	of polygonal lights in the path has to match the scene.
+	\return 0 on success.*/
+int start_camera_path_playback(camera_path_t* path, const char* file_path, const scene_specification_t* scene);
+
+/*! Appends a frame to the path while recording or applies the next frame to
+	the given scene while playing.
+	\param drain_frame_count The number of frames that playback continues at
+		the last pose to retrieve timings of frames in flight.
+	\return VK_TRUE iff playback has just finished.*/
+VkBool32 advance_camera_path(camera_path_t* path, scene_specification_t* scene, uint32_t drain_frame_count);
+
+//! Prints the average timings and the slowest segments of the camera path
+//! after playback and writes timings of all frames to the given *.csv file
+void report_camera_path_timings(const camera_path_t* path, const char* timings_path);
+
+//! Frees memory and zeros the object
+void destroy_camera_path(camera_path_t* path);
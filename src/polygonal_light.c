@@ -104,6 +104,63 @@ void update_polygonal_light(polygonal_light_t* light) {
 }
 
 
+void add_polygonal_light_keyframe(polygonal_light_t* light) {
+	polygonal_light_keyframe_t* keyframes = (polygonal_light_keyframe_t*) malloc(sizeof(polygonal_light_keyframe_t) * (light->keyframe_count + 1));
+	if (light->keyframe_count > 0)
+		memcpy(keyframes, light->keyframes, sizeof(polygonal_light_keyframe_t) * light->keyframe_count);
+	polygonal_light_keyframe_t* keyframe = &keyframes[light->keyframe_count];
+	memset(keyframe, 0, sizeof(*keyframe));
+	keyframe->time = (light->keyframe_count > 0) ? (keyframes[light->keyframe_count - 1].time + 1.0f) : 0.0f;
+	memcpy(keyframe->rotation_angles, light->rotation_angles, sizeof(keyframe->rotation_angles));
+	memcpy(keyframe->translation, light->translation, sizeof(keyframe->translation));
+	memcpy(keyframe->radiant_flux, light->radiant_flux, sizeof(keyframe->radiant_flux));
+	free(light->keyframes);
+	light->keyframes = keyframes;
+	++light->keyframe_count;
+}
+
+
+//! Feeds the given bytes into an FNV-1a hash
+uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+	for (size_t i = 0; i != size; ++i) {
+		hash ^= ((const uint8_t*) data)[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+
+uint64_t get_polygonal_light_geometry_hash(const polygonal_light_t* lights, uint32_t light_count) {
+	uint64_t hash = hash_bytes(0xcbf29ce484222325ull, &light_count, sizeof(light_count));
+	for (uint32_t i = 0; i != light_count; ++i) {
+		const polygonal_light_t* light = &lights[i];
+		hash = hash_bytes(hash, light->rotation_angles, sizeof(light->rotation_angles));
+		hash = hash_bytes(hash, light->translation, sizeof(light->translation));
+		hash = hash_bytes(hash, &light->scaling_x, sizeof(light->scaling_x));
+		hash = hash_bytes(hash, &light->scaling_y, sizeof(light->scaling_y));
+		hash = hash_bytes(hash, &light->vertex_count, sizeof(light->vertex_count));
+		for (uint32_t j = 0; j != light->vertex_count; ++j)
+			hash = hash_bytes(hash, &light->vertices_plane_space[4 * j], sizeof(float) * 2);
+	}
+	return hash;
+}
+
+
+uint64_t get_polygonal_light_hash(const polygonal_light_t* lights, uint32_t light_count) {
+	uint64_t hash = get_polygonal_light_geometry_hash(lights, light_count);
+	for (uint32_t i = 0; i != light_count; ++i) {
+		const polygonal_light_t* light = &lights[i];
+		hash = hash_bytes(hash, light->radiant_flux, sizeof(light->radiant_flux));
+		hash = hash_bytes(hash, &light->texturing_technique, sizeof(light->texturing_technique));
+		if (light->texture_file_path)
+			hash = hash_bytes(hash, light->texture_file_path, strlen(light->texture_file_path) + 1);
+		hash = hash_bytes(hash, &light->keyframe_count, sizeof(light->keyframe_count));
+		hash = hash_bytes(hash, light->keyframes, sizeof(polygonal_light_keyframe_t) * light->keyframe_count);
+	}
+	return hash;
+}
+
+
 polygonal_light_t duplicate_polygonal_light(const polygonal_light_t* light) {
 	polygonal_light_t result = *light;
 	result.texture_file_path = copy_string(light->texture_file_path);
@@ -113,6 +170,11 @@ polygonal_light_t duplicate_polygonal_light(const polygonal_light_t* light) {
 	result.fan_areas = NULL;
 	set_polygonal_light_vertex_count(&result, light->vertex_count);
 	memcpy(result.vertices_plane_space, light->vertices_plane_space, sizeof(float) * 4 * light->vertex_count);
+	result.keyframes = NULL;
+	if (light->keyframe_count > 0) {
+		result.keyframes = (polygonal_light_keyframe_t*) malloc(sizeof(polygonal_light_keyframe_t) * light->keyframe_count);
+		memcpy(result.keyframes, light->keyframes, sizeof(polygonal_light_keyframe_t) * light->keyframe_count);
+	}
 	return result;
 }
 
@@ -122,5 +184,6 @@ void destroy_polygonal_light(polygonal_light_t* light) {
 	free(light->vertices_world_space);
 	free(light->fan_areas);
 	free(light->texture_file_path);
+	free(light->keyframes);
 	memset(light, 0, sizeof(*light));
 }
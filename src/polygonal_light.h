@@ -90,6 +90,21 @@ typedef enum polygon_texturing_technique_e {
 } polygon_texturing_technique_t;
 
 
+/*! A keyframe in the animation of a polygonal light. It matches the layout of
+	the corresponding structure in the shader.
+	\see animate_lights.comp.glsl */
+typedef struct polygonal_light_keyframe_s {
+	//! See polygonal_light_t
+	float rotation_angles[3];
+	//! The time in seconds at which the light takes on this state
+	float time;
+	float translation[3];
+	float padding_0;
+	float radiant_flux[3];
+	float padding_1;
+} polygonal_light_keyframe_t;
+
+
 /*! This struct represents a convex polygonal light source. The polygon is
 	planar but oriented arbitrarily in 3D space. By design, it matches the
 	layout of the corresponding structure in the shader (except for the
@@ -126,6 +141,12 @@ typedef struct polygonal_light_s {
 	//! Written by update_polygonal_light() but allocated before. Each entry is
 	//! padded up to four floats.
 	float* fan_areas;
+	/*! The number of keyframes for the animation of this light and an array
+		of them, sorted by time. While there are keyframes, the rotation,
+		translation and radiant flux are overwritten on the GPU (see
+		animate_lights.comp.glsl) and redundant values are computed there.*/
+	uint32_t keyframe_count;
+	polygonal_light_keyframe_t* keyframes;
 } polygonal_light_t;
 
 //! This many bytes at the beginning of the structure polygonal_light_t are
@@ -147,6 +168,20 @@ EXTERN_C int set_polygonal_light_vertex_count(polygonal_light_t* light, uint32_t
 //! already allocated with appropriate size but 
 EXTERN_C void update_polygonal_light(polygonal_light_t* light);
 
+//! Appends a keyframe with the current rotation, translation and radiant flux
+//! of the given light one second after the last keyframe (or at time zero)
+EXTERN_C void add_polygonal_light_keyframe(polygonal_light_t* light);
+
+/*! Returns a hash of everything that determines the shape and placement of the
+	given polygonal lights. Radiant flux and textures do not enter. Baked
+	visibility (see visibility_baker) uses it to detect outdated files.*/
+EXTERN_C uint64_t get_polygonal_light_geometry_hash(const polygonal_light_t* lights, uint32_t light_count);
+
+/*! Returns a hash of everything that the user can edit about the given
+	polygonal lights, including radiant flux, texturing and keyframes. The
+	renderer uses it to rewrite lights on the GPU only after edits.*/
+EXTERN_C uint64_t get_polygonal_light_hash(const polygonal_light_t* lights, uint32_t light_count);
+
 //! Returns a deep copy of the given polygonal light
 EXTERN_C polygonal_light_t duplicate_polygonal_light(const polygonal_light_t* light);
 
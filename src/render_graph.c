@@ -0,0 +1,515 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "render_graph.h"
+#include "string_utilities.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//! Intermediate results of create_render_graph(), which are not needed
+//! afterwards
+typedef struct render_graph_plan_s {
+	//! For each declared attachment the first and last subpass using it or
+	//! UINT32_MAX and 0 if it is unused
+	uint32_t *first_uses, *last_uses;
+	//! For each physical attachment the first declared attachment that it
+	//! holds, its image usage and its final layout
+	uint32_t* sources;
+	VkImageUsageFlags* image_usages;
+	VkImageLayout* final_layouts;
+	/*! For each subpass and physical attachment (in this order) the
+		render_graph_usage_t + 1 of the access or 0 if there is none. Writes
+		take precedence over reads.*/
+	uint32_t* usages;
+} render_graph_plan_t;
+
+
+//! Frees the memory held by the given plan
+void free_render_graph_plan(render_graph_plan_t* plan) {
+	free(plan->first_uses);
+	free(plan->last_uses);
+	free(plan->sources);
+	free(plan->image_usages);
+	free(plan->final_layouts);
+	free(plan->usages);
+	memset(plan, 0, sizeof(*plan));
+}
+
+
+//! \return VK_TRUE iff the given usage writes to the attachment
+VkBool32 is_render_graph_write(render_graph_usage_t usage) {
+	return usage != render_graph_usage_input;
+}
+
+
+//! Outputs pipeline stages, access flags, image layout and image usage flags
+//! that correspond to the given usage
+void get_render_graph_usage_info(VkPipelineStageFlags* stages, VkAccessFlags* access, VkImageLayout* layout, VkImageUsageFlags* image_usage, render_graph_usage_t usage) {
+	switch (usage) {
+	case render_graph_usage_color:
+		(*stages) = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		(*access) = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		(*layout) = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		(*image_usage) = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		break;
+	case render_graph_usage_depth:
+		(*stages) = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		(*access) = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		(*layout) = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		(*image_usage) = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		break;
+	default:
+		(*stages) = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		(*access) = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		(*layout) = VK_IMAGE_LAYOUT_GENERAL;
+		(*image_usage) = VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+		break;
+	}
+}
+
+
+/*! Adds a dependency from subpass src to subpass dst for the given usages or
+	merges it into an existing dependency between these subpasses.
+	\param src_usage The usage in subpass src. Ignored if src is
+		VK_SUBPASS_EXTERNAL.*/
+void add_render_graph_dependency(VkSubpassDependency* dependencies, uint32_t* dependency_count,
+	uint32_t src, uint32_t dst, render_graph_usage_t src_usage, render_graph_usage_t dst_usage)
+{
+	VkPipelineStageFlags src_stages, dst_stages;
+	VkAccessFlags src_access, dst_access;
+	VkImageLayout layout;
+	VkImageUsageFlags image_usage;
+	get_render_graph_usage_info(&dst_stages, &dst_access, &layout, &image_usage, dst_usage);
+	if (src == VK_SUBPASS_EXTERNAL) {
+		// Wait for whatever happened to the image before the render pass
+		// (e.g. acquiring a swapchain image) in the same stages
+		src_stages = dst_stages;
+		src_access = 0;
+	}
+	else {
+		get_render_graph_usage_info(&src_stages, &src_access, &layout, &image_usage, src_usage);
+		// Reads do not have to be made available
+		if (!is_render_graph_write(src_usage))
+			src_access = 0;
+	}
+	for (uint32_t i = 0; i != *dependency_count; ++i) {
+		VkSubpassDependency* dependency = &dependencies[i];
+		if (dependency->srcSubpass == src && dependency->dstSubpass == dst) {
+			dependency->srcStageMask |= src_stages;
+			dependency->dstStageMask |= dst_stages;
+			dependency->srcAccessMask |= src_access;
+			dependency->dstAccessMask |= dst_access;
+			return;
+		}
+	}
+	// Attachments are only accessed at the same pixel, so dependencies between
+	// subpasses are by region. This way, tiled GPUs can merge subpasses.
+	VkSubpassDependency dependency = {
+		.srcSubpass = src, .dstSubpass = dst,
+		.srcStageMask = src_stages, .dstStageMask = dst_stages,
+		.srcAccessMask = src_access, .dstAccessMask = dst_access,
+		.dependencyFlags = (src == VK_SUBPASS_EXTERNAL) ? 0 : VK_DEPENDENCY_BY_REGION_BIT,
+	};
+	dependencies[(*dependency_count)++] = dependency;
+}
+
+
+/*! Culls passes, assigns subpass indices and maps declared attachments to
+	physical attachments. Fills the corresponding members of the graph and
+	the given plan.
+	\return 0 on success.*/
+int plan_render_graph(render_graph_t* graph, render_graph_plan_t* plan, uint32_t attachment_count, const render_graph_attachment_t* attachments,
+	uint32_t pass_count, const render_graph_pass_t* passes)
+{
+	// Validate the declaration
+	for (uint32_t i = 0; i != pass_count; ++i) {
+		uint32_t depth_count = 0;
+		for (uint32_t j = 0; j != passes[i].access_count; ++j) {
+			if (passes[i].accesses[j].attachment >= attachment_count) {
+				printf("The render graph pass %s accesses attachment %u but there are only %u.\n", passes[i].name, passes[i].accesses[j].attachment, attachment_count);
+				return 1;
+			}
+			depth_count += (passes[i].accesses[j].usage == render_graph_usage_depth) ? 1 : 0;
+		}
+		if (depth_count > 1) {
+			printf("The render graph pass %s uses %u depth attachments but at most one is supported.\n", passes[i].name, depth_count);
+			return 1;
+		}
+	}
+	// Walk backwards from the outputs. A pass is needed if it writes to an
+	// attachment that is needed later on.
+	graph->pass_count = pass_count;
+	graph->subpass_indices = malloc(sizeof(uint32_t) * pass_count);
+	VkBool32* needed = malloc(sizeof(VkBool32) * attachment_count);
+	for (uint32_t i = 0; i != attachment_count; ++i)
+		needed[i] = (attachments[i].final_layout != VK_IMAGE_LAYOUT_UNDEFINED);
+	for (uint32_t i = pass_count; i != 0; --i) {
+		const render_graph_pass_t* pass = &passes[i - 1];
+		VkBool32 live = pass->keep;
+		for (uint32_t j = 0; j != pass->access_count; ++j)
+			live |= is_render_graph_write(pass->accesses[j].usage) && needed[pass->accesses[j].attachment];
+		// Color attachments may be blended, so everything that the pass
+		// accesses is needed
+		for (uint32_t j = 0; j != pass->access_count && live; ++j)
+			needed[pass->accesses[j].attachment] = VK_TRUE;
+		graph->subpass_indices[i - 1] = live ? 0 : UINT32_MAX;
+	}
+	free(needed);
+	graph->subpass_count = 0;
+	for (uint32_t i = 0; i != pass_count; ++i) {
+		if (graph->subpass_indices[i] != UINT32_MAX)
+			graph->subpass_indices[i] = graph->subpass_count++;
+		else
+			printf("Culling the render graph pass %s because it does not contribute to any output.\n", passes[i].name);
+	}
+	if (graph->subpass_count == 0) {
+		printf("All passes of the render graph have been culled.\n");
+		return 1;
+	}
+	// Figure out in which subpasses each attachment is used
+	plan->first_uses = malloc(sizeof(uint32_t) * attachment_count);
+	plan->last_uses = malloc(sizeof(uint32_t) * attachment_count);
+	VkImageUsageFlags* image_usages = malloc(sizeof(VkImageUsageFlags) * attachment_count);
+	VkImageLayout* last_layouts = malloc(sizeof(VkImageLayout) * attachment_count);
+	for (uint32_t i = 0; i != attachment_count; ++i) {
+		plan->first_uses[i] = UINT32_MAX;
+		plan->last_uses[i] = 0;
+		image_usages[i] = attachments[i].usage;
+		last_layouts[i] = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+	for (uint32_t i = 0; i != pass_count; ++i) {
+		uint32_t subpass_index = graph->subpass_indices[i];
+		for (uint32_t j = 0; j != passes[i].access_count && subpass_index != UINT32_MAX; ++j) {
+			uint32_t attachment = passes[i].accesses[j].attachment;
+			VkPipelineStageFlags stages;
+			VkAccessFlags access;
+			VkImageUsageFlags image_usage;
+			get_render_graph_usage_info(&stages, &access, &last_layouts[attachment], &image_usage, passes[i].accesses[j].usage);
+			image_usages[attachment] |= image_usage;
+			if (plan->first_uses[attachment] == UINT32_MAX)
+				plan->first_uses[attachment] = subpass_index;
+			plan->last_uses[attachment] = subpass_index;
+		}
+	}
+	// Assign physical attachments. Transient attachments with equal format
+	// and disjoint lifetimes share one, unless the later one needs to be
+	// cleared.
+	graph->attachment_count = attachment_count;
+	graph->physical_attachments = malloc(sizeof(uint32_t) * attachment_count);
+	graph->physical_attachment_count = 0;
+	plan->sources = malloc(sizeof(uint32_t) * attachment_count);
+	plan->image_usages = malloc(sizeof(VkImageUsageFlags) * attachment_count);
+	plan->final_layouts = malloc(sizeof(VkImageLayout) * attachment_count);
+	uint32_t* physical_last_uses = malloc(sizeof(uint32_t) * attachment_count);
+	for (uint32_t i = 0; i != attachment_count; ++i) {
+		const render_graph_attachment_t* attachment = &attachments[i];
+		graph->physical_attachments[i] = UINT32_MAX;
+		if (plan->first_uses[i] == UINT32_MAX)
+			continue;
+		VkBool32 transient = !attachment->external && attachment->final_layout == VK_IMAGE_LAYOUT_UNDEFINED;
+		uint32_t physical = graph->physical_attachment_count;
+		for (uint32_t j = 0; j != graph->physical_attachment_count && transient && !attachment->clear; ++j) {
+			const render_graph_attachment_t* other = &attachments[plan->sources[j]];
+			if (!other->external && other->final_layout == VK_IMAGE_LAYOUT_UNDEFINED
+				&& other->format == attachment->format && physical_last_uses[j] < plan->first_uses[i])
+			{
+				physical = j;
+				break;
+			}
+		}
+		if (physical == graph->physical_attachment_count) {
+			plan->sources[physical] = i;
+			plan->image_usages[physical] = 0;
+			++graph->physical_attachment_count;
+		}
+		graph->physical_attachments[i] = physical;
+		physical_last_uses[physical] = plan->last_uses[i];
+		plan->image_usages[physical] |= image_usages[i];
+		plan->final_layouts[physical] = (attachment->final_layout != VK_IMAGE_LAYOUT_UNDEFINED) ? attachment->final_layout : last_layouts[i];
+	}
+	free(physical_last_uses);
+	free(image_usages);
+	free(last_layouts);
+	// Record how each subpass uses each physical attachment
+	size_t usage_count = (size_t) graph->subpass_count * graph->physical_attachment_count;
+	plan->usages = malloc(sizeof(uint32_t) * (usage_count > 0 ? usage_count : 1));
+	memset(plan->usages, 0, sizeof(uint32_t) * usage_count);
+	for (uint32_t i = 0; i != pass_count; ++i) {
+		uint32_t subpass_index = graph->subpass_indices[i];
+		for (uint32_t j = 0; j != passes[i].access_count && subpass_index != UINT32_MAX; ++j) {
+			render_graph_usage_t usage = passes[i].accesses[j].usage;
+			uint32_t* entry = &plan->usages[subpass_index * graph->physical_attachment_count + graph->physical_attachments[passes[i].accesses[j].attachment]];
+			if ((*entry) == 0 || is_render_graph_write(usage))
+				(*entry) = (uint32_t) usage + 1;
+		}
+	}
+	return 0;
+}
+
+
+/*! Creates graph->render_pass according to the given plan.
+	\return 0 on success.*/
+int create_render_graph_render_pass(render_graph_t* graph, const device_t* device, const render_graph_plan_t* plan,
+	const render_graph_attachment_t* attachments, uint32_t pass_count, const render_graph_pass_t* passes)
+{
+	uint32_t physical_count = graph->physical_attachment_count;
+	uint32_t subpass_count = graph->subpass_count;
+	// Describe attachments
+	VkAttachmentDescription* descriptions = malloc(sizeof(VkAttachmentDescription) * physical_count);
+	graph->clear_values = malloc(sizeof(VkClearValue) * physical_count);
+	for (uint32_t i = 0; i != physical_count; ++i) {
+		const render_graph_attachment_t* attachment = &attachments[plan->sources[i]];
+		VkAttachmentDescription description = {
+			.format = attachment->format,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = attachment->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.storeOp = (attachment->final_layout != VK_IMAGE_LAYOUT_UNDEFINED) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.finalLayout = plan->final_layouts[i]
+		};
+		descriptions[i] = description;
+		graph->clear_values[i] = attachment->clear_value;
+	}
+	// Describe subpasses
+	uint32_t reference_count = 0;
+	for (uint32_t i = 0; i != pass_count; ++i)
+		reference_count += passes[i].access_count;
+	VkAttachmentReference* references = malloc(sizeof(VkAttachmentReference) * (reference_count > 0 ? reference_count : 1));
+	uint32_t* preserves = malloc(sizeof(uint32_t) * subpass_count * physical_count);
+	VkSubpassDescription* subpasses = malloc(sizeof(VkSubpassDescription) * subpass_count);
+	memset(subpasses, 0, sizeof(VkSubpassDescription) * subpass_count);
+	uint32_t reference_index = 0;
+	for (uint32_t i = 0; i != pass_count; ++i) {
+		uint32_t subpass_index = graph->subpass_indices[i];
+		if (subpass_index == UINT32_MAX)
+			continue;
+		const render_graph_pass_t* pass = &passes[i];
+		VkSubpassDescription* subpass = &subpasses[subpass_index];
+		subpass->pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		// Gather references by usage
+		render_graph_usage_t usages[] = { render_graph_usage_color, render_graph_usage_input, render_graph_usage_depth };
+		for (uint32_t j = 0; j != COUNT_OF(usages); ++j) {
+			VkAttachmentReference* first_reference = &references[reference_index];
+			uint32_t count = 0;
+			for (uint32_t k = 0; k != pass->access_count; ++k) {
+				if (pass->accesses[k].usage != usages[j])
+					continue;
+				VkPipelineStageFlags stages;
+				VkAccessFlags access;
+				VkImageUsageFlags image_usage;
+				VkAttachmentReference reference = { .attachment = graph->physical_attachments[pass->accesses[k].attachment] };
+				get_render_graph_usage_info(&stages, &access, &reference.layout, &image_usage, usages[j]);
+				references[reference_index++] = reference;
+				++count;
+			}
+			if (usages[j] == render_graph_usage_color) {
+				subpass->colorAttachmentCount = count;
+				subpass->pColorAttachments = first_reference;
+			}
+			else if (usages[j] == render_graph_usage_input) {
+				subpass->inputAttachmentCount = count;
+				subpass->pInputAttachments = first_reference;
+			}
+			else if (count > 0)
+				subpass->pDepthStencilAttachment = first_reference;
+		}
+		// Preserve attachments that are used before and after but not here
+		subpass->pPreserveAttachments = &preserves[subpass_index * physical_count];
+		for (uint32_t j = 0; j != graph->attachment_count; ++j) {
+			uint32_t physical = graph->physical_attachments[j];
+			if (physical == UINT32_MAX || plan->first_uses[j] >= subpass_index || plan->last_uses[j] <= subpass_index
+				|| plan->usages[subpass_index * physical_count + physical] != 0)
+				continue;
+			VkBool32 listed = VK_FALSE;
+			for (uint32_t k = 0; k != subpass->preserveAttachmentCount; ++k)
+				listed |= (subpass->pPreserveAttachments[k] == physical);
+			if (!listed)
+				preserves[subpass_index * physical_count + subpass->preserveAttachmentCount++] = physical;
+		}
+	}
+	// Each access depends on the most recent write to the same physical
+	// attachment (or on whatever happened before the render pass). Writes
+	// additionally have to wait for all reads since then.
+	VkSubpassDependency* dependencies = malloc(sizeof(VkSubpassDependency) * subpass_count * (subpass_count + 1));
+	uint32_t dependency_count = 0;
+	for (uint32_t i = 0; i != subpass_count; ++i) {
+		for (uint32_t j = 0; j != physical_count; ++j) {
+			uint32_t entry = plan->usages[i * physical_count + j];
+			if (entry == 0)
+				continue;
+			render_graph_usage_t usage = (render_graph_usage_t) (entry - 1);
+			uint32_t writer = VK_SUBPASS_EXTERNAL;
+			render_graph_usage_t writer_usage = usage;
+			for (uint32_t k = 0; k != i; ++k) {
+				uint32_t other = plan->usages[k * physical_count + j];
+				if (other != 0 && is_render_graph_write((render_graph_usage_t) (other - 1))) {
+					writer = k;
+					writer_usage = (render_graph_usage_t) (other - 1);
+				}
+			}
+			add_render_graph_dependency(dependencies, &dependency_count, writer, i, writer_usage, usage);
+			for (uint32_t k = (writer == VK_SUBPASS_EXTERNAL) ? 0 : (writer + 1); k < i && is_render_graph_write(usage); ++k) {
+				uint32_t other = plan->usages[k * physical_count + j];
+				if (other != 0)
+					add_render_graph_dependency(dependencies, &dependency_count, k, i, (render_graph_usage_t) (other - 1), usage);
+			}
+		}
+	}
+	// Create the render pass
+	VkRenderPassCreateInfo render_pass_info = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		.attachmentCount = physical_count, .pAttachments = descriptions,
+		.subpassCount = subpass_count, .pSubpasses = subpasses,
+		.dependencyCount = dependency_count, .pDependencies = dependencies
+	};
+	VkResult result = vkCreateRenderPass(device->device, &render_pass_info, NULL, &graph->render_pass);
+	free(descriptions);
+	free(references);
+	free(preserves);
+	free(subpasses);
+	free(dependencies);
+	if (result) {
+		printf("Failed to create a render pass for a render graph with %u subpasses and %u attachments.\n", subpass_count, physical_count);
+		return 1;
+	}
+	return 0;
+}
+
+
+/*! Creates images for all physical attachments that are not external and
+	framebuffers that bind them.
+	\return 0 on success.*/
+int create_render_graph_framebuffers(render_graph_t* graph, const device_t* device, const render_graph_plan_t* plan, VkExtent2D extent,
+	const render_graph_attachment_t* attachments, const VkImageView* const* external_views)
+{
+	uint32_t physical_count = graph->physical_attachment_count;
+	uint32_t duplicate_count = graph->duplicate_count;
+	// Request one image per attachment that is not external and duplicate
+	graph->image_indices = malloc(sizeof(uint32_t) * physical_count);
+	uint32_t image_count = 0;
+	for (uint32_t i = 0; i != physical_count; ++i)
+		graph->image_indices[i] = attachments[plan->sources[i]].external ? UINT32_MAX : image_count++;
+	image_request_t* requests = malloc(sizeof(image_request_t) * (image_count * duplicate_count + 1));
+	memset(requests, 0, sizeof(image_request_t) * (image_count * duplicate_count + 1));
+	for (uint32_t i = 0; i != physical_count; ++i) {
+		if (graph->image_indices[i] == UINT32_MAX)
+			continue;
+		// If the contents are not needed beyond the render pass, the image
+		// may never be backed by actual memory
+		VkImageUsageFlags usage = plan->image_usages[i];
+		VkImageUsageFlags attachment_usages = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+		if (attachments[plan->sources[i]].final_layout == VK_IMAGE_LAYOUT_UNDEFINED && (usage & ~attachment_usages) == 0)
+			usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		image_request_t request = {
+			.image_info = {
+				.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+				.imageType = VK_IMAGE_TYPE_2D,
+				.format = attachments[plan->sources[i]].format,
+				.extent = {extent.width, extent.height, 1},
+				.mipLevels = 1, .arrayLayers = 1, .samples = 1,
+				.usage = usage
+			},
+			.view_info = {
+				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+				.viewType = VK_IMAGE_VIEW_TYPE_2D,
+				.subresourceRange = {
+					.aspectMask = (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT
+				}
+			}
+		};
+		for (uint32_t j = 0; j != duplicate_count; ++j)
+			requests[j * image_count + graph->image_indices[i]] = request;
+	}
+	int result = create_images(&graph->images, device, requests, image_count * duplicate_count, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	free(requests);
+	if (result) {
+		printf("Failed to create images for attachments of a render graph.\n");
+		return 1;
+	}
+	// Create one framebuffer per duplicate
+	VkImageView* views = malloc(sizeof(VkImageView) * (physical_count > 0 ? physical_count : 1));
+	graph->framebuffers = malloc(sizeof(VkFramebuffer) * duplicate_count);
+	memset(graph->framebuffers, 0, sizeof(VkFramebuffer) * duplicate_count);
+	for (uint32_t i = 0; i != duplicate_count; ++i) {
+		for (uint32_t j = 0; j != physical_count; ++j)
+			views[j] = (graph->image_indices[j] == UINT32_MAX)
+				? external_views[plan->sources[j]][i]
+				: graph->images.images[i * image_count + graph->image_indices[j]].view;
+		VkFramebufferCreateInfo framebuffer_info = {
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = graph->render_pass,
+			.attachmentCount = physical_count, .pAttachments = views,
+			.width = extent.width, .height = extent.height,
+			.layers = 1
+		};
+		if (vkCreateFramebuffer(device->device, &framebuffer_info, NULL, &graph->framebuffers[i])) {
+			printf("Failed to create framebuffer %u for a render graph.\n", i);
+			free(views);
+			return 1;
+		}
+	}
+	free(views);
+	return 0;
+}
+
+
+int create_render_graph(render_graph_t* graph, const device_t* device, VkExtent2D extent, uint32_t duplicate_count,
+	uint32_t attachment_count, const render_graph_attachment_t* attachments,
+	uint32_t pass_count, const render_graph_pass_t* passes, const VkImageView* const* external_views)
+{
+	memset(graph, 0, sizeof(*graph));
+	graph->duplicate_count = duplicate_count;
+	render_graph_plan_t plan;
+	memset(&plan, 0, sizeof(plan));
+	if (plan_render_graph(graph, &plan, attachment_count, attachments, pass_count, passes)
+		|| create_render_graph_render_pass(graph, device, &plan, attachments, pass_count, passes)
+		|| create_render_graph_framebuffers(graph, device, &plan, extent, attachments, external_views))
+	{
+		free_render_graph_plan(&plan);
+		destroy_render_graph(graph, device);
+		return 1;
+	}
+	free_render_graph_plan(&plan);
+	return 0;
+}
+
+
+void destroy_render_graph(render_graph_t* graph, const device_t* device) {
+	for (uint32_t i = 0; i != graph->duplicate_count && graph->framebuffers; ++i)
+		if (graph->framebuffers[i])
+			vkDestroyFramebuffer(device->device, graph->framebuffers[i], NULL);
+	free(graph->framebuffers);
+	destroy_images(&graph->images, device);
+	if (graph->render_pass) vkDestroyRenderPass(device->device, graph->render_pass, NULL);
+	free(graph->subpass_indices);
+	free(graph->physical_attachments);
+	free(graph->clear_values);
+	free(graph->image_indices);
+	memset(graph, 0, sizeof(*graph));
+}
+
+
+VkImageView get_render_graph_view(const render_graph_t* graph, uint32_t attachment, uint32_t duplicate_index) {
+	uint32_t physical = graph->physical_attachments[attachment];
+	if (physical == UINT32_MAX || graph->image_indices[physical] == UINT32_MAX)
+		return NULL;
+	uint32_t image_count = graph->images.image_count / graph->duplicate_count;
+	return graph->images.images[duplicate_index * image_count + graph->image_indices[physical]].view;
+}
@@ -0,0 +1,136 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+#include "vulkan_basics.h"
+
+
+//! Ways in which a pass of a render graph can access an attachment
+typedef enum render_graph_usage_e {
+	//! The pass writes (and possibly blends into) a color attachment. The
+	//! location in the shader is the index among color accesses of the pass.
+	render_graph_usage_color,
+	//! The pass tests against and writes to a depth attachment. There can
+	//! only be one per pass.
+	render_graph_usage_depth,
+	//! The pass reads the attachment as input attachment. The input attachment
+	//! index in the shader is the index among input accesses of the pass.
+	//! The layout is VK_IMAGE_LAYOUT_GENERAL.
+	render_graph_usage_input,
+} render_graph_usage_t;
+
+
+//! Declares an image that passes of a render graph render to or read from
+typedef struct render_graph_attachment_s {
+	//! The format of the image
+	VkFormat format;
+	//! Usage flags that are needed in addition to the ones implied by the
+	//! accesses of passes (e.g. VK_IMAGE_USAGE_SAMPLED_BIT)
+	VkImageUsageFlags usage;
+	//! Whether the attachment is cleared to clear_value when it is first used
+	VkBool32 clear;
+	VkClearValue clear_value;
+	//! VK_TRUE if the calling side provides the image (e.g. swapchain images)
+	//! instead of the render graph allocating it
+	VkBool32 external;
+	//! If this is not VK_IMAGE_LAYOUT_UNDEFINED, the attachment is an output
+	//! of the graph. Its contents get stored and transitioned to this layout.
+	VkImageLayout final_layout;
+} render_graph_attachment_t;
+
+
+//! A single access of a render graph pass to an attachment
+typedef struct render_graph_access_s {
+	//! The index of the accessed attachment
+	uint32_t attachment;
+	//! How the attachment is accessed
+	render_graph_usage_t usage;
+} render_graph_access_t;
+
+
+/*! Declares a pass of a render graph. Each pass becomes a subpass, unless it
+	gets culled because nothing that it writes contributes to an output.*/
+typedef struct render_graph_pass_s {
+	//! A name used in error messages
+	const char* name;
+	//! The number of attachment accesses of this pass and an array of them
+	uint32_t access_count;
+	const render_graph_access_t* accesses;
+	//! VK_TRUE if this pass must not be culled, e.g. because it writes to
+	//! storage buffers
+	VkBool32 keep;
+} render_graph_pass_t;
+
+
+/*! A render pass with all of its subpasses, attachments and framebuffers,
+	which have been derived from a declaration of passes and their reads and
+	writes. All subpasses are merged into a single VkRenderPass with
+	dependencies by region, such that tiled GPUs can keep attachments on chip.
+	Attachments that are not needed after the render pass are transient and
+	those with disjoint lifetimes share images.*/
+typedef struct render_graph_s {
+	//! The number of declared passes and for each of them its subpass index
+	//! or UINT32_MAX if it has been culled
+	uint32_t pass_count;
+	uint32_t* subpass_indices;
+	//! The number of subpasses, i.e. passes that have not been culled
+	uint32_t subpass_count;
+	/*! The number of declared attachments and for each of them the index of
+		the attachment of render_pass that holds it or UINT32_MAX if no pass
+		uses it*/
+	uint32_t attachment_count;
+	uint32_t* physical_attachments;
+	//! The number of attachments of render_pass and for each of them the
+	//! value to which it gets cleared (as needed by VkRenderPassBeginInfo)
+	uint32_t physical_attachment_count;
+	VkClearValue* clear_values;
+	//! The render pass with all subpasses
+	VkRenderPass render_pass;
+	//! The number of copies of all attachments (e.g. one per swapchain image)
+	uint32_t duplicate_count;
+	//! Images for all physical attachments that are not external, ordered by
+	//! duplicate, then by index of the physical attachment
+	images_t images;
+	//! Per physical attachment the index of its image among duplicate_count
+	//! consecutive images in images or UINT32_MAX for external attachments
+	uint32_t* image_indices;
+	//! One framebuffer per duplicate
+	VkFramebuffer* framebuffers;
+} render_graph_t;
+
+
+/*! Derives and creates a render pass with subpasses, dependencies,
+	attachment images and framebuffers from the given declaration.
+	\param graph The output. Clean up using destroy_render_graph().
+	\param extent The resolution of all attachments.
+	\param duplicate_count The number of copies of all attachments and the
+		number of framebuffers.
+	\param attachments, attachment_count The declared attachments.
+	\param passes, pass_count The declared passes in the order in which they
+		should be executed.
+	\param external_views For each attachment an array of duplicate_count
+		image views. Only used for external attachments. Others may be NULL.
+	\return 0 on success.*/
+int create_render_graph(render_graph_t* graph, const device_t* device, VkExtent2D extent, uint32_t duplicate_count,
+	uint32_t attachment_count, const render_graph_attachment_t* attachments,
+	uint32_t pass_count, const render_graph_pass_t* passes, const VkImageView* const* external_views);
+
+//! Frees objects and zeros
+void destroy_render_graph(render_graph_t* graph, const device_t* device);
+
+//! \return The view onto the image that holds the given attachment in the
+//!		given duplicate or NULL if it is external or unused
+VkImageView get_render_graph_view(const render_graph_t* graph, uint32_t attachment, uint32_t duplicate_index);
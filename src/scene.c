@@ -21,6 +21,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+//! The size in bytes of the staging buffer used to upload meshes
+#define MESH_STAGING_BUFFER_SIZE (64 * 1024 * 1024)
+
+
 const char* get_material_texture_suffix(material_texture_type_t type) {
 	switch (type) {
 	case material_texture_type_base_color: return "BaseColor";
@@ -31,6 +35,16 @@ const char* get_material_texture_suffix(material_texture_type_t type) {
 }
 
 
+VkFormat get_material_texture_format(material_texture_type_t type) {
+	switch (type) {
+	case material_texture_type_base_color: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+	case material_texture_type_specular: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	case material_texture_type_normal: return VK_FORMAT_BC5_UNORM_BLOCK;
+	default: return VK_FORMAT_UNDEFINED;
+	}
+}
+
+
 /*! Given a mesh with count variables set as appropriate, this function creates
 	the required buffers and allocates and binds memory for them. It does not
 	fill them with data.
@@ -53,9 +67,10 @@ int create_mesh(mesh_t* mesh, const device_t* device, VkBool32 staging) {
 	// Create the buffers
 	VkBufferCreateInfo buffer_infos[mesh_buffer_count_full];
 	memset(buffer_infos, 0, sizeof(buffer_infos));
-	mesh->positions.size = sizeof(uint32_t) * 2 * 3 * mesh->triangle_count;
-	mesh->normals_and_tex_coords.size = sizeof(uint16_t) * 4 * 3 * mesh->triangle_count;
-	mesh->material_indices.size = sizeof(uint8_t) * mesh->triangle_count;
+	uint64_t triangle_count = mesh->triangle_count + mesh->lod_triangle_count;
+	mesh->positions.size = sizeof(uint32_t) * 2 * 3 * triangle_count;
+	mesh->normals_and_tex_coords.size = sizeof(uint16_t) * 4 * 3 * triangle_count;
+	mesh->material_indices.size = sizeof(uint8_t) * triangle_count;
 	mesh->triangle.size = sizeof(int8_t) * 3 * 2;
 	for (uint32_t i = 0; i != mesh_buffer_count_full; ++i) {
 		buffer_infos[i].sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -67,7 +82,7 @@ int create_mesh(mesh_t* mesh, const device_t* device, VkBool32 staging) {
 	buffers_t buffers;
 	if (create_buffers(&buffers, device, buffer_infos, mesh_buffer_count_full, memory_properties)) {
 		printf("Failed to allocate %smemory for a mesh with %llu triangles.\n",
-			staging ? "staging " : "", mesh->triangle_count);
+			staging ? "staging " : "", triangle_count);
 		return 1;
 	}
 	memcpy(mesh->buffers, buffers.buffers, sizeof(mesh->buffers));
@@ -105,6 +120,8 @@ void destroy_mesh(mesh_t* mesh, const device_t* device) {
 		if (mesh->buffer_views[i]) vkDestroyBufferView(device->device, mesh->buffer_views[i], NULL);
 	}
 	if (mesh->memory) vkFreeMemory(device->device, mesh->memory, NULL);
+	destroy_buffers(&mesh->triangle_records, device);
+	destroy_buffers(&mesh->meshlets, device);
 	memset(mesh, 0, sizeof(*mesh));
 }
 
@@ -117,82 +134,154 @@ void destroy_materials(materials_t* materials, const device_t* device) {
 		free(materials->material_names);
 	}
 	destroy_images(&materials->textures, device);
-	if (materials->sampler) vkDestroySampler(device->device, materials->sampler, NULL);
+	destroy_buffers(&materials->texture_slots, device);
+	texture_stream_t* stream = &materials->stream;
+	for (uint32_t i = 0; i != stream->texture_count; ++i) {
+		if (stream->textures) destroy_images(&stream->textures[i].image, device);
+		if (stream->file_paths) free(stream->file_paths[i]);
+	}
+	free(stream->textures);
+	free(stream->file_paths);
 	memset(materials, 0, sizeof(*materials));
 }
 
 
+//! Frees and nulls the given temporary objects
+void destroy_acceleration_structure_build(acceleration_structure_build_t* build, const device_t* device) {
+	if (build->cmd) vkFreeCommandBuffers(device->device, device->command_pool, 1, &build->cmd);
+	destroy_pipeline_with_bindings(&build->dequantization, device);
+	destroy_shader(&build->dequantization_shader, device);
+	destroy_buffers(&build->scratch, device);
+	destroy_buffers(&build->instances, device);
+	destroy_buffers(&build->vertices, device);
+	memset(build, 0, sizeof(*build));
+}
+
+
 //! Frees and nulls the given acceleration structure
 void destroy_acceleration_structure(acceleration_structure_t* structure, const device_t* device) {
 	VK_LOAD(vkDestroyAccelerationStructureKHR)
 	if (structure->top_level) pvkDestroyAccelerationStructureKHR(device->device, structure->top_level, NULL);
 	if (structure->bottom_level) pvkDestroyAccelerationStructureKHR(device->device, structure->bottom_level, NULL);
+	destroy_acceleration_structure_build(&structure->build, device);
 	destroy_buffers(&structure->buffers, device);
 	memset(structure, 0, sizeof(*structure));
 }
 
 
-/*! Constructs top- and bottom-level acceleration structures for the given mesh
-	\param structure The output structure. Cleaned up by destroy_scene().
-	\param device A device that has to support ray tracing. Otherwise this
-		method fails.
-	\param mesh The staging version of the mesh.
-	\param mesh_data Pointer to the already mapped memory of the staging mesh.
+/*! Creates a compute pipeline that reads from texel buffers of a device-local
+	mesh and writes to a single storage buffer.
+	\param shader_file_path The path to the compute shader relative to the
+		CWD. Its bindings are the texel buffers followed by the storage buffer.
+	\param view_count The number of texel buffers in views.
+	\param views Views onto buffers of the mesh, bound in this order.
+	\param output The storage buffer to which the shader writes.
+	\param specialization_info Specialization constants for the shader.
 	\return 0 on success.*/
-int create_acceleration_structure(acceleration_structure_t* structure, const device_t* device, const mesh_t* mesh, const char* mesh_data) {
-	memset(structure, 0, sizeof(*structure));
-	if (!device->ray_tracing_supported) {
-		printf("Cannot create an acceleration structure without ray tracing support.\n");
+int create_mesh_compute_pipeline(pipeline_with_bindings_t* pipeline, shader_t* shader, const device_t* device, const char* shader_file_path,
+	uint32_t view_count, const VkBufferView* views, VkBuffer output, const VkSpecializationInfo* specialization_info)
+{
+	// Create the descriptor set
+	VkDescriptorSetLayoutBinding bindings[mesh_buffer_count_full + 1];
+	memset(bindings, 0, sizeof(bindings));
+	for (uint32_t i = 0; i != view_count; ++i)
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+	bindings[view_count].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptor_set_request_t set_request = {
+		.stage_flags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.min_descriptor_count = 1,
+		.binding_count = view_count + 1,
+		.bindings = bindings,
+	};
+	if (create_descriptor_sets(pipeline, device, &set_request, 1)) {
+		printf("Failed to create a descriptor set for the compute shader %s.\n", shader_file_path);
 		return 1;
 	}
-	VK_LOAD(vkGetAccelerationStructureBuildSizesKHR)
-	VK_LOAD(vkCreateAccelerationStructureKHR)
-	VK_LOAD(vkGetAccelerationStructureDeviceAddressKHR)
-	VK_LOAD(vkCmdBuildAccelerationStructuresKHR)
-	// Create a buffer for the dequantized triangle mesh
-	VkBufferCreateInfo staging_infos[2] = {
-		{
-			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-			.size = mesh->triangle_count * sizeof(float) * 3 * 3,
-			.usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	VkDescriptorBufferInfo output_info = { .buffer = output, .range = VK_WHOLE_SIZE };
+	VkWriteDescriptorSet writes[mesh_buffer_count_full + 1];
+	memset(writes, 0, sizeof(writes));
+	for (uint32_t i = 0; i != view_count; ++i) {
+		writes[i].dstSet = pipeline->descriptor_sets[0];
+		writes[i].dstBinding = i;
+		writes[i].pTexelBufferView = &views[i];
+	}
+	writes[view_count].dstSet = pipeline->descriptor_sets[0];
+	writes[view_count].dstBinding = view_count;
+	writes[view_count].pBufferInfo = &output_info;
+	complete_descriptor_set_write(view_count + 1, writes, &set_request);
+	vkUpdateDescriptorSets(device->device, view_count + 1, writes, 0, NULL);
+	// Compile the shader
+	shader_request_t shader_request = {
+		.shader_file_path = (char*) shader_file_path,
+		.include_path = "src/shaders",
+		.entry_point = "main",
+		.stage = VK_SHADER_STAGE_COMPUTE_BIT
+	};
+	if (compile_glsl_shader(shader, device, &shader_request)) {
+		printf("Failed to compile the compute shader %s.\n", shader_file_path);
+		return 1;
+	}
+	// Create the pipeline
+	VkComputePipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = shader->module,
+			.pName = "main",
+			.pSpecializationInfo = specialization_info,
 		},
-		{
-			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-			.size = sizeof(VkAccelerationStructureInstanceKHR),
-			.usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
-		}
+		.layout = pipeline->pipeline_layout,
 	};
-	buffers_t staging;
-	uint8_t* staging_data;
-	if (create_aligned_buffers(&staging, device, staging_infos, 2, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 16)
-		|| vkMapMemory(device->device, staging.memory, 0, staging.size, 0, (void**) &staging_data))
-	{
-		printf("Failed to allocate and map a buffer for dequantized mesh data (%llu triangles) to create an acceleration structure.\n", mesh->triangle_count);
-		destroy_buffers(&staging, device);
-		destroy_acceleration_structure(structure, device);
+	if (vkCreateComputePipelines(device->device, NULL, 1, &pipeline_info, NULL, &pipeline->pipeline)) {
+		printf("Failed to create a compute pipeline for the shader %s.\n", shader_file_path);
 		return 1;
 	}
-	// Dequantize the mesh data
-	const uint32_t* quantized_positions = (const uint32_t*) (mesh_data + mesh->positions.offset);
-	float* vertices = (float*) (staging_data + staging.buffers[0].offset);
-	for (uint32_t i = 0; i != mesh->triangle_count * 3; ++i) {
-		uint32_t quantized_position[2] = {quantized_positions[2 * i + 0], quantized_positions[2 * i + 1]};
-		float position[3] = {
-			(float) (quantized_position[0] & 0x1FFFFF),
-			(float) (((quantized_position[0] & 0xFFE00000) >> 21) | ((quantized_position[1] & 0x3FF) << 11)),
-			(float) ((quantized_position[1] & 0x7FFFFC00) >> 10)
-		};
-		for (uint32_t j = 0; j != 3; ++j)
-			vertices[3 * i + j] = position[j] * mesh->dequantization_factor[j] + mesh->dequantization_summand[j];
+	return 0;
+}
+
+
+/*! Creates a compute pipeline that reads the quantized positions of the given
+	device-local mesh and writes dequantized positions to the given buffer.
+	Dequantization constants and the vertex count are baked into the pipeline
+	as specialization constants.
+	\return 0 on success.*/
+int create_dequantization_pipeline(pipeline_with_bindings_t* pipeline, shader_t* shader, const device_t* device, const mesh_t* mesh, VkBuffer vertices) {
+	struct {
+		float dequantization_factor[3];
+		float dequantization_summand[3];
+		uint32_t vertex_count;
+	} constants = { .vertex_count = (uint32_t) (mesh->triangle_count * 3) };
+	memcpy(constants.dequantization_factor, mesh->dequantization_factor, sizeof(constants.dequantization_factor));
+	memcpy(constants.dequantization_summand, mesh->dequantization_summand, sizeof(constants.dequantization_summand));
+	VkSpecializationMapEntry map_entries[7];
+	for (uint32_t i = 0; i != COUNT_OF(map_entries); ++i) {
+		map_entries[i].constantID = i;
+		map_entries[i].offset = i * sizeof(float);
+		map_entries[i].size = sizeof(float);
 	}
-	// Figure out how big the buffers for the bottom-level need to be
-	uint32_t primitive_count = (uint32_t) mesh->triangle_count;
-	VkAccelerationStructureBuildSizesInfoKHR bottom_sizes = {
-		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR,
+	VkSpecializationInfo specialization_info = {
+		.mapEntryCount = COUNT_OF(map_entries),
+		.pMapEntries = map_entries,
+		.dataSize = sizeof(constants),
+		.pData = &constants,
 	};
+	return create_mesh_compute_pipeline(pipeline, shader, device, "src/shaders/dequantize_positions.comp.glsl",
+		1, &mesh->positions_view, vertices, &specialization_info);
+}
+
+
+/*! Describes builds of the bottom and top level of the given acceleration
+	structure from the vertices and instances in the given build objects.
+	Scratch memory and destinations are left for the calling side.
+	\param geometries Output geometries, which build_infos point to.
+	\param build_infos Output build infos for the bottom and top level.*/
+void get_acceleration_structure_build_infos(VkAccelerationStructureGeometryKHR geometries[2], VkAccelerationStructureBuildGeometryInfoKHR build_infos[2],
+	const acceleration_structure_t* structure, const acceleration_structure_build_t* build, const device_t* device)
+{
 	VkBufferDeviceAddressInfo vertices_address = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-		.buffer = staging.buffers[0].buffer
+		.buffer = build->vertices.buffers[0].buffer
 	};
 	VkAccelerationStructureGeometryKHR bottom_geometry = {
 		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
@@ -201,7 +290,7 @@ int create_acceleration_structure(acceleration_structure_t* structure, const dev
 			.triangles = {
 				.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR,
 				.vertexData = { .deviceAddress = vkGetBufferDeviceAddress(device->device, &vertices_address) },
-				.maxVertex = primitive_count * 3 - 1,
+				.maxVertex = structure->primitive_count * 3 - 1,
 				.vertexStride = 3 * sizeof(float),
 				.indexType = VK_INDEX_TYPE_NONE_KHR,
 				.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT,
@@ -209,24 +298,9 @@ int create_acceleration_structure(acceleration_structure_t* structure, const dev
 		},
 		.flags = VK_GEOMETRY_OPAQUE_BIT_KHR,
 	};
-	VkAccelerationStructureBuildGeometryInfoKHR bottom_build_info = {
-		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
-		.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
-		.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR,
-		.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
-		.geometryCount = 1, .pGeometries = &bottom_geometry,
-	};
-	pvkGetAccelerationStructureBuildSizesKHR(
-		device->device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-		&bottom_build_info, &primitive_count, &bottom_sizes);
-
-	// Figure out how big the buffers for the top-level need to be
-	VkAccelerationStructureBuildSizesInfoKHR top_sizes = {
-		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR,
-	};
 	VkBufferDeviceAddressInfo instances_address = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-		.buffer = staging.buffers[1].buffer
+		.buffer = build->instances.buffers[0].buffer
 	};
 	VkAccelerationStructureGeometryKHR top_geometry = {
 		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
@@ -240,19 +314,148 @@ int create_acceleration_structure(acceleration_structure_t* structure, const dev
 		},
 		.flags = VK_GEOMETRY_OPAQUE_BIT_KHR,
 	};
+	geometries[0] = bottom_geometry;
+	geometries[1] = top_geometry;
+	// The top level is rebuilt with each update, so it favors fast builds
+	VkAccelerationStructureBuildGeometryInfoKHR bottom_build_info = {
+		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+		.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+		.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR
+			| (structure->updatable ? VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR : 0),
+		.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+		.geometryCount = 1, .pGeometries = &geometries[0],
+	};
 	VkAccelerationStructureBuildGeometryInfoKHR top_build_info = {
 		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
 		.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
-		.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR,
+		.flags = structure->updatable ? VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR : VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR,
 		.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
-		.geometryCount = 1, .pGeometries = &top_geometry,
+		.geometryCount = 1, .pGeometries = &geometries[1],
+	};
+	build_infos[0] = bottom_build_info;
+	build_infos[1] = top_build_info;
+}
+
+
+//! Returns the only instance of the bottom level of the given acceleration
+//! structure using its current transform
+VkAccelerationStructureInstanceKHR get_acceleration_structure_instance(const acceleration_structure_t* structure, const device_t* device) {
+	VK_LOAD(vkGetAccelerationStructureDeviceAddressKHR)
+	VkAccelerationStructureDeviceAddressInfoKHR address_request = {
+		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
+		.accelerationStructure = structure->bottom_level,
+	};
+	VkAccelerationStructureInstanceKHR instance = {
+		.transform = structure->transform,
+		.mask = 0xFF,
+		.flags = VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR | VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR,
+		.accelerationStructureReference = pvkGetAccelerationStructureDeviceAddressKHR(device->device, &address_request),
+	};
+	return instance;
+}
+
+
+/*! Records a dispatch that dequantizes positions of the mesh into
+	build->vertices and a barrier that makes them available to acceleration
+	structure builds.*/
+void record_position_dequantization(VkCommandBuffer cmd, const acceleration_structure_build_t* build, const mesh_t* mesh) {
+	// The dispatch is capped at the guaranteed maximal group count and
+	// threads loop over vertices
+	uint32_t group_count = (uint32_t) ((mesh->triangle_count * 3 + 63) / 64);
+	if (group_count > 0xFFFF) group_count = 0xFFFF;
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, build->dequantization.pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, build->dequantization.pipeline_layout, 0, 1, build->dequantization.descriptor_sets, 0, NULL);
+	vkCmdDispatch(cmd, group_count, 1, 1);
+	VkMemoryBarrier after_dequantization_barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR,
+	};
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0,
+			1, &after_dequantization_barrier, 0, NULL, 0, NULL);
+}
+
+
+/*! Constructs top- and bottom-level acceleration structures for the given mesh
+	\param structure The output structure. Cleaned up by destroy_scene().
+	\param device A device that has to support ray tracing. Otherwise this
+		method fails.
+	\param mesh The device-local version of the mesh, which has been filled
+		with data already. Its positions are dequantized on the device to serve
+		as input for the build.
+	\param updatable VK_TRUE to keep everything that is needed for
+		record_acceleration_structure_update().
+	\return 0 on success.*/
+int create_acceleration_structure(acceleration_structure_t* structure, const device_t* device, const mesh_t* mesh, VkBool32 updatable) {
+	memset(structure, 0, sizeof(*structure));
+	if (!device->ray_tracing_supported) {
+		printf("Cannot create an acceleration structure without ray tracing support.\n");
+		return 1;
+	}
+	VK_LOAD(vkGetAccelerationStructureBuildSizesKHR)
+	VK_LOAD(vkCreateAccelerationStructureKHR)
+	VK_LOAD(vkCmdBuildAccelerationStructuresKHR)
+	structure->updatable = updatable;
+	structure->primitive_count = (uint32_t) mesh->triangle_count;
+	VkTransformMatrixKHR identity = { .matrix = {
+			{1.0f, 0.0f, 0.0f, 0.0f},
+			{0.0f, 1.0f, 0.0f, 0.0f},
+			{0.0f, 0.0f, 1.0f, 0.0f},
+		}
+	};
+	structure->transform = identity;
+	acceleration_structure_build_t build;
+	memset(&build, 0, sizeof(build));
+	// Create a device-local buffer for the dequantized triangle mesh and a
+	// small host-visible buffer for the instance. Updates write the instance
+	// using vkCmdUpdateBuffer().
+	VkBufferCreateInfo vertices_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = mesh->triangle_count * sizeof(float) * 3 * 3,
+		.usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
 	};
-	pvkGetAccelerationStructureBuildSizesKHR(
-		device->device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-		&top_build_info, &top_build_info.geometryCount, &top_sizes);
+	VkBufferCreateInfo instances_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = sizeof(VkAccelerationStructureInstanceKHR),
+		.usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	};
+	if (create_buffers(&build.vertices, device, &vertices_info, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+		printf("Failed to allocate a buffer for dequantized mesh data (%llu triangles) to create an acceleration structure.\n", mesh->triangle_count);
+		destroy_acceleration_structure_build(&build, device);
+		destroy_acceleration_structure(structure, device);
+		return 1;
+	}
+	uint8_t* instances_data;
+	if (create_aligned_buffers(&build.instances, device, &instances_info, 1, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 16)
+		|| vkMapMemory(device->device, build.instances.memory, 0, build.instances.size, 0, (void**) &instances_data))
+	{
+		printf("Failed to allocate and map a buffer for instances to create an acceleration structure.\n");
+		destroy_acceleration_structure_build(&build, device);
+		destroy_acceleration_structure(structure, device);
+		return 1;
+	}
+	// Prepare dequantization of the mesh data
+	if (create_dequantization_pipeline(&build.dequantization, &build.dequantization_shader, device, mesh, build.vertices.buffers[0].buffer)) {
+		destroy_acceleration_structure_build(&build, device);
+		destroy_acceleration_structure(structure, device);
+		return 1;
+	}
+	// Figure out how big the buffers for both levels need to be
+	VkAccelerationStructureGeometryKHR geometries[2];
+	VkAccelerationStructureBuildGeometryInfoKHR build_infos[2];
+	get_acceleration_structure_build_infos(geometries, build_infos, structure, &build, device);
+	uint32_t primitive_counts[2] = { structure->primitive_count, 1 };
+	VkAccelerationStructureBuildSizesInfoKHR sizes[2];
+	for (uint32_t i = 0; i != 2; ++i) {
+		sizes[i].sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+		sizes[i].pNext = NULL;
+		pvkGetAccelerationStructureBuildSizesKHR(
+			device->device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+			&build_infos[i], &primitive_counts[i], &sizes[i]);
+	}
 	
 	// Create buffers for the acceleration structures
-	VkAccelerationStructureBuildSizesInfoKHR sizes[2] = { bottom_sizes, top_sizes };
 	VkBufferCreateInfo buffer_requests[] = {
 		{
 			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -267,7 +470,7 @@ int create_acceleration_structure(acceleration_structure_t* structure, const dev
 	};
 	if (create_buffers(&structure->buffers, device, buffer_requests, 2, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
 		printf("Failed to create buffers to hold acceleration structures.\n");
-		destroy_buffers(&staging, device);
+		destroy_acceleration_structure_build(&build, device);
 		destroy_acceleration_structure(structure, device);
 		return 1;
 	}
@@ -282,17 +485,20 @@ int create_acceleration_structure(acceleration_structure_t* structure, const dev
 		};
 		if (pvkCreateAccelerationStructureKHR(device->device, &create_info, NULL, &structure->levels[i])) {
 			printf("Failed to create a %s-level acceleration structure.\n", (i == 0) ? "bottom" : "top");
-			destroy_buffers(&staging, device);
+			destroy_acceleration_structure_build(&build, device);
 			destroy_acceleration_structure(structure, device);
 			return 1;
 		}
 	}
 
-	// Allocate scratch memory for the build
+	// Allocate scratch memory for the build and for refits later on
+	VkDeviceSize bottom_scratch_size = sizes[0].buildScratchSize;
+	if (updatable && sizes[0].updateScratchSize > bottom_scratch_size)
+		bottom_scratch_size = sizes[0].updateScratchSize;
 	VkBufferCreateInfo scratch_infos[] = {
 		{
 			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-			.size = sizes[0].buildScratchSize,
+			.size = bottom_scratch_size,
 			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 		},
 		{
@@ -301,31 +507,17 @@ int create_acceleration_structure(acceleration_structure_t* structure, const dev
 			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 		},
 	};
-	buffers_t scratch;
-	if (create_aligned_buffers(&scratch, device, scratch_infos, 2, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT, device->acceleration_structure_properties.minAccelerationStructureScratchOffsetAlignment)) {
+	if (create_aligned_buffers(&build.scratch, device, scratch_infos, 2, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT, device->acceleration_structure_properties.minAccelerationStructureScratchOffsetAlignment)) {
 		printf("Failed to allocate scratch memory for building acceleration structures.\n");
-		destroy_buffers(&staging, device);
+		destroy_acceleration_structure_build(&build, device);
 		destroy_acceleration_structure(structure, device);
 		return 1;
 	}
 	
 	// Specify the only instance
-	VkAccelerationStructureDeviceAddressInfoKHR address_request = {
-		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
-		.accelerationStructure = structure->bottom_level,
-	};
-	VkAccelerationStructureInstanceKHR instance = {
-		.transform = { .matrix = {
-				{1.0f, 0.0f, 0.0f, 0.0f},
-				{0.0f, 1.0f, 0.0f, 0.0f},
-				{0.0f, 0.0f, 1.0f, 0.0f},
-			}
-		},
-		.mask = 0xFF,
-		.flags = VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR | VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR,
-		.accelerationStructureReference = pvkGetAccelerationStructureDeviceAddressKHR(device->device, &address_request),
-	};
-	memcpy(staging_data + staging.buffers[1].offset, &instance, sizeof(instance));
+	VkAccelerationStructureInstanceKHR instance = get_acceleration_structure_instance(structure, device);
+	memcpy(instances_data + build.instances.buffers[0].offset, &instance, sizeof(instance));
+	vkUnmapMemory(device->device, build.instances.memory);
 
 	// Get ready to record commands
 	VkCommandBufferAllocateInfo cmd_info = {
@@ -333,34 +525,32 @@ int create_acceleration_structure(acceleration_structure_t* structure, const dev
 		.commandPool = device->command_pool,
 		.commandBufferCount =  1
 	};
-	VkCommandBuffer cmd;
-	if (vkAllocateCommandBuffers(device->device, &cmd_info, &cmd)) {
+	if (vkAllocateCommandBuffers(device->device, &cmd_info, &build.cmd)) {
 		printf("Failed to allocate a command buffer for building an acceleration structure.\n");
-		destroy_buffers(&scratch, device);
-		destroy_buffers(&staging, device);
+		destroy_acceleration_structure_build(&build, device);
 		destroy_acceleration_structure(structure, device);
 		return 1;
 	}
 	VkCommandBufferBeginInfo begin_info = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	VkCommandBuffer cmd = build.cmd;
 	if (vkBeginCommandBuffer(cmd, &begin_info)) {
 		printf("Failed to begin command buffer recording for building acceleration structures.\n");
-		vkFreeCommandBuffers(device->device, device->command_pool, 1, &cmd);
-		destroy_buffers(&scratch, device);
-		destroy_buffers(&staging, device);
+		destroy_acceleration_structure_build(&build, device);
 		destroy_acceleration_structure(structure, device);
 		return 1;
 	}
+	// Dequantize positions into the vertex buffer
+	record_position_dequantization(cmd, &build, mesh);
 	// Build bottom- and top-level acceleration structures in this order
 	VkAccelerationStructureBuildRangeInfoKHR build_ranges[] = {
-		{ .primitiveCount = (uint32_t) mesh->triangle_count },
-		{ .primitiveCount = 1 },
+		{ .primitiveCount = primitive_counts[0] },
+		{ .primitiveCount = primitive_counts[1] },
 	};
 	for (uint32_t i = 0; i != 2; ++i) {
-		const char* level_name = (i == 0) ? "bottom" : "top";
-		VkAccelerationStructureBuildGeometryInfoKHR build_info = (i == 0) ? bottom_build_info : top_build_info;
+		VkAccelerationStructureBuildGeometryInfoKHR build_info = build_infos[i];
 		VkBufferDeviceAddressInfo scratch_adress_info = {
 			.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-			.buffer = scratch.buffers[i].buffer
+			.buffer = build.scratch.buffers[i].buffer
 		};
 		build_info.scratchData.deviceAddress = vkGetBufferDeviceAddress(device->device, &scratch_adress_info);
 		build_info.dstAccelerationStructure = structure->levels[i];
@@ -376,37 +566,714 @@ int create_acceleration_structure(acceleration_structure_t* structure, const dev
 				VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0,
 				1, &after_build_barrier, 0, NULL, 0, NULL);
 	}
-	// Submit the command buffer
-	VkSubmitInfo cmd_submit = {
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.commandBufferCount = 1, .pCommandBuffers = &cmd
+	// Submit the command buffer and clean up once the build is finished
+	if (vkEndCommandBuffer(cmd) || submit_command_buffer(device, cmd)) {
+		printf("Failed to submit and complete the command buffer for building acceleration structures.\n");
+		destroy_acceleration_structure_build(&build, device);
+		destroy_acceleration_structure(structure, device);
+		return 1;
+	}
+	// Updatable structures hold on to everything but the command buffer
+	if (updatable) {
+		vkFreeCommandBuffers(device->device, device->command_pool, 1, &build.cmd);
+		build.cmd = NULL;
+		structure->build = build;
+	}
+	else
+		destroy_acceleration_structure_build(&build, device);
+	return 0;
+}
+
+
+void record_acceleration_structure_update(VkCommandBuffer cmd, acceleration_structure_t* structure, const device_t* device, const mesh_t* mesh,
+	VkBool32 refit_bottom_level, uint32_t full_rebuild_interval)
+{
+	VK_LOAD(vkCmdBuildAccelerationStructuresKHR)
+	const acceleration_structure_build_t* build = &structure->build;
+	// Wait for ray queries and builds of previous frames to finish reading
+	// inputs and acceleration structures
+	VkMemoryBarrier before_update_barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
 	};
-	if (vkEndCommandBuffer(cmd) || vkQueueSubmit(device->queue, 1, &cmd_submit, NULL)) {
-		printf("Failed to end and submit the command buffer for building acceleration structures.\n");
-		vkFreeCommandBuffers(device->device, device->command_pool, 1, &cmd);
-		destroy_buffers(&scratch, device);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0,
+		1, &before_update_barrier, 0, NULL, 0, NULL);
+	// Write the instance with the current transform
+	VkAccelerationStructureInstanceKHR instance = get_acceleration_structure_instance(structure, device);
+	vkCmdUpdateBuffer(cmd, build->instances.buffers[0].buffer, 0, sizeof(instance), &instance);
+	VkMemoryBarrier after_instance_barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR,
+	};
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0,
+		1, &after_instance_barrier, 0, NULL, 0, NULL);
+	VkAccelerationStructureGeometryKHR geometries[2];
+	VkAccelerationStructureBuildGeometryInfoKHR build_infos[2];
+	get_acceleration_structure_build_infos(geometries, build_infos, structure, build, device);
+	VkAccelerationStructureBuildRangeInfoKHR build_ranges[] = {
+		{ .primitiveCount = structure->primitive_count },
+		{ .primitiveCount = 1 },
+	};
+	// Refit the bottom level in place or rebuild it once refits have
+	// degraded it enough
+	if (refit_bottom_level) {
+		record_position_dequantization(cmd, build, mesh);
+		if (structure->refit_count < full_rebuild_interval) {
+			build_infos[0].mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+			build_infos[0].srcAccelerationStructure = structure->bottom_level;
+			++structure->refit_count;
+		}
+		else
+			structure->refit_count = 0;
+	}
+	// Build the bottom level if it changes, then the top level
+	for (uint32_t i = refit_bottom_level ? 0 : 1; i != 2; ++i) {
+		VkBufferDeviceAddressInfo scratch_adress_info = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+			.buffer = build->scratch.buffers[i].buffer
+		};
+		build_infos[i].scratchData.deviceAddress = vkGetBufferDeviceAddress(device->device, &scratch_adress_info);
+		build_infos[i].dstAccelerationStructure = structure->levels[i];
+		const VkAccelerationStructureBuildRangeInfoKHR* build_range = &build_ranges[i];
+		pvkCmdBuildAccelerationStructuresKHR(cmd, 1, &build_infos[i], &build_range);
+		VkMemoryBarrier after_build_barrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+			.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR,
+		};
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			(i == 0) ? VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			1, &after_build_barrier, 0, NULL, 0, NULL);
+	}
+}
+
+
+/*! Fills the given device-local buffers with data read from the given file
+	one after the other. The data is streamed through a single host-visible
+	staging buffer of size MESH_STAGING_BUFFER_SIZE (or less), which gets
+	reused for each piece, so the amount of host-visible memory does not
+	depend on the size of the data.
+	\param buffers buffer_count buffers, which have to be usable as transfer
+		destination.
+	\param offsets, sizes NULL to fill the whole buffers or buffer_count
+		offsets and sizes in bytes of the ranges that are to be filled.
+	\param sources NULL or buffer_count pointers. Where a pointer is not
+		NULL, the data for the corresponding buffer is copied from there
+		instead of being read from the file.
+	\return 0 on success.*/
+int upload_buffers_from_file(const device_t* device, FILE* file, uint32_t buffer_count, const buffer_t* buffers,
+	const VkDeviceSize* offsets, const VkDeviceSize* sizes, const void* const* sources)
+{
+	// Create the staging buffer
+	VkDeviceSize staging_size = 0;
+	for (uint32_t i = 0; i != buffer_count; ++i) {
+		VkDeviceSize size = sizes ? sizes[i] : buffers[i].size;
+		staging_size = (size > staging_size) ? size : staging_size;
+	}
+	if (staging_size == 0)
+		return 0;
+	if (staging_size > MESH_STAGING_BUFFER_SIZE)
+		staging_size = MESH_STAGING_BUFFER_SIZE;
+	VkBufferCreateInfo staging_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = staging_size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+	};
+	buffers_t staging;
+	char* staging_data;
+	if (create_buffers(&staging, device, &staging_info, 1, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		|| vkMapMemory(device->device, staging.memory, 0, staging.size, 0, (void**) &staging_data))
+	{
+		printf("Failed to allocate and map a staging buffer of %llu bytes for mesh data.\n", staging_size);
 		destroy_buffers(&staging, device);
-		destroy_acceleration_structure(structure, device);
 		return 1;
 	}
-	// Clean up once the build is finished
-	VkResult result;
-	if (result = vkQueueWaitIdle(device->queue)) {
-		printf("Failed to wait for the construction of the acceleration structure to finish. Error code %d.\n", result);
-		vkFreeCommandBuffers(device->device, device->command_pool, 1, &cmd);
-		destroy_buffers(&scratch, device);
+	// Read the binary data piece by piece. The file has it exactly in the
+	// format in which it goes onto the GPU.
+	for (uint32_t i = 0; i != buffer_count; ++i) {
+		VkDeviceSize range_offset = offsets ? offsets[i] : 0;
+		VkDeviceSize range_size = sizes ? sizes[i] : buffers[i].size;
+		for (VkDeviceSize offset = 0; offset < range_size; offset += staging_size) {
+			VkDeviceSize size = range_size - offset;
+			if (size > staging_size)
+				size = staging_size;
+			if (sources && sources[i])
+				memcpy(staging_data, ((const char*) sources[i]) + offset, size);
+			else if (fread(staging_data, size, 1, file) != 1) {
+				printf("The mesh data in the scene file ends prematurely.\n");
+				vkUnmapMemory(device->device, staging.memory);
+				destroy_buffers(&staging, device);
+				return 1;
+			}
+			VkBufferCopy region = { .dstOffset = range_offset + offset, .size = size };
+			if (copy_buffers(device, 1, &staging.buffers[0].buffer, &buffers[i].buffer, &region)) {
+				printf("Failed to copy %llu bytes of mesh data from a staging buffer to the device.\n", size);
+				vkUnmapMemory(device->device, staging.memory);
+				destroy_buffers(&staging, device);
+				return 1;
+			}
+		}
+	}
+	vkUnmapMemory(device->device, staging.memory);
+	destroy_buffers(&staging, device);
+	return 0;
+}
+
+
+/*! Fills the buffers of the given device-local mesh with data read from the
+	given file and writes the screen-filling triangle.
+	\param mesh A mesh created by create_mesh() with staging set to 0.
+	\param file A file whose cursor is at the start of the mesh data.
+	\param lod Pass 0 to fill the regular triangles and the screen-filling
+		triangle or 1 to fill the triangles for levels of detail.
+	\return 0 on success.*/
+int upload_mesh_from_file(mesh_t* mesh, const device_t* device, FILE* file, VkBool32 lod) {
+	int8_t triangle_vertices[3][2] = { {-1, -1}, {3, -1}, {-1, 3} };
+	const void* sources[mesh_buffer_count_full];
+	memset(sources, 0, sizeof(sources));
+	sources[mesh_buffer_type_triangle] = triangle_vertices;
+	// Regular triangles come first, triangles for levels of detail follow
+	VkDeviceSize triangle_sizes[mesh_buffer_count] = { sizeof(uint32_t) * 2 * 3, sizeof(uint16_t) * 4 * 3, sizeof(uint8_t) };
+	VkDeviceSize offsets[mesh_buffer_count_full], sizes[mesh_buffer_count_full];
+	for (uint32_t i = 0; i != mesh_buffer_count; ++i) {
+		offsets[i] = lod ? (triangle_sizes[i] * mesh->triangle_count) : 0;
+		sizes[i] = triangle_sizes[i] * (lod ? mesh->lod_triangle_count : mesh->triangle_count);
+	}
+	offsets[mesh_buffer_type_triangle] = 0;
+	sizes[mesh_buffer_type_triangle] = mesh->triangle.size;
+	uint32_t buffer_count = lod ? mesh_buffer_count : mesh_buffer_count_full;
+	return upload_buffers_from_file(device, file, buffer_count, mesh->buffers, offsets, sizes, sources);
+}
+
+
+/*! Once compressed geometry has been loaded and the acceleration structure has
+	been built, the shaders decode meshlets and nothing reads the uncompressed
+	triangles anymore. This function recreates the uncompressed buffers with
+	room for a single triangle, which keeps their views valid for descriptor
+	sets, and writes the screen-filling triangle again.
+	\return 0 on success.*/
+int release_uncompressed_triangles(mesh_t* mesh, const device_t* device) {
+	VkDeviceSize released_size = mesh->size;
+	for (uint32_t i = 0; i != mesh_buffer_count_full; ++i) {
+		if (mesh->buffers[i].buffer) vkDestroyBuffer(device->device, mesh->buffers[i].buffer, NULL);
+		if (mesh->buffer_views[i]) vkDestroyBufferView(device->device, mesh->buffer_views[i], NULL);
+	}
+	if (mesh->memory) vkFreeMemory(device->device, mesh->memory, NULL);
+	memset(mesh->buffers, 0, sizeof(mesh->buffers));
+	memset(mesh->buffer_views, 0, sizeof(mesh->buffer_views));
+	mesh->memory = NULL;
+	// create_mesh() sizes buffers by the triangle count
+	uint64_t triangle_count = mesh->triangle_count;
+	uint64_t lod_triangle_count = mesh->lod_triangle_count;
+	mesh->triangle_count = 1;
+	mesh->lod_triangle_count = 0;
+	int8_t triangle_vertices[3][2] = { {-1, -1}, {3, -1}, {-1, 3} };
+	const void* sources[] = { triangle_vertices };
+	int result = create_mesh(mesh, device, VK_FALSE)
+		|| upload_buffers_from_file(device, NULL, 1, &mesh->buffers[mesh_buffer_type_triangle], NULL, NULL, sources);
+	mesh->triangle_count = triangle_count;
+	mesh->lod_triangle_count = lod_triangle_count;
+	if (result) {
+		printf("Failed to recreate mesh buffers without uncompressed triangles.\n");
+		return 1;
+	}
+	printf("Released %.1f MiB of uncompressed geometry in favor of compressed geometry.\n", (double) (released_size - mesh->size) / (1024.0 * 1024.0));
+	return 0;
+}
+
+
+/*! Creates mesh->meshlets and fills it with compressed geometry read from the
+	given file.
+	\param vertex_count, position_word_count The counts from the file header.
+	\param file A file whose cursor is at the start of the meshlets.
+	\return 0 on success.*/
+int load_meshlets(mesh_t* mesh, const device_t* device, FILE* file, uint64_t vertex_count, uint64_t position_word_count) {
+	VkBufferCreateInfo buffer_infos[meshlet_buffer_count];
+	memset(buffer_infos, 0, sizeof(buffer_infos));
+	buffer_infos[meshlet_buffer_type_meshlets].size = sizeof(uint32_t) * 4 * ((mesh->triangle_count + MESHLET_TRIANGLE_COUNT - 1) / MESHLET_TRIANGLE_COUNT);
+	buffer_infos[meshlet_buffer_type_positions].size = sizeof(uint32_t) * position_word_count;
+	buffer_infos[meshlet_buffer_type_attributes].size = sizeof(uint16_t) * 4 * vertex_count;
+	buffer_infos[meshlet_buffer_type_triangles].size = sizeof(uint32_t) * mesh->triangle_count;
+	VkDeviceSize total_size = 0;
+	for (uint32_t i = 0; i != meshlet_buffer_count; ++i) {
+		buffer_infos[i].sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_infos[i].usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		total_size += buffer_infos[i].size;
+		if (buffer_infos[i].size > device->physical_device_properties.limits.maxStorageBufferRange) {
+			printf("Buffer %u of the compressed geometry takes %llu bytes but storage buffers are limited to %u bytes.\n",
+				i, buffer_infos[i].size, device->physical_device_properties.limits.maxStorageBufferRange);
+			return 1;
+		}
+	}
+	if (create_buffers(&mesh->meshlets, device, buffer_infos, meshlet_buffer_count, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+		printf("Failed to allocate buffers for compressed geometry.\n");
+		return 1;
+	}
+	if (upload_buffers_from_file(device, file, meshlet_buffer_count, mesh->meshlets.buffers, NULL, NULL, NULL)) {
+		destroy_buffers(&mesh->meshlets, device);
+		return 1;
+	}
+	uint64_t uncompressed_size = sizeof(uint32_t) * 2 * 3 + sizeof(uint16_t) * 4 * 3 + sizeof(uint8_t);
+	printf("Compressed geometry: %.2f bytes per triangle (%.3f vertices per triangle), uncompressed: %llu bytes per triangle.\n",
+		(double) total_size / (double) mesh->triangle_count, (double) vertex_count / (double) mesh->triangle_count, uncompressed_size);
+	return 0;
+}
+
+
+//! Advances the cursor of the given file by the given number of bytes, which
+//! may exceed the range of long
+//! \return 0 on success.
+int skip_file_bytes(FILE* file, uint64_t size) {
+	while (size > 0) {
+		long step = (size < 0x40000000) ? ((long) size) : 0x40000000;
+		if (fseek(file, step, SEEK_CUR))
+			return 1;
+		size -= (uint64_t) step;
+	}
+	return 0;
+}
+
+
+int read_streamed_triangles(geometry_stream_t* stream, uint64_t first_triangle, uint64_t triangle_count, void* const destinations[mesh_buffer_count]) {
+	const uint64_t triangle_sizes[mesh_buffer_count] = { sizeof(uint32_t) * 2 * 3, sizeof(uint16_t) * 4 * 3, sizeof(uint8_t) };
+	if (triangle_count == 0)
+		return 0;
+	// Triangles for levels of detail follow the regular triangles
+	uint32_t lod = (first_triangle >= stream->triangle_count) ? 1 : 0;
+	uint64_t section_triangle = first_triangle - (lod ? stream->triangle_count : 0);
+	for (uint32_t i = 0; i != mesh_buffer_count; ++i) {
+		if (fseek(stream->file, 0, SEEK_SET)
+			|| skip_file_bytes(stream->file, stream->section_offsets[lod][i] + triangle_sizes[i] * section_triangle)
+			|| fread(destinations[i], triangle_sizes[i] * triangle_count, 1, stream->file) != 1)
+		{
+			printf("Failed to read %llu triangles of a streamed scene from its file.\n", triangle_count);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*! Partitions the mesh of the given scene into chunks of
+	CULLING_CHUNK_TRIANGLE_COUNT triangles and computes their bounding boxes
+	from the quantized positions in the scene file.
+	\param positions_offset The offset in bytes from the start of the file to
+		the quantized positions.
+	\return 0 on success.*/
+int create_fixed_size_chunks(scene_t* scene, const char* file_path, uint64_t positions_offset) {
+	FILE* file = fopen(file_path, "rb");
+	if (!file || skip_file_bytes(file, positions_offset)) {
+		if (file) fclose(file);
+		printf("Failed to open the scene file at path %s to compute bounding boxes of chunks.\n", file_path);
+		return 1;
+	}
+	const mesh_t* mesh = &scene->mesh;
+	uint64_t chunk_count = (mesh->triangle_count + CULLING_CHUNK_TRIANGLE_COUNT - 1) / CULLING_CHUNK_TRIANGLE_COUNT;
+	mesh_chunk_t* chunks = malloc(sizeof(mesh_chunk_t) * chunk_count);
+	uint32_t* positions = malloc(sizeof(uint32_t) * 2 * 3 * CULLING_CHUNK_TRIANGLE_COUNT);
+	for (uint64_t i = 0; i != chunk_count; ++i) {
+		mesh_chunk_t* chunk = &chunks[i];
+		chunk->first_triangle = i * CULLING_CHUNK_TRIANGLE_COUNT;
+		chunk->triangle_count = mesh->triangle_count - chunk->first_triangle;
+		if (chunk->triangle_count > CULLING_CHUNK_TRIANGLE_COUNT)
+			chunk->triangle_count = CULLING_CHUNK_TRIANGLE_COUNT;
+		size_t vertex_count = (size_t) (3 * chunk->triangle_count);
+		if (fread(positions, sizeof(uint32_t) * 2, vertex_count, file) != vertex_count) {
+			printf("Failed to read positions from the scene file at path %s to compute bounding boxes of chunks.\n", file_path);
+			free(positions);
+			free(chunks);
+			fclose(file);
+			return 1;
+		}
+		// Find the bounding box of quantized positions, then dequantize it
+		uint32_t box_min[3] = { 0x1FFFFF, 0x1FFFFF, 0x1FFFFF }, box_max[3] = { 0, 0, 0 };
+		for (size_t j = 0; j != vertex_count; ++j) {
+			uint32_t low = positions[2 * j + 0], high = positions[2 * j + 1];
+			uint32_t position[3] = {
+				low & 0x1FFFFF,
+				(low >> 21) | ((high & 0x3FF) << 11),
+				(high >> 10) & 0x1FFFFF,
+			};
+			for (uint32_t k = 0; k != 3; ++k) {
+				box_min[k] = (box_min[k] < position[k]) ? box_min[k] : position[k];
+				box_max[k] = (box_max[k] > position[k]) ? box_max[k] : position[k];
+			}
+		}
+		for (uint32_t k = 0; k != 3; ++k) {
+			chunk->box_min[k] = mesh->dequantization_factor[k] * (float) box_min[k] + mesh->dequantization_summand[k];
+			chunk->box_max[k] = mesh->dequantization_factor[k] * (float) box_max[k] + mesh->dequantization_summand[k];
+		}
+	}
+	free(positions);
+	fclose(file);
+	scene->chunk_count = chunk_count;
+	scene->chunks = chunks;
+	return 0;
+}
+
+
+/*! Sets up scene->stream for a scene whose chunks and levels of detail have
+	been loaded already, whereas its mesh has not been created yet. It creates
+	the mesh buffers with room for proxies and slots and uploads the proxies.
+	Afterwards, scene->lod_level_count is 0 because the levels of detail are
+	not on the device.
+	\param section_offsets Offsets of mesh data in the scene file, as stored
+		in geometry_stream_t.section_offsets.
+	\param pool_size The maximal size in bytes for all slots together.
+	\return 0 on success.*/
+int create_geometry_stream(scene_t* scene, const device_t* device, const char* file_path, uint64_t section_offsets[2][mesh_buffer_count], VkDeviceSize pool_size) {
+	geometry_stream_t* stream = &scene->stream;
+	mesh_t* mesh = &scene->mesh;
+	stream->file = fopen(file_path, "rb");
+	if (!stream->file) {
+		printf("Failed to open the scene file at %s for streaming.\n", file_path);
+		return 1;
+	}
+	memcpy(stream->section_offsets, section_offsets, sizeof(stream->section_offsets));
+	stream->triangle_count = mesh->triangle_count;
+	// The coarsest level of detail of each chunk serves as its proxy. Proxies
+	// and slots start at page boundaries.
+	stream->chunks = malloc(sizeof(streamed_chunk_t) * scene->chunk_count);
+	memset(stream->chunks, 0, sizeof(streamed_chunk_t) * scene->chunk_count);
+	uint64_t max_chunk_triangle_count = 0;
+	for (uint64_t i = 0; i != scene->chunk_count; ++i) {
+		const mesh_chunk_lod_t* proxy = &scene->chunk_lods[(i + 1) * scene->lod_level_count - 1];
+		streamed_chunk_t* chunk = &stream->chunks[i];
+		chunk->proxy_first_triangle = stream->proxy_triangle_count;
+		chunk->proxy_triangle_count = proxy->triangle_count;
+		chunk->proxy_error = proxy->error;
+		chunk->slot_index = UINT32_MAX;
+		stream->proxy_triangle_count += (proxy->triangle_count + STREAM_PAGE_TRIANGLE_COUNT - 1) / STREAM_PAGE_TRIANGLE_COUNT * STREAM_PAGE_TRIANGLE_COUNT;
+		if (max_chunk_triangle_count < scene->chunks[i].triangle_count)
+			max_chunk_triangle_count = scene->chunks[i].triangle_count;
+	}
+	stream->slot_triangle_count = (max_chunk_triangle_count + STREAM_PAGE_TRIANGLE_COUNT - 1) / STREAM_PAGE_TRIANGLE_COUNT * STREAM_PAGE_TRIANGLE_COUNT;
+	const uint64_t triangle_sizes[mesh_buffer_count] = { sizeof(uint32_t) * 2 * 3, sizeof(uint16_t) * 4 * 3, sizeof(uint8_t) };
+	uint64_t triangle_size = triangle_sizes[0] + triangle_sizes[1] + triangle_sizes[2];
+	uint64_t slot_count = pool_size / (triangle_size * stream->slot_triangle_count);
+	slot_count = (slot_count < scene->chunk_count) ? slot_count : scene->chunk_count;
+	if (slot_count == 0) {
+		printf("A geometry pool of %llu bytes cannot hold a single chunk with %llu triangles.\n", pool_size, max_chunk_triangle_count);
+		return 1;
+	}
+	stream->slot_count = (uint32_t) slot_count;
+	stream->slot_chunks = malloc(sizeof(uint32_t) * stream->slot_count);
+	memset(stream->slot_chunks, 0xFF, sizeof(uint32_t) * stream->slot_count);
+	uint64_t proxy_page_count = stream->proxy_triangle_count / STREAM_PAGE_TRIANGLE_COUNT;
+	stream->proxy_page_chunks = malloc(sizeof(uint32_t) * proxy_page_count);
+	for (uint64_t i = 0; i != scene->chunk_count; ++i) {
+		const streamed_chunk_t* chunk = &stream->chunks[i];
+		uint64_t page_end = (chunk->proxy_first_triangle + chunk->proxy_triangle_count + STREAM_PAGE_TRIANGLE_COUNT - 1) / STREAM_PAGE_TRIANGLE_COUNT;
+		for (uint64_t j = chunk->proxy_first_triangle / STREAM_PAGE_TRIANGLE_COUNT; j != page_end; ++j)
+			stream->proxy_page_chunks[j] = (uint32_t) i;
+	}
+	// Create the mesh buffers for proxies and slots
+	mesh->triangle_count = stream->proxy_triangle_count + stream->slot_count * stream->slot_triangle_count;
+	mesh->lod_triangle_count = 0;
+	if (create_mesh(mesh, device, VK_FALSE)) {
+		printf("Failed to create mesh buffers for %llu triangles of proxies and slots for streaming.\n", mesh->triangle_count);
+		return 1;
+	}
+	// Gather all proxies in host memory, padding with zeros
+	void* proxies[mesh_buffer_count];
+	for (uint32_t i = 0; i != mesh_buffer_count; ++i) {
+		proxies[i] = malloc(triangle_sizes[i] * stream->proxy_triangle_count);
+		memset(proxies[i], 0, triangle_sizes[i] * stream->proxy_triangle_count);
+	}
+	int result = 0;
+	for (uint64_t i = 0; i != scene->chunk_count && !result; ++i) {
+		const mesh_chunk_lod_t* proxy = &scene->chunk_lods[(i + 1) * scene->lod_level_count - 1];
+		void* destinations[mesh_buffer_count];
+		for (uint32_t j = 0; j != mesh_buffer_count; ++j)
+			destinations[j] = ((char*) proxies[j]) + triangle_sizes[j] * stream->chunks[i].proxy_first_triangle;
+		result = read_streamed_triangles(stream, proxy->first_triangle, proxy->triangle_count, destinations);
+	}
+	// Upload them along with the screen-filling triangle
+	int8_t triangle_vertices[3][2] = { {-1, -1}, {3, -1}, {-1, 3} };
+	const void* sources[mesh_buffer_count_full] = { proxies[0], proxies[1], proxies[2], triangle_vertices };
+	VkDeviceSize offsets[mesh_buffer_count_full] = { 0, 0, 0, 0 };
+	VkDeviceSize sizes[mesh_buffer_count_full];
+	for (uint32_t i = 0; i != mesh_buffer_count; ++i)
+		sizes[i] = triangle_sizes[i] * stream->proxy_triangle_count;
+	sizes[mesh_buffer_type_triangle] = mesh->triangle.size;
+	result = result || upload_buffers_from_file(device, NULL, mesh_buffer_count_full, mesh->buffers, offsets, sizes, sources);
+	for (uint32_t i = 0; i != mesh_buffer_count; ++i)
+		free(proxies[i]);
+	if (result) {
+		printf("Failed to upload proxies for streaming.\n");
+		return 1;
+	}
+	// The device does not have the other levels of detail
+	free(scene->chunk_lods);
+	scene->chunk_lods = NULL;
+	scene->lod_level_count = 0;
+	printf("Geometry streaming: %llu chunks, %u slots for %llu triangles each (%.1f MiB), proxies with %llu triangles\n",
+		scene->chunk_count, stream->slot_count, stream->slot_triangle_count,
+		(double) (stream->slot_count * stream->slot_triangle_count * triangle_size) / (1024.0 * 1024.0), stream->proxy_triangle_count);
+	return 0;
+}
+
+
+/*! Creates mesh->triangle_records and fills it on the device using a compute
+	shader that gathers all attributes of each triangle from the other buffers
+	of the mesh.
+	\param mesh A device-local mesh, which has been filled with data already.
+	\return 0 on success.*/
+int create_triangle_records(mesh_t* mesh, const device_t* device) {
+	VkBufferCreateInfo records_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = MESH_TRIANGLE_RECORD_SIZE * (mesh->triangle_count + mesh->lod_triangle_count),
+		.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+	};
+	// Triangles for levels of detail get records, too
+	uint32_t triangle_count = (uint32_t) (mesh->triangle_count + mesh->lod_triangle_count);
+	if (records_info.size > device->physical_device_properties.limits.maxStorageBufferRange) {
+		printf("Per-triangle records for %u triangles would take %llu bytes but storage buffers are limited to %u bytes.\n",
+			triangle_count, records_info.size, device->physical_device_properties.limits.maxStorageBufferRange);
+		return 1;
+	}
+	if (create_buffers(&mesh->triangle_records, device, &records_info, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+		printf("Failed to allocate a buffer for per-triangle records of a mesh with %u triangles.\n", triangle_count);
+		return 1;
+	}
+	// Create the pipeline
+	VkSpecializationMapEntry map_entry = { .constantID = 0, .offset = 0, .size = sizeof(uint32_t) };
+	VkSpecializationInfo specialization_info = {
+		.mapEntryCount = 1, .pMapEntries = &map_entry,
+		.dataSize = sizeof(triangle_count), .pData = &triangle_count,
+	};
+	shader_t shader;
+	pipeline_with_bindings_t pipeline;
+	memset(&shader, 0, sizeof(shader));
+	memset(&pipeline, 0, sizeof(pipeline));
+	VkCommandBuffer cmd = NULL;
+	VkCommandBufferAllocateInfo cmd_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = device->command_pool,
+		.commandBufferCount = 1
+	};
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+	int result = create_mesh_compute_pipeline(&pipeline, &shader, device, "src/shaders/interleave_mesh_attributes.comp.glsl",
+		mesh_buffer_count, mesh->buffer_views, mesh->triangle_records.buffers[0].buffer, &specialization_info);
+	if (!result) {
+		if (vkAllocateCommandBuffers(device->device, &cmd_info, &cmd) || vkBeginCommandBuffer(cmd, &begin_info)) {
+			printf("Failed to allocate and begin a command buffer to create per-triangle records.\n");
+			result = 1;
+		}
+	}
+	if (!result) {
+		// Like for dequantization, the dispatch is capped at the guaranteed
+		// maximal group count and threads loop over triangles
+		uint32_t group_count = (triangle_count + 63) / 64;
+		if (group_count > 0xFFFF) group_count = 0xFFFF;
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline_layout, 0, 1, pipeline.descriptor_sets, 0, NULL);
+		vkCmdDispatch(cmd, group_count, 1, 1);
+		if (vkEndCommandBuffer(cmd) || submit_command_buffer(device, cmd)) {
+			printf("Failed to submit and complete the command buffer that creates per-triangle records.\n");
+			result = 1;
+		}
+	}
+	if (cmd) vkFreeCommandBuffers(device->device, device->command_pool, 1, &cmd);
+	destroy_pipeline_with_bindings(&pipeline, device);
+	destroy_shader(&shader, device);
+	if (result)
+		destroy_buffers(&mesh->triangle_records, device);
+	return result;
+}
+
+
+/*! Creates materials->texture_slots and fills it with the given slots.
+	\return 0 on success.*/
+int create_material_texture_slots(materials_t* materials, const device_t* device, const texture_array_slot_t* slots, uint32_t texture_count) {
+	VkBufferCreateInfo staging_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = sizeof(texture_array_slot_t) * ((texture_count > 0) ? texture_count : 1),
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+	};
+	VkBufferCreateInfo slots_info = staging_info;
+	slots_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	buffers_t staging;
+	char* staging_data;
+	if (create_buffers(&staging, device, &staging_info, 1, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		|| vkMapMemory(device->device, staging.memory, 0, staging.size, 0, (void**) &staging_data))
+	{
 		destroy_buffers(&staging, device);
-		destroy_acceleration_structure(structure, device);
 		return 1;
 	}
-	vkFreeCommandBuffers(device->device, device->command_pool, 1, &cmd);
-	destroy_buffers(&scratch, device);
+	memcpy(staging_data, slots, sizeof(texture_array_slot_t) * texture_count);
+	vkUnmapMemory(device->device, staging.memory);
+	VkBufferCopy region = { .size = staging_info.size };
+	int result = create_buffers(&materials->texture_slots, device, &slots_info, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		|| copy_buffers(device, 1, &staging.buffers[0].buffer, &materials->texture_slots.buffers[0].buffer, &region);
 	destroy_buffers(&staging, device);
+	return result;
+}
+
+
+//! Replaces the image of the given streamed texture by one that holds the
+//! mipmaps from first_mipmap on
+int set_first_resident_mipmap(texture_stream_t* stream, const device_t* device, uint32_t texture_index, uint32_t first_mipmap) {
+	streamed_texture_t* texture = &stream->textures[texture_index];
+	images_t image;
+	if (load_2d_texture_mipmaps(&image, device, stream->file_paths[texture_index], first_mipmap, VK_IMAGE_USAGE_SAMPLED_BIT)) {
+		printf("Failed to load mipmaps from %u on for the texture at path %s.\n", first_mipmap, stream->file_paths[texture_index]);
+		return 1;
+	}
+	if (texture->image.image_count > 0) {
+		stream->resident_size -= texture->image.images[0].memory_size;
+		destroy_images(&texture->image, device);
+	}
+	texture->image = image;
+	texture->first_resident_mipmap = first_mipmap;
+	stream->resident_size += image.images[0].memory_size;
 	return 0;
 }
 
 
-int load_scene(scene_t* scene, const device_t* device, const char* file_path, const char* texture_path, VkBool32 request_acceleration_structure) {
+/*! Sets up materials->stream and loads the coarse mipmaps of all textures,
+	each into its own image.
+	\param file_paths texture_count paths to texture files. The texture
+		stream takes ownership of the array and the strings in any case.
+	\param slots Overwritten with the location of each texture.
+	\param pool_size The budget for all images together in bytes.
+	\return 0 on success.*/
+int create_texture_stream(materials_t* materials, const device_t* device, char** file_paths, uint32_t texture_count, texture_array_slot_t* slots, VkDeviceSize pool_size) {
+	texture_stream_t* stream = &materials->stream;
+	stream->texture_count = texture_count;
+	stream->file_paths = file_paths;
+	stream->budget = pool_size;
+	stream->textures = malloc(sizeof(streamed_texture_t) * texture_count);
+	memset(stream->textures, 0, sizeof(streamed_texture_t) * texture_count);
+	for (uint32_t i = 0; i != texture_count; ++i) {
+		streamed_texture_t* texture = &stream->textures[i];
+		VkExtent2D resolution;
+		if (get_2d_texture_info(&texture->mipmap_count, &resolution, file_paths[i]))
+			return 1;
+		uint32_t max_side = (resolution.width > resolution.height) ? resolution.width : resolution.height;
+		while ((1u << texture->log2_resolution) < max_side)
+			++texture->log2_resolution;
+		// Load only mipmaps that are small enough
+		uint32_t first_mipmap = (texture->log2_resolution > STREAMED_TEXTURE_MIN_LOG2_RESOLUTION) ? (texture->log2_resolution - STREAMED_TEXTURE_MIN_LOG2_RESOLUTION) : 0;
+		if (first_mipmap > texture->mipmap_count - 1)
+			first_mipmap = texture->mipmap_count - 1;
+		texture->max_first_mipmap = texture->requested_mipmap = first_mipmap;
+		if (set_first_resident_mipmap(stream, device, i, first_mipmap))
+			return 1;
+		slots[i].array_index = i;
+		slots[i].layer = 0;
+	}
+	printf("Streaming %u textures. Coarse mipmaps occupy %.2f MiB of device memory with a budget of %.2f MiB.\n",
+		texture_count, stream->resident_size / 1048576.0, stream->budget / 1048576.0);
+	return 0;
+}
+
+
+//! \return The finest mipmap that should be resident for the given texture
+//!		according to feedback
+uint32_t get_wanted_first_mipmap(const texture_stream_t* stream, const streamed_texture_t* texture) {
+	if (stream->frame_index - texture->last_requested_frame > STREAMED_TEXTURE_KEEP_FRAME_COUNT)
+		return texture->max_first_mipmap;
+	return texture->requested_mipmap;
+}
+
+
+//! \return An estimate of the memory size that the given texture would
+//!		occupy with mipmaps from first_mipmap on. Each finer mipmap roughly
+//!		quadruples the size.
+VkDeviceSize estimate_streamed_texture_size(const streamed_texture_t* texture, uint32_t first_mipmap) {
+	VkDeviceSize current_size = texture->image.images[0].memory_size;
+	if (first_mipmap < texture->first_resident_mipmap)
+		return current_size << (2 * (texture->first_resident_mipmap - first_mipmap));
+	else
+		return current_size >> (2 * (first_mipmap - texture->first_resident_mipmap));
+}
+
+
+int update_texture_stream(materials_t* materials, const device_t* device, const uint32_t* feedback, VkBool32* changed) {
+	texture_stream_t* stream = &materials->stream;
+	(*changed) = VK_FALSE;
+	++stream->frame_index;
+	// Turn feedback for materials into requests for their textures
+	for (uint32_t i = 0; i != stream->texture_count && feedback; ++i) {
+		uint32_t level = feedback[i / material_texture_count];
+		if (level == UINT32_MAX)
+			continue;
+		streamed_texture_t* texture = &stream->textures[i];
+		int32_t mipmap = (int32_t) level + (int32_t) texture->log2_resolution - TEXTURE_FEEDBACK_LOG2_RESOLUTION;
+		if (mipmap < 0)
+			mipmap = 0;
+		texture->requested_mipmap = ((uint32_t) mipmap < texture->max_first_mipmap) ? (uint32_t) mipmap : texture->max_first_mipmap;
+		texture->last_requested_frame = stream->frame_index;
+	}
+	// Estimate how much memory dropping unwanted mipmaps would free
+	VkDeviceSize freeable_size = 0;
+	for (uint32_t i = 0; i != stream->texture_count; ++i) {
+		const streamed_texture_t* texture = &stream->textures[i];
+		uint32_t wanted = get_wanted_first_mipmap(stream, texture);
+		if (texture->first_resident_mipmap < wanted)
+			freeable_size += texture->image.images[0].memory_size - estimate_streamed_texture_size(texture, wanted);
+	}
+	// Find the texture that lacks the most mipmaps among those that can get
+	// at least one more. Otherwise, a texture that does not fit would block
+	// smaller ones forever.
+	uint32_t target_index = UINT32_MAX;
+	uint32_t max_missing_count = 0;
+	for (uint32_t i = 0; i != stream->texture_count; ++i) {
+		const streamed_texture_t* texture = &stream->textures[i];
+		uint32_t wanted = get_wanted_first_mipmap(stream, texture);
+		if (texture->first_resident_mipmap <= wanted || texture->first_resident_mipmap - wanted <= max_missing_count)
+			continue;
+		VkDeviceSize grown_size = estimate_streamed_texture_size(texture, texture->first_resident_mipmap - 1);
+		if (stream->resident_size - texture->image.images[0].memory_size + grown_size <= stream->budget + freeable_size) {
+			max_missing_count = texture->first_resident_mipmap - wanted;
+			target_index = i;
+		}
+	}
+	// If nothing can grow, nothing gets reloaded
+	if (target_index == UINT32_MAX)
+		return 0;
+	// Make room by dropping mipmaps that are not wanted anymore, starting
+	// with textures that have not been requested for the longest time. If
+	// that is not enough, the target gets fewer mipmaps.
+	streamed_texture_t* target = &stream->textures[target_index];
+	uint32_t first_mipmap = get_wanted_first_mipmap(stream, target);
+	while (first_mipmap < target->first_resident_mipmap) {
+		VkDeviceSize current_size = target->image.images[0].memory_size;
+		VkDeviceSize required_size = estimate_streamed_texture_size(target, first_mipmap);
+		if (stream->resident_size - current_size + required_size <= stream->budget)
+			break;
+		uint32_t victim_index = UINT32_MAX;
+		for (uint32_t i = 0; i != stream->texture_count; ++i) {
+			const streamed_texture_t* texture = &stream->textures[i];
+			if (i != target_index && texture->first_resident_mipmap < get_wanted_first_mipmap(stream, texture)
+				&& (victim_index == UINT32_MAX || texture->last_requested_frame < stream->textures[victim_index].last_requested_frame))
+				victim_index = i;
+		}
+		if (victim_index == UINT32_MAX)
+			++first_mipmap;
+		else {
+			if (set_first_resident_mipmap(stream, device, victim_index, get_wanted_first_mipmap(stream, &stream->textures[victim_index])))
+				return 1;
+			(*changed) = VK_TRUE;
+		}
+	}
+	if (first_mipmap < target->first_resident_mipmap) {
+		if (set_first_resident_mipmap(stream, device, target_index, first_mipmap))
+			return 1;
+		(*changed) = VK_TRUE;
+	}
+	return 0;
+}
+
+
+int load_scene(scene_t* scene, const device_t* device, const char* file_path, const char* texture_path, VkBool32 request_acceleration_structure, VkBool32 update_acceleration_structure, VkBool32 pack_textures, VkBool32 interleave_attributes, VkBool32 compress_geometry, VkDeviceSize geometry_pool_size, VkDeviceSize texture_pool_size) {
 	// Clear the output object
 	memset(scene, 0, sizeof(*scene));
 	// Open the source file
@@ -420,7 +1287,7 @@ int load_scene(scene_t* scene, const device_t* device, const char* file_path, co
 	uint32_t file_marker, version;
 	fread(&file_marker, sizeof(file_marker), 1, file);
 	fread(&version, sizeof(version), 1, file);
-	if (file_marker != 0xabcabc || version != 1) {
+	if (file_marker != 0xabcabc || version < 1 || version > 4) {
 		printf("The scene file at path %s is invalid or unsupported. The format marker is 0x%x, the version is %d.\n", file_path, file_marker, version);
 		fclose(file);
 		destroy_scene(scene, device);
@@ -428,6 +1295,19 @@ int load_scene(scene_t* scene, const device_t* device, const char* file_path, co
 	}
 	fread(&scene->materials.material_count, sizeof(uint64_t), 1, file);
 	fread(&scene->mesh.triangle_count, sizeof(uint64_t), 1, file);
+	// Version 2 adds a section with chunks at the end, version 3 adds
+	// compressed geometry after that and version 4 levels of detail
+	uint64_t meshlet_vertex_count = 0, meshlet_position_word_count = 0, lod_level_count = 0;
+	if (version >= 2)
+		fread(&scene->chunk_count, sizeof(uint64_t), 1, file);
+	if (version >= 3) {
+		fread(&meshlet_vertex_count, sizeof(uint64_t), 1, file);
+		fread(&meshlet_position_word_count, sizeof(uint64_t), 1, file);
+	}
+	if (version >= 4) {
+		fread(&lod_level_count, sizeof(uint64_t), 1, file);
+		fread(&scene->mesh.lod_triangle_count, sizeof(uint64_t), 1, file);
+	}
 	fread(scene->mesh.dequantization_factor, sizeof(float), 3, file);
 	fread(scene->mesh.dequantization_summand, sizeof(float), 3, file);
 	printf("Triangle count: %llu\n", scene->mesh.triangle_count);
@@ -439,6 +1319,7 @@ int load_scene(scene_t* scene, const device_t* device, const char* file_path, co
 		return 1;
 	}
 	// Read material names
+	uint64_t header_size = 2 * sizeof(uint32_t) + (2 + ((version >= 2) ? 1 : 0) + ((version >= 3) ? 2 : 0) + ((version >= 4) ? 2 : 0)) * sizeof(uint64_t) + 6 * sizeof(float);
 	scene->materials.material_names = malloc(sizeof(char*) * scene->materials.material_count);
 	memset(scene->materials.material_names, 0, sizeof(char*) * scene->materials.material_count);
 	for (uint64_t i = 0; i != scene->materials.material_count; ++i) {
@@ -446,76 +1327,140 @@ int load_scene(scene_t* scene, const device_t* device, const char* file_path, co
 		fread(&name_length, sizeof(name_length), 1, file);
 		scene->materials.material_names[i] = malloc(sizeof(char) * (name_length + 1));
 		fread(scene->materials.material_names[i], sizeof(char), name_length + 1, file);
+		header_size += sizeof(uint64_t) + name_length + 1;
 	}
+	// Streaming needs chunks with levels of detail to have proxies
+	VkBool32 stream = geometry_pool_size > 0 && scene->chunk_count > 0 && lod_level_count > 0;
+	if (geometry_pool_size > 0 && !stream)
+		printf("The scene file at path %s does not provide chunks with levels of detail, which are needed for streaming. Use tools/vks_opt with -lod_levels to add them. Loading the whole mesh instead.\n", file_path);
+	if (stream && (compress_geometry || interleave_attributes || (request_acceleration_structure && device->ray_tracing_supported)))
+		printf("Compressed geometry, per-triangle records and ray tracing are unavailable for streamed scenes.\n");
+	const uint64_t triangle_sizes[mesh_buffer_count] = { sizeof(uint32_t) * 2 * 3, sizeof(uint16_t) * 4 * 3, sizeof(uint8_t) };
+	uint64_t triangle_size = triangle_sizes[0] + triangle_sizes[1] + triangle_sizes[2];
 
-	// Allocate staging buffers for the mesh
-	mesh_t empty_mesh = scene->mesh;
-	if (create_mesh(&scene->mesh, device, VK_TRUE)) {
-		printf("Failed to create staging buffers and allocate memory for meshes of the scene file at path %s. It has %llu triangles.\n",
+	// Streamed meshes are created once the chunks are known
+	if (stream && skip_file_bytes(file, triangle_size * scene->mesh.triangle_count)) {
+		printf("Failed to skip mesh data of the scene file at path %s.\n", file_path);
+		fclose(file);
+		destroy_scene(scene, device);
+		return 1;
+	}
+	// Allocate device local mesh buffers
+	if (!stream && create_mesh(&scene->mesh, device, VK_FALSE)) {
+		printf("Failed to create device buffers and allocate memory for meshes of the scene file at path %s. It has %llu triangles.\n",
 			file_path, scene->mesh.triangle_count);
 		fclose(file);
 		destroy_scene(scene, device);
 		return 1;
 	}
-	// Map memory for the staging buffers
-	char* staging_data;
-	if (vkMapMemory(device->device, scene->mesh.memory, 0, scene->mesh.size, 0, (void**) &staging_data)) {
-		printf("Failed to map memory of the staging buffer for meshes of the scene file at path %s.\n", file_path);
+	// Stream the mesh data to the device
+	if (!stream && upload_mesh_from_file(&scene->mesh, device, file, VK_FALSE)) {
+		printf("Failed to upload mesh data of the scene file at path %s to the device. It has %llu triangles.\n",
+			file_path, scene->mesh.triangle_count);
 		fclose(file);
 		destroy_scene(scene, device);
 		return 1;
 	}
-	// Read the binary mesh data. The file has it exactly in the format in
-	// which it goes onto the GPU.
-	for (uint32_t i = 0; i != mesh_buffer_count; ++i)
-		fread(staging_data + scene->mesh.buffers[i].offset, scene->mesh.buffers[i].size, 1, file);
-	// Write the screen-filling triangle
-	int8_t triangle_vertices[3][2] = { {-1, -1}, {3, -1}, {-1, 3} };
-	memcpy(staging_data + scene->mesh.triangle.offset, triangle_vertices, sizeof(triangle_vertices));
+	// Read the chunks and validate that they cover the mesh
+	uint64_t chunk_triangle_count = 0;
+	if (scene->chunk_count > 0 && scene->chunk_count <= scene->mesh.triangle_count) {
+		scene->chunks = malloc(sizeof(mesh_chunk_t) * scene->chunk_count);
+		fread(scene->chunks, sizeof(mesh_chunk_t), scene->chunk_count, file);
+		for (uint64_t i = 0; i != scene->chunk_count; ++i)
+			if (scene->chunks[i].first_triangle == chunk_triangle_count)
+				chunk_triangle_count += scene->chunks[i].triangle_count;
+	}
+	// Load compressed geometry on request, otherwise skip it
+	uint64_t meshlet_count = (meshlet_vertex_count > 0) ? ((scene->mesh.triangle_count + MESHLET_TRIANGLE_COUNT - 1) / MESHLET_TRIANGLE_COUNT) : 0;
+	uint64_t meshlet_size = (meshlet_count > 0) ? (sizeof(uint32_t) * (4 * meshlet_count + meshlet_position_word_count + scene->mesh.triangle_count) + sizeof(uint16_t) * 4 * meshlet_vertex_count) : 0;
+	if (meshlet_vertex_count > 0 && compress_geometry && !stream) {
+		if (load_meshlets(&scene->mesh, device, file, meshlet_vertex_count, meshlet_position_word_count)) {
+			printf("Failed to load compressed geometry from the scene file at path %s.\n", file_path);
+			fclose(file);
+			destroy_scene(scene, device);
+			return 1;
+		}
+	}
+	else if (meshlet_vertex_count > 0)
+		skip_file_bytes(file, meshlet_size);
+	else if (compress_geometry && !stream)
+		printf("The scene file at path %s does not provide compressed geometry. Use tools/vks_opt with -meshlets 1 to add it.\n", file_path);
+	// Read levels of detail and validate that they refer to existing
+	// triangles
+	if (lod_level_count > 0 && scene->chunks) {
+		uint64_t lod_count = scene->chunk_count * lod_level_count;
+		scene->lod_level_count = (uint32_t) lod_level_count;
+		scene->chunk_lods = malloc(sizeof(mesh_chunk_lod_t) * lod_count);
+		fread(scene->chunk_lods, sizeof(mesh_chunk_lod_t), lod_count, file);
+		uint64_t total_triangle_count = scene->mesh.triangle_count + scene->mesh.lod_triangle_count;
+		VkBool32 valid = VK_TRUE;
+		for (uint64_t i = 0; i != lod_count; ++i)
+			valid &= (scene->chunk_lods[i].first_triangle + scene->chunk_lods[i].triangle_count <= total_triangle_count);
+		// Triangles of streamed scenes are read on demand
+		if (!valid || (stream && skip_file_bytes(file, triangle_size * scene->mesh.lod_triangle_count))
+			|| (!stream && upload_mesh_from_file(&scene->mesh, device, file, VK_TRUE)))
+		{
+			printf("Failed to load levels of detail from the scene file at path %s.\n", file_path);
+			fclose(file);
+			destroy_scene(scene, device);
+			return 1;
+		}
+		printf("Levels of detail: %u per chunk with %llu triangles in total\n", scene->lod_level_count, scene->mesh.lod_triangle_count);
+	}
 	// If everything went well, we have reached an end-of-file marker
 	uint32_t eof_marker = 0;
 	fread(&eof_marker, sizeof(eof_marker), 1, file);
 	fclose(file);
+	if (scene->chunk_count > 0 && chunk_triangle_count != scene->mesh.triangle_count) {
+		printf("The chunks in the scene file at path %s do not partition the mesh.\n", file_path);
+		destroy_scene(scene, device);
+		return 1;
+	}
 	if (eof_marker != 0xE0FE0F) {
 		printf("The scene file at path %s seems to be invalid. The geometry data is not followed by the expected end of file marker.\n", file_path);
 		destroy_scene(scene, device);
 		return 1;
 	}
-	// Create an acceleration structure now that the mesh data is available
-	if (request_acceleration_structure && device->ray_tracing_supported) {
-		if (create_acceleration_structure(&scene->acceleration_structure, device, &scene->mesh, staging_data)) {
-			printf("Failed to construct an acceleration structure for the scene file at path %s.\n", file_path);
+	// Without chunks from the file, we make our own for culling
+	if (scene->chunk_count == 0 && create_fixed_size_chunks(scene, file_path, header_size)) {
+		destroy_scene(scene, device);
+		return 1;
+	}
+	// Prepare streaming now that chunks and levels of detail are known
+	if (stream) {
+		uint64_t section_offsets[2][mesh_buffer_count];
+		section_offsets[0][0] = header_size;
+		section_offsets[1][0] = header_size + triangle_size * scene->mesh.triangle_count + sizeof(mesh_chunk_t) * scene->chunk_count
+			+ meshlet_size + sizeof(mesh_chunk_lod_t) * scene->chunk_count * lod_level_count;
+		for (uint32_t i = 1; i != mesh_buffer_count; ++i) {
+			section_offsets[0][i] = section_offsets[0][i - 1] + triangle_sizes[i - 1] * scene->mesh.triangle_count;
+			section_offsets[1][i] = section_offsets[1][i - 1] + triangle_sizes[i - 1] * scene->mesh.lod_triangle_count;
+		}
+		if (create_geometry_stream(scene, device, file_path, section_offsets, geometry_pool_size)) {
+			printf("Failed to prepare streaming for the scene file at path %s.\n", file_path);
 			destroy_scene(scene, device);
 			return 1;
 		}
 	}
-	// Unmap staging memory
-	vkUnmapMemory(device->device, scene->mesh.memory);
-	// Allocate device local mesh buffers
-	mesh_t staging_mesh = scene->mesh;
-	scene->mesh = empty_mesh;
-	if (create_mesh(&scene->mesh, device, VK_FALSE)) {
-		printf("Failed to create device buffers and allocate memory for meshes of the scene file at path %s. It has %llu triangles.\n",
-			file_path, scene->mesh.triangle_count);
-		destroy_mesh(&staging_mesh, device);
+	// Gather attributes into per-triangle records on request
+	if (interleave_attributes && !stream && create_triangle_records(&scene->mesh, device)) {
+		printf("Failed to create per-triangle records for the scene file at path %s.\n", file_path);
 		destroy_scene(scene, device);
 		return 1;
 	}
-	// Perform the mesh copy
-	VkBuffer staging_mesh_buffers[COUNT_OF(staging_mesh.buffers)];
-	VkBuffer mesh_buffers[COUNT_OF(staging_mesh.buffers)];
-	VkBufferCopy buffer_regions[mesh_buffer_count_full];
-	memset(buffer_regions, 0, sizeof(buffer_regions));
-	for (uint32_t i = 0; i != mesh_buffer_count_full; ++i) {
-		staging_mesh_buffers[i] = staging_mesh.buffers[i].buffer;
-		mesh_buffers[i] = scene->mesh.buffers[i].buffer;
-		buffer_regions[i].size = staging_mesh.buffers[i].size;
+	// Create an acceleration structure now that the mesh data is on the device
+	if (request_acceleration_structure && device->ray_tracing_supported && !stream) {
+		if (create_acceleration_structure(&scene->acceleration_structure, device, &scene->mesh, update_acceleration_structure)) {
+			printf("Failed to construct an acceleration structure for the scene file at path %s.\n", file_path);
+			destroy_scene(scene, device);
+			return 1;
+		}
 	}
-	int result = copy_buffers(device, mesh_buffer_count_full, staging_mesh_buffers, mesh_buffers, buffer_regions);
-	destroy_mesh(&staging_mesh, device);
-	if (result) {
-		printf("Failed to copy mesh and texture data of the scene file at path %s from staging buffers to the device. It has %llu triangles.\n",
-			file_path, scene->mesh.triangle_count);
+	// Updates of the acceleration structure dequantize uncompressed positions
+	// each time, otherwise compressed geometry makes them obsolete
+	if (scene->mesh.meshlets.buffer_count > 0 && !(update_acceleration_structure && scene->acceleration_structure.top_level)
+		&& release_uncompressed_triangles(&scene->mesh, device))
+	{
 		destroy_scene(scene, device);
 		return 1;
 	}
@@ -524,6 +1469,7 @@ int load_scene(scene_t* scene, const device_t* device, const char* file_path, co
 	uint32_t texture_count = (uint32_t) (scene->materials.material_count * material_texture_count);
 	char** texture_file_paths = malloc(sizeof(char*) * texture_count);
 	memset(texture_file_paths, 0, sizeof(char*) * texture_count);
+	VkFormat* texture_formats = malloc(sizeof(VkFormat) * texture_count);
 	for (uint32_t i = 0; i != scene->materials.material_count; ++i) {
 		for (uint32_t j = 0; j != material_texture_count; ++j) {
 			const char* path_pieces[] = {
@@ -531,27 +1477,34 @@ int load_scene(scene_t* scene, const device_t* device, const char* file_path, co
 				get_material_texture_suffix((material_texture_type_t) j), ".vkt"
 			};
 			texture_file_paths[i * material_texture_count + j] = concatenate_strings(COUNT_OF(path_pieces), path_pieces);
+			texture_formats[i * material_texture_count + j] = get_material_texture_format((material_texture_type_t) j);
 		}
 	}
-	result = load_2d_textures(&scene->materials.textures, device, texture_count, (const char* const*) texture_file_paths, VK_IMAGE_USAGE_SAMPLED_BIT);
-	for (uint32_t i = 0; i != texture_count; ++i)
-		free(texture_file_paths[i]);
+	// Textures provided as common image files are converted on first use
+	if (update_2d_texture_caches(texture_count, (const char* const*) texture_file_paths, texture_formats))
+		printf("Some textures for the scene file at path %s could not be converted. Previously converted textures will be used if available.\n", file_path);
+	free(texture_formats);
+	texture_array_slot_t* slots = malloc(sizeof(texture_array_slot_t) * texture_count);
+	int result;
+	if (texture_pool_size > 0)
+		result = create_texture_stream(&scene->materials, device, texture_file_paths, texture_count, slots, texture_pool_size);
+	else {
+		result = load_2d_texture_arrays(&scene->materials.textures, slots, device, texture_count, (const char* const*) texture_file_paths, VK_IMAGE_USAGE_SAMPLED_BIT, pack_textures);
+		for (uint32_t i = 0; i != texture_count; ++i)
+			free(texture_file_paths[i]);
+		free(texture_file_paths);
+	}
 	if (result) {
 		printf("Failed to load material textures for the scene file at path %s using texture path %s.\n", file_path, texture_path);
+		free(slots);
 		destroy_scene(scene, device);
 		return 1;
 	}
-
-	// Create a sampler for material textures
-	VkSamplerCreateInfo sampler_info = {
-		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-		.magFilter = VK_FILTER_LINEAR, .minFilter = VK_FILTER_LINEAR,
-		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-		.anisotropyEnable = VK_TRUE, .maxAnisotropy = 16,
-		.minLod = 0.0f, .maxLod = 3.4e38f
-	};
-	if (vkCreateSampler(device->device, &sampler_info, NULL, &scene->materials.sampler)) {
-		printf("Failed to create a sampler for materials of the scene %s.\n", file_path);
+	// Put the location of each texture into a buffer
+	result = create_material_texture_slots(&scene->materials, device, slots, texture_count);
+	free(slots);
+	if (result) {
+		printf("Failed to create a buffer with locations of material textures for the scene file at path %s.\n", file_path);
 		destroy_scene(scene, device);
 		return 1;
 	}
@@ -563,27 +1516,24 @@ void destroy_scene(scene_t* scene, const device_t* device) {
 	destroy_mesh(&scene->mesh, device);
 	destroy_materials(&scene->materials, device);
 	destroy_acceleration_structure(&scene->acceleration_structure, device);
+	free(scene->chunks);
+	free(scene->chunk_lods);
+	if (scene->stream.file) fclose(scene->stream.file);
+	free(scene->stream.chunks);
+	free(scene->stream.slot_chunks);
+	free(scene->stream.proxy_page_chunks);
+	memset(scene, 0, sizeof(*scene));
 }
 
 
-void get_materials_descriptor_layout(VkDescriptorSetLayoutBinding* layout_binding, uint32_t binding_index, const materials_t* materials) {
-	uint32_t texture_count = (uint32_t) materials->material_count * material_texture_count;
-	VkDescriptorSetLayoutBinding binding = {
-		.binding = binding_index,
-		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT,
-		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-		.descriptorCount = texture_count
-	};
-	(*layout_binding) = binding;
-}
-
-VkDescriptorImageInfo* get_materials_descriptor_infos(uint32_t* texture_count, const materials_t* materials) {
-	(*texture_count) = (uint32_t) materials->material_count * material_texture_count;
+VkDescriptorImageInfo* get_materials_descriptor_infos(uint32_t* texture_count, const materials_t* materials, VkSampler sampler) {
+	const texture_stream_t* stream = &materials->stream;
+	(*texture_count) = (stream->texture_count > 0) ? stream->texture_count : materials->textures.image_count;
 	VkDescriptorImageInfo* texture_infos = malloc(sizeof(VkDescriptorImageInfo) * *texture_count);
 	for (uint32_t i = 0; i != *texture_count; ++i) {
 		texture_infos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		texture_infos[i].imageView = materials->textures.images[i].view;
-		texture_infos[i].sampler = materials->sampler;
+		texture_infos[i].imageView = (stream->texture_count > 0) ? stream->textures[i].image.images[0].view : materials->textures.images[i].view;
+		texture_infos[i].sampler = sampler;
 	}
 	return texture_infos;
 }
@@ -40,6 +40,28 @@ typedef enum mesh_buffer_type_e {
 } mesh_buffer_type_t;
 
 
+//! The buffers in mesh_t.meshlets, which hold compressed geometry
+typedef enum meshlet_buffer_type_e {
+	/*! Four uint32_t per meshlet: The index of its first vertex, the index of
+		its first word in the positions (27 bits) together with the bit count
+		per coordinate (5 most significant bits) and the minimum of its
+		quantized positions packed like in mesh_t.positions.*/
+	meshlet_buffer_type_meshlets,
+	/*! A bit stream for each meshlet, which holds x, y, z of each vertex
+		relative to the minimum of the meshlet. It is lossless and the bit
+		count per coordinate is at least 10 and at most 21.*/
+	meshlet_buffer_type_positions,
+	//! A normal vector and texture coordinate per vertex, encoded like in
+	//! mesh_t.normals_and_tex_coords
+	meshlet_buffer_type_attributes,
+	//! One uint32_t per triangle with three 8-bit vertex indices relative to
+	//! the meshlet and the 8-bit material index in the most significant bits
+	meshlet_buffer_type_triangles,
+	//! The number of buffers used for compressed geometry
+	meshlet_buffer_count
+} meshlet_buffer_type_t;
+
+
 /*! Holds Vulkan objects representing the geometry of a scene. It is a simple
 	triangle mesh without index buffer and a material assignment per triangle.
 	It has normals and texture coordinates. Thanks to unions, you can easily
@@ -47,6 +69,11 @@ typedef enum mesh_buffer_type_e {
 typedef struct mesh_s {
 	//! The number of triangles in this mesh
 	uint64_t triangle_count;
+	/*! The number of additional triangles for simplified levels of detail
+		(see scene_t.chunk_lods). The buffers below hold them after the
+		triangle_count regular triangles. Acceleration structures and
+		compressed geometry only use the regular triangles.*/
+	uint64_t lod_triangle_count;
 	/*! Positions are quantized in 21 bits per coordinate. To turn these 21-bit
 		unsigned integers into world-space coordinates, multiply by this factor
 		and add the summand component-wise.*/
@@ -94,8 +121,127 @@ typedef struct mesh_s {
 	VkDeviceMemory memory;
 	//! The size in bytes of the allocated memory
 	VkDeviceSize size;
+	/*! Optional (see create_triangle_records()), otherwise empty. A single
+		device-local storage buffer with one record of
+		MESH_TRIANGLE_RECORD_SIZE bytes per triangle. It interleaves all data
+		that the shading pass needs for a triangle, such that it can be loaded
+		from a single cache line:
+		- Three times two uints for the quantized positions,
+		- Three times two uints holding the normal and texture coordinate
+		  (i.e. the entries of normals_and_tex_coords packed in pairs of
+		  16-bit UNORMs),
+		- One uint for the material index followed by three uints padding.*/
+	buffers_t triangle_records;
+	/*! Optional (see load_scene()), otherwise empty. Compressed geometry with
+		meshlet_buffer_count device-local storage buffers as described by
+		meshlet_buffer_type_t. Each meshlet consists of MESHLET_TRIANGLE_COUNT
+		consecutive triangles (fewer for the last one) and has its own
+		vertices, which triangles index. Decoding it yields exactly the
+		same data as the other buffers. Unless the acceleration structure
+		gets updated, the other buffers shrink to a single triangle once it
+		has been built (see release_uncompressed_triangles()).*/
+	buffers_t meshlets;
 } mesh_t;
 
+//! The size in bytes of an entry of mesh_t.triangle_records
+#define MESH_TRIANGLE_RECORD_SIZE 64
+//! The number of triangles per meshlet in mesh_t.meshlets
+#define MESHLET_TRIANGLE_COUNT 64
+
+
+/*! A contiguous range of triangles in a mesh along with a world space
+	bounding box for all of them. Scene files of version 2 (as written by
+	tools/vks_opt) partition the mesh into spatially compact chunks. For other
+	scene files, load_scene() creates chunks of CULLING_CHUNK_TRIANGLE_COUNT
+	triangles, which are compact thanks to the sorted triangle order.*/
+typedef struct mesh_chunk_s {
+	//! The index of the first triangle and the number of triangles
+	uint64_t first_triangle, triangle_count;
+	//! The bounding box of all vertex positions of the triangles
+	float box_min[3], box_max[3];
+} mesh_chunk_t;
+
+//! The number of triangles per chunk when load_scene() partitions a mesh,
+//! for which the scene file does not provide chunks
+#define CULLING_CHUNK_TRIANGLE_COUNT 4096
+
+
+/*! A simplified version of a chunk as produced by tools/vks_opt. Vertices on
+	the boundary of the chunk are kept, so neighboring chunks can use
+	different levels without cracks.*/
+typedef struct mesh_chunk_lod_s {
+	//! The index of the first triangle in the mesh (usually at least
+	//! mesh_t.triangle_count) and the number of triangles
+	uint64_t first_triangle, triangle_count;
+	//! An estimate of the world space distance between the simplified and the
+	//! original surface
+	float error;
+	//! Unused
+	uint32_t padding;
+} mesh_chunk_lod_t;
+
+
+//! The number of consecutive triangles that share one entry of visibility
+//! feedback for geometry streaming (see geometry_stream_t)
+#define STREAM_PAGE_TRIANGLE_COUNT 64
+
+
+//! The state of a single chunk of a geometry_stream_t
+typedef struct streamed_chunk_s {
+	//! The range of triangles in the mesh buffers holding the proxy of this
+	//! chunk, i.e. its coarsest level of detail
+	uint64_t proxy_first_triangle, proxy_triangle_count;
+	//! The error of the proxy (see mesh_chunk_lod_t.error)
+	float proxy_error;
+	//! The index of the slot holding this chunk at full resolution or
+	//! UINT32_MAX if it is not resident
+	uint32_t slot_index;
+	//! The value of geometry_stream_t.frame_index when this chunk was last
+	//! found to be needed at full resolution
+	uint32_t last_needed_frame;
+	//! Whether the most recently recorded frame used the proxy because its
+	//! error was small enough, no matter whether the chunk is resident
+	VkBool32 proxy_sufficient;
+} streamed_chunk_t;
+
+
+/*! Bookkeeping for scenes whose mesh is streamed in chunks (see load_scene()).
+	In this case, mesh_t does not hold the whole mesh. Its buffers start with
+	the proxy of each chunk, which is always resident. These are followed by
+	slot_count slots of slot_triangle_count triangles each, which hold chunks
+	at full resolution on demand. Proxies and slots start at multiples of
+	STREAM_PAGE_TRIANGLE_COUNT triangles.*/
+typedef struct geometry_stream_s {
+	//! The scene file, which remains open to read chunks on demand. NULL if
+	//! the scene is not streamed.
+	FILE* file;
+	/*! Offsets in bytes of the sections with positions, normals and texture
+		coordinates, and material indices in the file. The first set of
+		offsets is for regular triangles, the second for triangles of levels
+		of detail.*/
+	uint64_t section_offsets[2][mesh_buffer_count];
+	//! The number of regular triangles in the file (not in mesh_t)
+	uint64_t triangle_count;
+	//! The number of triangles at the start of the mesh buffers that are used
+	//! for proxies (including padding)
+	uint64_t proxy_triangle_count;
+	//! The number of triangles per slot. It is enough for the largest chunk.
+	uint64_t slot_triangle_count;
+	//! The number of slots for chunks at full resolution
+	uint32_t slot_count;
+	//! The number of chunks that are currently resident
+	uint32_t resident_count;
+	//! The state of each chunk (scene_t.chunk_count entries)
+	streamed_chunk_t* chunks;
+	//! The index of the chunk in each slot or UINT32_MAX for empty slots
+	uint32_t* slot_chunks;
+	//! For each page in the first proxy_triangle_count triangles, the index
+	//! of the chunk whose proxy it holds
+	uint32_t* proxy_page_chunks;
+	//! Incremented once per frame by the code that drives streaming
+	uint32_t frame_index;
+} geometry_stream_t;
+
 
 /*! Each material is defined by a fixed number of textures. These textures, and
 	their meanings are specified by this enum.*/
@@ -116,6 +262,65 @@ typedef enum material_texture_type_e {
 } material_texture_type_t;
 
 
+//! Feedback for texture streaming refers to mipmaps of a hypothetical texture
+//! with 2^TEXTURE_FEEDBACK_LOG2_RESOLUTION texels along each side
+#define TEXTURE_FEEDBACK_LOG2_RESOLUTION 15
+
+//! Streamed textures always keep mipmaps with at most
+//! 2^STREAMED_TEXTURE_MIN_LOG2_RESOLUTION texels along each side resident
+#define STREAMED_TEXTURE_MIN_LOG2_RESOLUTION 7
+
+//! When a streamed texture has not been requested for this many frames, it
+//! may lose all of its optional mipmaps
+#define STREAMED_TEXTURE_KEEP_FRAME_COUNT 60
+
+
+//! The state of a single texture of a texture_stream_t
+typedef struct streamed_texture_s {
+	//! Holds a single image with the mipmaps of the file from
+	//! first_resident_mipmap on
+	images_t image;
+	//! The number of mipmaps in the texture file
+	uint32_t mipmap_count;
+	//! The base-2 logarithm of the larger side of the finest mipmap in the
+	//! file, rounded up
+	uint32_t log2_resolution;
+	//! The index of the finest mipmap that is resident
+	uint32_t first_resident_mipmap;
+	//! The coarsest value that first_resident_mipmap ever takes
+	uint32_t max_first_mipmap;
+	//! The finest mipmap that was requested by the most recent feedback that
+	//! covered this texture
+	uint32_t requested_mipmap;
+	//! The value of texture_stream_t.frame_index when this texture was last
+	//! covered by feedback
+	uint32_t last_requested_frame;
+} streamed_texture_t;
+
+
+/*! Bookkeeping for material textures whose finer mipmaps are loaded on demand
+	(see load_scene()). Each texture has its own image with the resident
+	mipmaps only. Thus, the minimal level of detail is clamped implicitly and
+	shaders do not need to know about residency.*/
+typedef struct texture_stream_s {
+	//! The number of streamed textures. 0 if all mipmaps of all material
+	//! textures are resident.
+	uint32_t texture_count;
+	//! The state of each texture, in the same order as in
+	//! materials_t.texture_slots
+	streamed_texture_t* textures;
+	//! The path of the file for each texture
+	char** file_paths;
+	//! The maximal size in bytes of all images that is targeted. Mipmaps that
+	//! are always resident may exceed it.
+	VkDeviceSize budget;
+	//! The size in bytes of all images together
+	VkDeviceSize resident_size;
+	//! Incremented once per update_texture_stream()
+	uint32_t frame_index;
+} texture_stream_t;
+
+
 /*! A list of materials to be used in a scene. The material model is fairly, 
 	simplistic characterizing each material by a fixed set of textures. This
 	object handles the corresponding images and descriptors.*/
@@ -125,15 +330,37 @@ typedef struct materials_s {
 	//! An array of material_count null-terminated strings providing the name
 	//! for each material
 	char** material_names;
-	/*! material_texture_count * material_count textures characterizing all
-		materials. The textures for material i start at index 
+	/*! Images with views of type VK_IMAGE_VIEW_TYPE_2D_ARRAY holding the
+		material_texture_count * material_count textures that characterize all
+		materials. Depending on how the scene was loaded, there is one image
+		per texture or textures of equal format and size share an image.*/
+	images_t textures;
+	/*! A device-local storage buffer with one texture_array_slot_t per
+		texture. The textures for material i start at index
 		i * material_texture_count and are indexed by material_texture_t
 		entries.*/
-	images_t textures;
-	//! A sampler used for all material textures
-	VkSampler sampler;
+	buffers_t texture_slots;
+	//! If material textures are streamed, this object holds the images and
+	//! textures is empty
+	texture_stream_t stream;
 } materials_t;
 
+//! Objects that are needed while acceleration structures are built.
+//! Acceleration structures that can be updated keep them.
+typedef struct acceleration_structure_build_s {
+	//! A device-local buffer with dequantized positions (three floats per
+	//! vertex) and a host-visible buffer with the only instance
+	buffers_t vertices, instances;
+	//! Scratch memory for the bottom- and top-level build. For updatable
+	//! acceleration structures, the former is also large enough for refits.
+	buffers_t scratch;
+	//! The compute shader and pipeline that dequantize positions
+	shader_t dequantization_shader;
+	pipeline_with_bindings_t dequantization;
+	//! The command buffer used for dequantization and the initial build
+	VkCommandBuffer cmd;
+} acceleration_structure_build_t;
+
 /*! Combines a single bottom level acceleration structure with a single top
 	level acceleration structure holding only one instance of this bottom level
 	acceleration structure.*/
@@ -151,6 +378,21 @@ typedef struct acceleration_structure_s {
 	};
 	//! The buffers that hold the bottom and top-level acceleration structures
 	buffers_t buffers;
+	/*! VK_TRUE iff the bottom level has been built with
+		VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR and build holds
+		everything that record_acceleration_structure_update() needs. Otherwise
+		build is empty.*/
+	VkBool32 updatable;
+	//! The number of triangles in the bottom level
+	uint32_t primitive_count;
+	//! The transform of the only instance. Changes take effect with the next
+	//! update of the top level.
+	VkTransformMatrixKHR transform;
+	//! The number of times that the bottom level has been refit since it has
+	//! been built from scratch
+	uint32_t refit_count;
+	//! Buffers, pipelines and scratch memory for updates
+	acceleration_structure_build_t build;
 } acceleration_structure_t;
 
 /*! A static scene that is ready to be rendered. It includes geometry and
@@ -163,6 +405,21 @@ typedef struct scene_s {
 	//! Acceleration structures for ray tracing in this scene or a bunch of
 	//! NULL handles if no acceleration structure was requested
 	acceleration_structure_t acceleration_structure;
+	//! The number of chunks that partition the mesh and an array of them.
+	//! They come from the scene file or are created with fixed size.
+	uint64_t chunk_count;
+	mesh_chunk_t* chunks;
+	/*! The number of simplified levels of detail per chunk (excluding the
+		original) and an array of chunk_count * lod_level_count of them,
+		ordered by chunk and then from fine to coarse. 0 and NULL if the scene
+		file does not provide them.*/
+	uint32_t lod_level_count;
+	mesh_chunk_lod_t* chunk_lods;
+	//! The streaming state if the mesh is streamed, otherwise the file is
+	//! NULL. Streamed scenes have no levels of detail apart from the proxies
+	//! and no acceleration structure, compressed geometry or per-triangle
+	//! records.
+	geometry_stream_t stream;
 } scene_t;
 
 
@@ -170,33 +427,91 @@ typedef struct scene_s {
 	the given type.*/
 const char* get_material_texture_suffix(material_texture_type_t type);
 
+/*! Returns the format that is used for material textures of the given type
+	when they are converted from common image files.*/
+VkFormat get_material_texture_format(material_texture_type_t type);
+
 
 /*! Loads a scene from the file at the given path. The calling side has to
 	clean up using destroy_scene(). Textures are supposed to be in a directory
 	at texture_path. Their names are <material name>_<type suffix>.vkt. Such
-	*.vkt files have to be created beforehand using a Python script. If ray
+	*.vkt files can be created beforehand using tools/texture_conversion.
+	Where an image with the same name but an extension such as .png or .jpg is
+	newer than the *.vkt file, it is converted automatically (see
+	update_2d_texture_caches()). If ray
 	tracing is supported by the given device, an acceleration structure will be
 	created on request. Otherwise, the method succeeds without creating one.
+	If update_acceleration_structure is VK_TRUE as well, it can be updated
+	using record_acceleration_structure_update().
+	If pack_textures is VK_TRUE, material textures of equal format and
+	resolution are packed into texture arrays (see load_2d_texture_arrays()).
+	If interleave_attributes is VK_TRUE, the mesh also gets per-triangle
+	records with all of its attributes (see mesh_t.triangle_records).
+	If compress_geometry is VK_TRUE and the file provides compressed geometry
+	(as written by tools/vks_opt), it is loaded into mesh_t.meshlets.
+	Levels of detail are loaded whenever the file provides them. If the file
+	provides no chunks, the mesh is partitioned into chunks of fixed size for
+	culling.
+	If geometry_pool_size is not 0 and the file provides chunks with levels of
+	detail, the mesh is streamed (see geometry_stream_t) using a pool of at
+	most geometry_pool_size bytes for chunks at full resolution.
+	If texture_pool_size is not 0, material textures are streamed (see
+	texture_stream_t) aiming for at most texture_pool_size bytes of images.
+	Then pack_textures is ignored.
+	\return 0 on success.*/
+int load_scene(scene_t* scene, const device_t* device, const char* file_path, const char* texture_path, VkBool32 request_acceleration_structure, VkBool32 update_acceleration_structure, VkBool32 pack_textures, VkBool32 interleave_attributes, VkBool32 compress_geometry, VkDeviceSize geometry_pool_size, VkDeviceSize texture_pool_size);
+
+/*! Records commands that update the given acceleration structure, which must
+	have been created with updates enabled. The top level is always rebuilt
+	with the current transform of the instance, which is cheap. Optionally,
+	the bottom level is refit to the current positions of the mesh beforehand.
+	Refits degrade the quality of the bounding volume hierarchy, so after
+	full_rebuild_interval refits, the bottom level is rebuilt from scratch.
+	The commands synchronize with previous updates and ray queries in fragment
+	shaders on the same queue and must be recorded outside of a render pass.
+	\param mesh The mesh for which the acceleration structure was created.
+	\param refit_bottom_level VK_TRUE to update the bottom level as well.
+	\param full_rebuild_interval The number of refits after which the bottom
+		level is rebuilt from scratch. 0 rebuilds it each time.*/
+void record_acceleration_structure_update(VkCommandBuffer cmd, acceleration_structure_t* structure, const device_t* device, const mesh_t* mesh,
+	VkBool32 refit_bottom_level, uint32_t full_rebuild_interval);
+
+/*! Reads a range of triangles of a streamed scene from its file.
+	\param first_triangle The index of the first triangle in the concatenation
+		of regular triangles and triangles for levels of detail in the file.
+	\param destinations For each of the mesh_buffer_count buffers of a mesh, a
+		pointer to which the data of the triangles gets written in the format
+		of the mesh buffers.
+	\return 0 on success.*/
+int read_streamed_triangles(geometry_stream_t* stream, uint64_t first_triangle, uint64_t triangle_count, void* const destinations[mesh_buffer_count]);
+
+/*! Adapts which mipmaps of streamed material textures are resident. At most
+	one texture gains finer mipmaps per call. To stay within the budget,
+	other textures may lose mipmaps that have not been requested recently.
+	Textures are loaded synchronously. Since that waits for the queue to
+	become idle, replaced images are destroyed right away.
+	\param feedback NULL or one entry per material. Each entry is the finest
+		mipmap of a texture with 2^TEXTURE_FEEDBACK_LOG2_RESOLUTION texels
+		along each side that was sampled for the material or UINT32_MAX if
+		it was not sampled.
+	\param changed Set to VK_TRUE if any image has been replaced. Then
+		descriptors for material textures have to be written again.
 	\return 0 on success.*/
-int load_scene(scene_t* scene, const device_t* device, const char* file_path, const char* texture_path, VkBool32 request_acceleration_structure);
+int update_texture_stream(materials_t* materials, const device_t* device, const uint32_t* feedback, VkBool32* changed);
 
 //! Frees and nulls the given scene
 void destroy_scene(scene_t* scene, const device_t* device);
 
 
-/*! Writes a layout binding description to the given pointer to describe a
-	binding at the given index for all given material textures. The layout uses
-	the given binding index, the size will be sufficient for creating the given
-	number of descriptor sets.*/
-void get_materials_descriptor_layout(VkDescriptorSetLayoutBinding* layout_binding, uint32_t binding_index, const materials_t* materials);
-
 /*! Produces infos that let you bind all textures of the given materials in a
 	single array binding of a descriptor set.
-	\param texture_count Overwritten with the number of textures of all
-		materials.
+	\param texture_count Overwritten with the number of images holding
+		textures of all materials (see materials_t.textures and
+		texture_stream_t).
 	\param binding_index The binding index to which all materials should be
 		bound.
 	\param materials The materials to be bound.
+	\param sampler The sampler to use for all material textures.
 	\return An array of texture_count descriptor infos that has to be freed by
 		the calling side.*/
-VkDescriptorImageInfo* get_materials_descriptor_infos(uint32_t* texture_count, const materials_t* materials);
+VkDescriptorImageInfo* get_materials_descriptor_infos(uint32_t* texture_count, const materials_t* materials, VkSampler sampler);
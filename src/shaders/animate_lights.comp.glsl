@@ -0,0 +1,118 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+//! This shader writes animated lights in place
+#define POLYGONAL_LIGHTS_WRITABLE
+#define POLYGONAL_LIGHT_BINDING 3
+#include "shared_constants.glsl"
+#include "math_constants.glsl"
+
+//! The number of threads per work group
+layout (local_size_x = 64) in;
+
+//! A keyframe of the animation of a polygonal light. Matches
+//! polygonal_light_keyframe_t in the C code.
+struct polygonal_light_keyframe_t {
+	vec3 rotation_angles;
+	float time;
+	vec3 translation;
+	float padding_0;
+	vec3 radiant_flux;
+	float padding_1;
+};
+
+//! For each polygonal light the index of its first keyframe in g_keyframes
+//! and its number of keyframes (0 for lights that are not animated)
+layout (binding = 1, std430) readonly buffer tracks_buffer {
+	uvec2 g_tracks[];
+};
+//! Keyframes of all lights, sorted by time per light
+layout (binding = 2, std430) readonly buffer keyframes_buffer {
+	polygonal_light_keyframe_t g_keyframes[];
+};
+
+
+/*! Interpolates the keyframes of a light linearly at the current animation
+	time and updates all members of the light that depend on them. This is
+	the same as update_polygonal_light() in the C code, except that the
+	rotation, translation and radiant flux come from the keyframes.*/
+void main() {
+	uint light_index = gl_GlobalInvocationID.x;
+	if (light_index >= POLYGONAL_LIGHT_COUNT)
+		return;
+	uvec2 track = g_tracks[light_index];
+	if (track.y == 0)
+		return;
+	// Find the keyframes around the current time, looping the animation
+	float duration = g_keyframes[track.x + track.y - 1].time;
+	float time = (duration > 0.0f) ? mod(g_light_animation_time, duration) : 0.0f;
+	uint next = 1;
+	while (next < track.y - 1 && g_keyframes[track.x + next].time <= time)
+		++next;
+	polygonal_light_keyframe_t previous_key = g_keyframes[track.x + next - 1];
+	polygonal_light_keyframe_t next_key = g_keyframes[track.x + min(next, track.y - 1)];
+	float span = next_key.time - previous_key.time;
+	float weight = (span > 0.0f) ? clamp((time - previous_key.time) / span, 0.0f, 1.0f) : 0.0f;
+	polygonal_light_t light = g_polygonal_lights[light_index];
+	light.rotation_angles = mix(previous_key.rotation_angles, next_key.rotation_angles, weight);
+	light.translation = mix(previous_key.translation, next_key.translation, weight);
+	light.radiant_flux = mix(previous_key.radiant_flux, next_key.radiant_flux, weight);
+	// Invert scalings
+	light.inv_scaling_x = 1.0f / light.scaling_x;
+	light.inv_scaling_y = 1.0f / light.scaling_y;
+	// Construct a rotation matrix from Euler angles. These are its rows.
+	vec3 c = cos(light.rotation_angles);
+	vec3 s = sin(light.rotation_angles);
+	float cxsy = c.x * s.y;
+	float sxsy = s.x * s.y;
+	light.rotation = transpose(mat3(
+		vec3(c.y * c.z, -c.y * s.z, -s.y),
+		vec3(-sxsy * c.z + c.x * s.z, sxsy * s.z + c.x * c.z, -s.x * c.y),
+		vec3(cxsy * c.z + s.x * s.z, -cxsy * s.z + s.x * c.z, c.x * c.y)
+	));
+	// Transform vertices to world space, repeating the first one at the end
+	vec2 scalings = vec2(light.scaling_x, light.scaling_y);
+	for (uint i = 0; i != MAX_POLYGONAL_LIGHT_VERTEX_COUNT; ++i) {
+		vec2 vertex = scalings * light.vertices_plane_space[(i < light.vertex_count) ? i : 0];
+		light.vertices_world_space[i] = light.translation + light.rotation * vec3(vertex, 0.0f);
+	}
+	// Construct the plane of the polygon
+	light.plane = vec4(light.rotation[2], -dot(light.rotation[2], light.translation));
+	// Triangulate the polygon as triangle fan and compute individual areas
+	float signed_area = 0.0f;
+	for (uint i = 0; i != MAX_POLYGONAL_LIGHT_VERTEX_COUNT - 2; ++i) {
+		if (i + 2 >= light.vertex_count) {
+			light.fan_areas[i] = light.fan_areas[light.vertex_count - 3];
+			continue;
+		}
+		vec2 edge_0 = light.vertices_plane_space[i + 2] - light.vertices_plane_space[0];
+		vec2 edge_1 = light.vertices_plane_space[i + 1] - light.vertices_plane_space[0];
+		float triangle_area = 0.5f * (edge_0.x * edge_1.y - edge_1.x * edge_0.y);
+		signed_area += triangle_area;
+		light.fan_areas[i] = scalings.x * scalings.y * vec2(triangle_area, signed_area);
+		light.fan_areas[i] *= (triangle_area < 0.0f) ? -1.0f : 1.0f;
+	}
+	// Turn radiant flux into radiance
+	signed_area *= scalings.x * scalings.y;
+	light.area = abs(signed_area);
+	light.rcp_area = 1.0f / light.area;
+	light.surface_radiance = light.radiant_flux * (light.rcp_area * M_INV_PI);
+	// Flip the plane if the winding is the wrong way around
+	light.plane = (signed_area > 0.0f) ? light.plane : (-light.plane);
+	g_polygonal_lights[light_index] = light;
+}
@@ -0,0 +1,54 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#include "mesh_quantization.glsl"
+
+//! The number of threads per work group
+layout (local_size_x = 64) in;
+
+//! The constants for dequantization of positions (see mesh_t in the C code)
+layout (constant_id = 0) const float g_dequantization_factor_x = 1.0f;
+layout (constant_id = 1) const float g_dequantization_factor_y = 1.0f;
+layout (constant_id = 2) const float g_dequantization_factor_z = 1.0f;
+layout (constant_id = 3) const float g_dequantization_summand_x = 0.0f;
+layout (constant_id = 4) const float g_dequantization_summand_y = 0.0f;
+layout (constant_id = 5) const float g_dequantization_summand_z = 0.0f;
+//! The number of vertices (i.e. three times the triangle count)
+layout (constant_id = 6) const uint g_vertex_count = 0;
+
+//! The device-local quantized positions of the mesh
+layout (binding = 0) uniform utextureBuffer g_quantized_vertex_positions;
+//! Three floats per vertex as input for an acceleration structure build
+layout (binding = 1, std430) writeonly buffer vertices_buffer {
+	float g_vertices[];
+};
+
+void main() {
+	const vec3 factor = vec3(g_dequantization_factor_x, g_dequantization_factor_y, g_dequantization_factor_z);
+	const vec3 summand = vec3(g_dequantization_summand_x, g_dequantization_summand_y, g_dequantization_summand_z);
+	// The number of work groups is limited, so each thread may have to
+	// handle multiple vertices
+	uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
+	for (uint i = gl_GlobalInvocationID.x; i < g_vertex_count; i += stride) {
+		uvec2 quantized_position = texelFetch(g_quantized_vertex_positions, int(i)).rg;
+		vec3 position = decode_position_64_bit(quantized_position, factor, summand);
+		g_vertices[3 * i + 0] = position.x;
+		g_vertices[3 * i + 1] = position.y;
+		g_vertices[3 * i + 2] = position.z;
+	}
+}
@@ -0,0 +1,54 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#version 460
+
+//! The number of threads per work group
+layout (local_size_x = 64) in;
+
+//! The number of triangles in the mesh
+layout (constant_id = 0) const uint g_triangle_count = 0;
+
+//! Bindings for mesh geometry (see mesh_t in the C code)
+layout (binding = 0) uniform utextureBuffer g_quantized_vertex_positions;
+layout (binding = 1) uniform textureBuffer g_packed_normals_and_tex_coords;
+layout (binding = 2) uniform utextureBuffer g_material_indices;
+
+//! Output with one record per triangle (see mesh_t.triangle_records)
+layout (binding = 3, std430) writeonly buffer triangle_records_buffer {
+	uvec4 g_triangle_records[];
+};
+
+void main() {
+	// The number of work groups is limited, so each thread may have to
+	// handle multiple triangles
+	uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
+	for (uint i = gl_GlobalInvocationID.x; i < g_triangle_count; i += stride) {
+		uvec2 positions[3], normals_and_tex_coords[3];
+		for (uint j = 0; j != 3; ++j) {
+			int vertex_index = int(3 * i + j);
+			positions[j] = texelFetch(g_quantized_vertex_positions, vertex_index).rg;
+			// Repacking the UNORMs reproduces the original bits exactly
+			vec4 normal_and_tex_coords = texelFetch(g_packed_normals_and_tex_coords, vertex_index);
+			normals_and_tex_coords[j] = uvec2(packUnorm2x16(normal_and_tex_coords.xy), packUnorm2x16(normal_and_tex_coords.zw));
+		}
+		uint material_index = texelFetch(g_material_indices, int(i)).r;
+		g_triangle_records[4 * i + 0] = uvec4(positions[0], positions[1]);
+		g_triangle_records[4 * i + 1] = uvec4(positions[2], normals_and_tex_coords[0]);
+		g_triangle_records[4 * i + 2] = uvec4(normals_and_tex_coords[1], normals_and_tex_coords[2]);
+		g_triangle_records[4 * i + 3] = uvec4(material_index, 0, 0, 0);
+	}
+}
@@ -43,3 +43,56 @@ vec3 decode_position_64_bit(uvec2 quantized_position, vec3 dequantization_factor
 	);
 	return fma(position, dequantization_factor, dequantization_summand);
 }
+
+
+//! The number of consecutive triangles that form one meshlet of compressed
+//! geometry (see mesh_t.meshlets in the C code)
+#define MESHLET_TRIANGLE_COUNT 64
+
+//! The number of consecutive triangles that share one entry of visibility
+//! feedback for streamed geometry (see geometry_stream_t in the C code)
+#define STREAM_PAGE_TRIANGLE_COUNT 64
+
+
+/*! Determines where a coordinate of a vertex position in compressed geometry
+	is stored.
+	\param meshlet The meshlet containing the vertex.
+	\param vertex_index The index of the vertex relative to the meshlet.
+	\param coordinate 0, 1 or 2 for x, y or z.
+	\return The index of the word in the bit stream of positions, in which the
+		coordinate begins, and the index of its least significant bit in that
+		word.*/
+uvec2 get_meshlet_coordinate_location(uvec4 meshlet, uint vertex_index, uint coordinate) {
+	uint bit = (3 * vertex_index + coordinate) * (meshlet.y >> 27);
+	return uvec2((meshlet.y & 0x7FFFFFF) + bit / 32, bit % 32);
+}
+
+
+/*! Extracts a coordinate relative to the meshlet from the bit stream of
+	positions in compressed geometry.
+	\param words The word at the location returned by
+		get_meshlet_coordinate_location() and the following one.
+	\param shift The bit index returned by get_meshlet_coordinate_location().
+	\param meshlet The meshlet containing the vertex.*/
+uint extract_meshlet_coordinate(uvec2 words, uint shift, uvec4 meshlet) {
+	uint bit_count = meshlet.y >> 27;
+	uint coordinate = words[0] >> shift;
+	coordinate |= (shift > 0) ? (words[1] << (32 - shift)) : 0;
+	return coordinate & ((1 << bit_count) - 1);
+}
+
+
+/*! Turns a vertex position of compressed geometry into a world space position.
+	It is the same position that decode_position_64_bit() produces for the
+	uncompressed geometry.
+	\param meshlet The meshlet containing the vertex.
+	\param relative_position The coordinates of the vertex as returned by
+		extract_meshlet_coordinate().*/
+vec3 decode_meshlet_position(uvec4 meshlet, uvec3 relative_position, vec3 dequantization_factor, vec3 dequantization_summand) {
+	uvec3 minimum = uvec3(
+		meshlet.z & 0x1FFFFF,
+		((meshlet.z & 0xFFE00000) >> 21) | ((meshlet.w & 0x3FF) << 11),
+		(meshlet.w & 0x7FFFFC00) >> 10
+	);
+	return fma(vec3(minimum + relative_position), dequantization_factor, dequantization_summand);
+}
@@ -28,6 +28,8 @@
 //#include "polygon_sampling.glsl" via polygon_sampling_related_work.glsl
 #include "polygon_sampling_related_work.glsl"
 #include "polygon_clipping.glsl"
+//! Binding of the storage buffer with polygonal lights
+#define POLYGONAL_LIGHT_BINDING 16
 #include "shared_constants.glsl"
 #include "srgb_utility.glsl"
 #include "unrolling.glsl"
@@ -53,17 +55,83 @@ layout (binding = 3) uniform utextureBuffer g_material_indices;
 //! The texture with primitive indices per pixel produced by the visibility pass
 layout (binding = 4, input_attachment_index = 0) uniform usubpassInput g_visibility_buffer;
 
-//! Textures (base color, specular, normal consecutively) for each material
-layout (binding = 5) uniform sampler2D g_material_textures[3 * MATERIAL_COUNT];
+/*! A bindless array with all textures. It starts with textures for polygonal
+	lights (plane space textures, light probes or IES profiles), indexed by
+	polygonal_light_t.texture_index. Starting at MATERIAL_TEXTURE_SLOT_OFFSET,
+	there are texture arrays holding material textures. Slots that are not in
+	use may hold invalid descriptors.*/
+layout (binding = 5) uniform sampler2D g_textures[];
+//! An alias of g_textures for the slots holding material texture arrays
+layout (binding = 5) uniform sampler2DArray g_texture_arrays[];
+
+/*! For each material, the location of its textures (base color, specular,
+	normal consecutively) in g_texture_arrays. The x-component is the index of
+	the texture array relative to MATERIAL_TEXTURE_SLOT_OFFSET, the
+	y-component is the layer. See texture_array_slot_t in the C code.*/
+layout (binding = 8, std430) readonly buffer material_texture_slots_buffer {
+	uvec2 g_material_texture_slots[];
+};
+
+#if INTERLEAVED_MESH_ATTRIBUTES
+/*! Alternative to bindings 1 to 3 with four uvec4 per triangle holding all
+	of its attributes (see mesh_t.triangle_records in the C code).*/
+layout (binding = 9, std430) readonly buffer triangle_records_buffer {
+	uvec4 g_triangle_records[];
+};
+#endif
 
-//! Textures for each polygonal light. These can be plane space textures, light
-//! probes or IES profiles
-layout (binding = 8) uniform sampler2D g_light_textures[LIGHT_TEXTURE_COUNT];
+#if COMPRESSED_GEOMETRY
+//! Alternative to bindings 1 to 3 with compressed geometry (see
+//! mesh_t.meshlets in the C code)
+layout (binding = 10, std430) readonly buffer meshlets_buffer {
+	uvec4 g_meshlets[];
+};
+layout (binding = 11, std430) readonly buffer meshlet_positions_buffer {
+	uint g_meshlet_positions[];
+};
+layout (binding = 12, std430) readonly buffer meshlet_attributes_buffer {
+	uvec2 g_meshlet_attributes[];
+};
+layout (binding = 13, std430) readonly buffer meshlet_triangles_buffer {
+	uint g_meshlet_triangles[];
+};
+#endif
 
 //! The top-level acceleration structure that contains all shadow-casting
 //! geometry
 #if TRACE_SHADOW_RAYS
-layout(binding = 9, set = 0) uniform accelerationStructureEXT g_top_level_acceleration_structure;
+layout(binding = 17, set = 0) uniform accelerationStructureEXT g_top_level_acceleration_structure;
+//! Set to false while shading with a light for which no shadow rays are
+//! needed (see apply_baked_visibility())
+bool g_trace_shadow_rays = true;
+#endif
+
+#if BAKED_VISIBILITY
+/*! One entry per triangle and polygonal light. The three least significant
+	bytes hold the visibility of the light from the three vertices of the
+	triangle, where 0 means occluded and 255 means visible (see
+	baked_visibility_t in the C code).*/
+layout (binding = 18, std430) readonly buffer baked_visibility_buffer {
+	uint g_baked_visibility[];
+};
+#endif
+
+#if STREAM_GEOMETRY
+//! One entry per page of triangles of streamed geometry. Pages that are
+//! visible in this frame are set to 1 (see stream_buffers_t in the C code).
+layout (binding = 14, std430) writeonly buffer stream_feedback_buffer {
+	uint g_stream_feedback[];
+};
+#endif
+
+#if STREAM_TEXTURES
+/*! One entry per material. A sparse subset of pixels writes the finest
+	mipmap that it needs for a texture with
+	2^TEXTURE_FEEDBACK_LOG2_RESOLUTION texels along each side (see
+	stream_buffers_t in the C code).*/
+layout (binding = 15, std430) buffer texture_feedback_buffer {
+	uint g_texture_feedback[];
+};
 #endif
 
 //! The pixel index with origin in the upper left corner
@@ -119,7 +187,7 @@ vec3 error_to_color(float error) {
 	false already, no ray is traced. The ray direction must be normalized.*/
 void get_polygon_visibility(inout bool visibility, vec3 sampled_dir, vec3 shading_position, polygonal_light_t polygonal_light) {
 #if TRACE_SHADOW_RAYS
-	if (visibility) {
+	if (visibility && g_trace_shadow_rays) {
 		float max_t = -dot(vec4(shading_position, 1.0f), polygonal_light.plane) / dot(sampled_dir, polygonal_light.plane.xyz);
 		float min_t = 1.0e-3f;
 		// Perform a ray query and wait for it to finish. One call to
@@ -138,6 +206,25 @@ void get_polygon_visibility(inout bool visibility, vec3 sampled_dir, vec3 shadin
 }
 
 
+/*! Prepares shading of the given triangle with the given polygonal light
+	using baked visibility (if available). If the light is visible from all
+	vertices of the triangle, shadow rays are turned off.
+	\return false if the light is occluded from all vertices of the triangle,
+		i.e. it does not need to be shaded at all.*/
+bool apply_baked_visibility(uint primitive_index, uint light_index) {
+#if BAKED_VISIBILITY
+	// Triangles that have not been baked (e.g. levels of detail) trace rays
+	uint baked_visibility = 0x808080;
+	if (primitive_index < BAKED_VISIBILITY_TRIANGLE_COUNT)
+		baked_visibility = g_baked_visibility[primitive_index * POLYGONAL_LIGHT_COUNT + light_index] & 0xFFFFFF;
+	g_trace_shadow_rays = (baked_visibility != 0xFFFFFF);
+	return baked_visibility != 0;
+#else
+	return true;
+#endif
+}
+
+
 /*! Determines the radiance received from the given direction due to the given
 	polygonal light (ignoring visibility).
 	\param sampled_dir The normalized direction from the shading point to the
@@ -179,7 +266,7 @@ vec3 get_polygon_radiance(vec3 sampled_dir, vec3 shading_position, polygonal_lig
 			tex_coord.x = atan(lookup_dir.y, lookup_dir.x) * (0.5f * M_INV_PI);
 			tex_coord.y = acos(lookup_dir.z) * M_INV_PI;
 		}
-		radiance *= textureLod(g_light_textures[polygonal_light.texture_index], tex_coord, 0.0f).rgb;
+		radiance *= textureLod(g_textures[polygonal_light.texture_index], tex_coord, 0.0f).rgb;
 	}
 	return radiance;
 }
@@ -323,6 +410,41 @@ vec3 get_polygonal_light_mis_estimate(vec3 sampled_dir, float sampled_density, s
 }
 
 
+/*! Approximates the solid angle that the given polygonal light subtends at
+	the given shading point by treating it as a small planar patch at its
+	centroid.
+	\param centroid Output for the area-weighted centroid of the polygon.
+	\return The approximate solid angle in steradians.*/
+float get_polygonal_light_proxy_solid_angle(out vec3 centroid, vec3 shading_position, polygonal_light_t polygonal_light) {
+	// Weight centroids of the triangles in the fan by their areas
+	centroid = vec3(0.0f);
+	float area_sum = 0.0f;
+	for (uint i = 0; i != MAX_POLYGONAL_LIGHT_VERTEX_COUNT - 2; ++i) {
+		if (i + 2 >= polygonal_light.vertex_count)
+			break;
+		float area = polygonal_light.fan_areas[i].x;
+		centroid += area * (polygonal_light.vertices_world_space[i + 1] + polygonal_light.vertices_world_space[i + 2]);
+		area_sum += area;
+	}
+	centroid = (polygonal_light.vertices_world_space[0] + centroid / area_sum) * (1.0f / 3.0f);
+	vec3 offset = centroid - shading_position;
+	float rcp_squared_distance = 1.0f / dot(offset, offset);
+	return polygonal_light.area * abs(dot(polygonal_light.plane.xyz, offset)) * (rcp_squared_distance * sqrt(rcp_squared_distance));
+}
+
+
+/*! Shades with the given polygonal light as though it were a point light at
+	the given centroid, which receives the given solid angle. It traces a
+	single shadow ray (if enabled) and does not use any random numbers.
+	\return The color that arose from shading.*/
+vec3 evaluate_polygonal_light_proxy_shading(shading_data_t shading_data, polygonal_light_t polygonal_light, vec3 centroid, float solid_angle) {
+	vec3 light_dir = normalize(centroid - shading_data.position);
+	float lambert;
+	vec3 radiance_times_brdf = get_polygon_radiance_visibility_brdf_product(lambert, light_dir, shading_data, polygonal_light);
+	return radiance_times_brdf * (lambert * solid_angle);
+}
+
+
 /*! Takes samples from the given polygonal light to compute shading. The number
 	of samples and sampling techniques are determined by defines.
 	\return The color that arose from shading.*/
@@ -723,6 +845,44 @@ shading_data_t get_shading_data(ivec2 pixel, int primitive_index, vec3 ray_direc
 	// Load position, normal and texture coordinates for each triangle vertex
 	vec3 positions[3], normals[3];
 	vec2 tex_coords[3];
+#if COMPRESSED_GEOMETRY
+	// Find the vertices in the meshlet and decode them
+	uint triangle = g_meshlet_triangles[primitive_index];
+	uvec4 meshlet = g_meshlets[primitive_index / MESHLET_TRIANGLE_COUNT];
+	[[unroll]]
+	for (int i = 0; i != 3; ++i) {
+		uint vertex_index = (triangle >> (8 * i)) & 0xFF;
+		uvec3 relative_position;
+		[[unroll]]
+		for (uint j = 0; j != 3; ++j) {
+			uvec2 location = get_meshlet_coordinate_location(meshlet, vertex_index, j);
+			uvec2 words = uvec2(g_meshlet_positions[location.x], g_meshlet_positions[location.x + 1]);
+			relative_position[j] = extract_meshlet_coordinate(words, location.y, meshlet);
+		}
+		positions[i] = decode_meshlet_position(meshlet, relative_position, g_mesh_dequantization_factor, g_mesh_dequantization_summand);
+		uvec2 attributes = g_meshlet_attributes[meshlet.x + vertex_index];
+		vec4 normal_and_tex_coords = vec4(unpackUnorm2x16(attributes.x), unpackUnorm2x16(attributes.y));
+		normals[i] = decode_normal_32_bit(normal_and_tex_coords.xy);
+		tex_coords[i] = fma(normal_and_tex_coords.zw, vec2(8.0f, -8.0f), vec2(0.0f, 1.0f));
+	}
+#elif INTERLEAVED_MESH_ATTRIBUTES
+	// Everything is in one record, which also holds the material index
+	uvec4 record[4] = {
+		g_triangle_records[4 * primitive_index + 0],
+		g_triangle_records[4 * primitive_index + 1],
+		g_triangle_records[4 * primitive_index + 2],
+		g_triangle_records[4 * primitive_index + 3],
+	};
+	uvec2 quantized_positions[3] = { record[0].xy, record[0].zw, record[1].xy };
+	uvec2 packed_normals_and_tex_coords[3] = { record[1].zw, record[2].xy, record[2].zw };
+	[[unroll]]
+	for (int i = 0; i != 3; ++i) {
+		positions[i] = decode_position_64_bit(quantized_positions[i], g_mesh_dequantization_factor, g_mesh_dequantization_summand);
+		vec4 normal_and_tex_coords = vec4(unpackUnorm2x16(packed_normals_and_tex_coords[i].x), unpackUnorm2x16(packed_normals_and_tex_coords[i].y));
+		normals[i] = decode_normal_32_bit(normal_and_tex_coords.xy);
+		tex_coords[i] = fma(normal_and_tex_coords.zw, vec2(8.0f, -8.0f), vec2(0.0f, 1.0f));
+	}
+#else
 	[[unroll]]
 	for (int i = 0; i != 3; ++i) {
 		int vertex_index = primitive_index * 3 + i;
@@ -732,6 +892,7 @@ shading_data_t get_shading_data(ivec2 pixel, int primitive_index, vec3 ray_direc
 		normals[i] = decode_normal_32_bit(normal_and_tex_coords.xy);
 		tex_coords[i] = fma(normal_and_tex_coords.zw, vec2(8.0f, -8.0f), vec2(0.0f, 1.0f));
 	}
+#endif
 	// Construct the view ray for the pixel at hand (the ray direction is not
 	// normalized)
 	vec3 ray_origin = g_camera_position_world_space;
@@ -751,6 +912,7 @@ shading_data_t get_shading_data(ivec2 pixel, int primitive_index, vec3 ray_direc
 	float det_dir_edge_0_0 = dot(ray_direction, edge_0_cross_0);
 	barycentrics.z = -rcp_det_edges_direction * det_dir_edge_0_0;
 	barycentrics.x = 1.0f - (barycentrics.y + barycentrics.z);
+#if !RAY_CONE_TEXTURE_LOD
 	// Compute screen space derivatives for the barycentrics
 	vec3 barycentrics_derivs[2];
 	[[unroll]]
@@ -764,10 +926,30 @@ shading_data_t get_shading_data(ivec2 pixel, int primitive_index, vec3 ray_direc
 		barycentrics_derivs[i].z = -rcp_det_edges_direction_deriv * det_dir_edge_0_0 - rcp_det_edges_direction * det_dir_edge_0_0_deriv;
 		barycentrics_derivs[i].x = -(barycentrics_derivs[i].y + barycentrics_derivs[i].z);
 	}
+#endif
 	// Interpolate vertex attributes across the triangle
 	result.position = fma(vec3(barycentrics[0]), positions[0], fma(vec3(barycentrics[1]), positions[1], barycentrics[2] * positions[2]));
 	vec3 interpolated_normal = normalize(fma(vec3(barycentrics[0]), normals[0], fma(vec3(barycentrics[1]), normals[1], barycentrics[2] * normals[2])));
 	vec2 tex_coord = fma(vec2(barycentrics[0]), tex_coords[0], fma(vec2(barycentrics[1]), tex_coords[1], barycentrics[2] * tex_coords[2]));
+	vec2 tex_coord_edges[2] = {
+		tex_coords[1] - tex_coords[0],
+		tex_coords[2] - tex_coords[0]
+	};
+#if RAY_CONE_TEXTURE_LOD
+	// Following Akenine-Moeller et al. [2019], a cone around the ray covers
+	// one pixel. Its width at the shading point is stretched by the angle of
+	// incidence and the ratio of texture space and world space area of the
+	// triangle turns it into a level of detail for a texture with resolution
+	// one.
+	vec3 triangle_normal = cross(edges[0], edges[1]);
+	float world_area = length(triangle_normal);
+	float tex_coord_area = abs(tex_coord_edges[0].x * tex_coord_edges[1].y - tex_coord_edges[0].y * tex_coord_edges[1].x);
+	float ray_distance = dot(result.position - ray_origin, ray_direction) / dot(ray_direction, ray_direction);
+	float cone_width = ray_distance * length(g_pixel_to_ray_direction_world_space[1]);
+	float cos_incidence = abs(dot(triangle_normal, ray_direction)) / max(world_area * length(ray_direction), 1.0e-20f);
+	float texture_lod = log2(max(cone_width / max(cos_incidence, 1.0e-3f), 1.0e-20f))
+		+ 0.5f * log2(max(tex_coord_area, 1.0e-20f) / max(world_area, 1.0e-20f));
+#else
 	// Compute screen space texture coordinate derivatives for filtering
 	vec2 tex_coord_derivs[2] = { vec2(0.0f), vec2(0.0f) };
 	[[unroll]]
@@ -775,12 +957,47 @@ shading_data_t get_shading_data(ivec2 pixel, int primitive_index, vec3 ray_direc
 		[[unroll]]
 		for (uint j = 0; j != 3; ++j)
 			tex_coord_derivs[i] += barycentrics_derivs[i][j] * tex_coords[j];
+#endif
 	// Read all three textures
+#if COMPRESSED_GEOMETRY
+	uint material_index = triangle >> 24;
+#elif INTERLEAVED_MESH_ATTRIBUTES
+	uint material_index = record[3].x;
+#else
 	uint material_index = texelFetch(g_material_indices, primitive_index).r;
-	vec3 base_color = textureGrad(g_material_textures[nonuniformEXT(3 * material_index + 0)], tex_coord, tex_coord_derivs[0], tex_coord_derivs[1]).rgb;
-	vec3 specular_data = textureGrad(g_material_textures[nonuniformEXT(3 * material_index + 1)], tex_coord, tex_coord_derivs[0], tex_coord_derivs[1]).rgb;
+#endif
+	vec4 texture_samples[3];
+	[[unroll]]
+	for (uint i = 0; i != 3; ++i) {
+		uvec2 slot = g_material_texture_slots[3 * material_index + i];
+#if RAY_CONE_TEXTURE_LOD
+		// Trilinear filtering with an explicit level of detail
+		vec2 resolution = vec2(textureSize(g_texture_arrays[nonuniformEXT(MATERIAL_TEXTURE_SLOT_OFFSET + slot.x)], 0).xy);
+		float lod = texture_lod + 0.5f * log2(resolution.x * resolution.y);
+		texture_samples[i] = textureLod(g_texture_arrays[nonuniformEXT(MATERIAL_TEXTURE_SLOT_OFFSET + slot.x)], vec3(tex_coord, slot.y), lod);
+#else
+		texture_samples[i] = textureGrad(g_texture_arrays[nonuniformEXT(MATERIAL_TEXTURE_SLOT_OFFSET + slot.x)], vec3(tex_coord, slot.y), tex_coord_derivs[0], tex_coord_derivs[1]);
+#endif
+	}
+#if STREAM_TEXTURES
+	// One pixel out of 4x4 reports which mipmap it needs. Like the sampler
+	// with anisotropic filtering, we use the shorter axis of the footprint
+	// unless it is too anisotropic.
+	if (((uint(pixel.x) ^ g_noise_random_numbers.x) & 3) == 0 && ((uint(pixel.y) ^ g_noise_random_numbers.y) & 3) == 0) {
+#if RAY_CONE_TEXTURE_LOD
+		float level = texture_lod + TEXTURE_FEEDBACK_LOG2_RESOLUTION;
+#else
+		float major_length = max(length(tex_coord_derivs[0]), length(tex_coord_derivs[1]));
+		float minor_length = min(length(tex_coord_derivs[0]), length(tex_coord_derivs[1]));
+		float level = log2(max(max(minor_length, major_length * (1.0f / MAX_ANISOTROPY)), 1.0e-20f)) + TEXTURE_FEEDBACK_LOG2_RESOLUTION;
+#endif
+		atomicMin(g_texture_feedback[material_index], uint(clamp(level, 0.0f, float(TEXTURE_FEEDBACK_LOG2_RESOLUTION))));
+	}
+#endif
+	vec3 base_color = texture_samples[0].rgb;
+	vec3 specular_data = texture_samples[1].rgb;
 	vec3 normal_tangent_space;
-	normal_tangent_space.xy = textureGrad(g_material_textures[nonuniformEXT(3 * material_index + 2)], tex_coord, tex_coord_derivs[0], tex_coord_derivs[1]).rg;
+	normal_tangent_space.xy = texture_samples[2].rg;
 	normal_tangent_space.xy = fma(normal_tangent_space.xy, vec2(2.0f), vec2(-1.0f));
 	normal_tangent_space.z = sqrt(max(0.0f, fma(-normal_tangent_space.x, normal_tangent_space.x, fma(-normal_tangent_space.y, normal_tangent_space.y, 1.0f))));
 	// Prepare BRDF parameters (i.e. immitate Falcor to be compatible with its
@@ -795,10 +1012,6 @@ shading_data_t get_shading_data(ivec2 pixel, int primitive_index, vec3 ray_direc
 	result.roughness = linear_roughness * linear_roughness;
 	result.roughness = clamp(result.roughness * g_roughness_factor, 0.0064f, 1.0f);
 	// Transform the normal vector to world space
-	vec2 tex_coord_edges[2] = {
-		tex_coords[1] - tex_coords[0],
-		tex_coords[2] - tex_coords[0]
-	};
 	vec3 normal_cross_edge_0 = cross(interpolated_normal, edges[0]);
 	vec3 edge1_cross_normal = cross(edges[1], interpolated_normal);
 	vec3 tangent = edge1_cross_normal * tex_coord_edges[0].x + normal_cross_edge_0 * tex_coord_edges[1].x;
@@ -835,6 +1048,10 @@ void main() {
 	if (primitive_index == 0xFFFFFFFF)
 		view_ray_end = vec4(view_ray_direction, 0.0f);
 	else {
+#if STREAM_GEOMETRY
+		// Let the CPU know that this part of the geometry is needed
+		g_stream_feedback[primitive_index / STREAM_PAGE_TRIANGLE_COUNT] = 1;
+#endif
 		// Prepare shading data for the visible surface point
 		shading_data = get_shading_data(pixel, int(primitive_index), view_ray_direction);
 		view_ray_end = vec4(shading_data.position, 1.0f);
@@ -854,8 +1071,22 @@ void main() {
 		// Prepare noise for all sampling decisions
 		noise_accessor_t noise_accessor = get_noise_accessor(pixel, g_noise_resolution_mask, g_noise_texture_index_mask, g_noise_random_numbers);
 		// Shade with all polygonal lights
+		// Lights that subtend a small solid angle are shaded as point lights.
+		// A threshold of zero turns that off and skips the proxy entirely.
 		RAY_TRACING_FOR_LOOP(i, POLYGONAL_LIGHT_COUNT, POLYGONAL_LIGHT_COUNT_CLAMPED,
-			final_color += evaluate_polygonal_light_shading(shading_data, ltc, g_polygonal_lights[i], noise_accessor);
+			if (apply_baked_visibility(primitive_index, i)) {
+				vec3 centroid;
+				float solid_angle = 0.0f;
+				bool use_proxy = false;
+				if (g_light_lod_solid_angle > 0.0f) {
+					solid_angle = get_polygonal_light_proxy_solid_angle(centroid, shading_data.position, g_polygonal_lights[i]);
+					use_proxy = (solid_angle < g_light_lod_solid_angle);
+				}
+				if (use_proxy)
+					final_color += evaluate_polygonal_light_proxy_shading(shading_data, g_polygonal_lights[i], centroid, solid_angle);
+				else
+					final_color += evaluate_polygonal_light_shading(shading_data, ltc, g_polygonal_lights[i], noise_accessor);
+			}
 		)
 	}
 	// If there are NaNs or INFs, we want to know. Make them pink.
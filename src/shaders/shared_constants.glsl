@@ -55,12 +55,27 @@ layout (std140, row_major, binding = 0) uniform per_frame_constants {
 	//! 0 if an LDR frame should be output, 1 if low bits of a 16-bit HDR frame
 	//! should be output, 2 if high bits of a 16-bit HDR frame should be output
 	uint g_frame_bits;
+	//! The time in seconds at which keyframed animations of polygonal lights
+	//! are evaluated
+	float g_light_animation_time;
+	//! Polygonal lights that subtend a smaller solid angle (in steradians) at
+	//! a shading point are shaded as point lights. Zero disables this.
+	float g_light_lod_solid_angle;
 	//! Constants to randomize access to noise textures
 	uvec4 g_noise_random_numbers;
 	//! Constants for accessing linearly transformed cosine tables
 	ltc_constants_t g_ltc_constants;
+};
+
 #ifdef POLYGONAL_LIGHT_ARRAY_SIZE
-	//! The polygonal lights that are illuminating the scene
-	polygonal_light_t g_polygonal_lights[POLYGONAL_LIGHT_ARRAY_SIZE];
+/*! The polygonal lights that are illuminating the scene. Shaders that use
+	them define POLYGONAL_LIGHT_BINDING. The CPU only writes them after edits
+	and the light animation pass overwrites animated lights in each frame.*/
+#ifdef POLYGONAL_LIGHTS_WRITABLE
+layout (std140, row_major, binding = POLYGONAL_LIGHT_BINDING) buffer polygonal_lights_buffer {
+#else
+layout (std140, row_major, binding = POLYGONAL_LIGHT_BINDING) readonly buffer polygonal_lights_buffer {
 #endif
+	polygonal_light_t g_polygonal_lights[POLYGONAL_LIGHT_ARRAY_SIZE];
 };
+#endif
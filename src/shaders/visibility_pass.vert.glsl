@@ -19,13 +19,42 @@
 #include "mesh_quantization.glsl"
 #include "shared_constants.glsl"
 
+#if COMPRESSED_GEOMETRY
+//! Compressed geometry without vertex buffer (see mesh_t.meshlets in the C
+//! code)
+layout (binding = 1, std430) readonly buffer meshlets_buffer {
+	uvec4 g_meshlets[];
+};
+layout (binding = 2, std430) readonly buffer meshlet_positions_buffer {
+	uint g_meshlet_positions[];
+};
+layout (binding = 3, std430) readonly buffer meshlet_triangles_buffer {
+	uint g_meshlet_triangles[];
+};
+#else
 //! The quantized world space position from the vertex buffer
 layout (location = 0) in uvec2 g_quantized_vertex_position;
+#endif
 
 layout (location = 0) flat out uint g_out_primitive_index;
 
 void main() {
+#if COMPRESSED_GEOMETRY
+	// Find the vertex in its meshlet and decode its position
+	uint triangle_index = gl_VertexIndex / 3;
+	uint triangle = g_meshlet_triangles[triangle_index];
+	uvec4 meshlet = g_meshlets[triangle_index / MESHLET_TRIANGLE_COUNT];
+	uint vertex_index = (triangle >> (8 * (gl_VertexIndex % 3))) & 0xFF;
+	uvec3 relative_position;
+	for (uint i = 0; i != 3; ++i) {
+		uvec2 location = get_meshlet_coordinate_location(meshlet, vertex_index, i);
+		uvec2 words = uvec2(g_meshlet_positions[location.x], g_meshlet_positions[location.x + 1]);
+		relative_position[i] = extract_meshlet_coordinate(words, location.y, meshlet);
+	}
+	vec3 vertex_position_world_space = decode_meshlet_position(meshlet, relative_position, g_mesh_dequantization_factor, g_mesh_dequantization_summand);
+#else
 	vec3 vertex_position_world_space = decode_position_64_bit(g_quantized_vertex_position, g_mesh_dequantization_factor, g_mesh_dequantization_summand);
+#endif
 	gl_Position = g_world_to_projection_space * vec4(vertex_position_world_space, 1.0f);
 	// Without index buffer, the primitive index is the vertex index divided by
 	// three
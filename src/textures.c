@@ -15,6 +15,10 @@
 
 
 #include "textures.h"
+#include "texture_conversion.h"
+#include "string_utilities.h"
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -62,6 +66,10 @@ typedef struct texture_2d_loading_s {
 	uint32_t texture_count;
 	texture_2d_header_t* headers;
 	VkBufferCreateInfo* buffer_requests;
+	texture_array_slot_t* slots;
+	//! The number of created images (less than texture_count if textures are
+	//! packed into arrays) and requests for each of them
+	uint32_t image_count;
 	image_request_t* image_requests;
 	//! Number of array entries for the subsequent members
 	uint32_t total_mipmap_count;
@@ -84,6 +92,7 @@ void destroy_texture_loading(texture_2d_loading_t* loading, const device_t* devi
 		free(loading->headers);
 	}
 	free(loading->buffer_requests);
+	free(loading->slots);
 	free(loading->image_requests);
 	free(loading->buffer_to_image_regions);
 	free(loading->source_texture_buffers);
@@ -92,7 +101,65 @@ void destroy_texture_loading(texture_2d_loading_t* loading, const device_t* devi
 }
 
 
-int load_2d_textures(images_t* textures, const device_t* device, uint32_t texture_count, const char* const* file_paths, VkBufferUsageFlags usage) {
+/*! Opens the texture file at the given path and reads its header. Upon
+	success, header->file points to the beginning of the texel data and the
+	calling side has to close it and free header->mipmaps.
+	\return 0 upon success.*/
+int read_2d_texture_header(texture_2d_header_t* header, const char* file_path) {
+	memset(header, 0, sizeof(*header));
+	// Open the file
+	FILE* file = header->file = fopen(file_path, "rb");
+	if (!file) {
+		printf("Failed to open the texture file at path %s.\n", file_path);
+		return 1;
+	}
+	// Check the file format marker
+	uint32_t marker, version;
+	fread(&marker, sizeof(marker), 1, file);
+	fread(&version, sizeof(version), 1, file);
+	if (marker != 0xbc1bc1 || version != 1) {
+		printf("The texture at path %s does not seem to have the correct format. It is supposed to be converted to a custom format for the renderer using the texture conversion utility. Aborting.\n", file_path);
+		return 1;
+	}
+	// Load meta-data about the texture
+	fread(&header->mipmap_count, sizeof(uint32_t), 1, file);
+	fread(&header->resolution, sizeof(uint32_t), 2, file);
+	fread(&header->format, sizeof(uint32_t), 1, file);
+	fread(&header->size, sizeof(uint64_t), 1, file);
+	if (header->mipmap_count == 0) {
+		printf("The texture at path %s has no mipmaps.\n", file_path);
+		return 1;
+	}
+	// Load meta-data about mipmaps
+	header->mipmaps = malloc(sizeof(texture_2d_mipmap_header_t) * header->mipmap_count);
+	memset(header->mipmaps, 0, sizeof(texture_2d_mipmap_header_t) * header->mipmap_count);
+	for (uint32_t k = 0; k != header->mipmap_count; ++k) {
+		fread(&header->mipmaps[k].resolution, sizeof(uint32_t), 2, file);
+		fread(&header->mipmaps[k].size, sizeof(uint64_t), 1, file);
+		fread(&header->mipmaps[k].offset, sizeof(uint64_t), 1, file);
+	}
+	return 0;
+}
+
+
+/*! Implements load_2d_textures() and load_2d_texture_arrays().
+	\param slots Either NULL or an array of texture_count entries that is
+		overwritten with the location of each texture.
+	\param texel_data_size Either NULL or overwritten by the total size of all
+		texture data in bytes without any padding.
+	\param pack_layers VK_TRUE to pack textures with identical format,
+		resolution and mipmap count into layers of a single texture array. If
+		it is VK_FALSE, each texture gets its own image with a single layer.
+	\param array_views VK_TRUE to create views of type
+		VK_IMAGE_VIEW_TYPE_2D_ARRAY, VK_FALSE for VK_IMAGE_VIEW_TYPE_2D.
+	\param first_mipmaps Either NULL to load all mipmaps or an array of
+		texture_count entries. Entry i is the index of the finest mipmap that
+		is loaded for texture i. It gets clamped to the coarsest mipmap.
+	\return 0 upon success.*/
+int load_2d_textures_into_images(images_t* textures, texture_array_slot_t* slots, VkDeviceSize* texel_data_size,
+	const device_t* device, uint32_t texture_count, const char* const* file_paths, VkBufferUsageFlags usage, VkBool32 pack_layers, VkBool32 array_views,
+	const uint32_t* first_mipmaps)
+{
 	memset(textures, 0, sizeof(*textures));
 	texture_2d_loading_t loading = { .texture_count = texture_count };
 	// Open all the texture files and read their headers
@@ -100,36 +167,25 @@ int load_2d_textures(images_t* textures, const device_t* device, uint32_t textur
 	memset(loading.headers, 0, sizeof(texture_2d_header_t) * texture_count);
 	for (uint32_t i = 0; i != texture_count; ++i) {
 		texture_2d_header_t* header = &loading.headers[i];
-		// Open the file
-		FILE* file = loading.headers[i].file = fopen(file_paths[i], "rb");
-		if (!file) {
-			printf("Failed to open the texture file at path %s.\n", file_paths[i]);
+		if (read_2d_texture_header(header, file_paths[i])) {
 			destroy_texture_loading(&loading, device);
 			return 1;
 		}
-		// Check the file format marker
-		uint32_t marker, version;
-		fread(&marker, sizeof(marker), 1, file);
-		fread(&version, sizeof(version), 1, file);
-		if (marker != 0xbc1bc1 || version != 1) {
-			printf("The texture at path %s does not seem to have the correct format. It is supposed to be converted to a custom format for the renderer using the texture conversion utility. Aborting.\n", file_paths[i]);
-			destroy_texture_loading(&loading, device);
-			return 1;
+		// Drop mipmaps that should not be loaded and skip over their data
+		uint32_t first_mipmap = first_mipmaps ? first_mipmaps[i] : 0;
+		if (first_mipmap > header->mipmap_count - 1)
+			first_mipmap = header->mipmap_count - 1;
+		if (first_mipmap > 0) {
+			VkDeviceSize skipped_size = header->mipmaps[first_mipmap].offset;
+			header->mipmap_count -= first_mipmap;
+			memmove(header->mipmaps, &header->mipmaps[first_mipmap], sizeof(texture_2d_mipmap_header_t) * header->mipmap_count);
+			for (uint32_t k = 0; k != header->mipmap_count; ++k)
+				header->mipmaps[k].offset -= skipped_size;
+			header->resolution = header->mipmaps[0].resolution;
+			header->size -= skipped_size;
+			fseek(header->file, (long) skipped_size, SEEK_CUR);
 		}
-		// Load meta-data about the texture
-		fread(&header->mipmap_count, sizeof(uint32_t), 1, file);
 		loading.total_mipmap_count += header->mipmap_count;
-		fread(&header->resolution, sizeof(uint32_t), 2, file);
-		fread(&header->format, sizeof(uint32_t), 1, file);
-		fread(&header->size, sizeof(uint64_t), 1, file);
-		// Load meta-data about mipmaps
-		header->mipmaps = malloc(sizeof(texture_2d_mipmap_header_t) * header->mipmap_count);
-		memset(header->mipmaps, 0, sizeof(texture_2d_mipmap_header_t) * header->mipmap_count);
-		for (uint32_t k = 0; k != header->mipmap_count; ++k) {
-			fread(&header->mipmaps[k].resolution, sizeof(uint32_t), 2, file);
-			fread(&header->mipmaps[k].size, sizeof(uint64_t), 1, file);
-			fread(&header->mipmaps[k].offset, sizeof(uint64_t), 1, file);
-		}
 	}
 
 	// Allocate staging buffers for textures
@@ -171,10 +227,39 @@ int load_2d_textures(images_t* textures, const device_t* device, uint32_t textur
 		header->file = NULL;
 	}
 
-	// Create the GPU-resident texture objects
-	loading.image_requests = malloc(sizeof(image_request_t) * texture_count);
+	// Assign each texture to an image and a layer therein. Textures that agree
+	// in all image parameters share an image if requested.
+	loading.slots = malloc(sizeof(texture_array_slot_t) * texture_count);
+	uint32_t* first_textures = malloc(sizeof(uint32_t) * texture_count);
+	uint32_t* layer_counts = malloc(sizeof(uint32_t) * texture_count);
 	for (uint32_t i = 0; i != texture_count; ++i) {
-		texture_2d_header_t* header = &loading.headers[i];
+		const texture_2d_header_t* header = &loading.headers[i];
+		uint32_t image_index = loading.image_count;
+		for (uint32_t j = 0; j != loading.image_count && pack_layers; ++j) {
+			const texture_2d_header_t* other = &loading.headers[first_textures[j]];
+			if (header->format == other->format && header->mipmap_count == other->mipmap_count
+				&& layer_counts[j] < device->physical_device_properties.limits.maxImageArrayLayers
+				&& header->resolution.width == other->resolution.width
+				&& header->resolution.height == other->resolution.height)
+			{
+				image_index = j;
+				break;
+			}
+		}
+		if (image_index == loading.image_count) {
+			first_textures[image_index] = i;
+			layer_counts[image_index] = 0;
+			++loading.image_count;
+		}
+		loading.slots[i].array_index = image_index;
+		loading.slots[i].layer = layer_counts[image_index];
+		++layer_counts[image_index];
+	}
+
+	// Create the GPU-resident texture objects
+	loading.image_requests = malloc(sizeof(image_request_t) * loading.image_count);
+	for (uint32_t i = 0; i != loading.image_count; ++i) {
+		texture_2d_header_t* header = &loading.headers[first_textures[i]];
 		image_request_t request = {
 			.image_info = {
 				.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -182,21 +267,23 @@ int load_2d_textures(images_t* textures, const device_t* device, uint32_t textur
 				.format = header->format,
 				.extent = { header->resolution.width, header->resolution.height, 1 },
 				.mipLevels = header->mipmap_count,
-				.arrayLayers = 1,
+				.arrayLayers = layer_counts[i],
 				.samples = VK_SAMPLE_COUNT_1_BIT,
 				.tiling = VK_IMAGE_TILING_OPTIMAL,
 				.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | usage
 			},
 			.view_info = {
 				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-				.viewType = VK_IMAGE_VIEW_TYPE_2D,
+				.viewType = array_views ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D,
 				.subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT }
 			}
 		};
 		loading.image_requests[i] = request;
 	}
-	if (create_images(&loading.textures, device, loading.image_requests, texture_count, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
-		printf("Failed to create texture objects on GPU for %d textures.\n", texture_count);
+	free(first_textures);
+	free(layer_counts);
+	if (create_images(&loading.textures, device, loading.image_requests, loading.image_count, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+		printf("Failed to create %d texture objects on GPU for %d textures.\n", loading.image_count, texture_count);
 		destroy_texture_loading(&loading, device);
 		return 1;
 	}
@@ -215,12 +302,13 @@ int load_2d_textures(images_t* textures, const device_t* device, uint32_t textur
 				.imageSubresource = {
 					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 					.mipLevel = j,
+					.baseArrayLayer = loading.slots[i].layer,
 					.layerCount = 1
 				}
 			};
 			loading.buffer_to_image_regions[region_index] = region;
 			loading.source_texture_buffers[region_index] = loading.staging.buffers[i].buffer;
-			loading.destination_images[region_index] = loading.textures.images[i].image;
+			loading.destination_images[region_index] = loading.textures.images[loading.slots[i].array_index].image;
 			++region_index;
 		}
 	}
@@ -234,8 +322,102 @@ int load_2d_textures(images_t* textures, const device_t* device, uint32_t textur
 	}
 
 	// Hand over the result and clean up
+	if (slots)
+		memcpy(slots, loading.slots, sizeof(texture_array_slot_t) * texture_count);
+	if (texel_data_size) {
+		(*texel_data_size) = 0;
+		for (uint32_t i = 0; i != texture_count; ++i)
+			(*texel_data_size) += loading.headers[i].size;
+	}
 	(*textures) = loading.textures;
 	memset(&loading.textures, 0, sizeof(loading.textures));
 	destroy_texture_loading(&loading, device);
 	return 0;
 }
+
+
+int load_2d_textures(images_t* textures, const device_t* device, uint32_t texture_count, const char* const* file_paths, VkBufferUsageFlags usage) {
+	return load_2d_textures_into_images(textures, NULL, NULL, device, texture_count, file_paths, usage, VK_FALSE, VK_FALSE, NULL);
+}
+
+
+int load_2d_texture_arrays(images_t* texture_arrays, texture_array_slot_t* slots, const device_t* device,
+	uint32_t texture_count, const char* const* file_paths, VkBufferUsageFlags usage, VkBool32 pack_layers)
+{
+	VkDeviceSize texel_data_size;
+	if (load_2d_textures_into_images(texture_arrays, slots, &texel_data_size, device, texture_count, file_paths, usage, pack_layers, VK_TRUE, NULL))
+		return 1;
+	// Report how many descriptors are needed and how much memory is wasted
+	VkDeviceSize memory_size = 0;
+	for (uint32_t i = 0; i != texture_arrays->image_count; ++i)
+		memory_size += texture_arrays->images[i].memory_size;
+	printf("Loaded %u textures into %u %s (one descriptor each). They occupy %.2f MiB of device memory for %.2f MiB of texel data (%.2f MiB padding).\n",
+		texture_count, texture_arrays->image_count, pack_layers ? "texture arrays" : "images",
+		memory_size / 1048576.0, texel_data_size / 1048576.0, (memory_size - texel_data_size) / 1048576.0);
+	return 0;
+}
+
+
+int update_2d_texture_caches(uint32_t texture_count, const char* const* file_paths, const VkFormat* formats) {
+	const char* source_extensions[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+	char** source_paths = malloc(sizeof(char*) * texture_count);
+	const char** output_paths = malloc(sizeof(char*) * texture_count);
+	int32_t* output_formats = malloc(sizeof(int32_t) * texture_count);
+	uint32_t conversion_count = 0;
+	for (uint32_t i = 0; i != texture_count; ++i) {
+		// Strip the extension of the *.vkt file
+		size_t length = strlen(file_paths[i]);
+		if (length < 4 || strcmp(file_paths[i] + length - 4, ".vkt") != 0)
+			continue;
+		char* stem = copy_string(file_paths[i]);
+		stem[length - 4] = 0;
+		// Find a source image, which is newer than the *.vkt file
+		struct stat output_stat, source_stat;
+		int output_exists = (stat(file_paths[i], &output_stat) == 0);
+		for (uint32_t j = 0; j != COUNT_OF(source_extensions); ++j) {
+			const char* path_pieces[] = { stem, source_extensions[j] };
+			char* source_path = concatenate_strings(COUNT_OF(path_pieces), path_pieces);
+			if (stat(source_path, &source_stat) == 0 && (!output_exists || output_stat.st_mtime < source_stat.st_mtime)) {
+				source_paths[conversion_count] = source_path;
+				output_paths[conversion_count] = file_paths[i];
+				output_formats[conversion_count] = (int32_t) formats[i];
+				++conversion_count;
+				break;
+			}
+			free(source_path);
+		}
+		free(stem);
+	}
+	uint32_t failure_count = 0;
+	if (conversion_count > 0) {
+		printf("Converting %u source images to *.vkt textures...\n", conversion_count);
+		failure_count = convert_textures(conversion_count, output_formats, (const char* const*) source_paths, output_paths, 0);
+		if (failure_count > 0)
+			printf("Failed to convert %u of %u source images to *.vkt textures.\n", failure_count, conversion_count);
+	}
+	for (uint32_t i = 0; i != conversion_count; ++i)
+		free(source_paths[i]);
+	free(source_paths);
+	free(output_paths);
+	free(output_formats);
+	return (failure_count > 0) ? 1 : 0;
+}
+
+
+int get_2d_texture_info(uint32_t* mipmap_count, VkExtent2D* resolution, const char* file_path) {
+	texture_2d_header_t header;
+	int result = read_2d_texture_header(&header, file_path);
+	if (header.file)
+		fclose(header.file);
+	free(header.mipmaps);
+	if (!result) {
+		(*mipmap_count) = header.mipmap_count;
+		(*resolution) = header.resolution;
+	}
+	return result;
+}
+
+
+int load_2d_texture_mipmaps(images_t* texture, const device_t* device, const char* file_path, uint32_t first_mipmap, VkBufferUsageFlags usage) {
+	return load_2d_textures_into_images(texture, NULL, NULL, device, 1, &file_path, usage, VK_FALSE, VK_TRUE, &first_mipmap);
+}
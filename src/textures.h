@@ -17,6 +17,16 @@
 #pragma once
 #include "vulkan_basics.h"
 
+
+//! Identifies a single texture within a list of 2D texture arrays
+typedef struct texture_array_slot_s {
+	//! The index of the texture array (i.e. the image)
+	uint32_t array_index;
+	//! The array layer holding the texture
+	uint32_t layer;
+} texture_array_slot_t;
+
+
 /*! Loads 2D textures from files into GPU memory.
     \param textures Upon success, this object holds all loaded textures in the
         order specified through file_paths. The calling side takes
@@ -33,3 +43,50 @@
     \note Since this function always creates a new memory allocation, it is
         advisable to load many textures at once.*/
 int load_2d_textures(images_t* textures, const device_t* device, uint32_t texture_count, const char* const* file_paths, VkBufferUsageFlags usage);
+
+/*! Like load_2d_textures() but textures with identical format, resolution and
+	mipmap count may be packed into the layers of a single 2D texture array.
+	That reduces the number of images and descriptors and it tends to reduce
+	the memory wasted on alignment. All views have type
+	VK_IMAGE_VIEW_TYPE_2D_ARRAY. Statistics about memory usage are printed.
+	\param texture_arrays Upon success, this object holds all created images.
+		The calling side takes responsibility to free it using
+		destroy_images().
+	\param slots An array of texture_count entries. Upon success, entry i
+		tells in which image and layer the texture at file_paths[i] resides.
+	\param pack_layers VK_TRUE to pack textures into arrays. VK_FALSE to create
+		one image with a single layer per texture, e.g. for comparison.
+	\return 0 upon success.*/
+int load_2d_texture_arrays(images_t* texture_arrays, texture_array_slot_t* slots, const device_t* device,
+	uint32_t texture_count, const char* const* file_paths, VkBufferUsageFlags usage, VkBool32 pack_layers);
+
+/*! Brings *.vkt files up to date with source images in common formats. For
+	each given path of a *.vkt file, it looks for an image file with the same
+	name but the extension .png, .jpg, .jpeg, .tga or .bmp. If there is one and
+	the *.vkt file is missing or older, the image is converted to the given
+	format and written to the *.vkt path (see tools/texture_conversion). Thus,
+	*.vkt files act as a cache and the conversion only happens once. All
+	outdated textures are converted in parallel using all hardware threads.
+	\param formats For each texture the format of the *.vkt file.
+	\return 0 upon success. Textures without source image are no error.*/
+int update_2d_texture_caches(uint32_t texture_count, const char* const* file_paths, const VkFormat* formats);
+
+/*! Reads meta-data of a texture file without loading any texels.
+	\param mipmap_count Overwritten with the number of mipmaps in the file.
+	\param resolution Overwritten with the resolution of the finest mipmap.
+	\param file_path Path to a texture file in the *.vkt format.
+	\return 0 upon success.*/
+int get_2d_texture_info(uint32_t* mipmap_count, VkExtent2D* resolution, const char* file_path);
+
+/*! Loads a single 2D texture into its own image but skips the finest
+	mipmaps. The image is smaller accordingly and its finest mipmap is the
+	mipmap first_mipmap of the file. Texture coordinates do not change, but
+	the level of detail used for sampling is relative to the loaded mipmaps.
+	The view has type VK_IMAGE_VIEW_TYPE_2D_ARRAY.
+	\param texture Upon success, this object holds a single image. The
+		calling side takes responsibility to free it using destroy_images().
+	\param first_mipmap The index of the finest mipmap that is loaded. It is
+		clamped to the coarsest mipmap.
+	\return 0 upon success.
+	\see load_2d_textures()*/
+int load_2d_texture_mipmaps(images_t* texture, const device_t* device, const char* file_path, uint32_t first_mipmap, VkBufferUsageFlags usage);
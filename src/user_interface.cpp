@@ -57,6 +57,21 @@ void specify_user_interface(application_updates_t* updates, application_t* app,
 	ImGui::SameLine();
 	const char* progress_texts[] = {" ......", ". .....", ".. ....", "... ...", ".... ..", "..... .", "...... "};
 	ImGui::Text(progress_texts[frame_index % COUNT_OF(progress_texts)]);
+	// Display statistics for the geometry and shading pass
+	if (app->frame_queue.timestamps) {
+		ImGui::Text("Geometry pass: %.2f ms, %llu triangles", app->frame_queue.geometry_pass_time * 1000.0f, (unsigned long long) app->geometry_pass.drawn_triangle_count);
+		ImGui::Text("Shading pass: %.2f ms", app->frame_queue.shading_pass_time * 1000.0f);
+		if (app->scene.acceleration_structure.updatable && app->render_settings.acceleration_structure_update != acceleration_structure_update_none)
+			ImGui::Text("Acceleration structure update: %.2f ms", app->frame_queue.acceleration_structure_update_time * 1000.0f);
+	}
+	else
+		ImGui::Text("Geometry pass: %llu triangles", (unsigned long long) app->geometry_pass.drawn_triangle_count);
+	if (app->render_settings.cull_chunks)
+		ImGui::Text("Culling: %llu of %llu chunks culled", (unsigned long long) app->geometry_pass.culled_chunk_count, (unsigned long long) app->scene.chunk_count);
+	if (app->scene.stream.file)
+		ImGui::Text("Streaming: %u of %llu chunks resident", app->scene.stream.resident_count, (unsigned long long) app->scene.chunk_count);
+	if (app->scene.materials.stream.texture_count > 0)
+		ImGui::Text("Textures: %.1f of %.1f MiB", app->scene.materials.stream.resident_size / 1048576.0, app->scene.materials.stream.budget / 1048576.0);
 
 	// Scene selection
 	int scene_index = 0;
@@ -202,17 +217,116 @@ void specify_user_interface(application_updates_t* updates, application_t* app,
 	if (app->device.ray_tracing_supported) {
 		if (ImGui::Checkbox("Trace shadow rays", (bool*) &settings->trace_shadow_rays))
 			updates->change_shading = VK_TRUE;
+		if (settings->trace_shadow_rays && ImGui::Checkbox("Use baked visibility", (bool*) &settings->use_baked_visibility))
+			updates->reload_baked_visibility = VK_TRUE;
+		if (settings->trace_shadow_rays && ImGui::IsItemHovered())
+			ImGui::SetTooltip("Skips shadow rays where visibility baked by the visibility_baker tool into <quicksave>.vis is conclusive.");
+		// Updating the acceleration structure each frame
+		const char* acceleration_structure_updates[acceleration_structure_update_count];
+		acceleration_structure_updates[acceleration_structure_update_none] = "None";
+		acceleration_structure_updates[acceleration_structure_update_top_level] = "Rebuild top level";
+		acceleration_structure_updates[acceleration_structure_update_refit] = "Refit bottom level";
+		acceleration_structure_update_t old_update = settings->acceleration_structure_update;
+		if (ImGui::Combo("Acceleration structure update", (int*) &settings->acceleration_structure_update, acceleration_structure_updates, acceleration_structure_update_count)
+			&& (old_update == acceleration_structure_update_none) != (settings->acceleration_structure_update == acceleration_structure_update_none))
+			updates->reload_scene = VK_TRUE;
+		if (settings->acceleration_structure_update == acceleration_structure_update_refit) {
+			if (ImGui::InputInt("Refits per full rebuild", (int*) &settings->full_rebuild_interval, 1, 16))
+				if (((int) settings->full_rebuild_interval) < 0) settings->full_rebuild_interval = 0;
+		}
 	}
 	else
 		ImGui::Text("Ray tracing not supported");
+	// Filtering of material textures
+	if (ImGui::Checkbox("Ray cone texture LOD", (bool*) &settings->ray_cone_texture_lod))
+		updates->change_shading = VK_TRUE;
+	if (!settings->ray_cone_texture_lod) {
+		const char* anisotropies[] = { "1x", "2x", "4x", "8x", "16x" };
+		int anisotropy_index = 0;
+		uint32_t max_anisotropy = (settings->max_anisotropy > 0) ? settings->max_anisotropy : 16;
+		for (int i = 1; i != (int) COUNT_OF(anisotropies); ++i)
+			if (max_anisotropy >= (1u << i))
+				anisotropy_index = i;
+		if (ImGui::Combo("Anisotropic filtering", &anisotropy_index, anisotropies, COUNT_OF(anisotropies))) {
+			settings->max_anisotropy = 1u << anisotropy_index;
+			updates->change_shading = VK_TRUE;
+		}
+	}
+	// Packing material textures into texture arrays
+	if (ImGui::Checkbox("Pack material textures", (bool*) &settings->pack_material_textures))
+		updates->reload_scene = VK_TRUE;
+	// Interleaving mesh attributes per triangle changes the shader as well
+	if (ImGui::Checkbox("Interleave mesh attributes", (bool*) &settings->interleave_mesh_attributes))
+		updates->reload_scene = updates->change_shading = VK_TRUE;
+	// So does decoding compressed geometry
+	if (ImGui::Checkbox("Compress geometry", (bool*) &settings->compress_geometry))
+		updates->reload_scene = updates->change_shading = VK_TRUE;
+	// Streaming geometry through a pool of limited size
+	const char* pool_sizes[] = { "Off", "64 MiB", "128 MiB", "256 MiB", "512 MiB", "1 GiB", "2 GiB", "4 GiB" };
+	int pool_size_index = 0;
+	for (int i = 1; i != (int) COUNT_OF(pool_sizes); ++i)
+		if (settings->geometry_pool_size >= (32u << i))
+			pool_size_index = i;
+	if (ImGui::Combo("Geometry streaming", &pool_size_index, pool_sizes, COUNT_OF(pool_sizes))) {
+		settings->geometry_pool_size = (pool_size_index > 0) ? (32u << pool_size_index) : 0;
+		updates->reload_scene = VK_TRUE;
+	}
+	// Streaming mipmaps of material textures with a limited budget
+	pool_size_index = 0;
+	for (int i = 1; i != (int) COUNT_OF(pool_sizes); ++i)
+		if (settings->texture_pool_size >= (32u << i))
+			pool_size_index = i;
+	if (ImGui::Combo("Texture streaming", &pool_size_index, pool_sizes, COUNT_OF(pool_sizes))) {
+		settings->texture_pool_size = (pool_size_index > 0) ? (32u << pool_size_index) : 0;
+		updates->reload_scene = VK_TRUE;
+	}
+	// Levels of detail are selected while recording draws
+	if (app->scene.lod_level_count > 0 || app->scene.stream.file) {
+		ImGui::Checkbox("Select levels of detail", (bool*) &settings->select_lods);
+		if (settings->select_lods)
+			ImGui::DragFloat("LOD error (pixels)", &settings->lod_pixel_error, 0.05f, 0.0f, 100.0f, "%.2f");
+	}
+	// Frustum culling of chunks happens while recording draws
+	ImGui::Checkbox("Frustum culling", (bool*) &settings->cull_chunks);
 	// Switching vertical synchronization
 	if (ImGui::Checkbox("Vsync", (bool*) &settings->v_sync))
 		updates->recreate_swapchain = VK_TRUE;
+	ImGui::Checkbox("Render on demand", (bool*) &settings->render_on_demand);
+	if (ImGui::IsItemHovered())
+		ImGui::SetTooltip("Stops rendering and waits for input while nothing changes.\nAnimated lights count as changes. Animated noise freezes while paused.");
 	// Changing the sample count
 	if (ImGui::InputInt("Sample count", (int*) &settings->sample_count, 1, 10)) {
 		if (settings->sample_count < 1) settings->sample_count = 1;
 		updates->change_shading = VK_TRUE;
 	}
+	// Comparing multiple sampling configurations side by side
+	if (settings->comparison_count < MAX_COMPARISON_CONFIG_COUNT && ImGui::Button("Add sampling settings to comparison")) {
+		comparison_config_t config = { settings->sampling_strategies, settings->mis_heuristic, settings->polygon_sampling_technique, settings->sample_count };
+		settings->comparison_configs[settings->comparison_count] = config;
+		++settings->comparison_count;
+		updates->change_shading = VK_TRUE;
+	}
+	if (settings->comparison_count > 0) {
+		if (ImGui::Button("Clear comparison")) {
+			settings->comparison_count = 0;
+			updates->change_shading = VK_TRUE;
+		}
+		const char* heuristic_names[mis_heuristic_count];
+		heuristic_names[mis_heuristic_balance] = "balance";
+		heuristic_names[mis_heuristic_power] = "power";
+		heuristic_names[mis_heuristic_weighted] = "weighted";
+		heuristic_names[mis_heuristic_optimal_clamped] = "clamped optimal";
+		heuristic_names[mis_heuristic_optimal] = "optimal";
+		for (uint32_t i = 0; i != settings->comparison_count; ++i) {
+			const comparison_config_t* config = &settings->comparison_configs[i];
+			ImGui::Text("Strip %u: %s, %s, %s, %u samples", i + 1, sampling_strategies[config->sampling_strategies],
+				heuristic_names[config->mis_heuristic], polygon_sampling_techniques[config->polygon_sampling_technique], config->sample_count);
+			if (app->frame_queue.timestamps && i < app->shading_pass.comparison_count) {
+				ImGui::SameLine();
+				ImGui::Text("(%.2f ms)", app->frame_queue.comparison_times[i] * 1000.0f);
+			}
+		}
+	}
 	// Source of pseudorandom numbers
 	const char* noise_types[noise_type_full_count];
 	noise_types[noise_type_white] = "White noise";
@@ -233,6 +347,12 @@ void specify_user_interface(application_updates_t* updates, application_t* app,
 	// Polygonal light controls
 	if (ImGui::Checkbox("Show polygonal lights", (bool*) &settings->show_polygonal_lights))
 		updates->change_shading = VK_TRUE;
+	ImGui::DragFloat("Light LOD solid angle", &settings->light_lod_solid_angle, 1.0e-5f, 0.0f, 0.1f, "%.5f sr");
+	if (ImGui::IsItemHovered())
+		ImGui::SetTooltip("Lights subtending a smaller solid angle are shaded as point lights with one shadow ray. 0 disables this.");
+	ImGui::Checkbox("Animate lights", (bool*) &settings->animate_lights);
+	ImGui::SameLine();
+	ImGui::DragFloat("Animation time", &scene->light_animation_time, 0.01f, 0.0f, 1.0e6f, "%.2f s");
 	for (uint32_t i = 0; i < scene->polygonal_light_count; ++i) {
 		char* group_name = format_uint("Polygonal light %u", i);
 		polygonal_light_t* light = &scene->polygonal_lights[i];
@@ -288,6 +408,22 @@ void specify_user_interface(application_updates_t* updates, application_t* app,
 				if (ImGui::Button("Delete light"))
 					light->vertex_count = 0;
 			}
+			// Keyframes capture rotation, translation and radiant flux
+			if (ImGui::Button("Add keyframe")) {
+				add_polygonal_light_keyframe(light);
+				updates->update_light_animation = VK_TRUE;
+			}
+			if (light->keyframe_count > 0) {
+				ImGui::SameLine();
+				if (ImGui::Button("Clear keyframes")) {
+					free(light->keyframes);
+					light->keyframes = NULL;
+					light->keyframe_count = 0;
+					updates->update_light_animation = VK_TRUE;
+				}
+				ImGui::SameLine();
+				ImGui::Text("%u keyframes", light->keyframe_count);
+			}
 			ImGui::TreePop();
 		}
 		free(group_name);
@@ -337,6 +473,19 @@ void specify_user_interface(application_updates_t* updates, application_t* app,
 	ImGui::SameLine();
 	if (ImGui::Button("Quick load"))
 		updates->quick_load = VK_TRUE;
+	// Buttons to record and play camera paths next to the quicksave
+	const char* record_label = (app->camera_path.state == camera_path_state_recording) ? "Stop and save camera path" : "Record camera path";
+	if (ImGui::Button(record_label))
+		updates->record_camera_path = VK_TRUE;
+	if (app->camera_path.state != camera_path_state_recording) {
+		ImGui::SameLine();
+		if (ImGui::Button("Play camera path"))
+			updates->play_camera_path = VK_TRUE;
+	}
+	if (app->camera_path.state == camera_path_state_recording)
+		ImGui::Text("Recorded %u frames", app->camera_path.pose_count);
+	else if (app->camera_path.state == camera_path_state_playing)
+		ImGui::Text("Playing frame %u of %u", app->camera_path.next_frame, app->camera_path.pose_count);
 	// A button to reproduce experiments from the publication
 	if (ImGui::Button("Reproduce experiments"))
 		app->experiment_list.next = 0;
@@ -15,6 +15,7 @@
 
 
 #include "vulkan_basics.h"
+#include "job_system.h"
 #include "string_utilities.h"
 #include "math_utilities.h"
 #include <stdio.h>
@@ -163,6 +164,7 @@ int create_vulkan_device(device_t* device, const char* application_internal_name
 	VkPhysicalDeviceFeatures enabled_features = {
 		.shaderSampledImageArrayDynamicIndexing = VK_TRUE,
 		.samplerAnisotropy = VK_TRUE,
+		.fragmentStoresAndAtomics = VK_TRUE,
 	};
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR acceleration_structure_features = {
 		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR,
@@ -179,6 +181,10 @@ int create_vulkan_device(device_t* device, const char* application_internal_name
 		.descriptorIndexing = VK_TRUE,
 		.uniformAndStorageBuffer8BitAccess = VK_TRUE,
 		.shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+		.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+		.descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+		.descriptorBindingPartiallyBound = VK_TRUE,
+		.runtimeDescriptorArray = VK_TRUE,
 		.bufferDeviceAddress = device->ray_tracing_supported,
 	};
 	VkDeviceCreateInfo device_info = {
@@ -220,6 +226,7 @@ int create_vulkan_device(device_t* device, const char* application_internal_name
 	}
 	// Grab the selected queue
 	vkGetDeviceQueue(device->device, device->queue_family_index, 0, &device->queue);
+	device->submit_thread = create_job_thread();
 	// Give feedback about ray tracing
 	if (device->ray_tracing_supported)
 		printf("Ray tracing is available.\n");
@@ -230,6 +237,7 @@ int create_vulkan_device(device_t* device, const char* application_internal_name
 
 void destroy_vulkan_device(device_t* device) {
 	if (device->command_pool) vkDestroyCommandPool(device->device, device->command_pool, NULL);
+	if (device->submit_thread) destroy_job_thread(device->submit_thread);
 	free(device->queue_family_properties);
 	if (device->device) vkDestroyDevice(device->device, NULL);
 	free(device->physical_devices);
@@ -762,6 +770,41 @@ void destroy_buffers(buffers_t* buffers, const device_t* device) {
 }
 
 
+//! The argument of submit_command_buffer_job()
+typedef struct command_buffer_submission_s {
+	const device_t* device;
+	VkCommandBuffer command_buffer;
+	//! Signaled once the command buffer has executed
+	VkFence fence;
+} command_buffer_submission_t;
+
+
+//! Job for the submit thread of a device that submits a command buffer as
+//! specified by the given command_buffer_submission_t
+int submit_command_buffer_job(void* argument) {
+	command_buffer_submission_t* submission = (command_buffer_submission_t*) argument;
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &submission->command_buffer
+	};
+	return vkQueueSubmit(submission->device->queue, 1, &submit_info, submission->fence) != VK_SUCCESS;
+}
+
+
+int submit_command_buffer(const device_t* device, VkCommandBuffer command_buffer) {
+	command_buffer_submission_t submission = { .device = device, .command_buffer = command_buffer };
+	VkFenceCreateInfo fence_info = { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+	if (vkCreateFence(device->device, &fence_info, NULL, &submission.fence))
+		return 1;
+	// Only the submission takes turns, waiting happens on this thread
+	int result = run_on_job_thread(device->submit_thread, submit_command_buffer_job, &submission)
+		|| vkWaitForFences(device->device, 1, &submission.fence, VK_TRUE, UINT64_MAX);
+	vkDestroyFence(device->device, submission.fence, NULL);
+	return result;
+}
+
+
 int copy_buffers_and_images(const device_t* device,
 	uint32_t buffer_count, const VkBuffer* source_buffers, const VkBuffer* destination_buffers, VkBufferCopy* buffer_regions,
 	uint32_t image_count, const VkImage* source_images, const VkImage* destination_images, VkImageLayout source_layout,
@@ -769,14 +812,25 @@ int copy_buffers_and_images(const device_t* device,
 	uint32_t buffer_to_image_count, const VkBuffer* image_source_buffers, const VkImage* buffer_destination_images,
 	VkImageLayout buffer_destination_layout_before, VkImageLayout buffer_destination_layout_after, VkBufferImageCopy* buffer_to_image_regions)
 {
+	// Command pools must not be used by multiple threads at once, so each
+	// copy gets its own
+	VkCommandPoolCreateInfo command_pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.queueFamilyIndex = device->queue_family_index,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+	};
+	VkCommandPool command_pool;
+	if (vkCreateCommandPool(device->device, &command_pool_info, NULL, &command_pool))
+		return 1;
 	VkCommandBufferAllocateInfo command_buffer_info = {
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
 		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandPool = device->command_pool,
+		.commandPool = command_pool,
 		.commandBufferCount = 1
 	};
 	VkCommandBuffer command_buffer;
 	if (vkAllocateCommandBuffers(device->device, &command_buffer_info, &command_buffer)) {
+		vkDestroyCommandPool(device->device, command_pool, NULL);
 		return 1;
 	}
 	VkCommandBufferBeginInfo begin_info = {
@@ -784,7 +838,7 @@ int copy_buffers_and_images(const device_t* device,
 		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
 	};
 	if (vkBeginCommandBuffer(command_buffer, &begin_info)) {
-		vkFreeCommandBuffers(device->device, device->command_pool, 1, &command_buffer);
+		vkDestroyCommandPool(device->device, command_pool, NULL);
 		return 1;
 	}
 	// Transition all images to transfer source/destination layout
@@ -875,14 +929,9 @@ int copy_buffers_and_images(const device_t* device,
 	free(barriers);
 	// Transfer all images to the requested layouts
 	vkEndCommandBuffer(command_buffer);
-	VkSubmitInfo submit_info = {
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &command_buffer
-	};
-	VkResult result = vkQueueSubmit(device->queue, 1, &submit_info, NULL);
-	result |= vkQueueWaitIdle(device->queue);
-	vkFreeCommandBuffers(device->device, device->command_pool, 1, &command_buffer);
+	int result = submit_command_buffer(device, command_buffer);
+	// Destroying the pool frees the command buffer
+	vkDestroyCommandPool(device->device, command_pool, NULL);
 	return result;
 }
 
@@ -926,7 +975,7 @@ int compile_glsl_shader(shader_t* shader, const device_t* device, const shader_r
 #endif
 	// Delete the prospective output file such that we can verify its existence
 	// to see if the compiler did anything
-	const char* spirv_path_pieces[] = {request->shader_file_path, ".spv"};
+	const char* spirv_path_pieces[] = {request->shader_file_path, request->spirv_path_suffix ? request->spirv_path_suffix : ".spv"};
 	char* spirv_path = concatenate_strings(COUNT_OF(spirv_path_pieces), spirv_path_pieces);
 	remove(spirv_path);
 	// Build the part of the command line for defines
@@ -997,21 +1046,25 @@ int compile_glsl_shader(shader_t* shader, const device_t* device, const shader_r
 
 
 int compile_glsl_shader_with_second_chance(shader_t* shader, const device_t* device, const shader_request_t* request) {
-	while (compile_glsl_shader(shader, device, request)) {
-		printf("Try again (Y/n)? ");
-		char response;
-		scanf("%1c", &response);
-		if (response == 'N' || response == 'n') {
-			printf("\nGiving up.\n");
+	while (compile_glsl_shader(shader, device, request))
+		if (!ask_to_try_again())
 			return 1;
-		}
-		else
-			printf("\nTrying again.\n");
-	}
 	return 0;
 }
 
 
+int ask_to_try_again(void) {
+	printf("Try again (Y/n)? ");
+	char response;
+	if (scanf("%1c", &response) != 1 || response == 'N' || response == 'n') {
+		printf("\nGiving up.\n");
+		return 0;
+	}
+	printf("\nTrying again.\n");
+	return 1;
+}
+
+
 void destroy_shader(shader_t* shader, const device_t* device) {
 	if(shader->module) vkDestroyShaderModule(device->device, shader->module, NULL);
 	free(shader->spirv_code);
@@ -1031,9 +1084,21 @@ int create_descriptor_sets(pipeline_with_bindings_t* pipeline, const device_t* d
 			? request->min_descriptor_count
 			: bindings[i].descriptorCount;
 	}
+	// Check if there are bindings that get updated after binding
+	VkBool32 update_after_bind = VK_FALSE;
+	if (request->binding_flags)
+		for (uint32_t i = 0; i != request->binding_count; ++i)
+			update_after_bind |= (request->binding_flags[i] & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
 	// Create the descriptor set layout
+	VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+		.bindingCount = request->binding_count,
+		.pBindingFlags = request->binding_flags
+	};
 	VkDescriptorSetLayoutCreateInfo descriptor_layout_info = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = request->binding_flags ? &binding_flags_info : NULL,
+		.flags = update_after_bind ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0,
 		.bindingCount = request->binding_count,
 		.pBindings = bindings
 	};
@@ -1066,6 +1131,7 @@ int create_descriptor_sets(pipeline_with_bindings_t* pipeline, const device_t* d
 	free(bindings);
 	VkDescriptorPoolCreateInfo descriptor_pool_info = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = update_after_bind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0,
 		.maxSets = descriptor_set_count,
 		.poolSizeCount = request->binding_count,
 		.pPoolSizes = descriptor_pool_sizes
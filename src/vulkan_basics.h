@@ -68,8 +68,11 @@ typedef struct device_s {
 	uint32_t queue_family_index;
 	//! A queue based on queue_family_index
 	VkQueue queue;
-	//! A command pool for queue
+	//! A command pool for queue. It is only used by one thread at a time.
 	VkCommandPool command_pool;
+	/*! The only thread that submits to queue while loading jobs on different
+		threads upload data concurrently. See submit_command_buffer().*/
+	struct job_thread_s* submit_thread;
 } device_t;
 
 
@@ -204,6 +207,10 @@ typedef struct shader_request_s {
 	//! "IDENTIFIER=VALUE". Do not use white space, these strings go into the
 	//! command line unmodified.
 	char** defines;
+	/*! Appended to shader_file_path to get the path of the compiled SPIR-V
+		code. NULL means ".spv". Shaders that are compiled concurrently need
+		distinct paths.*/
+	char* spirv_path_suffix;
 } shader_request_t;
 
 
@@ -251,6 +258,12 @@ typedef struct descriptor_set_request_s {
 	//! stage_flags and descriptorCount clamped to a minimum of
 	//! min_descriptor_count.
 	VkDescriptorSetLayoutBinding* bindings;
+	//! Optional (may be NULL). If provided, it has binding_count entries with
+	//! flags for each binding, e.g. to allow for partially bound descriptor
+	//! arrays. If any entry includes
+	//! VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT, the layout and the pool
+	//! are created with the matching flags.
+	const VkDescriptorBindingFlags* binding_flags;
 } descriptor_set_request_t;
 
 
@@ -412,8 +425,17 @@ static inline VkDeviceSize get_mapped_memory_range_size(const device_t* device,
 }
 
 
+/*! Submits the given ended command buffer to device->queue and waits for its
+	execution to finish. The submission happens on device->submit_thread and
+	the wait uses a fence of the calling thread, so that many threads may call
+	this at once and their work overlaps on the device.
+	\return 0 on success.*/
+int submit_command_buffer(const device_t* device, VkCommandBuffer command_buffer);
+
 /*! Implements copy_buffers(), copy_images() and copy_buffers_to_images() using
-	a single command buffer.*/
+	a single command buffer. The command buffer comes from its own command pool
+	and gets submitted by submit_command_buffer(), so that different threads can
+	copy concurrently.*/
 int copy_buffers_and_images(const device_t* device,
 	uint32_t buffer_count, const VkBuffer* source_buffers, const VkBuffer* destination_buffers, VkBufferCopy* buffer_regions,
 	uint32_t image_count, const VkImage* source_images, const VkImage* destination_images, VkImageLayout source_layout,
@@ -503,18 +525,26 @@ static inline int copy_buffers_to_images(const device_t* device,
 	\param device The used device.
 	\param shader_request All attributes characterizing the shader to compile
 	\return 0 on success.
-	\note This function creates a file with extension .spv next to the given
-		shader. If it existed before, it is overwritten without prompt.
+	\note This function creates a file with extension .spv (or
+		shader_request_t.spirv_path_suffix) next to the given shader. If it
+		existed before, it is overwritten without prompt.
 	\note The debug build compiles shaders in a way that is optimal for
 		debugging, the release build optimizes for speed.*/
 int compile_glsl_shader(shader_t* shader, const device_t* device, const shader_request_t* request);
 
 /*! Forwards to compile_glsl_shader(). Upon failure, it keeps asking on the
 	console whether another attempt should be made until the user declines or
-	the shader has been fixed.
+	the shader has been fixed. Since it blocks on console input, jobs use
+	compile_glsl_shader() instead and failed jobs get retried afterwards.
 	\return 0 if compilation succeeded (after any number of tries).*/
 int compile_glsl_shader_with_second_chance(shader_t* shader, const device_t* device, const shader_request_t* request);
 
+/*! Asks on the console whether a failed operation should be attempted again,
+	e.g. after a shader has been fixed.
+	\return 1 if the user wants another attempt, 0 if the user declines or
+		the console has no more input.*/
+int ask_to_try_again(void);
+
 //! Frees and nulls the given shader
 void destroy_shader(shader_t* shader, const device_t* device);
 
@@ -0,0 +1,170 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*! \file
+	A command line tool that compares a benchmark report written by the
+	renderer in benchmark mode (vulkan_renderer -benchmark <report.csv>)
+	against a baseline report. Each line of either file is "name,milliseconds"
+	and lines of the baseline may add a third column with a relative
+	tolerance that overrides the default. The tool prints a table of all
+	metrics and exits with a non-zero code if any metric got slower than its
+	tolerance permits or is missing from the report, such that automated
+	builds can fail on performance regressions.*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//! Names of metrics may be at most this long (including the terminator)
+#define METRIC_NAME_LENGTH 256
+
+
+//! A single timing from a report
+typedef struct metric_s {
+	//! The name of the metric, e.g. frame_time_technique_4
+	char name[METRIC_NAME_LENGTH];
+	//! The measured time in milliseconds
+	double time;
+	//! The relative tolerance given in the file or a negative value if there
+	//! is none
+	double tolerance;
+} metric_t;
+
+
+//! A list of metrics loaded from a report
+typedef struct report_s {
+	//! Number of metrics
+	size_t count;
+	//! Array of count metrics
+	metric_t* metrics;
+} report_t;
+
+
+//! Frees memory and zeros the object
+void destroy_report(report_t* report) {
+	free(report->metrics);
+	memset(report, 0, sizeof(*report));
+}
+
+
+/*! Loads all metrics from the report at the given path. Empty lines and lines
+	that start with # are ignored.
+	\return 0 on success.*/
+int load_report(report_t* report, const char* path) {
+	memset(report, 0, sizeof(*report));
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		printf("Failed to open the report at %s.\n", path);
+		return 1;
+	}
+	size_t capacity = 0;
+	char line[1024];
+	uint32_t line_index = 0;
+	while (fgets(line, sizeof(line), file)) {
+		++line_index;
+		if (line[0] == '\n' || line[0] == '\r' || line[0] == '#' || line[0] == '\0')
+			continue;
+		metric_t metric;
+		metric.tolerance = -1.0;
+		if (sscanf(line, "%255[^,],%lf,%lf", metric.name, &metric.time, &metric.tolerance) < 2) {
+			printf("Line %u of %s is not of the form name,milliseconds[,tolerance].\n", line_index, path);
+			fclose(file);
+			destroy_report(report);
+			return 1;
+		}
+		if (report->count == capacity) {
+			capacity = (capacity > 0) ? (2 * capacity) : 64;
+			report->metrics = realloc(report->metrics, sizeof(metric_t) * capacity);
+		}
+		report->metrics[report->count] = metric;
+		++report->count;
+	}
+	fclose(file);
+	return 0;
+}
+
+
+//! Returns the metric with the given name in the given report or NULL if it
+//! does not exist
+const metric_t* find_metric(const report_t* report, const char* name) {
+	for (size_t i = 0; i != report->count; ++i)
+		if (strcmp(report->metrics[i].name, name) == 0)
+			return &report->metrics[i];
+	return NULL;
+}
+
+
+int main(int argc, char** argv) {
+	// Parse command line arguments
+	double tolerance = 0.1;
+	double noise_floor = 0.05;
+	int valid = (argc >= 3);
+	for (int i = 3; i < argc && valid; ++i) {
+		double value = 0.0;
+		valid &= (i + 1 < argc && sscanf(argv[i + 1], "%lf", &value) == 1 && value >= 0.0);
+		if (!valid) break;
+		if (strcmp(argv[i], "-tolerance") == 0) tolerance = value;
+		else if (strcmp(argv[i], "-noise_floor") == 0) noise_floor = value;
+		else valid = 0;
+		++i;
+	}
+	if (!valid) {
+		printf("Usage: benchmark_compare <baseline.csv> <report.csv> [options]\n");
+		printf("Options (each followed by a number):\n\
+-tolerance    Default relative slowdown that is tolerated (default 0.1)\n\
+-noise_floor  Slowdowns up to this many milliseconds are always tolerated (default 0.05)\n");
+		printf("The exit code is 1 if any metric of the baseline got slower or is missing.\n");
+		return 1;
+	}
+	report_t baseline, report;
+	if (load_report(&baseline, argv[1]))
+		return 1;
+	if (load_report(&report, argv[2])) {
+		destroy_report(&baseline);
+		return 1;
+	}
+	// Compare all metrics of the baseline
+	uint32_t regression_count = 0;
+	printf("%-40s %12s %12s %9s\n", "Metric", "Baseline", "Current", "Change");
+	for (size_t i = 0; i != baseline.count; ++i) {
+		const metric_t* reference = &baseline.metrics[i];
+		const metric_t* current = find_metric(&report, reference->name);
+		if (!current) {
+			printf("%-40s %9.4f ms %12s %9s MISSING\n", reference->name, reference->time, "-", "-");
+			++regression_count;
+			continue;
+		}
+		double metric_tolerance = (reference->tolerance >= 0.0) ? reference->tolerance : tolerance;
+		double limit = reference->time * (1.0 + metric_tolerance) + noise_floor;
+		double change = (reference->time > 0.0) ? (100.0 * (current->time - reference->time) / reference->time) : 0.0;
+		int regressed = (current->time > limit);
+		printf("%-40s %9.4f ms %9.4f ms %+8.1f%%%s\n", reference->name, reference->time, current->time, change, regressed ? " REGRESSION" : "");
+		regression_count += regressed;
+	}
+	// Metrics that are new in the report are listed without judgement
+	for (size_t i = 0; i != report.count; ++i)
+		if (!find_metric(&baseline, report.metrics[i].name))
+			printf("%-40s %12s %9.4f ms %9s NEW\n", report.metrics[i].name, "-", report.metrics[i].time, "-");
+	if (regression_count > 0)
+		printf("%u of %u metrics regressed.\n", regression_count, (uint32_t) baseline.count);
+	else
+		printf("No regressions in %u metrics.\n", (uint32_t) baseline.count);
+	destroy_report(&baseline);
+	destroy_report(&report);
+	return (regression_count > 0) ? 1 : 0;
+}
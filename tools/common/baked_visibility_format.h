@@ -0,0 +1,85 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*! \file The format of files with baked visibility between the triangles of
+	a scene (*.vks) and the polygonal lights of a quicksave. They are written
+	by the visibility_baker tool and read by the renderer. The file path is
+	the path of the quicksave followed by ".vis".
+
+	After the marker, the version and a baked_visibility_header_t, there is
+	one uint32_t per triangle and light, ordered by triangle first. Its three
+	least significant bytes hold the visibility of the light from the three
+	vertices of the triangle, the most significant byte is zero. A value of 0
+	means that all samples on the light are occluded, 255 means that all are
+	visible and anything in between encodes a partial visibility (see
+	encode_baked_visibility()). The end of file marker of *.vks files
+	follows.*/
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+
+//! The value of the first four bytes of each *.vis file
+#define BAKED_VISIBILITY_FILE_MARKER 0xb15b15
+//! The file format version
+#define BAKED_VISIBILITY_FILE_VERSION 1
+
+
+//! Meta-data at the beginning of a *.vis file after the marker and version
+typedef struct baked_visibility_header_s {
+	//! The number of triangles of the scene file, excluding levels of detail
+	uint64_t triangle_count;
+	//! The number of polygonal lights in the quicksave
+	uint32_t light_count;
+	//! The number of samples per light and vertex used for baking
+	uint32_t sample_count;
+	//! The result of get_polygonal_light_geometry_hash() for the lights of
+	//! the quicksave. If the lights change, the file is outdated.
+	uint64_t light_hash;
+} baked_visibility_header_t;
+
+
+/*! Turns the number of visible samples out of the given total into a byte.
+	Only complete visibility or occlusion map to 255 or 0, respectively. If no
+	samples were taken, the result indicates partial visibility.*/
+static inline uint8_t encode_baked_visibility(uint32_t visible_count, uint32_t total_count) {
+	if (total_count == 0) return 128;
+	if (visible_count == 0) return 0;
+	if (visible_count == total_count) return 255;
+	uint32_t encoded = 1 + (253 * visible_count) / total_count;
+	return (uint8_t) ((encoded < 254) ? encoded : 254);
+}
+
+
+/*! Reads the marker, version and header of a *.vis file. Afterwards, the file
+	position is at the start of the visibility data.
+	\return 0 on success.*/
+static inline int read_baked_visibility_header(FILE* file, baked_visibility_header_t* header) {
+	uint32_t marker_and_version[2] = { 0, 0 };
+	return fread(marker_and_version, sizeof(uint32_t), 2, file) != 2
+		|| marker_and_version[0] != BAKED_VISIBILITY_FILE_MARKER
+		|| marker_and_version[1] != BAKED_VISIBILITY_FILE_VERSION
+		|| fread(header, sizeof(*header), 1, file) != 1;
+}
+
+
+//! Writes the marker, version and header of a *.vis file
+//! \return 0 on success.
+static inline int write_baked_visibility_header(FILE* file, const baked_visibility_header_t* header) {
+	uint32_t marker_and_version[2] = { BAKED_VISIBILITY_FILE_MARKER, BAKED_VISIBILITY_FILE_VERSION };
+	return fwrite(marker_and_version, sizeof(uint32_t), 2, file) != 2
+		|| fwrite(header, sizeof(*header), 1, file) != 1;
+}
@@ -0,0 +1,128 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*! \file A minimal fork-join abstraction over Win32 threads and pthreads for
+	the command line tools. C99 has no threads of its own.*/
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+
+//! Signature of functions that can be run on many threads using
+//! run_in_parallel()
+typedef void (*tool_thread_function_t)(void* argument);
+
+
+//! The arguments of a single thread started by run_in_parallel()
+typedef struct tool_thread_s {
+	tool_thread_function_t function;
+	void* argument;
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+} tool_thread_t;
+
+
+#ifdef _WIN32
+static DWORD WINAPI tool_thread_entry(LPVOID thread) {
+	((tool_thread_t*) thread)->function(((tool_thread_t*) thread)->argument);
+	return 0;
+}
+#else
+static void* tool_thread_entry(void* thread) {
+	((tool_thread_t*) thread)->function(((tool_thread_t*) thread)->argument);
+	return NULL;
+}
+#endif
+
+
+//! Returns the number of hardware threads available on this machine (at least
+//! one)
+static inline uint32_t get_hardware_thread_count(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0) ? (uint32_t) info.dwNumberOfProcessors : 1;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (uint32_t) count : 1;
+#endif
+}
+
+
+/*! Invokes the given function thread_count times in parallel. Invocation i
+	receives the pointer arguments + i * argument_size. Returns once all
+	invocations have returned. If a thread cannot be created, its work is
+	done on the calling thread instead.*/
+static inline void run_in_parallel(uint32_t thread_count, tool_thread_function_t function, void* arguments, size_t argument_size) {
+	tool_thread_t* threads = (tool_thread_t*) malloc(sizeof(tool_thread_t) * thread_count);
+	int* started = (int*) malloc(sizeof(int) * thread_count);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		threads[i].function = function;
+		threads[i].argument = ((char*) arguments) + i * argument_size;
+		// The first invocation always runs on the calling thread
+		if (i == 0)
+			started[i] = 0;
+		else {
+#ifdef _WIN32
+			threads[i].handle = CreateThread(NULL, 0, tool_thread_entry, &threads[i], 0, NULL);
+			started[i] = (threads[i].handle != NULL);
+#else
+			started[i] = (pthread_create(&threads[i].handle, NULL, tool_thread_entry, &threads[i]) == 0);
+#endif
+		}
+	}
+	for (uint32_t i = 0; i != thread_count; ++i)
+		if (!started[i])
+			function(threads[i].argument);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		if (!started[i]) continue;
+#ifdef _WIN32
+		WaitForSingleObject(threads[i].handle, INFINITE);
+		CloseHandle(threads[i].handle);
+#else
+		pthread_join(threads[i].handle, NULL);
+#endif
+	}
+	free(started);
+	free(threads);
+}
+
+
+//! Returns a monotonic time stamp in seconds for measurement of durations
+static inline double get_tool_time(void) {
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (double) time.tv_sec + 1.0e-9 * (double) time.tv_nsec;
+#endif
+}
@@ -0,0 +1,481 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*! \file Utilities shared by all command line tools that read or write scene
+	files (*.vks). The encodings match those of the Blender exporter
+	(io_export_vulkan_blender28.py) bit for bit and the decoding in
+	mesh_quantization.glsl.*/
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+//! The value of the first four bytes of each *.vks file
+#define VKS_FILE_MARKER 0xabcabc
+//! The file format version written by the tools for files without chunks
+#define VKS_FILE_VERSION 1
+//! The file format version for files with a section of chunks. The header
+//! holds a chunk count after the triangle count. \see vks_chunk_t
+#define VKS_FILE_VERSION_CHUNKS 2
+/*! The file format version for files with compressed geometry (and an
+	optional section of chunks). The header holds a chunk count, a meshlet
+	vertex count and a meshlet position word count after the triangle count.
+	\see vks_layout_t.meshlets*/
+#define VKS_FILE_VERSION_MESHLETS 3
+/*! The file format version for files with simplified levels of detail for
+	each chunk. The header holds the counts of version 3 (where the meshlet
+	vertex count may be zero), the number of levels of detail per chunk and
+	the number of triangles in all of them. \see vks_chunk_lod_t*/
+#define VKS_FILE_VERSION_LODS 4
+//! The number of consecutive triangles that form one meshlet of compressed
+//! geometry. Only the last meshlet may have fewer triangles.
+#define VKS_MESHLET_TRIANGLE_COUNT 64
+//! The minimal number of bits per coordinate for positions in meshlets
+#define VKS_MESHLET_MIN_POSITION_BITS 10
+//! The value of the last four bytes of each *.vks file (and *.vkt file)
+#define VKS_EOF_MARKER 0xe0fe0f
+//! Material indices are stored as 8-bit integers, so there can be at most this
+//! many materials
+#define VKS_MAX_MATERIAL_COUNT 256
+
+
+//! Seeks to the given absolute offset. *.vks files can be larger than 2 GiB,
+//! so we need 64-bit offsets on all platforms.
+#ifdef _WIN32
+#define vks_fseek(FILE, OFFSET) _fseeki64(FILE, (__int64) (OFFSET), SEEK_SET)
+#else
+#define vks_fseek(FILE, OFFSET) fseeko(FILE, (off_t) (OFFSET), SEEK_SET)
+#endif
+
+
+/*! Meta-data at the beginning of a *.vks file, excluding the marker, the
+	version and the material names.*/
+typedef struct vks_header_s {
+	//! The number of materials and triangles in the scene
+	uint64_t material_count, triangle_count;
+	//! The number of entries in the chunk section. If it is zero, the file
+	//! has no chunk section.
+	uint64_t chunk_count;
+	//! The number of vertices in the compressed geometry sections. If it is
+	//! zero, the file uses version 1 or 2 and has no compressed geometry.
+	uint64_t meshlet_vertex_count;
+	//! The number of uint32_t in the section with positions of meshlets
+	uint64_t meshlet_position_word_count;
+	//! The number of simplified levels of detail per chunk (excluding the
+	//! full-resolution chunk). If it is zero, the file has a version below 4.
+	uint64_t lod_level_count;
+	//! The total number of triangles in the sections for levels of detail
+	uint64_t lod_triangle_count;
+	//! Constants to turn 21-bit quantized positions into world space
+	//! positions. \see mesh_t in scene.h
+	float dequantization_factor[3], dequantization_summand[3];
+} vks_header_t;
+
+
+/*! A contiguous range of triangles with a bounding box that encloses them.
+	Files of version 2 partition all triangles into such chunks and store
+	them after the material indices. Matches mesh_chunk_t in scene.h.*/
+typedef struct vks_chunk_s {
+	//! The index of the first triangle and the number of triangles
+	uint64_t first_triangle, triangle_count;
+	//! The world space bounding box of all dequantized vertex positions
+	float box_min[3], box_max[3];
+} vks_chunk_t;
+
+
+/*! A simplified version of a chunk. Files of version 4 store lod_level_count
+	of them per chunk, starting with the finest level. Vertices on the
+	boundary of a chunk are never moved or removed, so neighboring chunks can
+	use different levels without cracks. Matches mesh_chunk_lod_t in scene.h.*/
+typedef struct vks_chunk_lod_s {
+	/*! The index of the first triangle and the number of triangles. Indices
+		refer to the concatenation of the regular sections and the sections
+		for levels of detail, i.e. the first triangle is at least
+		triangle_count, unless the chunk could not be simplified at all. Then
+		the level refers to the original triangles of the chunk. Levels that
+		could not be simplified further share the triangles of the previous
+		level.*/
+	uint64_t first_triangle, triangle_count;
+	//! An estimate of the maximal distance between the simplified surface and
+	//! the original surface in world space
+	float error;
+	//! Unused, always zero
+	uint32_t padding;
+} vks_chunk_lod_t;
+
+
+/*! Byte offsets of the individual sections of a *.vks file. They are fully
+	determined by the header and the material names.*/
+typedef struct vks_layout_s {
+	//! 2 * 3 * triangle_count uint32_t holding quantized positions
+	uint64_t positions;
+	//! 4 * 3 * triangle_count uint16_t holding normals and texture coordinates
+	uint64_t normals_and_tex_coords;
+	//! triangle_count uint8_t holding material indices
+	uint64_t material_indices;
+	//! chunk_count vks_chunk_t (only present if chunk_count > 0)
+	uint64_t chunks;
+	/*! The sections with compressed geometry, which are only present if
+		meshlet_vertex_count > 0. The mesh is split into meshlets of
+		VKS_MESHLET_TRIANGLE_COUNT consecutive triangles. For each meshlet,
+		there are four uint32_t:
+		- The index of its first vertex,
+		- The index of its first word in meshlet_positions in the 27 least
+		  significant bits and the bit count per coordinate (between
+		  VKS_MESHLET_MIN_POSITION_BITS and 21) in the 5 most significant
+		  bits,
+		- The minimum of its quantized positions packed like in positions.*/
+	uint64_t meshlets;
+	/*! meshlet_position_word_count uint32_t. For each meshlet, a bit stream
+		starting at a word boundary holds x, y, z of each vertex relative to
+		the minimum of the meshlet using the bit count of the meshlet. Bits
+		are consumed from least to most significant. All meshlets are
+		lossless. The last word is padding, such that two consecutive words
+		can always be read.*/
+	uint64_t meshlet_positions;
+	//! meshlet_vertex_count times four uint16_t with a normal and texture
+	//! coordinate, encoded like in normals_and_tex_coords
+	uint64_t meshlet_attributes;
+	/*! triangle_count uint32_t. The three least significant bytes are
+		indices of the triangle vertices relative to the first vertex of its
+		meshlet, the most significant byte is the material index.*/
+	uint64_t meshlet_triangles;
+	//! chunk_count * lod_level_count vks_chunk_lod_t (only present if
+	//! lod_level_count > 0)
+	uint64_t chunk_lods;
+	//! Like positions, normals_and_tex_coords and material_indices but for
+	//! the lod_triangle_count triangles of all levels of detail
+	uint64_t lod_positions, lod_normals_and_tex_coords, lod_material_indices;
+	//! The end of file marker
+	uint64_t eof_marker;
+	//! The total file size in bytes
+	uint64_t file_size;
+} vks_layout_t;
+
+
+//! Returns the number of meshlets needed for the given number of triangles
+static inline uint64_t get_vks_meshlet_count(uint64_t triangle_count) {
+	return (triangle_count + VKS_MESHLET_TRIANGLE_COUNT - 1) / VKS_MESHLET_TRIANGLE_COUNT;
+}
+
+
+//! Returns the oldest file format version that can represent a file with the
+//! given header
+static inline uint32_t get_vks_file_version(const vks_header_t* header) {
+	if (header->lod_level_count > 0) return VKS_FILE_VERSION_LODS;
+	if (header->meshlet_vertex_count > 0) return VKS_FILE_VERSION_MESHLETS;
+	if (header->chunk_count > 0) return VKS_FILE_VERSION_CHUNKS;
+	return VKS_FILE_VERSION;
+}
+
+
+//! Computes the layout of a *.vks file with the given header and material
+//! names
+static inline vks_layout_t get_vks_layout(const vks_header_t* header, const char* const* material_names) {
+	vks_layout_t layout;
+	uint32_t version = get_vks_file_version(header);
+	layout.positions = 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + 6 * sizeof(float);
+	layout.positions += (version >= VKS_FILE_VERSION_CHUNKS) ? sizeof(uint64_t) : 0;
+	layout.positions += (version >= VKS_FILE_VERSION_MESHLETS) ? (2 * sizeof(uint64_t)) : 0;
+	layout.positions += (version >= VKS_FILE_VERSION_LODS) ? (2 * sizeof(uint64_t)) : 0;
+	for (uint64_t i = 0; i != header->material_count; ++i)
+		layout.positions += sizeof(uint64_t) + strlen(material_names[i]) + 1;
+	layout.normals_and_tex_coords = layout.positions + header->triangle_count * 3 * 2 * sizeof(uint32_t);
+	layout.material_indices = layout.normals_and_tex_coords + header->triangle_count * 3 * 4 * sizeof(uint16_t);
+	layout.chunks = layout.material_indices + header->triangle_count * sizeof(uint8_t);
+	layout.meshlets = layout.chunks + header->chunk_count * sizeof(vks_chunk_t);
+	uint64_t meshlet_count = (header->meshlet_vertex_count > 0) ? get_vks_meshlet_count(header->triangle_count) : 0;
+	layout.meshlet_positions = layout.meshlets + meshlet_count * 4 * sizeof(uint32_t);
+	layout.meshlet_attributes = layout.meshlet_positions + header->meshlet_position_word_count * sizeof(uint32_t);
+	layout.meshlet_triangles = layout.meshlet_attributes + header->meshlet_vertex_count * 4 * sizeof(uint16_t);
+	layout.chunk_lods = layout.meshlet_triangles + ((meshlet_count > 0) ? header->triangle_count : 0) * sizeof(uint32_t);
+	layout.lod_positions = layout.chunk_lods + header->chunk_count * header->lod_level_count * sizeof(vks_chunk_lod_t);
+	layout.lod_normals_and_tex_coords = layout.lod_positions + header->lod_triangle_count * 3 * 2 * sizeof(uint32_t);
+	layout.lod_material_indices = layout.lod_normals_and_tex_coords + header->lod_triangle_count * 3 * 4 * sizeof(uint16_t);
+	layout.eof_marker = layout.lod_material_indices + header->lod_triangle_count * sizeof(uint8_t);
+	layout.file_size = layout.eof_marker + sizeof(uint32_t);
+	return layout;
+}
+
+
+/*! Computes constants for quantization of positions within the given bounding
+	box to 21 bits per coordinate and for the corresponding dequantization.
+	Degenerate boxes are handled gracefully.*/
+static inline void get_vks_quantization(float quantization_factor[3], float quantization_summand[3], vks_header_t* header, const float box_min[3], const float box_max[3]) {
+	for (uint32_t i = 0; i != 3; ++i) {
+		float extent = box_max[i] - box_min[i];
+		extent = (extent > 0.0f) ? extent : 1.0f;
+		quantization_factor[i] = 2097152.0f / extent;
+		quantization_summand[i] = -box_min[i] * quantization_factor[i];
+		header->dequantization_factor[i] = 1.0f / quantization_factor[i];
+		header->dequantization_summand[i] = box_min[i] + 0.5f * header->dequantization_factor[i];
+	}
+}
+
+
+//! Quantizes the given position to 21 bits per coordinate and packs it into
+//! two 32-bit integers
+static inline void quantize_position_64_bit(uint32_t packed[2], const float position[3], const float quantization_factor[3], const float quantization_summand[3]) {
+	uint32_t quantized[3];
+	for (uint32_t i = 0; i != 3; ++i) {
+		float value = position[i] * quantization_factor[i] + quantization_summand[i];
+		value = (value > 0.0f) ? value : 0.0f;
+		quantized[i] = (uint32_t) value;
+		quantized[i] = (quantized[i] < 0x1FFFFF) ? quantized[i] : 0x1FFFFF;
+	}
+	packed[0] = quantized[0] | ((quantized[1] & 0x7FF) << 21);
+	packed[1] = ((quantized[1] & 0x1FF800) >> 11) | (quantized[2] << 10);
+}
+
+
+//! Extracts the three 21-bit integers from a position packed by
+//! quantize_position_64_bit()
+static inline void unpack_position_64_bit(uint32_t quantized[3], const uint32_t packed[2]) {
+	quantized[0] = packed[0] & 0x1FFFFF;
+	quantized[1] = ((packed[0] & 0xFFE00000) >> 21) | ((packed[1] & 0x3FF) << 11);
+	quantized[2] = (packed[1] & 0x7FFFFC00) >> 10;
+}
+
+
+//! Inverse of quantize_position_64_bit()
+static inline void dequantize_position_64_bit(float position[3], const uint32_t packed[2], const float dequantization_factor[3], const float dequantization_summand[3]) {
+	uint32_t quantized[3];
+	unpack_position_64_bit(quantized, packed);
+	for (uint32_t i = 0; i != 3; ++i)
+		position[i] = quantized[i] * dequantization_factor[i] + dequantization_summand[i];
+}
+
+
+/*! Encodes the given normal vector (which does not have to be normalized but
+	must not be zero) into two 16-bit UNORMs using an octahedral map.*/
+static inline void encode_normal_32_bit(uint16_t encoded[2], const float normal[3]) {
+	// Project the sphere onto the octahedron, and then onto the xy plane
+	float norm = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	norm = (norm > 0.0f) ? norm : 1.0f;
+	float octahedral[2] = { normal[0] / norm, normal[1] / norm };
+	// Reflect the folds of the lower hemisphere over the diagonals
+	if (normal[2] <= 0.0f) {
+		float folded[2] = {
+			(1.0f - fabsf(octahedral[1])) * ((octahedral[0] >= 0.0f) ? 1.0f : -1.0f),
+			(1.0f - fabsf(octahedral[0])) * ((octahedral[1] >= 0.0f) ? 1.0f : -1.0f),
+		};
+		octahedral[0] = folded[0];
+		octahedral[1] = folded[1];
+	}
+	// -1, 0 and 1 are represented exactly and the truncation rounds to nearest
+	const float factor = 32767.0f;
+	const float summand = factor + 1.5f;
+	for (uint32_t i = 0; i != 2; ++i)
+		encoded[i] = (uint16_t) (octahedral[i] * factor + summand);
+}
+
+
+/*! Inverts encode_normal_32_bit() like decode_normal_32_bit() in
+	mesh_quantization.glsl. The output is normalized.*/
+static inline void decode_normal_32_bit(float normal[3], const uint16_t encoded[2]) {
+	// -1.0f corresponds to the second-smallest fixed point number
+	const float factor = 1.0f / 32767.0f;
+	const float summand = -32768.0f / 32767.0f;
+	float octahedral[2] = { encoded[0] * factor + summand, encoded[1] * factor + summand };
+	// Undo the octahedral map
+	normal[0] = octahedral[0];
+	normal[1] = octahedral[1];
+	normal[2] = 1.0f - fabsf(octahedral[0]) - fabsf(octahedral[1]);
+	if (normal[2] < 0.0f) {
+		normal[0] = (1.0f - fabsf(octahedral[1])) * ((octahedral[0] >= 0.0f) ? 1.0f : -1.0f);
+		normal[1] = (1.0f - fabsf(octahedral[0])) * ((octahedral[1] >= 0.0f) ? 1.0f : -1.0f);
+	}
+	float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	for (uint32_t i = 0; i != 3; ++i)
+		normal[i] /= length;
+}
+
+
+/*! Encodes texture coordinates for the three vertices of a triangle into
+	16-bit UNORMs. An integer offset is subtracted such that the smallest
+	coordinates are in [0,1), up to eight repetitions within a triangle are
+	supported, additional ones get clamped.
+	\return 1 if clamping was needed, 0 otherwise.*/
+static inline int encode_triangle_tex_coords(uint16_t encoded[3][2], const float tex_coords[3][2]) {
+	int clamped = 0;
+	for (uint32_t j = 0; j != 2; ++j) {
+		float min = tex_coords[0][j];
+		min = (tex_coords[1][j] < min) ? tex_coords[1][j] : min;
+		min = (tex_coords[2][j] < min) ? tex_coords[2][j] : min;
+		float offset = floorf(min);
+		for (uint32_t i = 0; i != 3; ++i) {
+			float value = (tex_coords[i][j] - offset) * (65535.0f / 8.0f) + 0.5f;
+			clamped |= (value > 65535.0f);
+			value = (value < 65535.0f) ? value : 65535.0f;
+			encoded[i][j] = (uint16_t) value;
+		}
+	}
+	return clamped;
+}
+
+
+//! Inserts two zero bits between any two of the ten least significant bits of
+//! the given integer. Higher bits are truncated.
+static inline uint32_t part_1_by_2(uint32_t x) {
+	x &= 0x000003ff;
+	x = (x ^ (x << 16)) & 0xff0000ff;
+	x = (x ^ (x << 8)) & 0x0300f00f;
+	x = (x ^ (x << 4)) & 0x030c30c3;
+	x = (x ^ (x << 2)) & 0x09249249;
+	return x;
+}
+
+
+//! Computes a 30-bit Morton code for the given position within the given
+//! bounding box
+static inline uint32_t get_morton_code_3d(const float position[3], const float box_min[3], const float box_max[3]) {
+	uint32_t result = 0;
+	for (uint32_t i = 0; i != 3; ++i) {
+		float extent = box_max[i] - box_min[i];
+		float value = (extent > 0.0f) ? ((position[i] - box_min[i]) * (1024.0f / extent)) : 0.0f;
+		value = (value > 0.0f) ? value : 0.0f;
+		value = (value < 1023.0f) ? value : 1023.0f;
+		result |= part_1_by_2((uint32_t) value) << i;
+	}
+	return result;
+}
+
+
+/*! Produces a permutation that sorts the given 30-bit Morton codes in
+	ascending order using a stable radix sort with three passes over ten bits.
+	\param order Receives count indices such that codes[order[i]] is
+		ascending in i. Ties retain the original order.
+	\param codes The Morton codes. Overwritten by scratch data.
+	\param count The number of codes. Must be less than 2^32.*/
+static inline void sort_morton_codes(uint32_t* order, uint32_t* codes, uint64_t count) {
+	uint32_t* scratch_codes = (uint32_t*) malloc(sizeof(uint32_t) * count);
+	uint32_t* scratch_order = (uint32_t*) malloc(sizeof(uint32_t) * count);
+	for (uint64_t i = 0; i != count; ++i)
+		order[i] = (uint32_t) i;
+	uint32_t* source_codes = codes, *source_order = order, *target_codes = scratch_codes, *target_order = scratch_order;
+	for (uint32_t shift = 0; shift != 30; shift += 10) {
+		uint64_t offsets[1024];
+		memset(offsets, 0, sizeof(offsets));
+		for (uint64_t i = 0; i != count; ++i)
+			++offsets[(source_codes[i] >> shift) & 0x3FF];
+		uint64_t sum = 0;
+		for (uint32_t i = 0; i != 1024; ++i) {
+			uint64_t bucket_size = offsets[i];
+			offsets[i] = sum;
+			sum += bucket_size;
+		}
+		for (uint64_t i = 0; i != count; ++i) {
+			uint64_t target = offsets[(source_codes[i] >> shift) & 0x3FF]++;
+			target_codes[target] = source_codes[i];
+			target_order[target] = source_order[i];
+		}
+		uint32_t* swap = source_codes; source_codes = target_codes; target_codes = swap;
+		swap = source_order; source_order = target_order; target_order = swap;
+	}
+	// After an odd number of passes, the result is in scratch memory
+	if (source_order != order)
+		memcpy(order, source_order, sizeof(uint32_t) * count);
+	free(scratch_codes);
+	free(scratch_order);
+}
+
+
+/*! Writes the file marker, version, header and material names to the
+	beginning of the given file. Afterwards, the file position is at
+	vks_layout_t.positions.
+	\return 0 on success.*/
+static inline int write_vks_header(FILE* file, const vks_header_t* header, const char* const* material_names) {
+	uint32_t version = get_vks_file_version(header);
+	uint32_t marker_and_version[2] = { VKS_FILE_MARKER, version };
+	if (fwrite(marker_and_version, sizeof(uint32_t), 2, file) != 2
+		|| fwrite(&header->material_count, sizeof(uint64_t), 1, file) != 1
+		|| fwrite(&header->triangle_count, sizeof(uint64_t), 1, file) != 1
+		|| (version >= VKS_FILE_VERSION_CHUNKS && fwrite(&header->chunk_count, sizeof(uint64_t), 1, file) != 1)
+		|| (version >= VKS_FILE_VERSION_MESHLETS && (fwrite(&header->meshlet_vertex_count, sizeof(uint64_t), 1, file) != 1
+			|| fwrite(&header->meshlet_position_word_count, sizeof(uint64_t), 1, file) != 1))
+		|| (version >= VKS_FILE_VERSION_LODS && (fwrite(&header->lod_level_count, sizeof(uint64_t), 1, file) != 1
+			|| fwrite(&header->lod_triangle_count, sizeof(uint64_t), 1, file) != 1))
+		|| fwrite(header->dequantization_factor, sizeof(float), 3, file) != 3
+		|| fwrite(header->dequantization_summand, sizeof(float), 3, file) != 3)
+		return 1;
+	for (uint64_t i = 0; i != header->material_count; ++i) {
+		uint64_t length = strlen(material_names[i]);
+		if (fwrite(&length, sizeof(uint64_t), 1, file) != 1
+			|| fwrite(material_names[i], sizeof(char), length + 1, file) != length + 1)
+			return 1;
+	}
+	return 0;
+}
+
+
+/*! Reads the file marker, version and header of a *.vks file and allocates
+	the material names. On success, the calling side has to free each material
+	name and the array. Afterwards, the file position is at
+	vks_layout_t.positions.
+	\return 0 on success.*/
+static inline int read_vks_header(FILE* file, vks_header_t* header, char*** material_names) {
+	uint32_t marker_and_version[2] = { 0, 0 };
+	memset(header, 0, sizeof(*header));
+	(*material_names) = NULL;
+	uint32_t version = 0;
+	if (fread(marker_and_version, sizeof(uint32_t), 2, file) != 2
+		|| marker_and_version[0] != VKS_FILE_MARKER
+		|| (version = marker_and_version[1]) < VKS_FILE_VERSION || version > VKS_FILE_VERSION_LODS
+		|| fread(&header->material_count, sizeof(uint64_t), 1, file) != 1
+		|| fread(&header->triangle_count, sizeof(uint64_t), 1, file) != 1
+		|| (version >= VKS_FILE_VERSION_CHUNKS && fread(&header->chunk_count, sizeof(uint64_t), 1, file) != 1)
+		|| (version >= VKS_FILE_VERSION_MESHLETS && (fread(&header->meshlet_vertex_count, sizeof(uint64_t), 1, file) != 1
+			|| fread(&header->meshlet_position_word_count, sizeof(uint64_t), 1, file) != 1))
+		|| (version >= VKS_FILE_VERSION_LODS && (fread(&header->lod_level_count, sizeof(uint64_t), 1, file) != 1
+			|| fread(&header->lod_triangle_count, sizeof(uint64_t), 1, file) != 1))
+		|| get_vks_file_version(header) != version
+		|| fread(header->dequantization_factor, sizeof(float), 3, file) != 3
+		|| fread(header->dequantization_summand, sizeof(float), 3, file) != 3
+		|| header->material_count > VKS_MAX_MATERIAL_COUNT)
+		return 1;
+	(*material_names) = (char**) malloc(sizeof(char*) * header->material_count);
+	memset(*material_names, 0, sizeof(char*) * header->material_count);
+	for (uint64_t i = 0; i != header->material_count; ++i) {
+		uint64_t length = 0;
+		if (fread(&length, sizeof(uint64_t), 1, file) != 1 || length > 0xFFFF)
+			return 1;
+		(*material_names)[i] = (char*) malloc(length + 1);
+		if (fread((*material_names)[i], sizeof(char), length + 1, file) != length + 1)
+			return 1;
+		(*material_names)[i][length] = 0;
+	}
+	return 0;
+}
+
+
+//! Frees material names as returned by read_vks_header()
+static inline void free_vks_material_names(char** material_names, uint64_t material_count) {
+	if (material_names)
+		for (uint64_t i = 0; i != material_count; ++i)
+			free(material_names[i]);
+	free(material_names);
+}
+
+
+//! Writes the end of file marker at the current file position
+//! \return 0 on success.
+static inline int write_vks_eof_marker(FILE* file) {
+	uint32_t eof = VKS_EOF_MARKER;
+	return fwrite(&eof, sizeof(eof), 1, file) != 1;
+}
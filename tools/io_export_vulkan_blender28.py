@@ -19,6 +19,23 @@ import numpy as np
 import bpy
 from os import path
 import re
+from time import perf_counter
+
+
+# The number of triangles that are encoded and written at once. This bounds
+# the size of temporary arrays during export of large scenes.
+TRIANGLE_CHUNK_SIZE = 1 << 20
+
+
+def write_array(file, array, dtype):
+    """Writes the given numpy array to the given binary file in the given
+       dtype (with explicit byte order such as "<u4"). Large arrays are
+       converted and written in chunks to limit memory use.
+    """
+    flat_array = array.reshape(-1)
+    chunk_size = TRIANGLE_CHUNK_SIZE * 16
+    for begin in range(0, flat_array.size, chunk_size):
+        file.write(np.asarray(flat_array[begin:begin + chunk_size], dtype=dtype).tobytes())
 
 
 def encode_normal_32_bit(normal):
@@ -122,19 +139,16 @@ class Mesh:
             edge_count = len(mesh.edges)
             result.primitive_vertex_count = 2 * np.ones((edge_count,), dtype=np.uint32)
             # Generate a flat list of vertex indices for all primitives
-            result.primitive_vertex_indices = np.asarray(
-                [vertex_index for edge in mesh.edges for vertex_index in edge.vertices], dtype=np.uint32)
-            if result.primitive_vertex_indices.size != 2 * edge_count:
-                print("It seems that an edge in mesh %s does not have exactly two vertices. Aborting." % mesh.name)
-                return "FAILURE"
+            result.primitive_vertex_indices = np.zeros(2 * edge_count, dtype=np.uint32)
+            mesh.edges.foreach_get("vertices", result.primitive_vertex_indices)
             # By convention, all edges use material 0
             result.primitive_material_index = np.zeros((edge_count,), dtype=np.uint32)
             # By convention, all texture coordinates are zero (Blender does not 
             # provide any for edges)
             result.primitive_vertex_uv = np.zeros((result.get_primitive_count() * 2, 2), dtype=np.float32)
         else:
-            result.primitive_vertex_count = np.asarray([len(polygon.vertices) for polygon in mesh.polygons],
-                                                       dtype=np.uint32)
+            result.primitive_vertex_count = np.zeros(len(mesh.polygons), dtype=np.uint32)
+            mesh.polygons.foreach_get("loop_total", result.primitive_vertex_count)
             if result.primitive_vertex_count.min() < 2:
                 print("Skipping mesh %s because it has a polygon with only %d vertices." %
                       (mesh.name, result.primitive_vertex_count.min()))
@@ -176,26 +190,38 @@ class Mesh:
            Mesh objects. The slot remaps are list providing a new slot index
            for each old slot index.
         """
+        return Mesh.concatenate_meshes([lhs, rhs], [lhs_material_slot_remap, rhs_material_slot_remap])
+
+    @staticmethod
+    def concatenate_meshes(mesh_list, material_slot_remap_list=None):
+        """Creates a new Mesh containing the geometry of all given Mesh
+           objects. Each array is concatenated once, so this is much cheaper
+           than repeated use of merge_meshes(). The optional list of slot
+           remaps holds None or a list of new slot indices for each mesh.
+        """
+        if material_slot_remap_list is None:
+            material_slot_remap_list = [None] * len(mesh_list)
         result = Mesh()
         # Concatenate vertex arrays
-        result.vertex_position = np.vstack([lhs.vertex_position, rhs.vertex_position])
-        result.vertex_normal = np.vstack([lhs.vertex_normal, rhs.vertex_normal])
-        result.vertex_line_radius = np.concatenate([lhs.vertex_line_radius, rhs.vertex_line_radius])
+        result.vertex_position = np.vstack([mesh.vertex_position for mesh in mesh_list])
+        result.vertex_normal = np.vstack([mesh.vertex_normal for mesh in mesh_list])
+        result.vertex_line_radius = np.concatenate([mesh.vertex_line_radius for mesh in mesh_list])
         # Concatenate primitive arrays, but with appropriate index offsets
-        result.primitive_vertex_count = np.concatenate([lhs.primitive_vertex_count, rhs.primitive_vertex_count])
+        result.primitive_vertex_count = np.concatenate([mesh.primitive_vertex_count for mesh in mesh_list])
+        vertex_offsets = np.cumsum([0] + [mesh.get_vertex_count() for mesh in mesh_list])
         result.primitive_vertex_indices = np.concatenate(
-            [lhs.primitive_vertex_indices, rhs.primitive_vertex_indices + lhs.vertex_position.shape[0]])
-        # Remap material slots
-        remap_list = [lhs_material_slot_remap, rhs_material_slot_remap]
-        material_index_list = list();
-        for mesh, remap in zip([lhs, rhs], remap_list):
+            [np.asarray(mesh.primitive_vertex_indices + offset, dtype=np.uint32)
+             for mesh, offset in zip(mesh_list, vertex_offsets)])
+        # Remap material slots through a lookup table
+        material_index_list = list()
+        for mesh, remap in zip(mesh_list, material_slot_remap_list):
             if remap is not None:
-                material_index_list.append(np.choose(mesh.primitive_material_index, remap))
+                material_index_list.append(np.asarray(remap, dtype=np.uint32)[mesh.primitive_material_index])
             else:
                 material_index_list.append(mesh.primitive_material_index)
         result.primitive_material_index = np.concatenate(material_index_list)
         # Merge UVs
-        result.primitive_vertex_uv = np.vstack([lhs.primitive_vertex_uv, rhs.primitive_vertex_uv])
+        result.primitive_vertex_uv = np.vstack([mesh.primitive_vertex_uv for mesh in mesh_list])
         return result
 
     def get_primitive_count(self):
@@ -224,16 +250,11 @@ class Mesh:
         old_primitive_vertex_primitive_index = np.arange(self.get_primitive_count()).repeat(self.primitive_vertex_count)
         old_primitive_vertex_mask = mask[old_primitive_vertex_primitive_index]
         result.primitive_vertex_indices = self.primitive_vertex_indices[old_primitive_vertex_mask].copy()
-        result.primitive_vertex_uv = np.zeros((result.primitive_vertex_indices.size, 2), dtype=np.float32)
-        result.primitive_vertex_uv[:, 0] = self.primitive_vertex_uv[:, 0][old_primitive_vertex_mask]
-        result.primitive_vertex_uv[:, 1] = self.primitive_vertex_uv[:, 1][old_primitive_vertex_mask]
+        result.primitive_vertex_uv = self.primitive_vertex_uv[old_primitive_vertex_mask]
         # Discard unused vertices
         remaining_vertex_indices = np.unique(result.primitive_vertex_indices)
-        result.vertex_position = np.zeros((remaining_vertex_indices.size, 3), dtype=np.float32)
-        result.vertex_normal = np.zeros_like(result.vertex_position)
-        for j in range(3):
-            result.vertex_position[:, j] = self.vertex_position[:, j][remaining_vertex_indices]
-            result.vertex_normal[:, j] = self.vertex_normal[:, j][remaining_vertex_indices]
+        result.vertex_position = np.asarray(self.vertex_position[remaining_vertex_indices], dtype=np.float32)
+        result.vertex_normal = np.asarray(self.vertex_normal[remaining_vertex_indices], dtype=np.float32)
         result.vertex_line_radius = np.copy(self.vertex_line_radius[remaining_vertex_indices])
         # Update vertex indices
         old_index_to_new_index = np.zeros((self.vertex_position.shape[0],), dtype=np.uint32)
@@ -248,9 +269,7 @@ class Mesh:
           \note The line radius is not scaled.
         """
         inverse_transpose = np.linalg.inv(matrix_3x4[:3, :3]).T
-        self.vertex_position = (matrix_3x4[:3, :3] @ self.vertex_position.T).T
-        for j in range(3):
-            self.vertex_position[:, j] += matrix_3x4[j, 3]
+        self.vertex_position = (matrix_3x4[:3, :3] @ self.vertex_position.T).T + matrix_3x4[np.newaxis, :3, 3]
         self.vertex_normal = (inverse_transpose @ self.vertex_normal.T).T
         self.vertex_normal /= np.linalg.norm(self.vertex_normal, axis=1)[:, np.newaxis]
         # Flip the primitive orientation if the transform is not orientation 
@@ -399,9 +418,7 @@ class Scene:
         if len(reduced_mesh_list) == 0:
             return None
         # Merge them all together
-        merged_mesh = reduced_mesh_list[0]
-        for rhs_mesh in reduced_mesh_list[1:]:
-            merged_mesh = Mesh.merge_meshes(merged_mesh, rhs_mesh)
+        merged_mesh = Mesh.concatenate_meshes(reduced_mesh_list)
         if merged_mesh.get_primitive_count() > 0:
             return merged_mesh
         else:
@@ -420,13 +437,9 @@ class Scene:
         # Merge material lists
         used_material_list = sorted(list(self.get_material_set()))
         material_index_dict = dict([(name, i) for i, name in enumerate(used_material_list)])
-        # Merge meshes sequentially
+        # Merge all meshes at once
         remap_list = [[material_index_dict[name] for name in mesh.slot_material_name] for mesh in self.mesh_list]
-        merged_mesh = self.mesh_list[0]
-        for i in range(1, len(self.mesh_list)):
-            lhs_remap = remap_list[0] if i == 1 else None
-            rhs_remap = remap_list[i]
-            merged_mesh = Mesh.merge_meshes(merged_mesh, self.mesh_list[i], lhs_remap, rhs_remap)
+        merged_mesh = Mesh.concatenate_meshes(self.mesh_list, remap_list)
         merged_mesh.slot_material_name = used_material_list
         return merged_mesh
 
@@ -438,6 +451,7 @@ def export_scene(blender_scene, scene_file_path, selection_only, add_triangulate
     """
     print()
     print("-###- Beginning Vulkan renderer export to %s. -###-" % scene_file_path)
+    start_time = perf_counter()
     if path.splitext(scene_file_path)[1] == ".blend":
         scene_file_path = path.splitext(scene_file_path)[0] + ".vks"
     # Bring the scene into Python objects
@@ -455,24 +469,24 @@ def export_scene(blender_scene, scene_file_path, selection_only, add_triangulate
               % (mesh.primitive_vertex_count.size, triangle_count)
               + "Allow the exporter to add triangulate modifiers to export anyway.")
         return
+    gather_time = perf_counter()
     # Sort triangles by the Morton code of their centroid
+    indices = mesh.primitive_vertex_indices.reshape((triangle_count, 3))
+    triangle_vertex_uv = mesh.primitive_vertex_uv.reshape((triangle_count, 3, 2))
+    material_indices = mesh.primitive_material_index
     if sort_triangles:
-        centroids = np.zeros((triangle_count, 3), dtype=np.float32)
-        for j in range(3):
-            coordinate = mesh.vertex_position[:, j][mesh.primitive_vertex_indices]
-            centroids[:, j] = coordinate.reshape((triangle_count, 3)).mean(axis=1)
+        centroids = mesh.vertex_position[indices].mean(axis=1)
         morton = get_morton_code_3d(centroids, centroids.min(axis=0), centroids.max(axis=0))
         triangle_permutation = np.argsort(morton)
-        for j in range(3):
-            mesh.primitive_vertex_indices[j::3] = mesh.primitive_vertex_indices[j::3][triangle_permutation]
-            mesh.primitive_vertex_uv[j::3] = mesh.primitive_vertex_uv[j::3][triangle_permutation]
-        mesh.primitive_material_index = mesh.primitive_material_index[triangle_permutation]
+        indices = indices[triangle_permutation]
+        triangle_vertex_uv = triangle_vertex_uv[triangle_permutation]
+        material_indices = material_indices[triangle_permutation]
     # Open the output file
     file = open(scene_file_path, "wb")
     # Write file format marker and version
-    file.write(pack("II", 0x00abcabc, 1))
+    file.write(pack("<II", 0x00abcabc, 1))
     # Write the number of materials, primitives and vertices
-    file.write(pack("QQ", len(used_material_list), triangle_count))
+    file.write(pack("<QQ", len(used_material_list), triangle_count))
     # Quantize vertex positions to 21 bits per coordinate
     box_min = mesh.vertex_position.min(axis=0)[np.newaxis, :]
     box_max = mesh.vertex_position.max(axis=0)[np.newaxis, :]
@@ -483,53 +497,53 @@ def export_scene(blender_scene, scene_file_path, selection_only, add_triangulate
     # Write the constants needed for dequantization
     dequantization_factor = 1.0 / quantization_factor
     dequantization_summand = box_min + 0.5 * dequantization_factor
-    file.write(pack("fff", *dequantization_factor.flat))
-    file.write(pack("fff", *dequantization_summand.flat))
+    write_array(file, dequantization_factor, "<f4")
+    write_array(file, dequantization_summand, "<f4")
     # Make a few changes to material names to support ORCA assets
     used_material_list = [re.sub(r"\.[0-9][0-9][0-9]$", "", name) for name in used_material_list]
     used_material_list = [name.replace(".DoubleSided", "") for name in used_material_list]
     # Write the material names as null-terminated strings, preceded by their
     # lengths
     for material_name in used_material_list:
-        file.write(pack("Q", len(material_name)))
+        file.write(pack("<Q", len(material_name)))
         file.write(material_name.encode("utf-8"))
         file.write(pack("b", 0))
-    # Write the vertex positions
-    indices = mesh.primitive_vertex_indices
+    # Write the vertex positions chunk by chunk
     packed_positions = np.zeros((mesh.get_vertex_count(), 2), dtype=np.uint32)
     packed_positions[:, 0] = quantized_positions[:, 0]
     packed_positions[:, 0] += (quantized_positions[:, 1] & 0x7FF) << 21
     packed_positions[:, 1] = (quantized_positions[:, 1] & 0x1FF800) >> 11
     packed_positions[:, 1] += quantized_positions[:, 2] << 10
-    triangle_list_positions = np.zeros((triangle_count * 3, 2), dtype=np.uint32)
-    triangle_list_positions[:, 0] = packed_positions[:, 0][indices]
-    triangle_list_positions[:, 1] = packed_positions[:, 1][indices]
-    file.write(pack("I" * triangle_list_positions.size, *triangle_list_positions.flat))
+    for begin in range(0, triangle_count, TRIANGLE_CHUNK_SIZE):
+        write_array(file, packed_positions[indices[begin:begin + TRIANGLE_CHUNK_SIZE]], "<u4")
     # Pack texture coordinate pairs into 32 bit. We allow a texture to
     # repeat up to eight times within one triangle.
-    triangle_vertex_uv = mesh.primitive_vertex_uv.reshape((indices.size // 3, 3, 2))
-    triangle_min_uv = triangle_vertex_uv.min(axis=1)
-    triangle_vertex_uv -= np.floor(triangle_min_uv)[:, np.newaxis, :]
+    triangle_vertex_uv = triangle_vertex_uv - np.floor(triangle_vertex_uv.min(axis=1))[:, np.newaxis, :]
     if np.max(triangle_vertex_uv) > 8.0:
         print("A mesh has %d triangles where the UV coordinates imply more than seven repetitions. "
               % np.count_nonzero(np.any(triangle_vertex_uv > 8.0, axis=(1, 2)))
               + "In the most extreme case, there are %f repetitions. " % np.max(triangle_vertex_uv)
               + "The used quantization does not support that. Coordinates will be clipped.")
-    normal_and_uv = np.zeros((indices.size, 4), dtype=np.uint16)
-    packed_uv = triangle_vertex_uv * ((2.0**16 - 1.0) / 8.0) + 0.5
-    normal_and_uv[:, 2:4] = np.asarray(np.clip(packed_uv.reshape((-1, 2)), 0.0, 2.0**16.0 - 1.0), dtype=np.uint16)
     # Pack normals into 32 bit
-    packed_normal_0, packed_normal_1 = encode_normal_32_bit(mesh.vertex_normal)
-    normal_and_uv[:, 0] = packed_normal_0[indices]
-    normal_and_uv[:, 1] = packed_normal_1[indices]
-    # Write normal vectors and texture coordinates
-    file.write(pack("H" * normal_and_uv.size, *normal_and_uv.flat))
+    packed_normals = np.zeros((mesh.get_vertex_count(), 2), dtype=np.uint16)
+    packed_normals[:, 0], packed_normals[:, 1] = encode_normal_32_bit(mesh.vertex_normal)
+    # Write normal vectors and texture coordinates chunk by chunk
+    for begin in range(0, triangle_count, TRIANGLE_CHUNK_SIZE):
+        chunk_indices = indices[begin:begin + TRIANGLE_CHUNK_SIZE]
+        normal_and_uv = np.zeros(chunk_indices.shape + (4,), dtype=np.uint16)
+        normal_and_uv[:, :, 0:2] = packed_normals[chunk_indices]
+        packed_uv = triangle_vertex_uv[begin:begin + TRIANGLE_CHUNK_SIZE] * ((2.0**16 - 1.0) / 8.0) + 0.5
+        normal_and_uv[:, :, 2:4] = np.asarray(np.clip(packed_uv, 0.0, 2.0**16.0 - 1.0), dtype=np.uint16)
+        write_array(file, normal_and_uv, "<u2")
     # Write the material index for each primitive
-    file.write(pack("B" * triangle_count, *mesh.primitive_material_index))
+    write_array(file, material_indices, "u1")
     # Write an end of file marker
-    file.write(pack("I", 0x00e0fe0f))
+    file.write(pack("<I", 0x00e0fe0f))
     file.close()
+    end_time = perf_counter()
     print("Wrote %d materials and %d primitives." % (len(used_material_list), triangle_count))
+    print("Gathering geometry took %.3f s, encoding and writing took %.3f s, %.3f s in total."
+          % (gather_time - start_time, end_time - gather_time, end_time - start_time))
     print("-###- Export completed. -###-")
     print()
 
@@ -0,0 +1,953 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "vks_format.h"
+#include "tool_threads.h"
+#include "camera.h"
+#include "polygonal_light.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+
+//! Pi with single precision
+#define M_PI_F 3.1415926535897932384626433832795f
+
+//! The number of triangles that a worker thread encodes before it writes them
+//! to the file
+#define TRIANGLE_BATCH_SIZE 65536
+
+
+//! The kinds of procedural scenes that this tool can generate
+typedef enum scene_type_e {
+	//! A ground plane with a regular grid of finely tessellated spheres. The
+	//! triangle count per sphere is adapted to the requested total.
+	scene_type_grid,
+	//! A ground plane densely covered by randomly oriented, double-sided grass
+	//! blades. Produces lots of tiny triangles.
+	scene_type_foliage,
+	//! Many parallel walls behind one another, which are written back to front
+	//! to produce a controllable depth complexity.
+	scene_type_occluders,
+	//! Number of available scene types
+	scene_type_count
+} scene_type_t;
+
+
+//! Names of scene types as used on the command line
+const char* const g_scene_type_names[scene_type_count] = { "grid", "foliage", "occluders" };
+
+
+//! A small indexed triangle mesh that is instanced many times throughout a
+//! scene
+typedef struct template_mesh_s {
+	//! The number of vertices and triangles in this mesh
+	uint32_t vertex_count, triangle_count;
+	//! Per-vertex attributes (vertex_count entries each)
+	float (*positions)[3], (*normals)[3], (*tex_coords)[2];
+	//! Three vertex indices per triangle
+	uint32_t (*triangles)[3];
+	//! A bounding box for positions
+	float box_min[3], box_max[3];
+} template_mesh_t;
+
+
+//! A placement of a template mesh in the scene
+typedef struct instance_s {
+	//! An affine transform from template space to world space with positive
+	//! determinant
+	float transform[3][4];
+	//! The index of the instanced template mesh
+	uint32_t template_index;
+	//! The material used for all triangles of this instance
+	uint32_t material_index;
+	//! The index of the first triangle of this instance in the output file
+	uint64_t first_triangle;
+} instance_t;
+
+
+//! The templates available for instancing
+typedef enum template_type_e {
+	template_type_plane,
+	template_type_sphere,
+	template_type_blade,
+	template_type_count
+} template_type_t;
+
+
+//! Everything needed to write the geometry of a scene
+typedef struct stress_scene_s {
+	//! The type of this scene
+	scene_type_t type;
+	//! Template meshes indexed by template_type_t
+	template_mesh_t templates[template_type_count];
+	//! All instances of templates in this scene
+	uint64_t instance_count;
+	instance_t* instances;
+	//! The total number of triangles
+	uint64_t triangle_count;
+	//! The number of distinct materials
+	uint32_t material_count;
+	//! A bounding box for the whole scene
+	float box_min[3], box_max[3];
+} stress_scene_t;
+
+
+//! Parameters provided on the command line
+typedef struct generator_settings_s {
+	//! The kind of scene to generate
+	scene_type_t type;
+	//! Output files are this prefix followed by .vks, .save or _textures
+	const char* output_prefix;
+	//! The approximate number of triangles to generate
+	uint64_t target_triangle_count;
+	//! The number of materials to use (at most VKS_MAX_MATERIAL_COUNT)
+	uint32_t material_count;
+	//! For scene_type_occluders, the number of walls behind one another
+	uint32_t layer_count;
+	//! The number of polygonal lights in the quicksave
+	uint32_t light_count;
+	//! The number of threads used for encoding
+	uint32_t thread_count;
+	//! Seed for all pseudo-random decisions
+	uint32_t seed;
+	//! Whether instances should be sorted by the Morton code of their centers
+	int sort_instances;
+} generator_settings_t;
+
+
+//! The work of one thread writing triangles into the output file
+typedef struct generator_job_s {
+	const stress_scene_t* scene;
+	const char* file_path;
+	vks_layout_t layout;
+	float quantization_factor[3], quantization_summand[3];
+	//! The range of instances to be written by this job
+	uint64_t instance_begin, instance_end;
+	//! 0 if this job succeeded
+	int result;
+	//! The number of triangles for which texture coordinates had to be clamped
+	uint64_t clamped_count;
+} generator_job_t;
+
+
+//! Cheap and ok-ish random number generator (same as in math_utilities.h)
+static inline uint32_t wang_random_number(uint32_t seed) {
+	seed = (seed ^ 61) ^ (seed >> 16);
+	seed *= 9;
+	seed = seed ^ (seed >> 4);
+	seed *= 0x27d4eb2d;
+	seed = seed ^ (seed >> 15);
+	return seed;
+}
+
+
+//! Returns a pseudo-random number in [0,1) that is a deterministic function of
+//! the given seed, the index of an object and the index of a random variable
+static inline float get_random_float(uint32_t seed, uint64_t object_index, uint32_t variable_index) {
+	uint32_t hash = wang_random_number(seed ^ wang_random_number((uint32_t) object_index ^ wang_random_number((uint32_t) (object_index >> 32) + variable_index * 0x9E3779B9)));
+	return (float) (hash >> 8) * (1.0f / 16777216.0f);
+}
+
+
+//! Allocates memory for the given template with the given size
+void allocate_template_mesh(template_mesh_t* mesh, uint32_t vertex_count, uint32_t triangle_count) {
+	mesh->vertex_count = vertex_count;
+	mesh->triangle_count = triangle_count;
+	mesh->positions = malloc(sizeof(float) * 3 * vertex_count);
+	mesh->normals = malloc(sizeof(float) * 3 * vertex_count);
+	mesh->tex_coords = malloc(sizeof(float) * 2 * vertex_count);
+	mesh->triangles = malloc(sizeof(uint32_t) * 3 * triangle_count);
+}
+
+
+//! Computes the bounding box of the given template mesh
+void update_template_bounds(template_mesh_t* mesh) {
+	for (uint32_t j = 0; j != 3; ++j) {
+		mesh->box_min[j] = mesh->box_max[j] = mesh->positions[0][j];
+		for (uint32_t i = 1; i < mesh->vertex_count; ++i) {
+			mesh->box_min[j] = (mesh->positions[i][j] < mesh->box_min[j]) ? mesh->positions[i][j] : mesh->box_min[j];
+			mesh->box_max[j] = (mesh->positions[i][j] > mesh->box_max[j]) ? mesh->positions[i][j] : mesh->box_max[j];
+		}
+	}
+}
+
+
+//! Frees memory of the given template mesh and zeros it
+void destroy_template_mesh(template_mesh_t* mesh) {
+	free(mesh->positions);
+	free(mesh->normals);
+	free(mesh->tex_coords);
+	free(mesh->triangles);
+	memset(mesh, 0, sizeof(*mesh));
+}
+
+
+//! Creates a square [-0.5,0.5]^2 in the xy-plane facing towards +z,
+//! subdivided into 2 * subdivision_count^2 triangles
+void create_plane_mesh(template_mesh_t* mesh, uint32_t subdivision_count) {
+	uint32_t row_size = subdivision_count + 1;
+	allocate_template_mesh(mesh, row_size * row_size, 2 * subdivision_count * subdivision_count);
+	for (uint32_t y = 0; y != row_size; ++y) {
+		for (uint32_t x = 0; x != row_size; ++x) {
+			uint32_t i = y * row_size + x;
+			mesh->tex_coords[i][0] = (float) x / (float) subdivision_count;
+			mesh->tex_coords[i][1] = (float) y / (float) subdivision_count;
+			mesh->positions[i][0] = mesh->tex_coords[i][0] - 0.5f;
+			mesh->positions[i][1] = mesh->tex_coords[i][1] - 0.5f;
+			mesh->positions[i][2] = 0.0f;
+			mesh->normals[i][0] = mesh->normals[i][1] = 0.0f;
+			mesh->normals[i][2] = 1.0f;
+		}
+	}
+	for (uint32_t y = 0; y != subdivision_count; ++y) {
+		for (uint32_t x = 0; x != subdivision_count; ++x) {
+			uint32_t i = 2 * (y * subdivision_count + x);
+			uint32_t corner = y * row_size + x;
+			uint32_t quad[2][3] = {
+				{ corner, corner + 1, corner + row_size + 1 },
+				{ corner, corner + row_size + 1, corner + row_size },
+			};
+			memcpy(mesh->triangles[i], quad, sizeof(quad));
+		}
+	}
+	update_template_bounds(mesh);
+}
+
+
+//! Creates a unit sphere centered at (0,0,0.5) such that it rests on the
+//! xy-plane with 4 * ring_count * (ring_count - 1) triangles
+void create_sphere_mesh(template_mesh_t* mesh, uint32_t ring_count) {
+	uint32_t segment_count = 2 * ring_count;
+	uint32_t row_size = segment_count + 1;
+	allocate_template_mesh(mesh, (ring_count + 1) * row_size, 2 * segment_count * (ring_count - 1));
+	for (uint32_t y = 0; y != ring_count + 1; ++y) {
+		float theta = M_PI_F * (float) y / (float) ring_count;
+		for (uint32_t x = 0; x != row_size; ++x) {
+			float phi = 2.0f * M_PI_F * (float) x / (float) segment_count;
+			uint32_t i = y * row_size + x;
+			mesh->normals[i][0] = sinf(theta) * cosf(phi);
+			mesh->normals[i][1] = sinf(theta) * sinf(phi);
+			mesh->normals[i][2] = cosf(theta);
+			for (uint32_t j = 0; j != 3; ++j)
+				mesh->positions[i][j] = 0.5f * mesh->normals[i][j];
+			mesh->positions[i][2] += 0.5f;
+			mesh->tex_coords[i][0] = 4.0f * (float) x / (float) segment_count;
+			mesh->tex_coords[i][1] = 2.0f * (float) y / (float) ring_count;
+		}
+	}
+	uint32_t triangle_index = 0;
+	for (uint32_t y = 0; y != ring_count; ++y) {
+		for (uint32_t x = 0; x != segment_count; ++x) {
+			uint32_t corner = y * row_size + x;
+			// The caps consist of a single triangle per segment
+			if (y != ring_count - 1) {
+				uint32_t triangle[3] = { corner, corner + row_size, corner + row_size + 1 };
+				memcpy(mesh->triangles[triangle_index++], triangle, sizeof(triangle));
+			}
+			if (y != 0) {
+				uint32_t triangle[3] = { corner, corner + row_size + 1, corner + 1 };
+				memcpy(mesh->triangles[triangle_index++], triangle, sizeof(triangle));
+			}
+		}
+	}
+	update_template_bounds(mesh);
+}
+
+
+//! Creates a curved, tapered grass blade of unit height standing on the
+//! origin. Since the renderer culls back faces, both sides are modeled
+//! explicitly, which yields 4 * segment_count - 2 triangles.
+void create_blade_mesh(template_mesh_t* mesh, uint32_t segment_count) {
+	// Each level has a left and a right vertex, the tip is a single vertex
+	uint32_t side_vertex_count = 2 * segment_count + 1;
+	uint32_t side_triangle_count = 2 * segment_count - 1;
+	allocate_template_mesh(mesh, 2 * side_vertex_count, 2 * side_triangle_count);
+	for (uint32_t side = 0; side != 2; ++side) {
+		float normal_sign = side ? -1.0f : 1.0f;
+		for (uint32_t i = 0; i != side_vertex_count; ++i) {
+			float height = (float) (i / 2) / (float) segment_count;
+			float half_width = 0.02f * (1.0f - height);
+			float offset = (i == side_vertex_count - 1) ? 0.0f : ((i % 2) ? half_width : -half_width);
+			uint32_t v = side * side_vertex_count + i;
+			mesh->positions[v][0] = offset;
+			mesh->positions[v][1] = 0.3f * height * height;
+			mesh->positions[v][2] = height;
+			// The normal is orthogonal to the bent center line
+			float slope = 0.6f * height;
+			float norm = sqrtf(1.0f + slope * slope);
+			mesh->normals[v][0] = 0.0f;
+			mesh->normals[v][1] = normal_sign / norm;
+			mesh->normals[v][2] = -normal_sign * slope / norm;
+			mesh->tex_coords[v][0] = offset * 25.0f + 0.5f;
+			mesh->tex_coords[v][1] = height;
+		}
+		// Triangulate as strip. Consecutive triangles of a strip alternate
+		// their winding, so every other one gets flipped such that all of them
+		// face along the normal of their side.
+		for (uint32_t i = 0; i != side_triangle_count; ++i) {
+			uint32_t base = side * side_vertex_count;
+			uint32_t triangle[3] = { base + i, base + i + 1, base + i + 2 };
+			if ((i % 2 == 0) == (side == 0)) {
+				uint32_t swap = triangle[1];
+				triangle[1] = triangle[2];
+				triangle[2] = swap;
+			}
+			memcpy(mesh->triangles[side * side_triangle_count + i], triangle, sizeof(triangle));
+		}
+	}
+	update_template_bounds(mesh);
+}
+
+
+/*! Builds a transform that scales by the given factors, rotates around the
+	x-axis, then around the z-axis and finally translates.*/
+void make_transform(float transform[3][4], const float scaling[3], float rotation_x, float rotation_z, const float translation[3]) {
+	float cx = cosf(rotation_x), sx = sinf(rotation_x);
+	float cz = cosf(rotation_z), sz = sinf(rotation_z);
+	float rotation[3][3] = {
+		{cz, -sz * cx, sz * sx},
+		{sz, cz * cx, -cz * sx},
+		{0.0f, sx, cx},
+	};
+	for (uint32_t i = 0; i != 3; ++i) {
+		for (uint32_t j = 0; j != 3; ++j)
+			transform[i][j] = rotation[i][j] * scaling[j];
+		transform[i][3] = translation[i];
+	}
+}
+
+
+//! Applies the given affine transform to the given point
+static inline void transform_point(float output[3], const float transform[3][4], const float point[3]) {
+	for (uint32_t i = 0; i != 3; ++i)
+		output[i] = transform[i][0] * point[0] + transform[i][1] * point[1] + transform[i][2] * point[2] + transform[i][3];
+}
+
+
+//! Computes the cofactor matrix of the linear part of the given transform,
+//! which transforms normals up to scaling
+void get_normal_transform(float normal_transform[3][3], const float transform[3][4]) {
+	for (uint32_t i = 0; i != 3; ++i) {
+		for (uint32_t j = 0; j != 3; ++j) {
+			uint32_t i0 = (i + 1) % 3, i1 = (i + 2) % 3;
+			uint32_t j0 = (j + 1) % 3, j1 = (j + 2) % 3;
+			normal_transform[i][j] = transform[i0][j0] * transform[i1][j1] - transform[i0][j1] * transform[i1][j0];
+		}
+	}
+}
+
+
+//! Appends an instance with the given properties to the scene, assuming that
+//! enough memory has been allocated
+void add_instance(stress_scene_t* scene, template_type_t template_type, uint32_t material_index, const float scaling[3], float rotation_x, float rotation_z, const float translation[3]) {
+	instance_t* instance = &scene->instances[scene->instance_count];
+	make_transform(instance->transform, scaling, rotation_x, rotation_z, translation);
+	instance->template_index = template_type;
+	instance->material_index = material_index;
+	instance->first_triangle = scene->triangle_count;
+	scene->triangle_count += scene->templates[template_type].triangle_count;
+	++scene->instance_count;
+}
+
+
+//! Adds a ground plane of the given size centered at the origin
+void add_ground_plane(stress_scene_t* scene, float size) {
+	float scaling[3] = { size, size, 1.0f };
+	float translation[3] = { 0.0f, 0.0f, 0.0f };
+	add_instance(scene, template_type_plane, 0, scaling, 0.0f, 0.0f, translation);
+}
+
+
+/*! Defines all instances of the requested scene. Template meshes are created
+	with resolutions that bring the triangle count close to the target.
+	\return 0 on success.*/
+int create_stress_scene(stress_scene_t* scene, const generator_settings_t* settings) {
+	memset(scene, 0, sizeof(*scene));
+	scene->type = settings->type;
+	scene->material_count = settings->material_count;
+	uint64_t target = settings->target_triangle_count;
+	uint32_t seed = settings->seed;
+	switch (settings->type) {
+	case scene_type_grid: {
+		// Aim for roughly 2000 triangles per sphere, then refine spheres
+		uint32_t grid_size = (uint32_t) ceil(sqrt((double) target / 2000.0));
+		grid_size = (grid_size < 1) ? 1 : grid_size;
+		uint64_t sphere_count = (uint64_t) grid_size * grid_size;
+		uint32_t ring_count = (uint32_t) (0.5 + sqrt((double) target / (4.0 * (double) sphere_count)));
+		ring_count = (ring_count < 3) ? 3 : ring_count;
+		create_plane_mesh(&scene->templates[template_type_plane], 1);
+		create_sphere_mesh(&scene->templates[template_type_sphere], ring_count);
+		create_blade_mesh(&scene->templates[template_type_blade], 1);
+		scene->instances = malloc(sizeof(instance_t) * (sphere_count + 1));
+		float spacing = 1.5f;
+		add_ground_plane(scene, spacing * (grid_size + 1));
+		for (uint64_t i = 0; i != sphere_count; ++i) {
+			float scale = 0.6f + 0.4f * get_random_float(seed, i, 0);
+			float scaling[3] = { scale, scale, scale };
+			float translation[3] = {
+				spacing * ((float) (i % grid_size) - 0.5f * (float) (grid_size - 1)),
+				spacing * ((float) (i / grid_size) - 0.5f * (float) (grid_size - 1)),
+				0.0f
+			};
+			uint32_t material_index = (uint32_t) (i % scene->material_count);
+			add_instance(scene, template_type_sphere, material_index, scaling, 0.0f, 2.0f * M_PI_F * get_random_float(seed, i, 1), translation);
+		}
+		break;
+	}
+	case scene_type_foliage: {
+		create_plane_mesh(&scene->templates[template_type_plane], 16);
+		create_sphere_mesh(&scene->templates[template_type_sphere], 3);
+		create_blade_mesh(&scene->templates[template_type_blade], 4);
+		uint64_t blade_count = target / scene->templates[template_type_blade].triangle_count;
+		blade_count = (blade_count < 1) ? 1 : blade_count;
+		// Roughly 1000 blades per square meter
+		float size = sqrtf((float) blade_count / 1000.0f);
+		size = (size < 1.0f) ? 1.0f : size;
+		scene->instances = malloc(sizeof(instance_t) * (blade_count + 1));
+		add_ground_plane(scene, size);
+		for (uint64_t i = 0; i != blade_count; ++i) {
+			float height = 0.15f + 0.25f * get_random_float(seed, i, 0);
+			float width = 0.5f + get_random_float(seed, i, 1);
+			float scaling[3] = { width, height, height };
+			float translation[3] = {
+				size * (get_random_float(seed, i, 2) - 0.5f),
+				size * (get_random_float(seed, i, 3) - 0.5f),
+				0.0f
+			};
+			float tilt = 0.3f * (get_random_float(seed, i, 4) - 0.5f);
+			uint32_t material_index = (uint32_t) (get_random_float(seed, i, 5) * scene->material_count) % scene->material_count;
+			add_instance(scene, template_type_blade, material_index, scaling, tilt, 2.0f * M_PI_F * get_random_float(seed, i, 6), translation);
+		}
+		break;
+	}
+	case scene_type_occluders: {
+		// Each layer is a wall made of tile_count^2 tiles
+		uint32_t layer_count = settings->layer_count;
+		uint64_t layer_triangle_count = target / layer_count;
+		uint32_t tile_count = 8;
+		uint64_t tile_triangle_count = layer_triangle_count / (tile_count * tile_count);
+		uint32_t subdivision_count = (uint32_t) (0.5 + sqrt((double) tile_triangle_count / 2.0));
+		subdivision_count = (subdivision_count < 1) ? 1 : subdivision_count;
+		create_plane_mesh(&scene->templates[template_type_plane], subdivision_count);
+		create_sphere_mesh(&scene->templates[template_type_sphere], 3);
+		create_blade_mesh(&scene->templates[template_type_blade], 1);
+		scene->instances = malloc(sizeof(instance_t) * layer_count * tile_count * tile_count);
+		float wall_size = 20.0f;
+		float tile_size = wall_size / (float) tile_count;
+		float layer_spacing = 0.5f;
+		// The camera is at negative y looking along +y. Layers are written
+		// back to front, which is the worst case for early depth testing.
+		for (uint32_t layer = layer_count; layer-- != 0;) {
+			for (uint32_t i = 0; i != tile_count * tile_count; ++i) {
+				float scaling[3] = { tile_size, tile_size, 1.0f };
+				float jitter = 0.1f * (get_random_float(seed, (uint64_t) layer * tile_count * tile_count + i, 0) - 0.5f);
+				float translation[3] = {
+					tile_size * ((float) (i % tile_count) + 0.5f) - 0.5f * wall_size,
+					layer_spacing * (float) layer + jitter * layer_spacing,
+					tile_size * ((float) (i / tile_count) + 0.5f),
+				};
+				// Rotating the xy-plane around x by -pi/2 makes it face -y
+				add_instance(scene, template_type_plane, layer % scene->material_count, scaling, -0.5f * M_PI_F, 0.0f, translation);
+			}
+		}
+		break;
+	}
+	default:
+		printf("Unknown scene type %d.\n", (int) settings->type);
+		return 1;
+	}
+	// Compute the bounding box of the scene using transformed template boxes
+	for (uint32_t j = 0; j != 3; ++j) {
+		scene->box_min[j] = INFINITY;
+		scene->box_max[j] = -INFINITY;
+	}
+	for (uint64_t i = 0; i != scene->instance_count; ++i) {
+		const instance_t* instance = &scene->instances[i];
+		const template_mesh_t* mesh = &scene->templates[instance->template_index];
+		for (uint32_t k = 0; k != 8; ++k) {
+			float corner[3] = {
+				(k & 1) ? mesh->box_max[0] : mesh->box_min[0],
+				(k & 2) ? mesh->box_max[1] : mesh->box_min[1],
+				(k & 4) ? mesh->box_max[2] : mesh->box_min[2],
+			};
+			float world_corner[3];
+			transform_point(world_corner, instance->transform, corner);
+			for (uint32_t j = 0; j != 3; ++j) {
+				scene->box_min[j] = (world_corner[j] < scene->box_min[j]) ? world_corner[j] : scene->box_min[j];
+				scene->box_max[j] = (world_corner[j] > scene->box_max[j]) ? world_corner[j] : scene->box_max[j];
+			}
+		}
+	}
+	return 0;
+}
+
+
+//! Frees memory of the given scene and zeros it
+void destroy_stress_scene(stress_scene_t* scene) {
+	for (uint32_t i = 0; i != template_type_count; ++i)
+		destroy_template_mesh(&scene->templates[i]);
+	free(scene->instances);
+	memset(scene, 0, sizeof(*scene));
+}
+
+
+//! An instance with its Morton code for sorting
+typedef struct instance_sort_key_s {
+	uint32_t morton_code;
+	uint64_t instance_index;
+} instance_sort_key_t;
+
+
+//! Comparison of instance_sort_key_t for qsort()
+int compare_instance_sort_keys(const void* lhs, const void* rhs) {
+	const instance_sort_key_t* a = (const instance_sort_key_t*) lhs;
+	const instance_sort_key_t* b = (const instance_sort_key_t*) rhs;
+	if (a->morton_code != b->morton_code)
+		return (a->morton_code < b->morton_code) ? -1 : 1;
+	return (a->instance_index < b->instance_index) ? -1 : ((a->instance_index > b->instance_index) ? 1 : 0);
+}
+
+
+/*! Sorts the instances of the given scene by the Morton code of their
+	translation, which is much cheaper than sorting triangles and has a
+	similar effect on memory coherence. Triangle offsets get updated.*/
+void sort_instances(stress_scene_t* scene) {
+	instance_sort_key_t* keys = malloc(sizeof(instance_sort_key_t) * scene->instance_count);
+	for (uint64_t i = 0; i != scene->instance_count; ++i) {
+		float center[3] = { scene->instances[i].transform[0][3], scene->instances[i].transform[1][3], scene->instances[i].transform[2][3] };
+		keys[i].morton_code = get_morton_code_3d(center, scene->box_min, scene->box_max);
+		keys[i].instance_index = i;
+	}
+	qsort(keys, scene->instance_count, sizeof(instance_sort_key_t), compare_instance_sort_keys);
+	instance_t* sorted = malloc(sizeof(instance_t) * scene->instance_count);
+	uint64_t triangle_count = 0;
+	for (uint64_t i = 0; i != scene->instance_count; ++i) {
+		sorted[i] = scene->instances[keys[i].instance_index];
+		sorted[i].first_triangle = triangle_count;
+		triangle_count += scene->templates[sorted[i].template_index].triangle_count;
+	}
+	free(scene->instances);
+	scene->instances = sorted;
+	free(keys);
+}
+
+
+//! Writes the given triangles to the appropriate locations in the file
+//! \return 0 on success.
+int write_triangle_batch(FILE* file, const vks_layout_t* layout, uint64_t first_triangle, uint64_t triangle_count, const uint32_t* positions, const uint16_t* normals_and_tex_coords, const uint8_t* material_indices) {
+	return vks_fseek(file, layout->positions + first_triangle * 3 * 2 * sizeof(uint32_t))
+		|| fwrite(positions, sizeof(uint32_t) * 3 * 2, triangle_count, file) != triangle_count
+		|| vks_fseek(file, layout->normals_and_tex_coords + first_triangle * 3 * 4 * sizeof(uint16_t))
+		|| fwrite(normals_and_tex_coords, sizeof(uint16_t) * 3 * 4, triangle_count, file) != triangle_count
+		|| vks_fseek(file, layout->material_indices + first_triangle * sizeof(uint8_t))
+		|| fwrite(material_indices, sizeof(uint8_t), triangle_count, file) != triangle_count;
+}
+
+
+//! Thread function that encodes and writes all triangles of a range of
+//! instances. Takes a generator_job_t.
+void run_generator_job(void* argument) {
+	generator_job_t* job = (generator_job_t*) argument;
+	const stress_scene_t* scene = job->scene;
+	job->result = 0;
+	job->clamped_count = 0;
+	if (job->instance_begin == job->instance_end)
+		return;
+	FILE* file = fopen(job->file_path, "r+b");
+	if (!file) {
+		printf("Failed to open %s for writing on a worker thread.\n", job->file_path);
+		job->result = 1;
+		return;
+	}
+	uint32_t* positions = malloc(sizeof(uint32_t) * 3 * 2 * TRIANGLE_BATCH_SIZE);
+	uint16_t* normals_and_tex_coords = malloc(sizeof(uint16_t) * 3 * 4 * TRIANGLE_BATCH_SIZE);
+	uint8_t* material_indices = malloc(sizeof(uint8_t) * TRIANGLE_BATCH_SIZE);
+	uint64_t batch_begin = scene->instances[job->instance_begin].first_triangle;
+	uint64_t batch_size = 0;
+	for (uint64_t i = job->instance_begin; i != job->instance_end && !job->result; ++i) {
+		const instance_t* instance = &scene->instances[i];
+		const template_mesh_t* mesh = &scene->templates[instance->template_index];
+		float normal_transform[3][3];
+		get_normal_transform(normal_transform, instance->transform);
+		for (uint32_t t = 0; t != mesh->triangle_count; ++t) {
+			float tex_coords[3][2];
+			uint16_t encoded_tex_coords[3][2];
+			for (uint32_t k = 0; k != 3; ++k) {
+				uint32_t vertex = mesh->triangles[t][k];
+				float position[3], normal[3];
+				transform_point(position, instance->transform, mesh->positions[vertex]);
+				for (uint32_t j = 0; j != 3; ++j)
+					normal[j] = normal_transform[j][0] * mesh->normals[vertex][0] + normal_transform[j][1] * mesh->normals[vertex][1] + normal_transform[j][2] * mesh->normals[vertex][2];
+				quantize_position_64_bit(&positions[(batch_size * 3 + k) * 2], position, job->quantization_factor, job->quantization_summand);
+				encode_normal_32_bit(&normals_and_tex_coords[(batch_size * 3 + k) * 4], normal);
+				tex_coords[k][0] = mesh->tex_coords[vertex][0];
+				tex_coords[k][1] = mesh->tex_coords[vertex][1];
+			}
+			job->clamped_count += encode_triangle_tex_coords(encoded_tex_coords, (const float (*)[2]) tex_coords);
+			for (uint32_t k = 0; k != 3; ++k) {
+				normals_and_tex_coords[(batch_size * 3 + k) * 4 + 2] = encoded_tex_coords[k][0];
+				normals_and_tex_coords[(batch_size * 3 + k) * 4 + 3] = encoded_tex_coords[k][1];
+			}
+			material_indices[batch_size] = (uint8_t) instance->material_index;
+			++batch_size;
+			if (batch_size == TRIANGLE_BATCH_SIZE) {
+				job->result |= write_triangle_batch(file, &job->layout, batch_begin, batch_size, positions, normals_and_tex_coords, material_indices);
+				batch_begin += batch_size;
+				batch_size = 0;
+			}
+		}
+	}
+	if (batch_size > 0 && !job->result)
+		job->result |= write_triangle_batch(file, &job->layout, batch_begin, batch_size, positions, normals_and_tex_coords, material_indices);
+	if (job->result)
+		printf("Failed to write triangles to %s on a worker thread.\n", job->file_path);
+	free(positions);
+	free(normals_and_tex_coords);
+	free(material_indices);
+	fclose(file);
+}
+
+
+/*! Writes the *.vks file for the given scene. The header is written first,
+	then worker threads write disjoint ranges of triangles into all three
+	sections of the file concurrently.
+	\return 0 on success.*/
+int write_stress_scene(const stress_scene_t* scene, const char* file_path, char** material_names, uint32_t thread_count) {
+	vks_header_t header = {
+		.material_count = scene->material_count,
+		.triangle_count = scene->triangle_count,
+	};
+	float quantization_factor[3], quantization_summand[3];
+	get_vks_quantization(quantization_factor, quantization_summand, &header, scene->box_min, scene->box_max);
+	vks_layout_t layout = get_vks_layout(&header, (const char* const*) material_names);
+	// Write the header and the end of file marker, such that the file has its
+	// final size before the workers start
+	FILE* file = fopen(file_path, "wb");
+	if (!file) {
+		printf("Failed to open the output file %s.\n", file_path);
+		return 1;
+	}
+	if (write_vks_header(file, &header, (const char* const*) material_names) || vks_fseek(file, layout.eof_marker) || write_vks_eof_marker(file)) {
+		printf("Failed to write the header of %s.\n", file_path);
+		fclose(file);
+		return 1;
+	}
+	fclose(file);
+	// Split the triangles evenly between jobs
+	thread_count = ((uint64_t) thread_count > scene->instance_count) ? (uint32_t) scene->instance_count : thread_count;
+	generator_job_t* jobs = malloc(sizeof(generator_job_t) * thread_count);
+	memset(jobs, 0, sizeof(generator_job_t) * thread_count);
+	uint64_t instance_begin = 0;
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		generator_job_t* job = &jobs[i];
+		job->scene = scene;
+		job->file_path = file_path;
+		job->layout = layout;
+		memcpy(job->quantization_factor, quantization_factor, sizeof(quantization_factor));
+		memcpy(job->quantization_summand, quantization_summand, sizeof(quantization_summand));
+		job->instance_begin = instance_begin;
+		uint64_t triangle_end = (scene->triangle_count * (i + 1)) / thread_count;
+		uint64_t instance_end = instance_begin;
+		while (instance_end != scene->instance_count && scene->instances[instance_end].first_triangle < triangle_end)
+			++instance_end;
+		job->instance_end = instance_begin = (i + 1 == thread_count) ? scene->instance_count : instance_end;
+	}
+	run_in_parallel(thread_count, run_generator_job, jobs, sizeof(generator_job_t));
+	int result = 0;
+	uint64_t clamped_count = 0;
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		result |= jobs[i].result;
+		clamped_count += jobs[i].clamped_count;
+	}
+	free(jobs);
+	if (clamped_count)
+		printf("Texture coordinates of %llu triangles imply more than seven repetitions and have been clamped.\n", (unsigned long long) clamped_count);
+	return result;
+}
+
+
+//! Creates the given directory unless it exists already
+void create_directory(const char* path) {
+#ifdef _WIN32
+	_mkdir(path);
+#else
+	mkdir(path, 0755);
+#endif
+}
+
+
+/*! Writes a *.vkt texture of size 4x4 with a single mipmap consisting of the
+	given compressed block.
+	\return 0 on success.*/
+int write_constant_texture(const char* file_path, int32_t format, const uint8_t* block, size_t block_size) {
+	FILE* file = fopen(file_path, "wb");
+	if (!file) {
+		printf("Failed to open the texture file %s for writing.\n", file_path);
+		return 1;
+	}
+	int32_t header[6] = { 0xbc1bc1, 1, 1, 4, 4, format };
+	size_t payload_size = block_size;
+	int32_t mipmap_extent[2] = { 4, 4 };
+	size_t mipmap_offset = 0;
+	uint32_t eof = VKS_EOF_MARKER;
+	int result = fwrite(header, sizeof(int32_t), 6, file) != 6
+		|| fwrite(&payload_size, sizeof(payload_size), 1, file) != 1
+		|| fwrite(mipmap_extent, sizeof(int32_t), 2, file) != 2
+		|| fwrite(&payload_size, sizeof(payload_size), 1, file) != 1
+		|| fwrite(&mipmap_offset, sizeof(mipmap_offset), 1, file) != 1
+		|| fwrite(block, sizeof(uint8_t), block_size, file) != block_size
+		|| fwrite(&eof, sizeof(eof), 1, file) != 1;
+	fclose(file);
+	if (result)
+		printf("Failed to write the texture file %s.\n", file_path);
+	return result;
+}
+
+
+//! Converts a color with components in [0,1] to 16-bit RGB565
+static inline uint16_t get_rgb565(float red, float green, float blue) {
+	return (uint16_t) (((uint32_t) (red * 31.0f + 0.5f) << 11) | ((uint32_t) (green * 63.0f + 0.5f) << 5) | (uint32_t) (blue * 31.0f + 0.5f));
+}
+
+
+/*! Writes textures for all materials into the given directory. Each material
+	has a distinct uniform base color, a roughness that varies between
+	materials and a flat normal map.
+	\return 0 on success.*/
+int write_material_textures(const char* texture_directory, char** material_names, uint32_t material_count) {
+	create_directory(texture_directory);
+	for (uint32_t i = 0; i != material_count; ++i) {
+		// Pick a hue from the golden angle for distinct colors
+		float hue = fmodf((float) i * 0.381966f, 1.0f) * 6.0f;
+		float rgb[3];
+		for (uint32_t j = 0; j != 3; ++j) {
+			float channel = fabsf(fmodf(hue + 4.0f * (float) j, 6.0f) - 3.0f) - 1.0f;
+			channel = (channel < 0.0f) ? 0.0f : ((channel > 1.0f) ? 1.0f : channel);
+			rgb[j] = 0.8f * (0.4f + 0.6f * channel);
+		}
+		float roughness = 0.2f + 0.6f * fmodf((float) i * 0.618034f, 1.0f);
+		uint16_t base_color = get_rgb565(rgb[0], rgb[1], rgb[2]);
+		uint16_t specular = get_rgb565(1.0f, roughness, 0.0f);
+		// BC1 blocks with equal endpoints and all indices zero are constant
+		uint8_t base_color_block[8] = { base_color & 0xFF, base_color >> 8, base_color & 0xFF, base_color >> 8, 0, 0, 0, 0 };
+		uint8_t specular_block[8] = { specular & 0xFF, specular >> 8, specular & 0xFF, specular >> 8, 0, 0, 0, 0 };
+		// A BC5 block, i.e. two BC4 blocks, encoding (0.5, 0.5)
+		uint8_t normal_block[16] = { 128, 128, 0, 0, 0, 0, 0, 0, 128, 128, 0, 0, 0, 0, 0, 0 };
+		const char* suffixes[3] = { "_BaseColor.vkt", "_Specular.vkt", "_Normal.vkt" };
+		// VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC1_RGB_UNORM_BLOCK,
+		// VK_FORMAT_BC5_UNORM_BLOCK
+		int32_t formats[3] = { 132, 131, 141 };
+		const uint8_t* blocks[3] = { base_color_block, specular_block, normal_block };
+		size_t block_sizes[3] = { sizeof(base_color_block), sizeof(specular_block), sizeof(normal_block) };
+		for (uint32_t j = 0; j != 3; ++j) {
+			size_t path_size = strlen(texture_directory) + 1 + strlen(material_names[i]) + strlen(suffixes[j]) + 1;
+			char* path = malloc(path_size);
+			sprintf(path, "%s/%s%s", texture_directory, material_names[i], suffixes[j]);
+			int result = write_constant_texture(path, formats[j], blocks[j], block_sizes[j]);
+			free(path);
+			if (result)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*! Writes a quicksave with a camera overlooking the scene and light_count
+	rectangular lights on a regular grid above the scene. The layout matches
+	quick_save() in main.c.
+	\return 0 on success.*/
+int write_quicksave(const stress_scene_t* scene, const char* file_path, uint32_t light_count, uint32_t seed) {
+	FILE* file = fopen(file_path, "wb");
+	if (!file) {
+		printf("Failed to open the quicksave file %s for writing.\n", file_path);
+		return 1;
+	}
+	float extent[3], center[3];
+	for (uint32_t j = 0; j != 3; ++j) {
+		extent[j] = scene->box_max[j] - scene->box_min[j];
+		center[j] = 0.5f * (scene->box_min[j] + scene->box_max[j]);
+	}
+	float horizontal_extent = (extent[0] > extent[1]) ? extent[0] : extent[1];
+	first_person_camera_t camera;
+	memset(&camera, 0, sizeof(camera));
+	camera.vertical_fov = 0.4f * M_PI_F;
+	camera.near = 0.05f;
+	camera.far = 10.0f * (horizontal_extent + extent[2]);
+	camera.speed = 0.1f * horizontal_extent;
+	if (scene->type == scene_type_occluders) {
+		// Look through all layers along +y
+		camera.position_world_space[0] = center[0];
+		camera.position_world_space[1] = scene->box_min[1] - 0.5f * extent[0];
+		camera.position_world_space[2] = center[2];
+		camera.rotation_x = 0.5f * M_PI_F;
+		camera.rotation_z = M_PI_F;
+	}
+	else {
+		// Look at the center from above at an angle
+		camera.position_world_space[0] = center[0];
+		camera.position_world_space[1] = scene->box_min[1] - 0.1f * horizontal_extent;
+		camera.position_world_space[2] = scene->box_max[2] + 0.3f * horizontal_extent;
+		camera.rotation_x = 0.3f * M_PI_F;
+		camera.rotation_z = M_PI_F;
+	}
+	fwrite(&camera, sizeof(camera), 1, file);
+	uint32_t legacy_count = 0;
+	fwrite(&legacy_count, sizeof(uint32_t), 1, file);
+	fwrite(&light_count, sizeof(uint32_t), 1, file);
+	// Lights form a grid above the scene and point downwards. Their total
+	// radiant flux is independent of their count.
+	uint32_t grid_size = (uint32_t) ceil(sqrt((double) light_count));
+	grid_size = (grid_size < 1) ? 1 : grid_size;
+	float spacing = horizontal_extent / (float) grid_size;
+	float total_flux = 2.0f * horizontal_extent * horizontal_extent;
+	for (uint32_t i = 0; i != light_count; ++i) {
+		polygonal_light_t light;
+		memset(&light, 0, sizeof(light));
+		light.rotation_angles[0] = M_PI_F;
+		light.rotation_angles[2] = 2.0f * M_PI_F * get_random_float(seed, i, 0);
+		light.scaling_x = light.scaling_y = 0.25f * spacing;
+		light.inv_scaling_x = light.inv_scaling_y = 1.0f / light.scaling_x;
+		light.translation[0] = scene->box_min[0] + spacing * ((float) (i % grid_size) + 0.5f);
+		light.translation[1] = scene->box_min[1] + spacing * ((float) (i / grid_size) + 0.5f);
+		light.translation[2] = scene->box_max[2] + 0.25f * horizontal_extent;
+		for (uint32_t j = 0; j != 3; ++j)
+			light.radiant_flux[j] = total_flux / (float) light_count * (0.8f + 0.4f * get_random_float(seed, i, 1 + j));
+		light.vertex_count = 4;
+		light.texturing_technique = polygon_texturing_none;
+		fwrite(&light, POLYGONAL_LIGHT_QUICKSAVE_SIZE, 1, file);
+		size_t path_size = 0;
+		fwrite(&path_size, sizeof(path_size), 1, file);
+		float* null_pointers[2] = { NULL, NULL };
+		fwrite(null_pointers, sizeof(float*), 2, file);
+		float vertices_plane_space[4][4] = {
+			{0.0f, 0.0f, 0.0f, 0.0f},
+			{1.0f, 0.0f, 0.0f, 0.0f},
+			{1.0f, 1.0f, 0.0f, 0.0f},
+			{0.0f, 1.0f, 0.0f, 0.0f},
+		};
+		fwrite(vertices_plane_space, sizeof(float), 4 * light.vertex_count, file);
+	}
+	int result = ferror(file);
+	fclose(file);
+	if (result)
+		printf("Failed to write the quicksave file %s.\n", file_path);
+	return result;
+}
+
+
+//! Returns the concatenation of the two given strings, which has to be freed
+char* concatenate_two(const char* lhs, const char* rhs) {
+	char* result = malloc(strlen(lhs) + strlen(rhs) + 1);
+	strcpy(result, lhs);
+	strcat(result, rhs);
+	return result;
+}
+
+
+int main(int argc, char** argv) {
+	// Parse command line arguments
+	generator_settings_t settings = {
+		.type = scene_type_count,
+		.target_triangle_count = 10000000,
+		.material_count = 16,
+		.layer_count = 16,
+		.light_count = 4,
+		.thread_count = get_hardware_thread_count(),
+		.seed = 0,
+		.sort_instances = 1,
+	};
+	if (argc >= 3) {
+		for (uint32_t i = 0; i != scene_type_count; ++i)
+			if (strcmp(argv[1], g_scene_type_names[i]) == 0)
+				settings.type = (scene_type_t) i;
+		settings.output_prefix = argv[2];
+	}
+	int valid = (settings.type != scene_type_count);
+	for (int i = 3; i < argc && valid; ++i) {
+		unsigned long long value = 0;
+		valid &= (i + 1 < argc && sscanf(argv[i + 1], "%llu", &value) == 1);
+		if (!valid) break;
+		if (strcmp(argv[i], "-triangles") == 0) settings.target_triangle_count = value;
+		else if (strcmp(argv[i], "-materials") == 0) settings.material_count = (uint32_t) value;
+		else if (strcmp(argv[i], "-layers") == 0) settings.layer_count = (uint32_t) value;
+		else if (strcmp(argv[i], "-lights") == 0) settings.light_count = (uint32_t) value;
+		else if (strcmp(argv[i], "-threads") == 0) settings.thread_count = (uint32_t) value;
+		else if (strcmp(argv[i], "-seed") == 0) settings.seed = (uint32_t) value;
+		else if (strcmp(argv[i], "-sort") == 0) settings.sort_instances = (value != 0);
+		else valid = 0;
+		++i;
+	}
+	valid &= (settings.material_count >= 1 && settings.material_count <= VKS_MAX_MATERIAL_COUNT);
+	valid &= (settings.layer_count >= 1 && settings.thread_count >= 1 && settings.target_triangle_count >= 1);
+	if (!valid) {
+		printf("Usage: scene_generator <grid|foliage|occluders> <output_prefix> [options]\n");
+		printf("Options (each followed by an integer):\n\
+-triangles   Approximate total triangle count (default 10000000)\n\
+-materials   Number of materials, at most 256 (default 16)\n\
+-layers      Number of walls for the occluders scene (default 16)\n\
+-lights      Number of polygonal lights in the quicksave (default 4)\n\
+-threads     Number of worker threads (default: hardware thread count)\n\
+-seed        Seed for pseudo-random placement (default 0)\n\
+-sort        1 to sort instances by Morton code, 0 otherwise (default 1)\n");
+		printf("Writes <output_prefix>.vks, <output_prefix>.save and textures in <output_prefix>_textures.\n");
+		return 1;
+	}
+	double start_time = get_tool_time();
+
+	// Define the scene
+	stress_scene_t scene;
+	if (create_stress_scene(&scene, &settings)) {
+		destroy_stress_scene(&scene);
+		return 1;
+	}
+	// Sorting would break the back-to-front order of occluders
+	if (settings.sort_instances && scene.type != scene_type_occluders)
+		sort_instances(&scene);
+	char** material_names = malloc(sizeof(char*) * scene.material_count);
+	for (uint32_t i = 0; i != scene.material_count; ++i) {
+		material_names[i] = malloc(32);
+		sprintf(material_names[i], "stress_material_%03u", i);
+	}
+
+	// Write all output files
+	char* scene_path = concatenate_two(settings.output_prefix, ".vks");
+	char* texture_directory = concatenate_two(settings.output_prefix, "_textures");
+	char* quicksave_path = concatenate_two(settings.output_prefix, ".save");
+	int result = write_stress_scene(&scene, scene_path, material_names, settings.thread_count)
+		|| write_material_textures(texture_directory, material_names, scene.material_count)
+		|| write_quicksave(&scene, quicksave_path, settings.light_count, settings.seed);
+	if (!result)
+		printf("Wrote %llu triangles in %llu instances with %u materials to %s in %.3f seconds using %u threads.\n",
+			(unsigned long long) scene.triangle_count, (unsigned long long) scene.instance_count, scene.material_count,
+			scene_path, get_tool_time() - start_time, settings.thread_count);
+
+	// Clean up
+	free(scene_path);
+	free(texture_directory);
+	free(quicksave_path);
+	free_vks_material_names(material_names, scene.material_count);
+	destroy_stress_scene(&scene);
+	return result;
+}
@@ -0,0 +1,739 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "scene_importer.h"
+#include "tool_threads.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+//! The types of values in a JSON document
+typedef enum json_type_e {
+	json_type_null,
+	json_type_boolean,
+	json_type_number,
+	json_type_string,
+	json_type_array,
+	json_type_object,
+} json_type_t;
+
+
+/*! A single value in a parsed JSON document. The document is stored as flat
+	array of tokens in depth-first order. Object members are stored as key
+	token (a string) followed by the value.*/
+typedef struct json_token_s {
+	json_type_t type;
+	//! For strings, the characters between the quotes (escape sequences are
+	//! not decoded). For other types, the whole text of the value.
+	const char* text;
+	uint32_t length;
+	//! For arrays the element count, for objects the member count
+	uint32_t child_count;
+	//! The index of the first token after this value and all its children
+	uint32_t next;
+	//! For numbers and booleans the value
+	double number;
+} json_token_t;
+
+
+//! A parsed JSON document
+typedef struct json_document_s {
+	uint32_t token_count, token_capacity;
+	json_token_t* tokens;
+} json_document_t;
+
+
+//! Skips JSON white space
+static const char* skip_json_space(const char* text, const char* end) {
+	while (text != end && (*text == ' ' || *text == '\t' || *text == '\n' || *text == '\r'))
+		++text;
+	return text;
+}
+
+
+/*! Parses the JSON value at the given location recursively and appends
+	tokens to the document.
+	\return A pointer to the first character after the value or NULL on
+		failure.*/
+static const char* parse_json_value(json_document_t* document, const char* text, const char* end, uint32_t depth) {
+	text = skip_json_space(text, end);
+	if (text == end || depth > 256)
+		return NULL;
+	if (document->token_count == document->token_capacity) {
+		document->token_capacity = 2 * document->token_capacity + 1024;
+		document->tokens = realloc(document->tokens, sizeof(json_token_t) * document->token_capacity);
+	}
+	uint32_t index = document->token_count++;
+	json_token_t token = { .text = text };
+	if (*text == '{' || *text == '[') {
+		int is_object = (*text == '{');
+		char closing = is_object ? '}' : ']';
+		token.type = is_object ? json_type_object : json_type_array;
+		text = skip_json_space(text + 1, end);
+		while (text != end && *text != closing) {
+			if (is_object) {
+				if (*text != '"' || !(text = parse_json_value(document, text, end, depth + 1)))
+					return NULL;
+				text = skip_json_space(text, end);
+				if (text == end || *text != ':')
+					return NULL;
+				++text;
+			}
+			if (!(text = parse_json_value(document, text, end, depth + 1)))
+				return NULL;
+			++token.child_count;
+			text = skip_json_space(text, end);
+			if (text != end && *text == ',')
+				text = skip_json_space(text + 1, end);
+			else if (text == end || *text != closing)
+				return NULL;
+		}
+		if (text == end)
+			return NULL;
+		++text;
+	}
+	else if (*text == '"') {
+		token.type = json_type_string;
+		token.text = ++text;
+		while (text != end && *text != '"')
+			text += (*text == '\\' && text + 1 != end) ? 2 : 1;
+		if (text == end)
+			return NULL;
+		token.length = (uint32_t) (text - token.text);
+		++text;
+	}
+	else if (end - text >= 4 && memcmp(text, "true", 4) == 0) {
+		token.type = json_type_boolean;
+		token.number = 1.0;
+		text += 4;
+	}
+	else if (end - text >= 5 && memcmp(text, "false", 5) == 0) {
+		token.type = json_type_boolean;
+		text += 5;
+	}
+	else if (end - text >= 4 && memcmp(text, "null", 4) == 0) {
+		token.type = json_type_null;
+		text += 4;
+	}
+	else {
+		char* number_end;
+		token.type = json_type_number;
+		token.number = strtod(text, &number_end);
+		if (number_end == text || number_end > end)
+			return NULL;
+		text = number_end;
+	}
+	if (token.type != json_type_string)
+		token.length = (uint32_t) (text - token.text);
+	token.next = document->token_count;
+	document->tokens[index] = token;
+	return text;
+}
+
+
+//! Returns the index of the member with the given key in the given object or
+//! 0 if there is no such member (index 0 is always the root)
+static uint32_t get_json_member(const json_document_t* document, uint32_t object, const char* key) {
+	if (object == 0 && document->tokens[0].type != json_type_object) return 0;
+	if (document->tokens[object].type != json_type_object) return 0;
+	size_t key_length = strlen(key);
+	uint32_t token = object + 1;
+	for (uint32_t i = 0; i != document->tokens[object].child_count; ++i) {
+		const json_token_t* key_token = &document->tokens[token];
+		if (key_token->length == key_length && memcmp(key_token->text, key, key_length) == 0)
+			return token + 1;
+		token = document->tokens[token + 1].next;
+	}
+	return 0;
+}
+
+
+//! Returns the index of the element with the given index in the given array
+//! or 0 if it does not exist
+static uint32_t get_json_element(const json_document_t* document, uint32_t array, uint32_t element) {
+	if (array == 0 || document->tokens[array].type != json_type_array || element >= document->tokens[array].child_count)
+		return 0;
+	uint32_t token = array + 1;
+	for (uint32_t i = 0; i != element; ++i)
+		token = document->tokens[token].next;
+	return token;
+}
+
+
+//! Returns the number in the given member of the given object or the default
+//! if it does not exist
+static double get_json_number(const json_document_t* document, uint32_t object, const char* key, double default_value) {
+	uint32_t member = object ? get_json_member(document, object, key) : 0;
+	return (member && document->tokens[member].type == json_type_number) ? document->tokens[member].number : default_value;
+}
+
+
+//! Like get_json_number() but with an integer. Returns -1 if there is no
+//! such member.
+static int64_t get_json_index(const json_document_t* document, uint32_t object, const char* key) {
+	return (int64_t) get_json_number(document, object, key, -1.0);
+}
+
+
+//! Writes up to count numbers from the array in the given member of the given
+//! object. Returns the number of written numbers.
+static uint32_t get_json_numbers(float* numbers, uint32_t count, const json_document_t* document, uint32_t object, const char* key) {
+	uint32_t array = get_json_member(document, object, key);
+	if (!array || document->tokens[array].type != json_type_array)
+		return 0;
+	uint32_t token = array + 1, written = 0;
+	for (uint32_t i = 0; i != document->tokens[array].child_count && written != count; ++i) {
+		numbers[written++] = (float) document->tokens[token].number;
+		token = document->tokens[token].next;
+	}
+	return written;
+}
+
+
+//! Turns a glTF component type and accessor type into the byte size of one
+//! element. Returns 0 for unsupported types.
+static uint32_t get_accessor_element_size(int64_t component_type, const json_token_t* type, uint32_t* component_count) {
+	uint32_t component_size = 0;
+	switch (component_type) {
+	case 5120: case 5121: component_size = 1; break;
+	case 5122: case 5123: component_size = 2; break;
+	case 5125: case 5126: component_size = 4; break;
+	default: return 0;
+	}
+	const char* type_names[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+	for (uint32_t i = 0; i != 4; ++i) {
+		if (type->length == strlen(type_names[i]) && memcmp(type->text, type_names[i], type->length) == 0) {
+			(*component_count) = i + 1;
+			return component_size * (i + 1);
+		}
+	}
+	return 0;
+}
+
+
+//! Provides convenient access to the data of a glTF accessor
+typedef struct gltf_accessor_s {
+	//! Pointer to the first element or NULL if the accessor is unavailable
+	const uint8_t* data;
+	//! The number of elements
+	uint64_t count;
+	//! The byte distance between consecutive elements
+	uint64_t stride;
+	//! The glTF component type (5120 to 5126)
+	int64_t component_type;
+	//! The number of components per element (1 to 4)
+	uint32_t component_count;
+	//! Whether integer components are normalized
+	int normalized;
+} gltf_accessor_t;
+
+
+//! Loaded buffers of a glTF file
+typedef struct gltf_buffers_s {
+	uint32_t count;
+	//! For each buffer a pointer to its data and its size
+	const uint8_t** data;
+	uint64_t* sizes;
+	//! Memory allocated for external buffers that has to be freed
+	char** allocations;
+} gltf_buffers_t;
+
+
+/*! Retrieves the accessor with the given index and validates that it lies
+	within the loaded buffers.
+	\return 0 on success.*/
+static int get_gltf_accessor(gltf_accessor_t* accessor, const json_document_t* document, const gltf_buffers_t* buffers, int64_t index) {
+	memset(accessor, 0, sizeof(*accessor));
+	uint32_t accessor_token = get_json_element(document, get_json_member(document, 0, "accessors"), (uint32_t) index);
+	if (index < 0 || !accessor_token)
+		return 1;
+	if (get_json_member(document, accessor_token, "sparse")) {
+		printf("Sparse accessors are not supported.\n");
+		return 1;
+	}
+	uint32_t type = get_json_member(document, accessor_token, "type");
+	accessor->component_type = get_json_index(document, accessor_token, "componentType");
+	accessor->count = (uint64_t) get_json_number(document, accessor_token, "count", 0.0);
+	uint32_t normalized = get_json_member(document, accessor_token, "normalized");
+	accessor->normalized = normalized && document->tokens[normalized].number != 0.0;
+	uint32_t element_size = type ? get_accessor_element_size(accessor->component_type, &document->tokens[type], &accessor->component_count) : 0;
+	uint32_t view = get_json_element(document, get_json_member(document, 0, "bufferViews"), (uint32_t) get_json_index(document, accessor_token, "bufferView"));
+	if (!element_size || !view)
+		return 1;
+	int64_t buffer = get_json_index(document, view, "buffer");
+	uint64_t view_offset = (uint64_t) get_json_number(document, view, "byteOffset", 0.0);
+	uint64_t view_length = (uint64_t) get_json_number(document, view, "byteLength", 0.0);
+	accessor->stride = (uint64_t) get_json_number(document, view, "byteStride", (double) element_size);
+	uint64_t offset = view_offset + (uint64_t) get_json_number(document, accessor_token, "byteOffset", 0.0);
+	if (buffer < 0 || buffer >= buffers->count || !buffers->data[buffer] || view_offset + view_length > buffers->sizes[buffer])
+		return 1;
+	if (accessor->count > 0 && offset + (accessor->count - 1) * accessor->stride + element_size > view_offset + view_length)
+		return 1;
+	accessor->data = buffers->data[buffer] + offset;
+	return 0;
+}
+
+
+//! Reads a single component of an element of the given accessor and
+//! converts it to float (respecting normalization)
+static inline float read_accessor_float(const gltf_accessor_t* accessor, uint64_t element, uint32_t component) {
+	const uint8_t* data = accessor->data + element * accessor->stride;
+	switch (accessor->component_type) {
+	case 5126: { float value; memcpy(&value, data + 4 * component, 4); return value; }
+	case 5121: return accessor->normalized ? (data[component] / 255.0f) : data[component];
+	case 5123: { uint16_t value; memcpy(&value, data + 2 * component, 2); return accessor->normalized ? (value / 65535.0f) : value; }
+	case 5120: { int8_t value = (int8_t) data[component]; return accessor->normalized ? fmaxf(value / 127.0f, -1.0f) : value; }
+	case 5122: { int16_t value; memcpy(&value, data + 2 * component, 2); return accessor->normalized ? fmaxf(value / 32767.0f, -1.0f) : value; }
+	case 5125: { uint32_t value; memcpy(&value, data + 4 * component, 4); return (float) value; }
+	default: return 0.0f;
+	}
+}
+
+
+//! Reads an unsigned integer index from the given accessor
+static inline uint32_t read_accessor_index(const gltf_accessor_t* accessor, uint64_t element) {
+	const uint8_t* data = accessor->data + element * accessor->stride;
+	switch (accessor->component_type) {
+	case 5121: return data[0];
+	case 5123: { uint16_t value; memcpy(&value, data, 2); return value; }
+	case 5125: { uint32_t value; memcpy(&value, data, 4); return value; }
+	default: return 0;
+	}
+}
+
+
+//! A single triangle primitive of a mesh instanced by a node, along with
+//! everything needed to write it to the imported scene
+typedef struct gltf_draw_s {
+	//! Object to world space transform in row-major order and its cofactor
+	//! matrix for normals
+	float transform[3][4], normal_transform[3][3];
+	//! Whether the transform flips orientation
+	int flip_winding;
+	//! Accessors for vertex attributes and indices (data may be NULL for
+	//! normals, texture coordinates and indices)
+	gltf_accessor_t positions, normals, tex_coords, indices;
+	//! The material index in the imported scene
+	uint32_t material_index;
+	//! Global offsets of vertices and triangles of this draw
+	uint64_t vertex_offset, triangle_offset;
+} gltf_draw_t;
+
+
+//! The work of one thread decoding glTF data
+typedef struct gltf_job_s {
+	imported_scene_t* scene;
+	const gltf_draw_t* draws;
+	uint32_t draw_count;
+	//! The range of global vertices and triangles to decode
+	uint64_t vertex_begin, vertex_end, triangle_begin, triangle_end;
+	//! Whether positions and normals are rotated from y-up to z-up
+	int y_up;
+	//! The number of indices that were out of bounds
+	uint64_t invalid_index_count;
+} gltf_job_t;
+
+
+//! Returns the index of the draw containing the given global element using
+//! binary search over vertex or triangle offsets
+static uint32_t find_gltf_draw(const gltf_draw_t* draws, uint32_t draw_count, uint64_t element, int triangles) {
+	uint32_t low = 0, high = draw_count;
+	while (high - low > 1) {
+		uint32_t middle = (low + high) / 2;
+		uint64_t offset = triangles ? draws[middle].triangle_offset : draws[middle].vertex_offset;
+		if (offset <= element) low = middle;
+		else high = middle;
+	}
+	return low;
+}
+
+
+//! Thread function decoding vertices and triangles. Takes a gltf_job_t.
+void run_gltf_job(void* argument) {
+	gltf_job_t* job = (gltf_job_t*) argument;
+	imported_scene_t* scene = job->scene;
+	// Transform vertices to world space
+	uint32_t draw_index = find_gltf_draw(job->draws, job->draw_count, job->vertex_begin, 0);
+	for (uint64_t v = job->vertex_begin; v < job->vertex_end; ++v) {
+		while (draw_index + 1 < job->draw_count && job->draws[draw_index + 1].vertex_offset <= v)
+			++draw_index;
+		const gltf_draw_t* draw = &job->draws[draw_index];
+		uint64_t local = v - draw->vertex_offset;
+		float position[3], normal[3] = { 0.0f, 0.0f, 1.0f };
+		for (uint32_t j = 0; j != 3; ++j)
+			position[j] = read_accessor_float(&draw->positions, local, j);
+		if (draw->normals.data)
+			for (uint32_t j = 0; j != 3; ++j)
+				normal[j] = read_accessor_float(&draw->normals, local, j);
+		float* world_position = scene->positions[v];
+		float* world_normal = scene->normals[v];
+		for (uint32_t i = 0; i != 3; ++i) {
+			world_position[i] = draw->transform[i][3];
+			world_normal[i] = 0.0f;
+			for (uint32_t j = 0; j != 3; ++j) {
+				world_position[i] += draw->transform[i][j] * position[j];
+				world_normal[i] += draw->normal_transform[i][j] * normal[j];
+			}
+		}
+		if (job->y_up) {
+			float y = world_position[1];
+			world_position[1] = -world_position[2];
+			world_position[2] = y;
+			y = world_normal[1];
+			world_normal[1] = -world_normal[2];
+			world_normal[2] = y;
+		}
+		// glTF puts the texture coordinate origin at the top left
+		scene->tex_coords[v][0] = draw->tex_coords.data ? read_accessor_float(&draw->tex_coords, local, 0) : 0.0f;
+		scene->tex_coords[v][1] = draw->tex_coords.data ? (1.0f - read_accessor_float(&draw->tex_coords, local, 1)) : 0.0f;
+	}
+	// Resolve indices
+	draw_index = find_gltf_draw(job->draws, job->draw_count, job->triangle_begin, 1);
+	for (uint64_t t = job->triangle_begin; t < job->triangle_end; ++t) {
+		while (draw_index + 1 < job->draw_count && job->draws[draw_index + 1].triangle_offset <= t)
+			++draw_index;
+		const gltf_draw_t* draw = &job->draws[draw_index];
+		uint64_t local = t - draw->triangle_offset;
+		for (uint32_t k = 0; k != 3; ++k) {
+			uint32_t corner = draw->flip_winding ? (2 - k) : k;
+			uint64_t index = draw->indices.data ? read_accessor_index(&draw->indices, 3 * local + corner) : (3 * local + corner);
+			if (index >= draw->positions.count) {
+				++job->invalid_index_count;
+				index = 0;
+			}
+			uint32_t vertex = (uint32_t) (draw->vertex_offset + index);
+			scene->corners[t][k][0] = vertex;
+			scene->corners[t][k][1] = draw->tex_coords.data ? vertex : NO_ATTRIBUTE;
+			scene->corners[t][k][2] = draw->normals.data ? vertex : NO_ATTRIBUTE;
+		}
+		scene->material_indices[t] = (uint8_t) draw->material_index;
+	}
+}
+
+
+//! Multiplies two column-major 4x4 matrices as used by glTF
+static void multiply_gltf_matrices(float result[16], const float lhs[16], const float rhs[16]) {
+	float product[16];
+	for (uint32_t column = 0; column != 4; ++column)
+		for (uint32_t row = 0; row != 4; ++row) {
+			product[column * 4 + row] = 0.0f;
+			for (uint32_t k = 0; k != 4; ++k)
+				product[column * 4 + row] += lhs[k * 4 + row] * rhs[column * 4 + k];
+		}
+	memcpy(result, product, sizeof(product));
+}
+
+
+//! Computes the local transform of a node as column-major 4x4 matrix from its
+//! matrix or its translation, rotation and scale
+static void get_gltf_node_transform(float transform[16], const json_document_t* document, uint32_t node) {
+	float identity[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	memcpy(transform, identity, sizeof(identity));
+	if (get_json_numbers(transform, 16, document, node, "matrix") == 16)
+		return;
+	float translation[3] = { 0.0f, 0.0f, 0.0f }, rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f }, scale[3] = { 1.0f, 1.0f, 1.0f };
+	get_json_numbers(translation, 3, document, node, "translation");
+	get_json_numbers(rotation, 4, document, node, "rotation");
+	get_json_numbers(scale, 3, document, node, "scale");
+	float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+	float rotation_matrix[3][3] = {
+		{1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - z * w), 2.0f * (x * z + y * w)},
+		{2.0f * (x * y + z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z - x * w)},
+		{2.0f * (x * z - y * w), 2.0f * (y * z + x * w), 1.0f - 2.0f * (x * x + y * y)},
+	};
+	for (uint32_t column = 0; column != 3; ++column)
+		for (uint32_t row = 0; row != 3; ++row)
+			transform[column * 4 + row] = rotation_matrix[row][column] * scale[column];
+	for (uint32_t row = 0; row != 3; ++row)
+		transform[12 + row] = translation[row];
+}
+
+
+//! State for the traversal of the node hierarchy
+typedef struct gltf_traversal_s {
+	const json_document_t* document;
+	const gltf_buffers_t* buffers;
+	imported_scene_t* scene;
+	uint32_t draw_count, draw_capacity;
+	gltf_draw_t* draws;
+	uint64_t vertex_count, triangle_count;
+	uint64_t skipped_primitive_count;
+	int result;
+} gltf_traversal_t;
+
+
+//! Creates draws for all triangle primitives of the given node and its
+//! children recursively
+static void traverse_gltf_node(gltf_traversal_t* traversal, uint32_t node, const float parent_transform[16], uint32_t depth) {
+	const json_document_t* document = traversal->document;
+	if (!node || depth > 64) {
+		traversal->result = 1;
+		return;
+	}
+	float transform[16];
+	get_gltf_node_transform(transform, document, node);
+	multiply_gltf_matrices(transform, parent_transform, transform);
+	uint32_t mesh = get_json_element(document, get_json_member(document, 0, "meshes"), (uint32_t) get_json_index(document, node, "mesh"));
+	uint32_t primitives = mesh ? get_json_member(document, mesh, "primitives") : 0;
+	for (uint32_t i = 0; primitives && i != document->tokens[primitives].child_count; ++i) {
+		uint32_t primitive = get_json_element(document, primitives, i);
+		if (get_json_index(document, primitive, "mode") != -1 && get_json_index(document, primitive, "mode") != 4) {
+			++traversal->skipped_primitive_count;
+			continue;
+		}
+		uint32_t attributes = get_json_member(document, primitive, "attributes");
+		gltf_draw_t draw;
+		memset(&draw, 0, sizeof(draw));
+		if (get_gltf_accessor(&draw.positions, document, traversal->buffers, get_json_index(document, attributes, "POSITION")) || draw.positions.component_count != 3) {
+			++traversal->skipped_primitive_count;
+			continue;
+		}
+		if (get_gltf_accessor(&draw.normals, document, traversal->buffers, get_json_index(document, attributes, "NORMAL")) || draw.normals.component_count != 3 || draw.normals.count != draw.positions.count)
+			draw.normals.data = NULL;
+		if (get_gltf_accessor(&draw.tex_coords, document, traversal->buffers, get_json_index(document, attributes, "TEXCOORD_0")) || draw.tex_coords.component_count != 2 || draw.tex_coords.count != draw.positions.count)
+			draw.tex_coords.data = NULL;
+		int64_t indices = get_json_index(document, primitive, "indices");
+		if (indices >= 0 && (get_gltf_accessor(&draw.indices, document, traversal->buffers, indices) || draw.indices.component_count != 1)) {
+			++traversal->skipped_primitive_count;
+			continue;
+		}
+		uint64_t triangle_count = (indices >= 0 ? draw.indices.count : draw.positions.count) / 3;
+		if (triangle_count == 0)
+			continue;
+		// Store the transform in row-major order and compute its cofactor
+		// matrix for normals
+		for (uint32_t row = 0; row != 3; ++row)
+			for (uint32_t column = 0; column != 4; ++column)
+				draw.transform[row][column] = transform[column * 4 + row];
+		for (uint32_t row = 0; row != 3; ++row)
+			for (uint32_t column = 0; column != 3; ++column) {
+				uint32_t r0 = (row + 1) % 3, r1 = (row + 2) % 3, c0 = (column + 1) % 3, c1 = (column + 2) % 3;
+				draw.normal_transform[row][column] = draw.transform[r0][c0] * draw.transform[r1][c1] - draw.transform[r0][c1] * draw.transform[r1][c0];
+			}
+		float determinant = 0.0f;
+		for (uint32_t j = 0; j != 3; ++j)
+			determinant += draw.transform[0][j] * draw.normal_transform[0][j];
+		draw.flip_winding = (determinant < 0.0f);
+		// The cofactor matrix is the inverse transpose times the determinant,
+		// so its sign has to be corrected for mirroring transforms
+		if (draw.flip_winding)
+			for (uint32_t row = 0; row != 3; ++row)
+				for (uint32_t column = 0; column != 3; ++column)
+					draw.normal_transform[row][column] = -draw.normal_transform[row][column];
+		// Determine the material
+		uint32_t material = get_json_element(document, get_json_member(document, 0, "materials"), (uint32_t) get_json_index(document, primitive, "material"));
+		uint32_t name = material ? get_json_member(document, material, "name") : 0;
+		if (name && document->tokens[name].type == json_type_string)
+			draw.material_index = get_imported_material_index(traversal->scene, document->tokens[name].text, document->tokens[name].length);
+		else if (material) {
+			char generated_name[32];
+			sprintf(generated_name, "material_%lld", (long long) get_json_index(document, primitive, "material"));
+			draw.material_index = get_imported_material_index(traversal->scene, generated_name, strlen(generated_name));
+		}
+		else
+			draw.material_index = get_imported_material_index(traversal->scene, "no_material_assigned", strlen("no_material_assigned"));
+		if (draw.material_index == NO_ATTRIBUTE) {
+			printf("The glTF file uses more than 256 materials, which is not supported.\n");
+			traversal->result = 1;
+			return;
+		}
+		draw.vertex_offset = traversal->vertex_count;
+		draw.triangle_offset = traversal->triangle_count;
+		traversal->vertex_count += draw.positions.count;
+		traversal->triangle_count += triangle_count;
+		if (traversal->draw_count == traversal->draw_capacity) {
+			traversal->draw_capacity = 2 * traversal->draw_capacity + 64;
+			traversal->draws = realloc(traversal->draws, sizeof(gltf_draw_t) * traversal->draw_capacity);
+		}
+		traversal->draws[traversal->draw_count++] = draw;
+	}
+	uint32_t children = get_json_member(document, node, "children");
+	uint32_t nodes = get_json_member(document, 0, "nodes");
+	for (uint32_t i = 0; children && i != document->tokens[children].child_count && !traversal->result; ++i) {
+		uint32_t child_index = (uint32_t) document->tokens[get_json_element(document, children, i)].number;
+		traverse_gltf_node(traversal, get_json_element(document, nodes, child_index), transform, depth + 1);
+	}
+}
+
+
+//! Frees buffers allocated by load_gltf_buffers()
+static void destroy_gltf_buffers(gltf_buffers_t* buffers) {
+	for (uint32_t i = 0; i != buffers->count; ++i)
+		free(buffers->allocations[i]);
+	free(buffers->allocations);
+	free((void*) buffers->data);
+	free(buffers->sizes);
+	memset(buffers, 0, sizeof(*buffers));
+}
+
+
+/*! Provides pointers to all buffers of the given glTF document. Buffer 0 may
+	be the binary chunk of a *.glb file, others are loaded from external files
+	relative to the glTF file.
+	\return 0 on success.*/
+static int load_gltf_buffers(gltf_buffers_t* buffers, const json_document_t* document, const char* file_path, const uint8_t* binary_chunk, uint64_t binary_chunk_size) {
+	memset(buffers, 0, sizeof(*buffers));
+	uint32_t buffer_list = get_json_member(document, 0, "buffers");
+	buffers->count = buffer_list ? document->tokens[buffer_list].child_count : 0;
+	buffers->data = malloc(sizeof(uint8_t*) * (buffers->count + 1));
+	buffers->sizes = malloc(sizeof(uint64_t) * (buffers->count + 1));
+	buffers->allocations = malloc(sizeof(char*) * (buffers->count + 1));
+	memset((void*) buffers->data, 0, sizeof(uint8_t*) * (buffers->count + 1));
+	memset(buffers->allocations, 0, sizeof(char*) * (buffers->count + 1));
+	for (uint32_t i = 0; i != buffers->count; ++i) {
+		uint32_t buffer = get_json_element(document, buffer_list, i);
+		uint32_t uri = get_json_member(document, buffer, "uri");
+		if (!uri) {
+			if (i != 0 || !binary_chunk) {
+				printf("Buffer %u of the glTF file has no URI and there is no binary chunk.\n", i);
+				return 1;
+			}
+			buffers->data[i] = binary_chunk;
+			buffers->sizes[i] = binary_chunk_size;
+			continue;
+		}
+		const json_token_t* uri_token = &document->tokens[uri];
+		if (uri_token->length >= 5 && memcmp(uri_token->text, "data:", 5) == 0) {
+			printf("Buffer %u of the glTF file uses a data URI, which is not supported.\n", i);
+			return 1;
+		}
+		// Build a path relative to the directory of the glTF file
+		const char* slash = strrchr(file_path, '/');
+		const char* backslash = strrchr(file_path, '\\');
+		slash = (backslash > slash) ? backslash : slash;
+		size_t directory_length = slash ? (size_t) (slash - file_path + 1) : 0;
+		char* path = malloc(directory_length + uri_token->length + 1);
+		memcpy(path, file_path, directory_length);
+		memcpy(path + directory_length, uri_token->text, uri_token->length);
+		path[directory_length + uri_token->length] = 0;
+		buffers->allocations[i] = read_whole_file(path, &buffers->sizes[i]);
+		buffers->data[i] = (const uint8_t*) buffers->allocations[i];
+		if (!buffers->data[i]) {
+			printf("Failed to load the glTF buffer at path %s.\n", path);
+			free(path);
+			return 1;
+		}
+		free(path);
+	}
+	return 0;
+}
+
+
+int import_gltf(imported_scene_t* scene, const char* file_path, const import_settings_t* settings) {
+	memset(scene, 0, sizeof(*scene));
+	uint64_t file_size;
+	char* file = read_whole_file(file_path, &file_size);
+	if (!file) {
+		printf("Failed to read the glTF file %s.\n", file_path);
+		return 1;
+	}
+	// Find the JSON and binary chunks in *.glb files
+	const char* json = file;
+	uint64_t json_size = file_size;
+	const uint8_t* binary_chunk = NULL;
+	uint64_t binary_chunk_size = 0;
+	uint32_t header[5];
+	if (file_size >= sizeof(header))
+		memcpy(header, file, sizeof(header));
+	if (file_size >= sizeof(header) && header[0] == 0x46546C67) {
+		if (header[1] != 2 || header[2] > file_size || header[4] != 0x4E4F534A || 20ull + header[3] > file_size) {
+			printf("The file %s is not a valid binary glTF 2.0 file.\n", file_path);
+			free(file);
+			return 1;
+		}
+		json = file + 20;
+		json_size = header[3];
+		uint64_t binary_offset = 20ull + ((header[3] + 3) & ~3u);
+		uint32_t binary_header[2];
+		if (binary_offset + 8 <= file_size) {
+			memcpy(binary_header, file + binary_offset, sizeof(binary_header));
+			if (binary_header[1] == 0x004E4942 && binary_offset + 8 + binary_header[0] <= file_size) {
+				binary_chunk = (const uint8_t*) file + binary_offset + 8;
+				binary_chunk_size = binary_header[0];
+			}
+		}
+	}
+	// Parse the JSON
+	json_document_t document = { 0 };
+	gltf_buffers_t buffers = { 0 };
+	gltf_traversal_t traversal = { .document = &document, .buffers = &buffers, .scene = scene };
+	int result = 0;
+	if (!parse_json_value(&document, json, json + json_size, 0) || document.tokens[0].type != json_type_object) {
+		printf("Failed to parse the JSON part of the glTF file %s.\n", file_path);
+		result = 1;
+	}
+	else if (load_gltf_buffers(&buffers, &document, file_path, binary_chunk, binary_chunk_size))
+		result = 1;
+	else {
+		// Traverse the root nodes of the default scene or of the first scene
+		uint32_t scenes = get_json_member(&document, 0, "scenes");
+		int64_t scene_index = get_json_index(&document, 0, "scene");
+		uint32_t root_scene = get_json_element(&document, scenes, (scene_index >= 0) ? (uint32_t) scene_index : 0);
+		uint32_t roots = root_scene ? get_json_member(&document, root_scene, "nodes") : 0;
+		uint32_t nodes = get_json_member(&document, 0, "nodes");
+		float identity[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+		for (uint32_t i = 0; roots && i != document.tokens[roots].child_count && !traversal.result; ++i) {
+			uint32_t node_index = (uint32_t) document.tokens[get_json_element(&document, roots, i)].number;
+			traverse_gltf_node(&traversal, get_json_element(&document, nodes, node_index), identity, 0);
+		}
+		result = traversal.result;
+		if (traversal.skipped_primitive_count)
+			printf("Skipped %llu primitives that are not triangle lists or lack valid positions.\n", (unsigned long long) traversal.skipped_primitive_count);
+		if (!result && traversal.triangle_count == 0) {
+			printf("The glTF file %s does not contain any triangles in its default scene.\n", file_path);
+			result = 1;
+		}
+		else if (!result && (traversal.vertex_count > 0xFFFFFFFEull || traversal.triangle_count > 0xFFFFFFFFull)) {
+			printf("The glTF file %s is too large. At most 2^32-2 vertices are supported.\n", file_path);
+			result = 1;
+		}
+	}
+	// Decode everything in parallel
+	if (!result) {
+		allocate_imported_scene(scene, traversal.vertex_count, traversal.vertex_count, traversal.vertex_count, traversal.triangle_count);
+		gltf_job_t* jobs = malloc(sizeof(gltf_job_t) * settings->thread_count);
+		for (uint32_t i = 0; i != settings->thread_count; ++i) {
+			gltf_job_t job = {
+				.scene = scene,
+				.draws = traversal.draws,
+				.draw_count = traversal.draw_count,
+				.vertex_begin = (traversal.vertex_count * i) / settings->thread_count,
+				.vertex_end = (traversal.vertex_count * (i + 1)) / settings->thread_count,
+				.triangle_begin = (traversal.triangle_count * i) / settings->thread_count,
+				.triangle_end = (traversal.triangle_count * (i + 1)) / settings->thread_count,
+				.y_up = settings->y_up,
+			};
+			jobs[i] = job;
+		}
+		run_in_parallel(settings->thread_count, run_gltf_job, jobs, sizeof(gltf_job_t));
+		uint64_t invalid_index_count = 0;
+		for (uint32_t i = 0; i != settings->thread_count; ++i)
+			invalid_index_count += jobs[i].invalid_index_count;
+		if (invalid_index_count)
+			printf("Warning: %llu indices in %s are out of bounds. They have been replaced.\n", (unsigned long long) invalid_index_count, file_path);
+		free(jobs);
+	}
+	// Clean up
+	destroy_gltf_buffers(&buffers);
+	free(traversal.draws);
+	free(document.tokens);
+	free(file);
+	if (result)
+		destroy_imported_scene(scene);
+	return result;
+}
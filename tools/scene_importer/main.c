@@ -0,0 +1,460 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*! \file
+	A command line tool that converts Wavefront OBJ and glTF 2.0 files into the
+	*.vks format used by the renderer without going through Blender. Parsing,
+	encoding and writing are all multithreaded and triangles get sorted along
+	a Morton curve for coherent memory accesses during ray tracing.*/
+
+#include "scene_importer.h"
+#include "tool_threads.h"
+#include "vks_format.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+
+
+//! The number of triangles that a worker thread encodes before writing them
+#define TRIANGLE_BATCH_SIZE 65536
+
+
+//! Supported input formats, detected from the file extension
+typedef enum input_format_e {
+	input_format_obj,
+	input_format_gltf,
+	input_format_count,
+} input_format_t;
+
+
+//! Settings specified on the command line
+typedef struct importer_settings_s {
+	//! Paths of the input file and of the *.vks file to write
+	const char* input_path;
+	const char* output_path;
+	//! The format of the input file
+	input_format_t format;
+	//! Settings forwarded to the parsers
+	import_settings_t import;
+	//! Whether triangles should be sorted by the Morton code of their centroid
+	int sort_triangles;
+} importer_settings_t;
+
+
+//! The work of one thread computing bounding boxes or Morton codes for a
+//! range of triangles
+typedef struct bounds_job_s {
+	const imported_scene_t* scene;
+	uint64_t triangle_begin, triangle_end;
+	//! Output: The bounding box of all vertices and of triangle centroids
+	float box_min[3], box_max[3], centroid_min[3], centroid_max[3];
+	//! If this is not NULL, Morton codes of triangle centroids within the
+	//! given centroid box get written here (indexed by triangle)
+	uint32_t* morton_codes;
+} bounds_job_t;
+
+
+//! The work of one thread encoding a range of triangles and writing it to a
+//! *.vks file
+typedef struct encoder_job_s {
+	const imported_scene_t* scene;
+	//! The order in which triangles are written (NULL for identity)
+	const uint32_t* order;
+	//! The range of output triangles handled by this job
+	uint64_t triangle_begin, triangle_end;
+	const char* file_path;
+	vks_layout_t layout;
+	float quantization_factor[3], quantization_summand[3];
+	//! Output: 0 on success, 1 on failure
+	int result;
+	//! Output: The number of triangles with clamped texture coordinates and
+	//! without usable normals
+	uint64_t clamped_count, flat_count;
+} encoder_job_t;
+
+
+char* read_whole_file(const char* file_path, uint64_t* file_size) {
+	FILE* file = fopen(file_path, "rb");
+	if (!file)
+		return NULL;
+	char* result = NULL;
+	if (!fseek(file, 0, SEEK_END)) {
+#ifdef _WIN32
+		int64_t size = _ftelli64(file);
+#else
+		int64_t size = (int64_t) ftello(file);
+#endif
+		if (size >= 0 && !fseek(file, 0, SEEK_SET)) {
+			result = malloc((size_t) size + 1);
+			if (fread(result, 1, (size_t) size, file) != (size_t) size) {
+				free(result);
+				result = NULL;
+			}
+			else {
+				result[size] = 0;
+				(*file_size) = (uint64_t) size;
+			}
+		}
+	}
+	fclose(file);
+	return result;
+}
+
+
+uint32_t get_imported_material_index(imported_scene_t* scene, const char* name, size_t length) {
+	for (uint32_t i = 0; i != scene->material_count; ++i)
+		if (strlen(scene->material_names[i]) == length && memcmp(scene->material_names[i], name, length) == 0)
+			return i;
+	if (scene->material_count == VKS_MAX_MATERIAL_COUNT)
+		return NO_ATTRIBUTE;
+	scene->material_names = realloc(scene->material_names, sizeof(char*) * (scene->material_count + 1));
+	char* copy = malloc(length + 1);
+	memcpy(copy, name, length);
+	copy[length] = 0;
+	scene->material_names[scene->material_count] = copy;
+	return scene->material_count++;
+}
+
+
+void allocate_imported_scene(imported_scene_t* scene, uint64_t position_count, uint64_t tex_coord_count, uint64_t normal_count, uint64_t triangle_count) {
+	scene->position_count = position_count;
+	scene->tex_coord_count = tex_coord_count;
+	scene->normal_count = normal_count;
+	scene->triangle_count = triangle_count;
+	scene->positions = malloc(sizeof(float) * 3 * (position_count + 1));
+	scene->tex_coords = malloc(sizeof(float) * 2 * (tex_coord_count + 1));
+	scene->normals = malloc(sizeof(float) * 3 * (normal_count + 1));
+	scene->corners = malloc(sizeof(uint32_t) * 3 * 3 * (triangle_count + 1));
+	scene->material_indices = malloc(sizeof(uint8_t) * (triangle_count + 1));
+}
+
+
+void destroy_imported_scene(imported_scene_t* scene) {
+	free(scene->positions);
+	free(scene->tex_coords);
+	free(scene->normals);
+	free(scene->corners);
+	free(scene->material_indices);
+	for (uint32_t i = 0; i != scene->material_count; ++i)
+		free(scene->material_names[i]);
+	free(scene->material_names);
+	memset(scene, 0, sizeof(*scene));
+}
+
+
+//! Thread function that computes bounding boxes and optionally Morton codes.
+//! Takes a bounds_job_t.
+void run_bounds_job(void* argument) {
+	bounds_job_t* job = (bounds_job_t*) argument;
+	const imported_scene_t* scene = job->scene;
+	if (job->morton_codes) {
+		for (uint64_t t = job->triangle_begin; t != job->triangle_end; ++t) {
+			float centroid[3];
+			for (uint32_t i = 0; i != 3; ++i)
+				centroid[i] = (scene->positions[scene->corners[t][0][0]][i] + scene->positions[scene->corners[t][1][0]][i] + scene->positions[scene->corners[t][2][0]][i]) * (1.0f / 3.0f);
+			job->morton_codes[t] = get_morton_code_3d(centroid, job->centroid_min, job->centroid_max);
+		}
+		return;
+	}
+	for (uint32_t i = 0; i != 3; ++i) {
+		job->box_min[i] = job->centroid_min[i] = FLT_MAX;
+		job->box_max[i] = job->centroid_max[i] = -FLT_MAX;
+	}
+	for (uint64_t t = job->triangle_begin; t != job->triangle_end; ++t) {
+		for (uint32_t i = 0; i != 3; ++i) {
+			float centroid = 0.0f;
+			for (uint32_t k = 0; k != 3; ++k) {
+				float value = scene->positions[scene->corners[t][k][0]][i];
+				job->box_min[i] = (value < job->box_min[i]) ? value : job->box_min[i];
+				job->box_max[i] = (value > job->box_max[i]) ? value : job->box_max[i];
+				centroid += value;
+			}
+			centroid *= 1.0f / 3.0f;
+			job->centroid_min[i] = (centroid < job->centroid_min[i]) ? centroid : job->centroid_min[i];
+			job->centroid_max[i] = (centroid > job->centroid_max[i]) ? centroid : job->centroid_max[i];
+		}
+	}
+}
+
+
+/*! Computes the bounding box of all triangles in the given scene and,
+	optionally, an order of triangles along a Morton curve through their
+	centroids.
+	\param order NULL or an array with one entry per triangle to receive the
+		order.*/
+void get_scene_bounds_and_order(float box_min[3], float box_max[3], uint32_t* order, const imported_scene_t* scene, uint32_t thread_count) {
+	bounds_job_t* jobs = malloc(sizeof(bounds_job_t) * thread_count);
+	memset(jobs, 0, sizeof(bounds_job_t) * thread_count);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		jobs[i].scene = scene;
+		jobs[i].triangle_begin = (scene->triangle_count * i) / thread_count;
+		jobs[i].triangle_end = (scene->triangle_count * (i + 1)) / thread_count;
+	}
+	run_in_parallel(thread_count, run_bounds_job, jobs, sizeof(bounds_job_t));
+	float centroid_min[3], centroid_max[3];
+	for (uint32_t i = 0; i != 3; ++i) {
+		box_min[i] = centroid_min[i] = FLT_MAX;
+		box_max[i] = centroid_max[i] = -FLT_MAX;
+		for (uint32_t j = 0; j != thread_count; ++j) {
+			box_min[i] = (jobs[j].box_min[i] < box_min[i]) ? jobs[j].box_min[i] : box_min[i];
+			box_max[i] = (jobs[j].box_max[i] > box_max[i]) ? jobs[j].box_max[i] : box_max[i];
+			centroid_min[i] = (jobs[j].centroid_min[i] < centroid_min[i]) ? jobs[j].centroid_min[i] : centroid_min[i];
+			centroid_max[i] = (jobs[j].centroid_max[i] > centroid_max[i]) ? jobs[j].centroid_max[i] : centroid_max[i];
+		}
+	}
+	if (order) {
+		uint32_t* morton_codes = malloc(sizeof(uint32_t) * scene->triangle_count);
+		for (uint32_t j = 0; j != thread_count; ++j) {
+			memcpy(jobs[j].centroid_min, centroid_min, sizeof(centroid_min));
+			memcpy(jobs[j].centroid_max, centroid_max, sizeof(centroid_max));
+			jobs[j].morton_codes = morton_codes;
+		}
+		run_in_parallel(thread_count, run_bounds_job, jobs, sizeof(bounds_job_t));
+		sort_morton_codes(order, morton_codes, scene->triangle_count);
+		free(morton_codes);
+	}
+	free(jobs);
+}
+
+
+//! Writes the given triangles to the appropriate locations in the file
+//! \return 0 on success.
+int write_triangle_batch(FILE* file, const vks_layout_t* layout, uint64_t first_triangle, uint64_t triangle_count, const uint32_t* positions, const uint16_t* normals_and_tex_coords, const uint8_t* material_indices) {
+	return vks_fseek(file, layout->positions + first_triangle * 3 * 2 * sizeof(uint32_t))
+		|| fwrite(positions, sizeof(uint32_t) * 3 * 2, triangle_count, file) != triangle_count
+		|| vks_fseek(file, layout->normals_and_tex_coords + first_triangle * 3 * 4 * sizeof(uint16_t))
+		|| fwrite(normals_and_tex_coords, sizeof(uint16_t) * 3 * 4, triangle_count, file) != triangle_count
+		|| vks_fseek(file, layout->material_indices + first_triangle * sizeof(uint8_t))
+		|| fwrite(material_indices, sizeof(uint8_t), triangle_count, file) != triangle_count;
+}
+
+
+//! Thread function that encodes and writes a range of triangles. Takes an
+//! encoder_job_t.
+void run_encoder_job(void* argument) {
+	encoder_job_t* job = (encoder_job_t*) argument;
+	const imported_scene_t* scene = job->scene;
+	job->result = 0;
+	job->clamped_count = job->flat_count = 0;
+	if (job->triangle_begin == job->triangle_end)
+		return;
+	FILE* file = fopen(job->file_path, "r+b");
+	if (!file) {
+		printf("Failed to open %s for writing on a worker thread.\n", job->file_path);
+		job->result = 1;
+		return;
+	}
+	uint32_t* positions = malloc(sizeof(uint32_t) * 3 * 2 * TRIANGLE_BATCH_SIZE);
+	uint16_t* normals_and_tex_coords = malloc(sizeof(uint16_t) * 3 * 4 * TRIANGLE_BATCH_SIZE);
+	uint8_t* material_indices = malloc(sizeof(uint8_t) * TRIANGLE_BATCH_SIZE);
+	uint64_t batch_begin = job->triangle_begin;
+	uint64_t batch_size = 0;
+	for (uint64_t i = job->triangle_begin; i != job->triangle_end && !job->result; ++i) {
+		uint64_t t = job->order ? job->order[i] : i;
+		const uint32_t (*corners)[3] = (const uint32_t (*)[3]) scene->corners[t];
+		// Use the face normal wherever no normal is available
+		const float* p[3] = { scene->positions[corners[0][0]], scene->positions[corners[1][0]], scene->positions[corners[2][0]] };
+		float edges[2][3], face_normal[3];
+		for (uint32_t j = 0; j != 3; ++j) {
+			edges[0][j] = p[1][j] - p[0][j];
+			edges[1][j] = p[2][j] - p[0][j];
+		}
+		for (uint32_t j = 0; j != 3; ++j)
+			face_normal[j] = edges[0][(j + 1) % 3] * edges[1][(j + 2) % 3] - edges[0][(j + 2) % 3] * edges[1][(j + 1) % 3];
+		float tex_coords[3][2];
+		uint16_t encoded_tex_coords[3][2];
+		int flat = 0;
+		for (uint32_t k = 0; k != 3; ++k) {
+			quantize_position_64_bit(&positions[(batch_size * 3 + k) * 2], p[k], job->quantization_factor, job->quantization_summand);
+			const float* normal = (corners[k][2] != NO_ATTRIBUTE) ? scene->normals[corners[k][2]] : NULL;
+			if (!normal || (normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f)) {
+				normal = face_normal;
+				flat = 1;
+			}
+			encode_normal_32_bit(&normals_and_tex_coords[(batch_size * 3 + k) * 4], normal);
+			tex_coords[k][0] = (corners[k][1] != NO_ATTRIBUTE) ? scene->tex_coords[corners[k][1]][0] : 0.0f;
+			tex_coords[k][1] = (corners[k][1] != NO_ATTRIBUTE) ? scene->tex_coords[corners[k][1]][1] : 0.0f;
+		}
+		job->flat_count += flat;
+		job->clamped_count += encode_triangle_tex_coords(encoded_tex_coords, (const float (*)[2]) tex_coords);
+		for (uint32_t k = 0; k != 3; ++k) {
+			normals_and_tex_coords[(batch_size * 3 + k) * 4 + 2] = encoded_tex_coords[k][0];
+			normals_and_tex_coords[(batch_size * 3 + k) * 4 + 3] = encoded_tex_coords[k][1];
+		}
+		material_indices[batch_size] = scene->material_indices[t];
+		++batch_size;
+		if (batch_size == TRIANGLE_BATCH_SIZE) {
+			job->result |= write_triangle_batch(file, &job->layout, batch_begin, batch_size, positions, normals_and_tex_coords, material_indices);
+			batch_begin += batch_size;
+			batch_size = 0;
+		}
+	}
+	if (batch_size > 0 && !job->result)
+		job->result |= write_triangle_batch(file, &job->layout, batch_begin, batch_size, positions, normals_and_tex_coords, material_indices);
+	if (job->result)
+		printf("Failed to write triangles to %s on a worker thread.\n", job->file_path);
+	free(positions);
+	free(normals_and_tex_coords);
+	free(material_indices);
+	fclose(file);
+}
+
+
+/*! Writes the given scene to a *.vks file. The header is written first, then
+	worker threads encode disjoint ranges of triangles and write them into all
+	three sections of the file concurrently.
+	\return 0 on success.*/
+int write_imported_scene(const imported_scene_t* scene, const char* file_path, const uint32_t* order, const float box_min[3], const float box_max[3], uint32_t thread_count) {
+	vks_header_t header = {
+		.material_count = scene->material_count,
+		.triangle_count = scene->triangle_count,
+	};
+	float quantization_factor[3], quantization_summand[3];
+	get_vks_quantization(quantization_factor, quantization_summand, &header, box_min, box_max);
+	vks_layout_t layout = get_vks_layout(&header, (const char* const*) scene->material_names);
+	// Write the header and the end of file marker, such that the file has its
+	// final size before the workers start
+	FILE* file = fopen(file_path, "wb");
+	if (!file) {
+		printf("Failed to open the output file %s.\n", file_path);
+		return 1;
+	}
+	if (write_vks_header(file, &header, (const char* const*) scene->material_names) || vks_fseek(file, layout.eof_marker) || write_vks_eof_marker(file)) {
+		printf("Failed to write the header of %s.\n", file_path);
+		fclose(file);
+		return 1;
+	}
+	fclose(file);
+	// Split the triangles evenly between jobs
+	encoder_job_t* jobs = malloc(sizeof(encoder_job_t) * thread_count);
+	memset(jobs, 0, sizeof(encoder_job_t) * thread_count);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		encoder_job_t* job = &jobs[i];
+		job->scene = scene;
+		job->order = order;
+		job->file_path = file_path;
+		job->layout = layout;
+		memcpy(job->quantization_factor, quantization_factor, sizeof(quantization_factor));
+		memcpy(job->quantization_summand, quantization_summand, sizeof(quantization_summand));
+		job->triangle_begin = (scene->triangle_count * i) / thread_count;
+		job->triangle_end = (scene->triangle_count * (i + 1)) / thread_count;
+	}
+	run_in_parallel(thread_count, run_encoder_job, jobs, sizeof(encoder_job_t));
+	int result = 0;
+	uint64_t clamped_count = 0, flat_count = 0;
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		result |= jobs[i].result;
+		clamped_count += jobs[i].clamped_count;
+		flat_count += jobs[i].flat_count;
+	}
+	free(jobs);
+	if (clamped_count)
+		printf("Texture coordinates of %llu triangles imply more than seven repetitions and have been clamped.\n", (unsigned long long) clamped_count);
+	if (flat_count)
+		printf("%llu triangles lack normals at some vertices. Face normals have been used there.\n", (unsigned long long) flat_count);
+	return result;
+}
+
+
+//! Returns non-zero iff the given path ends with the given extension (case
+//! insensitive)
+int has_extension(const char* path, const char* extension) {
+	size_t path_length = strlen(path), extension_length = strlen(extension);
+	if (path_length < extension_length)
+		return 0;
+	for (size_t i = 0; i != extension_length; ++i) {
+		char c = path[path_length - extension_length + i];
+		c = (c >= 'A' && c <= 'Z') ? (c - 'A' + 'a') : c;
+		if (c != extension[i])
+			return 0;
+	}
+	return 1;
+}
+
+
+int main(int argc, char** argv) {
+	// Parse command line arguments
+	importer_settings_t settings = {
+		.format = input_format_count,
+		.import = {
+			.thread_count = get_hardware_thread_count(),
+			.y_up = 1,
+		},
+		.sort_triangles = 1,
+	};
+	if (argc >= 3) {
+		settings.input_path = argv[1];
+		settings.output_path = argv[2];
+		if (has_extension(settings.input_path, ".obj"))
+			settings.format = input_format_obj;
+		else if (has_extension(settings.input_path, ".gltf") || has_extension(settings.input_path, ".glb"))
+			settings.format = input_format_gltf;
+	}
+	int valid = (settings.format != input_format_count);
+	for (int i = 3; i < argc && valid; ++i) {
+		unsigned long long value = 0;
+		valid &= (i + 1 < argc && sscanf(argv[i + 1], "%llu", &value) == 1);
+		if (!valid) break;
+		if (strcmp(argv[i], "-threads") == 0) settings.import.thread_count = (uint32_t) value;
+		else if (strcmp(argv[i], "-y_up") == 0) settings.import.y_up = (value != 0);
+		else if (strcmp(argv[i], "-sort") == 0) settings.sort_triangles = (value != 0);
+		else valid = 0;
+		++i;
+	}
+	valid &= (settings.import.thread_count >= 1);
+	if (!valid) {
+		printf("Usage: scene_importer <input.obj|input.gltf|input.glb> <output.vks> [options]\n");
+		printf("Options (each followed by an integer):\n\
+-threads     Number of worker threads (default: hardware thread count)\n\
+-y_up        1 if the input has the y-axis pointing up, 0 for z (default 1)\n\
+-sort        1 to sort triangles by Morton code, 0 otherwise (default 1)\n");
+		return 1;
+	}
+	double start_time = get_tool_time();
+
+	// Parse the input
+	imported_scene_t scene;
+	int result = (settings.format == input_format_obj)
+		? import_obj(&scene, settings.input_path, &settings.import)
+		: import_gltf(&scene, settings.input_path, &settings.import);
+	if (result)
+		return 1;
+	double parse_time = get_tool_time();
+
+	// Sort and write the scene
+	float box_min[3], box_max[3];
+	uint32_t* order = settings.sort_triangles ? malloc(sizeof(uint32_t) * scene.triangle_count) : NULL;
+	get_scene_bounds_and_order(box_min, box_max, order, &scene, settings.import.thread_count);
+	double sort_time = get_tool_time();
+	result = write_imported_scene(&scene, settings.output_path, order, box_min, box_max, settings.import.thread_count);
+	double end_time = get_tool_time();
+	if (!result) {
+		printf("Wrote %llu triangles with %u materials to %s using %u threads.\n",
+			(unsigned long long) scene.triangle_count, scene.material_count, settings.output_path, settings.import.thread_count);
+		printf("Parsing: %.3f s, bounds and sorting: %.3f s, encoding and writing: %.3f s, total: %.3f s (%.2f million triangles per second).\n",
+			parse_time - start_time, sort_time - parse_time, end_time - sort_time, end_time - start_time,
+			1.0e-6 * scene.triangle_count / (end_time - start_time));
+		printf("The renderer expects textures named <texture directory>/<material>_BaseColor.vkt, _Specular.vkt and _Normal.vkt for these materials:\n");
+		for (uint32_t i = 0; i != scene.material_count; ++i)
+			printf("    %s\n", scene.material_names[i]);
+	}
+
+	// Clean up
+	free(order);
+	destroy_imported_scene(&scene);
+	return result;
+}
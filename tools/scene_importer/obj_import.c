@@ -0,0 +1,416 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "scene_importer.h"
+#include "tool_threads.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/*! Each chunk of an OBJ file is processed in two passes. The first pass
+	counts elements and collects material switches, the second pass writes
+	elements to their final location. This object holds the state of one
+	chunk across both passes.*/
+typedef struct obj_chunk_s {
+	//! The range of characters of this chunk. It starts at the beginning of a
+	//! line and ends after a line break or at the end of the file.
+	const char* begin;
+	const char* end;
+	//! Counts of vertex positions, texture coordinates, normals and triangles
+	//! within this chunk (written in pass 1)
+	uint64_t position_count, tex_coord_count, normal_count, triangle_count;
+	//! The number of triangles before the first usemtl statement in this chunk
+	uint64_t triangle_count_before_material;
+	//! Pointers to the names in all usemtl statements of this chunk in order
+	//! and their lengths (written in pass 1)
+	uint32_t material_switch_count, material_switch_capacity;
+	const char** material_switch_names;
+	size_t* material_switch_lengths;
+	//! The global material index for each usemtl statement and the material
+	//! that is active at the beginning of the chunk
+	uint32_t* material_switch_indices;
+	uint32_t initial_material_index;
+	//! Global indices of the first element of this chunk in each array
+	uint64_t position_offset, tex_coord_offset, normal_offset, triangle_offset;
+	//! The scene into which the second pass writes
+	imported_scene_t* scene;
+	//! Whether positions and normals are rotated from y-up to z-up
+	int y_up;
+	//! The number of face corners with invalid indices
+	uint64_t invalid_index_count;
+} obj_chunk_t;
+
+
+//! Advances the given pointer past spaces and tabs
+static inline const char* skip_spaces(const char* text, const char* end) {
+	while (text != end && (*text == ' ' || *text == '\t'))
+		++text;
+	return text;
+}
+
+
+//! Returns a pointer to the line break at the end of the current line or end
+static inline const char* find_line_end(const char* text, const char* end) {
+	const char* line_end = memchr(text, '\n', end - text);
+	return line_end ? line_end : end;
+}
+
+
+/*! A fast parser for decimal floating point numbers, which is considerably
+	quicker than strtof() and locale independent. Precision may be off by an
+	ulp or so, which does not matter after quantization.
+	\return A pointer to the first character after the number.*/
+static inline const char* parse_float(float* result, const char* text, const char* end) {
+	double sign = 1.0;
+	if (text != end && (*text == '-' || *text == '+')) {
+		sign = (*text == '-') ? -1.0 : 1.0;
+		++text;
+	}
+	double value = 0.0;
+	while (text != end && *text >= '0' && *text <= '9')
+		value = value * 10.0 + (double) (*(text++) - '0');
+	if (text != end && *text == '.') {
+		++text;
+		double scale = 0.1;
+		while (text != end && *text >= '0' && *text <= '9') {
+			value += scale * (double) (*(text++) - '0');
+			scale *= 0.1;
+		}
+	}
+	if (text != end && (*text == 'e' || *text == 'E')) {
+		++text;
+		int exponent_sign = 1, exponent = 0;
+		if (text != end && (*text == '-' || *text == '+')) {
+			exponent_sign = (*text == '-') ? -1 : 1;
+			++text;
+		}
+		while (text != end && *text >= '0' && *text <= '9')
+			exponent = exponent * 10 + (*(text++) - '0');
+		double power = 1.0, base = (exponent_sign > 0) ? 10.0 : 0.1;
+		for (int i = 0; i != exponent && i < 400; ++i)
+			power *= base;
+		value *= power;
+	}
+	(*result) = (float) (sign * value);
+	return text;
+}
+
+
+//! Parses a signed decimal integer. Returns a pointer to the first character
+//! after it. If there is no integer, result is zero.
+static inline const char* parse_int(int64_t* result, const char* text, const char* end) {
+	int64_t sign = 1, value = 0;
+	if (text != end && *text == '-') {
+		sign = -1;
+		++text;
+	}
+	while (text != end && *text >= '0' && *text <= '9')
+		value = value * 10 + (*(text++) - '0');
+	(*result) = sign * value;
+	return text;
+}
+
+
+//! Returns the keyword at the beginning of the given line and advances to
+//! the first character after it
+static inline const char* get_keyword(size_t* length, const char** text, const char* end) {
+	const char* begin = (*text) = skip_spaces(*text, end);
+	while ((*text) != end && **text != ' ' && **text != '\t' && **text != '\r' && **text != '\n')
+		++(*text);
+	(*length) = (*text) - begin;
+	return begin;
+}
+
+
+//! Compares a keyword as returned by get_keyword() to a null-terminated
+//! string
+static inline int is_keyword(const char* keyword, size_t length, const char* reference) {
+	return strlen(reference) == length && memcmp(keyword, reference, length) == 0;
+}
+
+
+//! Counts the vertices of the face in the given line (after the keyword)
+static inline uint32_t count_face_vertices(const char* text, const char* line_end) {
+	uint32_t count = 0;
+	for (;;) {
+		text = skip_spaces(text, line_end);
+		if (text == line_end || *text == '\r' || *text == '#')
+			return count;
+		++count;
+		while (text != line_end && *text != ' ' && *text != '\t' && *text != '\r')
+			++text;
+	}
+}
+
+
+//! Extracts the material name after a usemtl keyword without trailing white
+//! space
+static inline const char* get_material_name(size_t* length, const char* text, const char* line_end) {
+	text = skip_spaces(text, line_end);
+	const char* name_end = line_end;
+	while (name_end != text && (name_end[-1] == ' ' || name_end[-1] == '\t' || name_end[-1] == '\r'))
+		--name_end;
+	(*length) = name_end - text;
+	return text;
+}
+
+
+//! Thread function for the first pass over a chunk. Takes an obj_chunk_t.
+void count_obj_chunk(void* argument) {
+	obj_chunk_t* chunk = (obj_chunk_t*) argument;
+	const char* text = chunk->begin;
+	while (text != chunk->end) {
+		const char* line_end = find_line_end(text, chunk->end);
+		size_t keyword_length;
+		const char* keyword = get_keyword(&keyword_length, &text, line_end);
+		if (is_keyword(keyword, keyword_length, "v"))
+			++chunk->position_count;
+		else if (is_keyword(keyword, keyword_length, "vt"))
+			++chunk->tex_coord_count;
+		else if (is_keyword(keyword, keyword_length, "vn"))
+			++chunk->normal_count;
+		else if (is_keyword(keyword, keyword_length, "f")) {
+			uint32_t vertex_count = count_face_vertices(text, line_end);
+			if (vertex_count >= 3) {
+				chunk->triangle_count += vertex_count - 2;
+				if (chunk->material_switch_count == 0)
+					chunk->triangle_count_before_material += vertex_count - 2;
+			}
+		}
+		else if (is_keyword(keyword, keyword_length, "usemtl")) {
+			if (chunk->material_switch_count == chunk->material_switch_capacity) {
+				chunk->material_switch_capacity = 2 * chunk->material_switch_capacity + 16;
+				chunk->material_switch_names = realloc((void*) chunk->material_switch_names, sizeof(char*) * chunk->material_switch_capacity);
+				chunk->material_switch_lengths = realloc(chunk->material_switch_lengths, sizeof(size_t) * chunk->material_switch_capacity);
+			}
+			chunk->material_switch_names[chunk->material_switch_count] = get_material_name(&chunk->material_switch_lengths[chunk->material_switch_count], text, line_end);
+			++chunk->material_switch_count;
+		}
+		text = (line_end == chunk->end) ? line_end : (line_end + 1);
+	}
+}
+
+
+//! Turns a 1-based or negative index from an OBJ file into a 0-based index.
+//! Returns NO_ATTRIBUTE and counts an error if it is out of bounds.
+static inline uint32_t resolve_obj_index(int64_t index, uint64_t current_count, uint64_t total_count, obj_chunk_t* chunk) {
+	int64_t result = (index < 0) ? ((int64_t) current_count + index) : (index - 1);
+	if (result < 0 || result >= (int64_t) total_count) {
+		++chunk->invalid_index_count;
+		return NO_ATTRIBUTE;
+	}
+	return (uint32_t) result;
+}
+
+
+//! Thread function for the second pass over a chunk. Takes an obj_chunk_t.
+void parse_obj_chunk(void* argument) {
+	obj_chunk_t* chunk = (obj_chunk_t*) argument;
+	imported_scene_t* scene = chunk->scene;
+	uint64_t position_index = chunk->position_offset;
+	uint64_t tex_coord_index = chunk->tex_coord_offset;
+	uint64_t normal_index = chunk->normal_offset;
+	uint64_t triangle_index = chunk->triangle_offset;
+	uint32_t material_switch_index = 0;
+	uint32_t material_index = chunk->initial_material_index;
+	// Scratch memory for corners of one polygon
+	uint32_t polygon_capacity = 64;
+	uint32_t (*polygon)[3] = malloc(sizeof(uint32_t) * 3 * polygon_capacity);
+	const char* text = chunk->begin;
+	while (text != chunk->end) {
+		const char* line_end = find_line_end(text, chunk->end);
+		size_t keyword_length;
+		const char* keyword = get_keyword(&keyword_length, &text, line_end);
+		if (is_keyword(keyword, keyword_length, "v") || is_keyword(keyword, keyword_length, "vn")) {
+			float vector[3] = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t i = 0; i != 3; ++i)
+				text = parse_float(&vector[i], skip_spaces(text, line_end), line_end);
+			if (chunk->y_up) {
+				float y = vector[1];
+				vector[1] = -vector[2];
+				vector[2] = y;
+			}
+			float* output = (keyword_length == 1) ? scene->positions[position_index++] : scene->normals[normal_index++];
+			memcpy(output, vector, sizeof(vector));
+		}
+		else if (is_keyword(keyword, keyword_length, "vt")) {
+			float* output = scene->tex_coords[tex_coord_index++];
+			output[0] = output[1] = 0.0f;
+			for (uint32_t i = 0; i != 2; ++i)
+				text = parse_float(&output[i], skip_spaces(text, line_end), line_end);
+		}
+		else if (is_keyword(keyword, keyword_length, "f")) {
+			uint32_t vertex_count = count_face_vertices(text, line_end);
+			if (vertex_count > polygon_capacity) {
+				polygon_capacity = vertex_count;
+				polygon = realloc(polygon, sizeof(uint32_t) * 3 * polygon_capacity);
+			}
+			// Parse v, v/vt, v//vn or v/vt/vn for each vertex
+			for (uint32_t i = 0; i != vertex_count; ++i) {
+				text = skip_spaces(text, line_end);
+				int64_t index;
+				text = parse_int(&index, text, line_end);
+				polygon[i][0] = resolve_obj_index(index, position_index, scene->position_count, chunk);
+				polygon[i][1] = polygon[i][2] = NO_ATTRIBUTE;
+				for (uint32_t j = 1; j != 3 && text != line_end && *text == '/'; ++j) {
+					++text;
+					if (text != line_end && *text != '/' && *text != ' ' && *text != '\t' && *text != '\r') {
+						text = parse_int(&index, text, line_end);
+						polygon[i][j] = (j == 1) ? resolve_obj_index(index, tex_coord_index, scene->tex_coord_count, chunk)
+												 : resolve_obj_index(index, normal_index, scene->normal_count, chunk);
+					}
+				}
+				while (text != line_end && *text != ' ' && *text != '\t' && *text != '\r')
+					++text;
+			}
+			// Triangulate as fan
+			for (uint32_t i = 2; i < vertex_count; ++i) {
+				memcpy(scene->corners[triangle_index][0], polygon[0], sizeof(polygon[0]));
+				memcpy(scene->corners[triangle_index][1], polygon[i - 1], sizeof(polygon[0]));
+				memcpy(scene->corners[triangle_index][2], polygon[i], sizeof(polygon[0]));
+				// Invalid positions are replaced by the first position
+				for (uint32_t k = 0; k != 3; ++k)
+					scene->corners[triangle_index][k][0] = (scene->corners[triangle_index][k][0] == NO_ATTRIBUTE) ? 0 : scene->corners[triangle_index][k][0];
+				scene->material_indices[triangle_index] = (uint8_t) material_index;
+				++triangle_index;
+			}
+		}
+		else if (is_keyword(keyword, keyword_length, "usemtl"))
+			material_index = chunk->material_switch_indices[material_switch_index++];
+		text = (line_end == chunk->end) ? line_end : (line_end + 1);
+	}
+	free(polygon);
+}
+
+
+//! A contiguous range of chunks that is processed by one thread
+typedef struct obj_chunk_range_s {
+	obj_chunk_t* chunks;
+	uint64_t count;
+	//! Either count_obj_chunk() or parse_obj_chunk()
+	tool_thread_function_t function;
+} obj_chunk_range_t;
+
+
+//! Thread function that applies a function to a range of chunks. Takes an
+//! obj_chunk_range_t.
+void run_obj_chunk_range(void* argument) {
+	obj_chunk_range_t* range = (obj_chunk_range_t*) argument;
+	for (uint64_t i = 0; i != range->count; ++i)
+		range->function(&range->chunks[i]);
+}
+
+
+int import_obj(imported_scene_t* scene, const char* file_path, const import_settings_t* settings) {
+	memset(scene, 0, sizeof(*scene));
+	uint64_t file_size;
+	char* file = read_whole_file(file_path, &file_size);
+	if (!file) {
+		printf("Failed to read the OBJ file %s.\n", file_path);
+		return 1;
+	}
+	// Split the file into chunks at line boundaries. Chunks are considerably
+	// smaller than the file divided by the thread count to balance the load.
+	uint64_t chunk_count = file_size / (1 << 22) + 1;
+	chunk_count = (chunk_count < settings->thread_count) ? settings->thread_count : chunk_count;
+	obj_chunk_t* chunks = malloc(sizeof(obj_chunk_t) * chunk_count);
+	memset(chunks, 0, sizeof(obj_chunk_t) * chunk_count);
+	const char* file_end = file + file_size;
+	for (uint64_t i = 0; i != chunk_count; ++i) {
+		chunks[i].begin = (i == 0) ? file : chunks[i - 1].end;
+		const char* end = file + (file_size * (i + 1)) / chunk_count;
+		end = (end < chunks[i].begin) ? chunks[i].begin : end;
+		if (i + 1 == chunk_count)
+			end = file_end;
+		else if (end != file && end != file_end && end[-1] != '\n') {
+			end = find_line_end(end, file_end);
+			end += (end != file_end);
+		}
+		chunks[i].end = end;
+		chunks[i].scene = scene;
+		chunks[i].y_up = settings->y_up;
+	}
+	// First pass: Count everything. Chunk and thread counts may differ, so
+	// each thread processes a contiguous range of chunks.
+	obj_chunk_range_t* ranges = malloc(sizeof(obj_chunk_range_t) * settings->thread_count);
+	for (uint32_t i = 0; i != settings->thread_count; ++i) {
+		uint64_t begin = (chunk_count * i) / settings->thread_count;
+		uint64_t end = (chunk_count * (i + 1)) / settings->thread_count;
+		ranges[i].chunks = chunks + begin;
+		ranges[i].count = end - begin;
+	}
+	for (uint32_t i = 0; i != settings->thread_count; ++i)
+		ranges[i].function = count_obj_chunk;
+	run_in_parallel(settings->thread_count, run_obj_chunk_range, ranges, sizeof(obj_chunk_range_t));
+	// Compute offsets and assign global material indices
+	uint64_t position_count = 0, tex_coord_count = 0, normal_count = 0, triangle_count = 0;
+	uint32_t material_index = NO_ATTRIBUTE;
+	int result = 0;
+	for (uint64_t i = 0; i != chunk_count; ++i) {
+		obj_chunk_t* chunk = &chunks[i];
+		chunk->position_offset = position_count;
+		chunk->tex_coord_offset = tex_coord_count;
+		chunk->normal_offset = normal_count;
+		chunk->triangle_offset = triangle_count;
+		position_count += chunk->position_count;
+		tex_coord_count += chunk->tex_coord_count;
+		normal_count += chunk->normal_count;
+		triangle_count += chunk->triangle_count;
+		if (chunk->triangle_count_before_material > 0 && material_index == NO_ATTRIBUTE)
+			material_index = get_imported_material_index(scene, "no_material_assigned", strlen("no_material_assigned"));
+		chunk->initial_material_index = material_index;
+		chunk->material_switch_indices = malloc(sizeof(uint32_t) * (chunk->material_switch_count + 1));
+		for (uint32_t j = 0; j != chunk->material_switch_count; ++j)
+			material_index = chunk->material_switch_indices[j] = get_imported_material_index(scene, chunk->material_switch_names[j], chunk->material_switch_lengths[j]);
+		if (material_index == NO_ATTRIBUTE && chunk->material_switch_count > 0)
+			result = 1;
+	}
+	if (result)
+		printf("The OBJ file %s uses more than 256 materials, which is not supported.\n", file_path);
+	else if (triangle_count == 0 || position_count == 0) {
+		printf("The OBJ file %s does not contain any faces.\n", file_path);
+		result = 1;
+	}
+	else if (triangle_count > 0xFFFFFFFFull || position_count > 0xFFFFFFFEull || tex_coord_count > 0xFFFFFFFEull || normal_count > 0xFFFFFFFEull) {
+		printf("The OBJ file %s is too large. At most 2^32-2 vertices are supported.\n", file_path);
+		result = 1;
+	}
+	// Second pass: Parse everything
+	if (!result) {
+		allocate_imported_scene(scene, position_count, tex_coord_count, normal_count, triangle_count);
+		for (uint32_t i = 0; i != settings->thread_count; ++i)
+			ranges[i].function = parse_obj_chunk;
+		run_in_parallel(settings->thread_count, run_obj_chunk_range, ranges, sizeof(obj_chunk_range_t));
+		uint64_t invalid_index_count = 0;
+		for (uint64_t i = 0; i != chunk_count; ++i)
+			invalid_index_count += chunks[i].invalid_index_count;
+		if (invalid_index_count)
+			printf("Warning: %llu face corners in %s have out of bounds indices. They have been replaced.\n", (unsigned long long) invalid_index_count, file_path);
+	}
+	// Clean up
+	for (uint64_t i = 0; i != chunk_count; ++i) {
+		free((void*) chunks[i].material_switch_names);
+		free(chunks[i].material_switch_lengths);
+		free(chunks[i].material_switch_indices);
+	}
+	free(chunks);
+	free(ranges);
+	free(file);
+	if (result)
+		destroy_imported_scene(scene);
+	return result;
+}
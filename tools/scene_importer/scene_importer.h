@@ -0,0 +1,92 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+
+//! Used in corner indices to indicate that an attribute is not available
+#define NO_ATTRIBUTE 0xFFFFFFFF
+
+
+/*! An intermediate representation of a triangle mesh in world space that is
+	produced by the parsers for the supported input formats. Each triangle
+	corner references a position, a texture coordinate and a normal with
+	separate indices, as in OBJ files.*/
+typedef struct imported_scene_s {
+	//! The number of entries in the attribute arrays below
+	uint64_t position_count, tex_coord_count, normal_count;
+	//! World space positions with z pointing upwards
+	float (*positions)[3];
+	//! Texture coordinates with the origin at the bottom left
+	float (*tex_coords)[2];
+	//! World space normals, not necessarily normalized
+	float (*normals)[3];
+	//! The number of triangles
+	uint64_t triangle_count;
+	/*! For each triangle and each of its corners, an index into positions,
+		tex_coords and normals (in this order). Texture coordinate and normal
+		indices may be NO_ATTRIBUTE.*/
+	uint32_t (*corners)[3][3];
+	//! For each triangle an index into material_names
+	uint8_t* material_indices;
+	//! The number of used materials and their null-terminated names
+	uint32_t material_count;
+	char** material_names;
+} imported_scene_t;
+
+
+//! Options that influence parsing of all formats
+typedef struct import_settings_s {
+	//! The number of threads used for parsing
+	uint32_t thread_count;
+	//! If this is non-zero, the input is assumed to have the y-axis pointing
+	//! upwards and gets rotated such that the z-axis points upwards
+	int y_up;
+} import_settings_t;
+
+
+/*! Loads the Wavefront OBJ file at the given path. Polygons are triangulated
+	as fans. The file is split into chunks at line boundaries which are parsed
+	concurrently.
+	\return 0 on success.*/
+int import_obj(imported_scene_t* scene, const char* file_path, const import_settings_t* settings);
+
+/*! Loads the glTF 2.0 file (*.glb or *.gltf with external buffers) at the
+	given path. All mesh instances of the default scene get transformed to
+	world space and all triangle primitives are merged. Vertices and triangles
+	are decoded concurrently.
+	\return 0 on success.*/
+int import_gltf(imported_scene_t* scene, const char* file_path, const import_settings_t* settings);
+
+/*! Returns the index of the material with the given name (length characters,
+	not necessarily null-terminated), adding it if needed.
+	\return The material index or NO_ATTRIBUTE if there are too many
+		materials.*/
+uint32_t get_imported_material_index(imported_scene_t* scene, const char* name, size_t length);
+
+//! Allocates all arrays of the given scene for the given sizes. Material
+//! names are left alone.
+void allocate_imported_scene(imported_scene_t* scene, uint64_t position_count, uint64_t tex_coord_count, uint64_t normal_count, uint64_t triangle_count);
+
+//! Frees all memory of the given scene and zeros it
+void destroy_imported_scene(imported_scene_t* scene);
+
+/*! Reads the complete file at the given path into memory. A null-terminator
+	is appended. The calling side has to free the returned pointer.
+	\return NULL on failure.*/
+char* read_whole_file(const char* file_path, uint64_t* file_size);
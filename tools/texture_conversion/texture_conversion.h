@@ -0,0 +1,41 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*! \file Conversion of images in common formats (PNG, JPEG, HDR, ...) into
+	the *.vkt format of the renderer with a complete mipmap hierarchy and
+	optional block compression. The texture_conversion tool exposes it on the
+	command line and the renderer uses it to update cached *.vkt files.*/
+#pragma once
+#include <stdint.h>
+
+
+//! \return 1 if convert_texture() can produce the given VkFormat, 0
+//!		otherwise
+int is_texture_conversion_format_supported(int32_t format);
+
+/*! Loads the image at the given path using stb_image, generates mipmaps,
+	converts them to the given format and writes them to a *.vkt file.
+	\param format A value of the VkFormat enumeration in Vulkan. It is an
+		integer, so that this header does not depend on Vulkan headers.
+	\return 0 upon success.*/
+int convert_texture(int32_t format, const char* input_file_path, const char* output_file_path);
+
+/*! Invokes convert_texture() for many textures, distributing them across the
+	given number of threads.
+	\param thread_count The number of threads to use or 0 to use one thread
+		per hardware thread.
+	\return The number of textures that could not be converted.*/
+uint32_t convert_textures(uint32_t texture_count, const int32_t* formats, const char* const* input_file_paths, const char* const* output_file_paths, uint32_t thread_count);
@@ -0,0 +1,608 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*! \file
+	A command line tool that bakes the visibility between the vertices of all
+	triangles in a *.vks file and the polygonal lights of a quicksave. For
+	each vertex and light, it traces shadow rays towards points on the light
+	using a bounding volume hierarchy on the CPU and stores which fraction of
+	them is unoccluded. The renderer uses the result to skip shadow rays
+	wherever a light is completely visible or occluded from all vertices of a
+	triangle. The output format is described in baked_visibility_format.h.*/
+
+#include "tool_threads.h"
+#include "vks_format.h"
+#include "baked_visibility_format.h"
+#include "camera.h"
+#include "polygonal_light.h"
+#include "math_utilities.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+
+//! Leaves of the bounding volume hierarchy hold at most this many triangles
+#define BVH_LEAF_SIZE 4
+//! The maximal depth of the bounding volume hierarchy. Splits at Morton code
+//! bits and at the middle of equal codes keep it well below that.
+#define BVH_MAX_DEPTH 64
+
+
+//! Parameters provided on the command line
+typedef struct baker_settings_s {
+	//! The scene file, the quicksave with lights and the output file
+	const char* scene_path;
+	const char* quicksave_path;
+	const char* output_path;
+	//! The number of shadow rays per vertex and light
+	uint32_t sample_count;
+	//! The number of worker threads
+	uint32_t thread_count;
+} baker_settings_t;
+
+
+/*! A node of a bounding volume hierarchy over triangles. Nodes are stored in
+	depth-first order, i.e. the first child of an inner node follows it
+	directly.*/
+typedef struct bvh_node_s {
+	float box_min[3];
+	//! For inner nodes the index of the second child, for leaves the index of
+	//! the first triangle in bvh_t.triangles
+	uint32_t index;
+	float box_max[3];
+	//! The number of triangles for leaves, zero for inner nodes
+	uint32_t triangle_count;
+} bvh_node_t;
+
+
+//! A bounding volume hierarchy for any-hit ray queries
+typedef struct bvh_s {
+	//! The number of triangles and their dequantized world space vertex
+	//! positions, sorted along a Morton curve
+	uint32_t triangle_count;
+	float (*triangles)[3][3];
+	//! For each sorted triangle its index in the scene file
+	uint32_t* triangle_indices;
+	//! The number of nodes and all of them, starting with the root
+	uint32_t node_count;
+	bvh_node_t* nodes;
+} bvh_t;
+
+
+//! Work of a single thread, which bakes visibility for a range of triangles
+typedef struct baker_job_s {
+	const baker_settings_t* settings;
+	const bvh_t* bvh;
+	//! The triangles as stored in the scene file
+	const float (*triangles)[3][3];
+	//! Normalized vertex normals of these triangles as stored in the scene
+	//! file
+	const float (*normals)[3][3];
+	//! The lights with up to date world space vertices
+	uint32_t light_count;
+	const polygonal_light_t* lights;
+	//! Offset of ray origins from the surface
+	float ray_offset;
+	//! The range of triangles (in file order) handled by this job
+	uint32_t triangle_begin, triangle_end;
+	//! The output for all triangles (see baked_visibility_format.h)
+	uint32_t* visibility;
+} baker_job_t;
+
+
+//! Computes the tightest box around the given triangles
+void get_triangle_bounds(float box_min[3], float box_max[3], const float (*triangles)[3][3], uint32_t triangle_count) {
+	for (uint32_t i = 0; i != 3; ++i) {
+		box_min[i] = FLT_MAX;
+		box_max[i] = -FLT_MAX;
+	}
+	for (uint32_t t = 0; t != triangle_count; ++t) {
+		for (uint32_t k = 0; k != 3; ++k) {
+			for (uint32_t i = 0; i != 3; ++i) {
+				box_min[i] = (triangles[t][k][i] < box_min[i]) ? triangles[t][k][i] : box_min[i];
+				box_max[i] = (triangles[t][k][i] > box_max[i]) ? triangles[t][k][i] : box_max[i];
+			}
+		}
+	}
+}
+
+
+/*! Recursively creates nodes for the given range of sorted triangles. Splits
+	happen at the most significant bit in which the Morton codes differ or in
+	the middle if all codes are equal.
+	\return The index of the created node.*/
+uint32_t build_bvh_node(bvh_t* bvh, const uint32_t* codes, uint32_t begin, uint32_t end) {
+	uint32_t node_index = bvh->node_count++;
+	bvh_node_t* node = &bvh->nodes[node_index];
+	if (end - begin <= BVH_LEAF_SIZE) {
+		get_triangle_bounds(node->box_min, node->box_max, bvh->triangles + begin, end - begin);
+		node->index = begin;
+		node->triangle_count = end - begin;
+		return node_index;
+	}
+	uint32_t split = begin + (end - begin) / 2;
+	uint32_t difference = codes[begin] ^ codes[end - 1];
+	if (difference) {
+		uint32_t bit = 31;
+		while (!(difference & (1u << bit)))
+			--bit;
+		// Binary search for the first code with this bit set
+		uint32_t lower = begin, upper = end - 1;
+		while (lower + 1 < upper) {
+			uint32_t middle = lower + (upper - lower) / 2;
+			if (codes[middle] & (1u << bit))
+				upper = middle;
+			else
+				lower = middle;
+		}
+		split = upper;
+	}
+	build_bvh_node(bvh, codes, begin, split);
+	uint32_t second_child = build_bvh_node(bvh, codes, split, end);
+	// The nodes array does not get reallocated, so the pointer is still valid
+	const bvh_node_t* first = &bvh->nodes[node_index + 1];
+	const bvh_node_t* second = &bvh->nodes[second_child];
+	for (uint32_t i = 0; i != 3; ++i) {
+		node->box_min[i] = (first->box_min[i] < second->box_min[i]) ? first->box_min[i] : second->box_min[i];
+		node->box_max[i] = (first->box_max[i] > second->box_max[i]) ? first->box_max[i] : second->box_max[i];
+	}
+	node->index = second_child;
+	node->triangle_count = 0;
+	return node_index;
+}
+
+
+//! Builds a bounding volume hierarchy over the given triangles
+void create_bvh(bvh_t* bvh, const float (*triangles)[3][3], uint32_t triangle_count) {
+	memset(bvh, 0, sizeof(*bvh));
+	bvh->triangle_count = triangle_count;
+	// Sort triangles by the Morton codes of their centroids
+	float centroid_min[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, centroid_max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	float (*centroids)[3] = malloc(sizeof(float) * 3 * triangle_count);
+	for (uint32_t t = 0; t != triangle_count; ++t) {
+		for (uint32_t i = 0; i != 3; ++i) {
+			centroids[t][i] = (triangles[t][0][i] + triangles[t][1][i] + triangles[t][2][i]) * (1.0f / 3.0f);
+			centroid_min[i] = (centroids[t][i] < centroid_min[i]) ? centroids[t][i] : centroid_min[i];
+			centroid_max[i] = (centroids[t][i] > centroid_max[i]) ? centroids[t][i] : centroid_max[i];
+		}
+	}
+	uint32_t* codes = malloc(sizeof(uint32_t) * triangle_count);
+	for (uint32_t t = 0; t != triangle_count; ++t)
+		codes[t] = get_morton_code_3d(centroids[t], centroid_min, centroid_max);
+	bvh->triangle_indices = malloc(sizeof(uint32_t) * triangle_count);
+	sort_morton_codes(bvh->triangle_indices, codes, triangle_count);
+	bvh->triangles = malloc(sizeof(float) * 3 * 3 * triangle_count);
+	for (uint32_t t = 0; t != triangle_count; ++t) {
+		memcpy(bvh->triangles[t], triangles[bvh->triangle_indices[t]], sizeof(float) * 3 * 3);
+		codes[t] = get_morton_code_3d(centroids[bvh->triangle_indices[t]], centroid_min, centroid_max);
+	}
+	free(centroids);
+	// Build the hierarchy. A binary tree with at least one triangle per leaf
+	// has less than twice as many nodes as triangles.
+	bvh->nodes = malloc(sizeof(bvh_node_t) * 2 * ((triangle_count > 0) ? triangle_count : 1));
+	if (triangle_count > 0)
+		build_bvh_node(bvh, codes, 0, triangle_count);
+	free(codes);
+}
+
+
+//! Frees memory and zeros
+void destroy_bvh(bvh_t* bvh) {
+	free(bvh->triangles);
+	free(bvh->triangle_indices);
+	free(bvh->nodes);
+	memset(bvh, 0, sizeof(*bvh));
+}
+
+
+//! Returns whether the given ray intersects the given box for some parameter
+//! in [0, max_t]
+static inline int ray_box_intersection(const float origin[3], const float inv_dir[3], float max_t, const float box_min[3], const float box_max[3]) {
+	float entry = 0.0f, exit = max_t;
+	for (uint32_t i = 0; i != 3; ++i) {
+		float t_0 = (box_min[i] - origin[i]) * inv_dir[i];
+		float t_1 = (box_max[i] - origin[i]) * inv_dir[i];
+		float t_near = (t_0 < t_1) ? t_0 : t_1;
+		float t_far = (t_0 < t_1) ? t_1 : t_0;
+		entry = (t_near > entry) ? t_near : entry;
+		exit = (t_far < exit) ? t_far : exit;
+	}
+	return entry <= exit;
+}
+
+
+//! Möller-Trumbore intersection test for a ray and a triangle with parameters
+//! in (0, max_t)
+static inline int ray_triangle_intersection(const float origin[3], const float dir[3], float max_t, const float triangle[3][3]) {
+	float edge_0[3], edge_1[3], offset[3];
+	for (uint32_t i = 0; i != 3; ++i) {
+		edge_0[i] = triangle[1][i] - triangle[0][i];
+		edge_1[i] = triangle[2][i] - triangle[0][i];
+		offset[i] = origin[i] - triangle[0][i];
+	}
+	float p[3] = {
+		dir[1] * edge_1[2] - dir[2] * edge_1[1],
+		dir[2] * edge_1[0] - dir[0] * edge_1[2],
+		dir[0] * edge_1[1] - dir[1] * edge_1[0],
+	};
+	float det = edge_0[0] * p[0] + edge_0[1] * p[1] + edge_0[2] * p[2];
+	if (det == 0.0f) return 0;
+	float rcp_det = 1.0f / det;
+	float u = (offset[0] * p[0] + offset[1] * p[1] + offset[2] * p[2]) * rcp_det;
+	if (u < 0.0f || u > 1.0f) return 0;
+	float q[3] = {
+		offset[1] * edge_0[2] - offset[2] * edge_0[1],
+		offset[2] * edge_0[0] - offset[0] * edge_0[2],
+		offset[0] * edge_0[1] - offset[1] * edge_0[0],
+	};
+	float v = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) * rcp_det;
+	if (v < 0.0f || u + v > 1.0f) return 0;
+	float t = (edge_1[0] * q[0] + edge_1[1] * q[1] + edge_1[2] * q[2]) * rcp_det;
+	return t > 0.0f && t < max_t;
+}
+
+
+/*! Returns whether the given ray hits any triangle of the hierarchy except
+	for the one with the given index in the scene file.
+	\param max_t Intersections must be closer than this parameter.*/
+int bvh_any_hit(const bvh_t* bvh, const float origin[3], const float dir[3], float max_t, uint32_t ignored_triangle) {
+	if (bvh->triangle_count == 0)
+		return 0;
+	float inv_dir[3];
+	for (uint32_t i = 0; i != 3; ++i)
+		inv_dir[i] = (dir[i] != 0.0f) ? (1.0f / dir[i]) : FLT_MAX;
+	uint32_t stack[BVH_MAX_DEPTH];
+	uint32_t stack_size = 0;
+	uint32_t node_index = 0;
+	while (1) {
+		const bvh_node_t* node = &bvh->nodes[node_index];
+		if (ray_box_intersection(origin, inv_dir, max_t, node->box_min, node->box_max)) {
+			if (node->triangle_count == 0) {
+				stack[stack_size++] = node->index;
+				node_index = node_index + 1;
+				continue;
+			}
+			for (uint32_t t = node->index; t != node->index + node->triangle_count; ++t)
+				if (bvh->triangle_indices[t] != ignored_triangle && ray_triangle_intersection(origin, dir, max_t, bvh->triangles[t]))
+					return 1;
+		}
+		if (stack_size == 0)
+			return 0;
+		node_index = stack[--stack_size];
+	}
+}
+
+
+/*! Maps the given uniform random numbers to a uniformly distributed point on
+	the given polygonal light, using its triangle fan.*/
+void sample_polygonal_light(float sample[3], const polygonal_light_t* light, const float random_numbers[3]) {
+	// Pick a triangle of the fan in proportion to its area
+	float target = random_numbers[0] * light->area;
+	uint32_t triangle = 0;
+	float area_sum = light->fan_areas[0];
+	while (triangle + 3 < light->vertex_count && area_sum < target) {
+		++triangle;
+		area_sum += light->fan_areas[4 * triangle];
+	}
+	// Sample the triangle uniformly
+	float root = sqrtf(random_numbers[1]);
+	float weights[3] = { 1.0f - root, root * (1.0f - random_numbers[2]), root * random_numbers[2] };
+	const float* vertices[3] = {
+		&light->vertices_world_space[0],
+		&light->vertices_world_space[4 * (triangle + 1)],
+		&light->vertices_world_space[4 * (triangle + 2)],
+	};
+	for (uint32_t i = 0; i != 3; ++i)
+		sample[i] = weights[0] * vertices[0][i] + weights[1] * vertices[1][i] + weights[2] * vertices[2][i];
+}
+
+
+//! Thread function that bakes visibility for a range of triangles. Takes a
+//! baker_job_t.
+void run_baker_job(void* argument) {
+	baker_job_t* job = (baker_job_t*) argument;
+	uint32_t sample_count = job->settings->sample_count;
+	// A rank-1 lattice (the R3 sequence), which gets randomly shifted per
+	// vertex to avoid correlation between neighbors
+	const float generator[3] = { 0.8191725134f, 0.6710436067f, 0.5497004779f };
+	for (uint32_t t = job->triangle_begin; t != job->triangle_end; ++t) {
+		const float (*triangle)[3] = job->triangles[t];
+		// Compute the geometric normal of the triangle
+		float edge_0[3], edge_1[3], centroid[3];
+		for (uint32_t i = 0; i != 3; ++i) {
+			edge_0[i] = triangle[1][i] - triangle[0][i];
+			edge_1[i] = triangle[2][i] - triangle[0][i];
+			centroid[i] = (triangle[0][i] + triangle[1][i] + triangle[2][i]) * (1.0f / 3.0f);
+		}
+		float normal[3] = {
+			edge_0[1] * edge_1[2] - edge_0[2] * edge_1[1],
+			edge_0[2] * edge_1[0] - edge_0[0] * edge_1[2],
+			edge_0[0] * edge_1[1] - edge_0[1] * edge_1[0],
+		};
+		float normal_length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		for (uint32_t i = 0; i != 3; ++i)
+			normal[i] = (normal_length > 0.0f) ? (normal[i] / normal_length) : 0.0f;
+		for (uint32_t l = 0; l != job->light_count; ++l) {
+			const polygonal_light_t* light = &job->lights[l];
+			uint32_t encoded = 0;
+			for (uint32_t k = 0; k != 3; ++k) {
+				// Move the origin slightly towards the centroid to avoid hits
+				// with adjacent triangles
+				float base[3];
+				const float* vertex_normal = job->normals[t][k];
+				for (uint32_t i = 0; i != 3; ++i)
+					base[i] = triangle[k][i] + 1.0e-3f * (centroid[i] - triangle[k][i]);
+				uint32_t seed = wang_random_number((uint32_t) (3 * t + k) ^ wang_random_number(l));
+				float shift[3];
+				for (uint32_t i = 0; i != 3; ++i) {
+					seed = wang_random_number(seed);
+					shift[i] = (float) (seed >> 8) * (1.0f / 16777216.0f);
+				}
+				uint32_t visible_count = 0;
+				for (uint32_t s = 0; s != sample_count; ++s) {
+					float random_numbers[3];
+					for (uint32_t i = 0; i != 3; ++i) {
+						random_numbers[i] = shift[i] + generator[i] * (float) s;
+						random_numbers[i] -= floorf(random_numbers[i]);
+					}
+					float sample[3], dir[3], origin[3];
+					sample_polygonal_light(sample, light, random_numbers);
+					for (uint32_t i = 0; i != 3; ++i)
+						dir[i] = sample[i] - base[i];
+					// The renderer shades with interpolated vertex normals, so
+					// samples behind the vertex normal count as occluded
+					if (dir[0] * vertex_normal[0] + dir[1] * vertex_normal[1] + dir[2] * vertex_normal[2] <= 0.0f)
+						continue;
+					// The winding of the triangle may disagree with its
+					// vertex normals. Leave the surface towards the sample.
+					float side = (dir[0] * normal[0] + dir[1] * normal[1] + dir[2] * normal[2] >= 0.0f) ? job->ray_offset : -job->ray_offset;
+					for (uint32_t i = 0; i != 3; ++i) {
+						origin[i] = base[i] + side * normal[i];
+						dir[i] = sample[i] - origin[i];
+					}
+					// The direction is not normalized, so the light is at t = 1
+					if (!bvh_any_hit(job->bvh, origin, dir, 0.9999f, t))
+						++visible_count;
+				}
+				encoded |= ((uint32_t) encode_baked_visibility(visible_count, sample_count)) << (8 * k);
+			}
+			job->visibility[(size_t) t * job->light_count + l] = encoded;
+		}
+	}
+}
+
+
+/*! Loads polygonal lights from a quicksave as written by quick_save() in
+	main.c and updates their redundant members.
+	\return 0 on success.*/
+int load_quicksave_lights(uint32_t* light_count, polygonal_light_t** lights, const char* file_path) {
+	(*light_count) = 0;
+	(*lights) = NULL;
+	FILE* file = fopen(file_path, "rb");
+	if (!file) {
+		printf("Failed to open the quicksave %s.\n", file_path);
+		return 1;
+	}
+	first_person_camera_t camera;
+	uint32_t legacy_count, count = 0;
+	int result = fread(&camera, sizeof(camera), 1, file) != 1
+		|| fread(&legacy_count, sizeof(uint32_t), 1, file) != 1
+		|| fread(&count, sizeof(uint32_t), 1, file) != 1;
+	(*lights) = malloc(sizeof(polygonal_light_t) * ((count > 0) ? count : 1));
+	memset(*lights, 0, sizeof(polygonal_light_t) * ((count > 0) ? count : 1));
+	for (uint32_t i = 0; i != count && !result; ++i) {
+		polygonal_light_t* light = &(*lights)[i];
+		size_t path_size = 0;
+		float* null_pointers[2];
+		result = fread(light, POLYGONAL_LIGHT_QUICKSAVE_SIZE, 1, file) != 1
+			|| light->vertex_count < 3
+			|| fread(&path_size, sizeof(path_size), 1, file) != 1
+			|| fseek(file, (long) path_size, SEEK_CUR)
+			|| fread(null_pointers, sizeof(float*), 2, file) != 2;
+		if (result) break;
+		uint32_t vertex_count = light->vertex_count;
+		light->vertex_count = 0;
+		set_polygonal_light_vertex_count(light, vertex_count);
+		result = fread(light->vertices_plane_space, sizeof(float), 4 * vertex_count, file) != 4 * vertex_count;
+		if (light->scaling_y <= 0.0f) light->scaling_y = light->scaling_x;
+		(*light_count) = i + 1;
+	}
+	// Animated lights cannot be baked
+	for (uint32_t i = 0; i != count && !result; ++i) {
+		uint32_t keyframe_count = 0;
+		if (fread(&keyframe_count, sizeof(uint32_t), 1, file) != 1)
+			break;
+		if (keyframe_count > 0) {
+			printf("Polygonal light %u in the quicksave %s is animated. Baked visibility only supports static lights.\n", i, file_path);
+			result = 1;
+		}
+	}
+	fclose(file);
+	if (result) {
+		printf("Failed to read polygonal lights from the quicksave %s.\n", file_path);
+		return 1;
+	}
+	for (uint32_t i = 0; i != *light_count; ++i)
+		update_polygonal_light(&(*lights)[i]);
+	return 0;
+}
+
+
+//! Bakes visibility as specified by the given settings
+//! \return 0 on success.
+int bake_visibility(const baker_settings_t* settings) {
+	double start_time = get_tool_time();
+	// Load the lights
+	uint32_t light_count;
+	polygonal_light_t* lights;
+	if (load_quicksave_lights(&light_count, &lights, settings->quicksave_path))
+		return 1;
+	// Load triangles
+	FILE* file = fopen(settings->scene_path, "rb");
+	if (!file) {
+		printf("Failed to open the scene file %s.\n", settings->scene_path);
+		return 1;
+	}
+	vks_header_t header;
+	char** material_names;
+	int result = read_vks_header(file, &header, &material_names);
+	uint32_t (*positions)[3][2] = NULL;
+	uint16_t (*normals_and_tex_coords)[3][4] = NULL;
+	if (!result && header.triangle_count > 0x3FFFFFFFull) {
+		printf("The scene has too many triangles for the visibility baker.\n");
+		result = 1;
+	}
+	if (!result) {
+		positions = malloc(sizeof(uint32_t) * 3 * 2 * header.triangle_count);
+		normals_and_tex_coords = malloc(sizeof(uint16_t) * 3 * 4 * header.triangle_count);
+		result = fread(positions, sizeof(uint32_t) * 3 * 2, header.triangle_count, file) != header.triangle_count
+			|| fread(normals_and_tex_coords, sizeof(uint16_t) * 3 * 4, header.triangle_count, file) != header.triangle_count;
+	}
+	fclose(file);
+	free_vks_material_names(material_names, header.material_count);
+	if (result) {
+		printf("Failed to load triangles from the scene file %s.\n", settings->scene_path);
+		free(positions);
+		free(normals_and_tex_coords);
+		for (uint32_t i = 0; i != light_count; ++i)
+			destroy_polygonal_light(&lights[i]);
+		free(lights);
+		return 1;
+	}
+	uint32_t triangle_count = (uint32_t) header.triangle_count;
+	float (*triangles)[3][3] = malloc(sizeof(float) * 3 * 3 * ((triangle_count > 0) ? triangle_count : 1));
+	float (*normals)[3][3] = malloc(sizeof(float) * 3 * 3 * ((triangle_count > 0) ? triangle_count : 1));
+	for (uint32_t t = 0; t != triangle_count; ++t) {
+		for (uint32_t k = 0; k != 3; ++k) {
+			dequantize_position_64_bit(triangles[t][k], positions[t][k], header.dequantization_factor, header.dequantization_summand);
+			decode_normal_32_bit(normals[t][k], normals_and_tex_coords[t][k]);
+		}
+	}
+	free(positions);
+	free(normals_and_tex_coords);
+	// Build the hierarchy
+	bvh_t bvh;
+	create_bvh(&bvh, (const float (*)[3][3]) triangles, triangle_count);
+	double bvh_time = get_tool_time();
+	// Offset ray origins by a small fraction of the scene extent
+	float box_min[3], box_max[3];
+	get_triangle_bounds(box_min, box_max, (const float (*)[3][3]) triangles, triangle_count);
+	float extent = 0.0f;
+	for (uint32_t i = 0; i != 3; ++i)
+		extent = (box_max[i] - box_min[i] > extent) ? (box_max[i] - box_min[i]) : extent;
+	// Bake using many threads, which work on batches of triangles
+	uint32_t* visibility = malloc(sizeof(uint32_t) * ((size_t) triangle_count * light_count + 1));
+	uint32_t batch_size = 4096;
+	uint32_t batch_count = (triangle_count + batch_size - 1) / batch_size;
+	uint32_t job_count = batch_count;
+	baker_job_t* jobs = malloc(sizeof(baker_job_t) * ((job_count > 0) ? job_count : 1));
+	for (uint32_t i = 0; i != job_count; ++i) {
+		baker_job_t job = {
+			.settings = settings,
+			.bvh = &bvh,
+			.triangles = (const float (*)[3][3]) triangles,
+			.normals = (const float (*)[3][3]) normals,
+			.light_count = light_count,
+			.lights = lights,
+			.ray_offset = 1.0e-5f * extent,
+			.triangle_begin = i * batch_size,
+			.triangle_end = ((i + 1) * batch_size < triangle_count) ? ((i + 1) * batch_size) : triangle_count,
+			.visibility = visibility,
+		};
+		jobs[i] = job;
+	}
+	for (uint32_t i = 0; i < job_count; i += settings->thread_count) {
+		uint32_t thread_count = (job_count - i < settings->thread_count) ? (job_count - i) : settings->thread_count;
+		run_in_parallel(thread_count, run_baker_job, &jobs[i], sizeof(baker_job_t));
+	}
+	free(jobs);
+	// Gather statistics
+	uint64_t counts[3] = { 0, 0, 0 };
+	for (size_t i = 0; i != (size_t) triangle_count * light_count; ++i) {
+		uint32_t lit = (visibility[i] & 0xFFFFFF) == 0xFFFFFF;
+		uint32_t shadowed = (visibility[i] & 0xFFFFFF) == 0;
+		++counts[lit ? 0 : (shadowed ? 1 : 2)];
+	}
+	// Write the output
+	baked_visibility_header_t output_header = {
+		.triangle_count = triangle_count,
+		.light_count = light_count,
+		.sample_count = settings->sample_count,
+		.light_hash = get_polygonal_light_geometry_hash(lights, light_count),
+	};
+	FILE* output = fopen(settings->output_path, "wb");
+	result = !output
+		|| write_baked_visibility_header(output, &output_header)
+		|| fwrite(visibility, sizeof(uint32_t), (size_t) triangle_count * light_count, output) != (size_t) triangle_count * light_count
+		|| write_vks_eof_marker(output);
+	if (output)
+		fclose(output);
+	if (result)
+		printf("Failed to write baked visibility to %s.\n", settings->output_path);
+	else {
+		double end_time = get_tool_time();
+		double total = (double) ((counts[0] + counts[1] + counts[2] > 0) ? (counts[0] + counts[1] + counts[2]) : 1);
+		printf("Baked visibility of %u lights for %u triangles to %s using %u threads.\n", light_count, triangle_count, settings->output_path, settings->thread_count);
+		printf("Triangle-light pairs: %.1f%% fully lit, %.1f%% fully shadowed, %.1f%% partial.\n",
+			100.0 * counts[0] / total, 100.0 * counts[1] / total, 100.0 * counts[2] / total);
+		printf("Loading and BVH: %.3f s, baking: %.3f s, total: %.3f s.\n", bvh_time - start_time, end_time - bvh_time, end_time - start_time);
+	}
+	// Clean up
+	free(visibility);
+	destroy_bvh(&bvh);
+	free(triangles);
+	free(normals);
+	for (uint32_t i = 0; i != light_count; ++i)
+		destroy_polygonal_light(&lights[i]);
+	free(lights);
+	return result;
+}
+
+
+int main(int argc, char** argv) {
+	// Parse command line arguments
+	baker_settings_t settings = {
+		.sample_count = 64,
+		.thread_count = get_hardware_thread_count(),
+	};
+	int valid = (argc >= 4);
+	if (valid) {
+		settings.scene_path = argv[1];
+		settings.quicksave_path = argv[2];
+		settings.output_path = argv[3];
+	}
+	for (int i = 4; i < argc && valid; ++i) {
+		unsigned long long value = 0;
+		valid &= (i + 1 < argc && sscanf(argv[i + 1], "%llu", &value) == 1);
+		if (!valid) break;
+		if (strcmp(argv[i], "-samples") == 0) settings.sample_count = (uint32_t) value;
+		else if (strcmp(argv[i], "-threads") == 0) settings.thread_count = (uint32_t) value;
+		else valid = 0;
+		++i;
+	}
+	valid &= (settings.sample_count >= 1 && settings.thread_count >= 1);
+	if (!valid) {
+		printf("Usage: visibility_baker <scene.vks> <quicksave.save> <output.vis> [options]\n");
+		printf("Options (each followed by an integer):\n\
+-samples     Shadow rays per vertex and light (default 64)\n\
+-threads     Number of worker threads (default: hardware thread count)\n");
+		printf("The renderer looks for the output next to the quicksave, i.e. at <quicksave.save>.vis.\n");
+		return 1;
+	}
+	return bake_visibility(&settings);
+}
@@ -0,0 +1,1424 @@
+//  Copyright (C) 2021, Christoph Peters, Karlsruhe Institute of Technology
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*! \file
+	A command line tool that rewrites an existing *.vks file with a better
+	triangle order, optionally tighter position quantization, optionally a
+	partition into spatial chunks with bounding boxes (file format version 2),
+	optionally compressed geometry in meshlets (file format version 3) and
+	optionally simplified levels of detail per chunk (file format version 4).
+	The input is processed one section at a time, so at most one section of
+	the input is held in memory.*/
+
+#include "tool_threads.h"
+#include "vks_format.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+
+
+//! The number of triangles that a worker thread gathers before writing them
+#define TRIANGLE_BATCH_SIZE 65536
+
+
+//! Available strategies for reordering triangles
+typedef enum triangle_order_e {
+	//! Keep the order of the input
+	triangle_order_none,
+	//! Sort by the Morton code of triangle centroids
+	triangle_order_morton,
+	/*! Sort by Morton code, then reorder triangles within each chunk using
+		Tipsify such that triangles sharing vertices end up close together
+		(Sander et al. 2007, Fast Triangle Reordering for Vertex Locality and
+		Reduced Overdraw)*/
+	triangle_order_cache,
+	//! Number of entries in this enum
+	triangle_order_count,
+} triangle_order_t;
+
+
+//! Names of triangle orders on the command line
+const char* const g_triangle_order_names[triangle_order_count] = { "none", "morton", "cache" };
+
+
+//! Settings specified on the command line
+typedef struct optimizer_settings_s {
+	//! Paths of the input and output file
+	const char* input_path;
+	const char* output_path;
+	//! How triangles should be reordered
+	triangle_order_t order;
+	//! Whether quantization should be recomputed from the tight bounding box of
+	//! all dequantized positions
+	int requantize;
+	//! The number of triangles per chunk or 0 to write a file without chunks
+	uint64_t chunk_size;
+	//! The size of the vertex cache assumed by Tipsify
+	uint32_t cache_size;
+	//! The number of worker threads
+	uint32_t thread_count;
+	//! Whether compressed geometry in meshlets should be written
+	int meshlets;
+	//! The number of simplified levels of detail per chunk
+	uint32_t lod_levels;
+} optimizer_settings_t;
+
+
+//! The work of one thread computing bounding boxes or Morton codes for a
+//! range of triangles
+typedef struct bounds_job_s {
+	const uint32_t (*positions)[3][2];
+	const vks_header_t* header;
+	uint64_t triangle_begin, triangle_end;
+	//! Output: The bounding box of all vertices and of triangle centroids
+	float box_min[3], box_max[3], centroid_min[3], centroid_max[3];
+	//! If this is not NULL, Morton codes of triangle centroids within the
+	//! given centroid box get written here (indexed by triangle)
+	uint32_t* morton_codes;
+} bounds_job_t;
+
+
+//! The work of one thread reordering triangles within a range of groups
+//! using Tipsify
+typedef struct tipsify_job_s {
+	const uint32_t (*positions)[3][2];
+	//! The order to be refined in place
+	uint32_t* order;
+	//! The total triangle count, the number of triangles per group and the
+	//! range of groups handled by this job
+	uint64_t triangle_count, group_size, group_begin, group_end;
+	uint32_t cache_size;
+} tipsify_job_t;
+
+
+//! The work of one thread permuting a range of triangles of one section and
+//! writing it to the output file
+typedef struct section_job_s {
+	//! The complete section of the input file in memory
+	const uint8_t* source;
+	//! The number of bytes per triangle in this section
+	size_t triangle_size;
+	//! The order in which triangles are written (NULL for identity)
+	const uint32_t* order;
+	//! The range of output triangles handled by this job
+	uint64_t triangle_begin, triangle_end;
+	//! The path of the output file and the offset of the section in it
+	const char* file_path;
+	uint64_t section_offset;
+	//! Non-zero iff the section holds positions. Then the boxes of chunks
+	//! in the range of this job are computed.
+	int positions;
+	//! Non-zero iff positions should be requantized from the input header to
+	//! the quantization below
+	int requantize;
+	const vks_header_t* input_header;
+	const vks_header_t* output_header;
+	float quantization_factor[3], quantization_summand[3];
+	//! NULL or the chunks to be written
+	vks_chunk_t* chunks;
+	uint64_t chunk_size;
+	//! Output: 0 on success, 1 on failure
+	int result;
+} section_job_t;
+
+
+/*! The work of one thread compressing a range of meshlets. The data is read
+	back from the output file once all of its regular sections are written.*/
+typedef struct meshlet_job_s {
+	//! The path and layout of the output file
+	const char* file_path;
+	const vks_layout_t* layout;
+	//! The total triangle count and the range of meshlets handled by this job
+	uint64_t triangle_count, meshlet_begin, meshlet_end;
+	//! Output: Meshlets, triangles and vertices in the format of the file,
+	//! except that vertex and word indices in meshlets are relative to this
+	//! job
+	uint32_t (*meshlets)[4];
+	uint32_t* triangles;
+	uint32_t* position_words;
+	uint16_t (*attributes)[4];
+	//! Output: The number of vertices and position words and the capacity of
+	//! the arrays above
+	uint64_t vertex_count, vertex_capacity, position_word_count, position_word_capacity;
+	//! Output: The number of meshlets using each bit count for positions
+	uint64_t position_bit_counts[22];
+	//! Output: 0 on success, 1 on failure
+	int result;
+} meshlet_job_t;
+
+
+/*! The work of one thread simplifying a range of chunks into levels of
+	detail. Chunks are read back from the output file once all of its regular
+	sections are written.*/
+typedef struct lod_job_s {
+	//! The path and layout of the output file
+	const char* file_path;
+	const vks_layout_t* layout;
+	const vks_header_t* header;
+	//! All chunks and the range of chunks handled by this job
+	const vks_chunk_t* chunks;
+	uint64_t chunk_begin, chunk_end;
+	//! The number of levels of detail to generate per chunk
+	uint32_t level_count;
+	/*! Output: level_count levels per chunk. Triangle indices are relative
+		to the triangles of this job, except that UINT64_MAX refers to the
+		original triangles of the chunk.*/
+	vks_chunk_lod_t* lods;
+	//! Output: The triangles of all levels in the format of the file
+	uint32_t (*positions)[3][2];
+	uint16_t (*normals_and_tex_coords)[3][4];
+	uint8_t* material_indices;
+	//! Output: The number of triangles and the capacity of the arrays above
+	uint64_t triangle_count, triangle_capacity;
+	//! Output: The number of vertices that got locked because they are on the
+	//! boundary of a chunk, a seam or a material boundary
+	uint64_t vertex_count, locked_vertex_count;
+	//! Output: 0 on success, 1 on failure
+	int result;
+} lod_job_t;
+
+
+/*! State of the simplification of a single chunk. Vertices are welded by
+	position and normal. Texture coordinates are stored per triangle corner,
+	such that the integer offsets in the file format do not matter.*/
+typedef struct simplifier_s {
+	//! The number of triangles, live triangles and vertices
+	uint32_t triangle_count, live_count, vertex_count;
+	//! Per triangle: Vertex indices, texture coordinates for each corner,
+	//! non-zero iff it has not been removed by a collapse
+	uint32_t (*triangles)[3];
+	float (*tex_coords)[3][2];
+	uint8_t* live;
+	//! Per vertex: Dequantized position, index of a corner in the input that
+	//! provides the quantized position and the normal, the accumulated error
+	//! quadric, non-zero iff it must not move
+	float (*positions)[3];
+	uint32_t* corners;
+	double (*quadrics)[11];
+	uint8_t* locked;
+} simplifier_t;
+
+
+//! Dequantizes a vertex position of the given triangle
+static inline void get_position(float position[3], const uint32_t (*positions)[3][2], const vks_header_t* header, uint64_t triangle, uint32_t vertex) {
+	dequantize_position_64_bit(position, positions[triangle][vertex], header->dequantization_factor, header->dequantization_summand);
+}
+
+
+//! Thread function that computes bounding boxes and optionally Morton codes.
+//! Takes a bounds_job_t.
+void run_bounds_job(void* argument) {
+	bounds_job_t* job = (bounds_job_t*) argument;
+	if (job->morton_codes) {
+		for (uint64_t t = job->triangle_begin; t != job->triangle_end; ++t) {
+			float centroid[3] = { 0.0f, 0.0f, 0.0f }, position[3];
+			for (uint32_t k = 0; k != 3; ++k) {
+				get_position(position, job->positions, job->header, t, k);
+				for (uint32_t i = 0; i != 3; ++i)
+					centroid[i] += position[i] * (1.0f / 3.0f);
+			}
+			job->morton_codes[t] = get_morton_code_3d(centroid, job->centroid_min, job->centroid_max);
+		}
+		return;
+	}
+	for (uint32_t i = 0; i != 3; ++i) {
+		job->box_min[i] = job->centroid_min[i] = FLT_MAX;
+		job->box_max[i] = job->centroid_max[i] = -FLT_MAX;
+	}
+	for (uint64_t t = job->triangle_begin; t != job->triangle_end; ++t) {
+		float centroid[3] = { 0.0f, 0.0f, 0.0f }, position[3];
+		for (uint32_t k = 0; k != 3; ++k) {
+			get_position(position, job->positions, job->header, t, k);
+			for (uint32_t i = 0; i != 3; ++i) {
+				job->box_min[i] = (position[i] < job->box_min[i]) ? position[i] : job->box_min[i];
+				job->box_max[i] = (position[i] > job->box_max[i]) ? position[i] : job->box_max[i];
+				centroid[i] += position[i] * (1.0f / 3.0f);
+			}
+		}
+		for (uint32_t i = 0; i != 3; ++i) {
+			job->centroid_min[i] = (centroid[i] < job->centroid_min[i]) ? centroid[i] : job->centroid_min[i];
+			job->centroid_max[i] = (centroid[i] > job->centroid_max[i]) ? centroid[i] : job->centroid_max[i];
+		}
+	}
+}
+
+
+/*! Computes the bounding box of all dequantized positions and, optionally, an
+	order of triangles along a Morton curve through their centroids.
+	\param order NULL or an array with one entry per triangle to receive the
+		order.*/
+void get_bounds_and_order(float box_min[3], float box_max[3], uint32_t* order, const uint32_t (*positions)[3][2], const vks_header_t* header, uint32_t thread_count) {
+	bounds_job_t* jobs = malloc(sizeof(bounds_job_t) * thread_count);
+	memset(jobs, 0, sizeof(bounds_job_t) * thread_count);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		jobs[i].positions = positions;
+		jobs[i].header = header;
+		jobs[i].triangle_begin = (header->triangle_count * i) / thread_count;
+		jobs[i].triangle_end = (header->triangle_count * (i + 1)) / thread_count;
+	}
+	run_in_parallel(thread_count, run_bounds_job, jobs, sizeof(bounds_job_t));
+	float centroid_min[3], centroid_max[3];
+	for (uint32_t i = 0; i != 3; ++i) {
+		box_min[i] = centroid_min[i] = FLT_MAX;
+		box_max[i] = centroid_max[i] = -FLT_MAX;
+		for (uint32_t j = 0; j != thread_count; ++j) {
+			box_min[i] = (jobs[j].box_min[i] < box_min[i]) ? jobs[j].box_min[i] : box_min[i];
+			box_max[i] = (jobs[j].box_max[i] > box_max[i]) ? jobs[j].box_max[i] : box_max[i];
+			centroid_min[i] = (jobs[j].centroid_min[i] < centroid_min[i]) ? jobs[j].centroid_min[i] : centroid_min[i];
+			centroid_max[i] = (jobs[j].centroid_max[i] > centroid_max[i]) ? jobs[j].centroid_max[i] : centroid_max[i];
+		}
+	}
+	if (order) {
+		uint32_t* morton_codes = malloc(sizeof(uint32_t) * header->triangle_count);
+		for (uint32_t j = 0; j != thread_count; ++j) {
+			memcpy(jobs[j].centroid_min, centroid_min, sizeof(centroid_min));
+			memcpy(jobs[j].centroid_max, centroid_max, sizeof(centroid_max));
+			jobs[j].morton_codes = morton_codes;
+		}
+		run_in_parallel(thread_count, run_bounds_job, jobs, sizeof(bounds_job_t));
+		sort_morton_codes(order, morton_codes, header->triangle_count);
+		free(morton_codes);
+	}
+	free(jobs);
+}
+
+
+/*! Reorders the given triangles using Tipsify. Vertices are identified by
+	their quantized position.
+	\param order On input, triangle_count indices of triangles in positions. On
+		output, the same indices in a new order.*/
+void tipsify(uint32_t* order, uint32_t triangle_count, const uint32_t (*positions)[3][2], uint32_t cache_size) {
+	// Weld vertices using a hash table with open addressing
+	uint32_t corner_count = 3 * triangle_count;
+	uint32_t table_size = 1;
+	while (table_size < 2 * corner_count)
+		table_size *= 2;
+	uint64_t* table_keys = malloc(sizeof(uint64_t) * table_size);
+	uint32_t* table_vertices = malloc(sizeof(uint32_t) * table_size);
+	memset(table_vertices, 0xFF, sizeof(uint32_t) * table_size);
+	uint32_t* corner_vertices = malloc(sizeof(uint32_t) * corner_count);
+	uint32_t vertex_count = 0;
+	for (uint32_t i = 0; i != corner_count; ++i) {
+		const uint32_t* packed = positions[order[i / 3]][i % 3];
+		uint64_t key = ((uint64_t) packed[1] << 32) | packed[0];
+		uint32_t slot = (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> 32) & (table_size - 1);
+		while (table_vertices[slot] != 0xFFFFFFFF && table_keys[slot] != key)
+			slot = (slot + 1) & (table_size - 1);
+		if (table_vertices[slot] == 0xFFFFFFFF) {
+			table_keys[slot] = key;
+			table_vertices[slot] = vertex_count++;
+		}
+		corner_vertices[i] = table_vertices[slot];
+	}
+	free(table_keys);
+	free(table_vertices);
+	// Build lists of adjacent triangles for each vertex
+	uint32_t* adjacency_offsets = malloc(sizeof(uint32_t) * (vertex_count + 1));
+	memset(adjacency_offsets, 0, sizeof(uint32_t) * (vertex_count + 1));
+	for (uint32_t i = 0; i != corner_count; ++i)
+		++adjacency_offsets[corner_vertices[i] + 1];
+	for (uint32_t i = 0; i != vertex_count; ++i)
+		adjacency_offsets[i + 1] += adjacency_offsets[i];
+	uint32_t* live_counts = malloc(sizeof(uint32_t) * vertex_count);
+	uint32_t* adjacency = malloc(sizeof(uint32_t) * corner_count);
+	for (uint32_t i = 0; i != vertex_count; ++i)
+		live_counts[i] = adjacency_offsets[i + 1] - adjacency_offsets[i];
+	uint32_t* fill = malloc(sizeof(uint32_t) * vertex_count);
+	memcpy(fill, adjacency_offsets, sizeof(uint32_t) * vertex_count);
+	for (uint32_t i = 0; i != corner_count; ++i)
+		adjacency[fill[corner_vertices[i]]++] = i / 3;
+	free(fill);
+	// Run Tipsify
+	uint32_t* cache_times = malloc(sizeof(uint32_t) * vertex_count);
+	memset(cache_times, 0, sizeof(uint32_t) * vertex_count);
+	uint8_t* emitted = malloc(sizeof(uint8_t) * triangle_count);
+	memset(emitted, 0, sizeof(uint8_t) * triangle_count);
+	uint32_t* dead_ends = malloc(sizeof(uint32_t) * corner_count);
+	uint32_t dead_end_count = 0;
+	uint32_t* candidates = malloc(sizeof(uint32_t) * corner_count);
+	uint32_t* new_order = malloc(sizeof(uint32_t) * triangle_count);
+	uint32_t emitted_count = 0;
+	uint32_t timestamp = cache_size + 1;
+	uint32_t cursor = 1;
+	uint32_t fanning_vertex = 0;
+	while (fanning_vertex != 0xFFFFFFFF) {
+		// Emit all remaining triangles around the fanning vertex
+		uint32_t candidate_count = 0;
+		for (uint32_t i = adjacency_offsets[fanning_vertex]; i != adjacency_offsets[fanning_vertex + 1]; ++i) {
+			uint32_t triangle = adjacency[i];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = 1;
+			new_order[emitted_count++] = order[triangle];
+			for (uint32_t k = 0; k != 3; ++k) {
+				uint32_t vertex = corner_vertices[3 * triangle + k];
+				dead_ends[dead_end_count++] = vertex;
+				candidates[candidate_count++] = vertex;
+				--live_counts[vertex];
+				if (timestamp - cache_times[vertex] > cache_size)
+					cache_times[vertex] = timestamp++;
+			}
+		}
+		// Pick the candidate that stays in the cache longest after emission
+		// of its remaining triangles
+		fanning_vertex = 0xFFFFFFFF;
+		int64_t best_priority = -1;
+		for (uint32_t i = 0; i != candidate_count; ++i) {
+			uint32_t vertex = candidates[i];
+			if (live_counts[vertex] == 0)
+				continue;
+			int64_t priority = 0;
+			if ((int64_t) timestamp - cache_times[vertex] + 2 * (int64_t) live_counts[vertex] <= (int64_t) cache_size)
+				priority = (int64_t) timestamp - cache_times[vertex];
+			if (priority > best_priority) {
+				best_priority = priority;
+				fanning_vertex = vertex;
+			}
+		}
+		// At a dead end, use recently seen vertices, then any live vertex
+		while (fanning_vertex == 0xFFFFFFFF && dead_end_count > 0) {
+			uint32_t vertex = dead_ends[--dead_end_count];
+			if (live_counts[vertex] > 0)
+				fanning_vertex = vertex;
+		}
+		while (fanning_vertex == 0xFFFFFFFF && cursor < vertex_count) {
+			if (live_counts[cursor] > 0)
+				fanning_vertex = cursor;
+			++cursor;
+		}
+	}
+	memcpy(order, new_order, sizeof(uint32_t) * triangle_count);
+	free(corner_vertices);
+	free(adjacency_offsets);
+	free(live_counts);
+	free(adjacency);
+	free(cache_times);
+	free(emitted);
+	free(dead_ends);
+	free(candidates);
+	free(new_order);
+}
+
+
+//! Thread function that applies Tipsify to a range of groups. Takes a
+//! tipsify_job_t.
+void run_tipsify_job(void* argument) {
+	tipsify_job_t* job = (tipsify_job_t*) argument;
+	for (uint64_t i = job->group_begin; i != job->group_end; ++i) {
+		uint64_t begin = i * job->group_size;
+		uint64_t end = (begin + job->group_size < job->triangle_count) ? (begin + job->group_size) : job->triangle_count;
+		tipsify(job->order + begin, (uint32_t) (end - begin), job->positions, job->cache_size);
+	}
+}
+
+
+//! Thread function that permutes and writes a range of triangles of one
+//! section. Takes a section_job_t.
+void run_section_job(void* argument) {
+	section_job_t* job = (section_job_t*) argument;
+	job->result = 0;
+	if (job->triangle_begin == job->triangle_end)
+		return;
+	FILE* file = fopen(job->file_path, "r+b");
+	if (!file) {
+		printf("Failed to open %s for writing on a worker thread.\n", job->file_path);
+		job->result = 1;
+		return;
+	}
+	uint8_t* batch = malloc(job->triangle_size * TRIANGLE_BATCH_SIZE);
+	for (uint64_t batch_begin = job->triangle_begin; batch_begin < job->triangle_end && !job->result; batch_begin += TRIANGLE_BATCH_SIZE) {
+		uint64_t batch_end = (batch_begin + TRIANGLE_BATCH_SIZE < job->triangle_end) ? (batch_begin + TRIANGLE_BATCH_SIZE) : job->triangle_end;
+		for (uint64_t i = batch_begin; i != batch_end; ++i) {
+			uint64_t source = job->order ? job->order[i] : i;
+			uint8_t* target = batch + (i - batch_begin) * job->triangle_size;
+			memcpy(target, job->source + source * job->triangle_size, job->triangle_size);
+			if (!job->positions)
+				continue;
+			// Requantize positions and grow the box of the chunk
+			uint32_t (*packed)[2] = (uint32_t (*)[2]) target;
+			vks_chunk_t* chunk = job->chunks ? &job->chunks[i / job->chunk_size] : NULL;
+			for (uint32_t k = 0; k != 3; ++k) {
+				float position[3];
+				if (job->requantize) {
+					dequantize_position_64_bit(position, packed[k], job->input_header->dequantization_factor, job->input_header->dequantization_summand);
+					quantize_position_64_bit(packed[k], position, job->quantization_factor, job->quantization_summand);
+				}
+				if (chunk) {
+					dequantize_position_64_bit(position, packed[k], job->output_header->dequantization_factor, job->output_header->dequantization_summand);
+					for (uint32_t j = 0; j != 3; ++j) {
+						chunk->box_min[j] = (position[j] < chunk->box_min[j]) ? position[j] : chunk->box_min[j];
+						chunk->box_max[j] = (position[j] > chunk->box_max[j]) ? position[j] : chunk->box_max[j];
+					}
+				}
+			}
+		}
+		job->result |= vks_fseek(file, job->section_offset + batch_begin * job->triangle_size)
+			|| fwrite(batch, job->triangle_size, batch_end - batch_begin, file) != batch_end - batch_begin;
+	}
+	if (job->result)
+		printf("Failed to write triangles to %s on a worker thread.\n", job->file_path);
+	free(batch);
+	fclose(file);
+}
+
+
+/*! Compresses a single meshlet into the output arrays of the given job.
+	\param triangle_count The number of triangles in the meshlet.
+	\param positions, normals_and_tex_coords, material_indices The data of
+		these triangles as stored in the regular sections.
+	\param meshlet_index The index of the meshlet relative to the job.*/
+void compress_meshlet(meshlet_job_t* job, uint32_t triangle_count, const uint32_t (*positions)[3][2], const uint16_t (*normals_and_tex_coords)[3][4], const uint8_t* material_indices, uint64_t meshlet_index) {
+	// Find the bounding box in quantized coordinates and the needed bit count
+	uint32_t box_min[3] = { 0x1FFFFF, 0x1FFFFF, 0x1FFFFF }, box_max[3] = { 0, 0, 0 };
+	for (uint32_t i = 0; i != triangle_count; ++i) {
+		for (uint32_t j = 0; j != 3; ++j) {
+			uint32_t quantized[3];
+			unpack_position_64_bit(quantized, positions[i][j]);
+			for (uint32_t k = 0; k != 3; ++k) {
+				box_min[k] = (quantized[k] < box_min[k]) ? quantized[k] : box_min[k];
+				box_max[k] = (quantized[k] > box_max[k]) ? quantized[k] : box_max[k];
+			}
+		}
+	}
+	uint32_t bit_count = VKS_MESHLET_MIN_POSITION_BITS;
+	for (uint32_t k = 0; k != 3; ++k)
+		while (((box_max[k] - box_min[k]) >> bit_count) > 0)
+			++bit_count;
+	job->position_bit_counts[bit_count]++;
+	// Make room for the worst case without shared vertices
+	uint64_t max_word_count = (3 * 3 * triangle_count * bit_count + 31) / 32;
+	if (job->position_word_count + max_word_count > job->position_word_capacity) {
+		job->position_word_capacity = 2 * job->position_word_capacity + max_word_count;
+		job->position_words = realloc(job->position_words, sizeof(uint32_t) * job->position_word_capacity);
+	}
+	if (job->vertex_count + 3 * triangle_count > job->vertex_capacity) {
+		job->vertex_capacity = 2 * job->vertex_capacity + 3 * triangle_count;
+		job->attributes = realloc(job->attributes, sizeof(job->attributes[0]) * job->vertex_capacity);
+	}
+	uint32_t* meshlet = job->meshlets[meshlet_index];
+	uint32_t box_min_packed[2] = { box_min[0] | ((box_min[1] & 0x7FF) << 21), ((box_min[1] & 0x1FF800) >> 11) | (box_min[2] << 10) };
+	meshlet[0] = (uint32_t) job->vertex_count;
+	meshlet[1] = (uint32_t) job->position_word_count | (bit_count << 27);
+	meshlet[2] = box_min_packed[0];
+	meshlet[3] = box_min_packed[1];
+	// Find unique vertices (identical bit for bit) using a small hash table
+	// and write triangles
+	int32_t table[256];
+	memset(table, 0xFF, sizeof(table));
+	uint32_t relative_positions[3 * VKS_MESHLET_TRIANGLE_COUNT][3];
+	uint32_t meshlet_vertex_count = 0;
+	uint64_t first_triangle = meshlet_index * VKS_MESHLET_TRIANGLE_COUNT;
+	for (uint32_t i = 0; i != triangle_count; ++i) {
+		uint32_t triangle = (uint32_t) material_indices[i] << 24;
+		for (uint32_t j = 0; j != 3; ++j) {
+			uint32_t quantized[3], relative[3];
+			unpack_position_64_bit(quantized, positions[i][j]);
+			for (uint32_t k = 0; k != 3; ++k)
+				relative[k] = quantized[k] - box_min[k];
+			const uint16_t* attributes = normals_and_tex_coords[i][j];
+			uint32_t hash = relative[0] * 0x9E3779B1u ^ relative[1] * 0x85EBCA77u ^ relative[2] * 0x165667B1u;
+			hash ^= (attributes[0] | ((uint32_t) attributes[1] << 16)) * 0xC2B2AE3Du;
+			hash ^= (attributes[2] | ((uint32_t) attributes[3] << 16)) * 0x27D4EB2Fu;
+			hash = (hash ^ (hash >> 15) ^ (hash >> 24)) & 0xFF;
+			uint32_t index;
+			for (;; hash = (hash + 1) & 0xFF) {
+				if (table[hash] < 0) {
+					index = meshlet_vertex_count++;
+					table[hash] = (int32_t) index;
+					memcpy(relative_positions[index], relative, sizeof(relative));
+					memcpy(job->attributes[job->vertex_count + index], attributes, sizeof(job->attributes[0]));
+					break;
+				}
+				index = (uint32_t) table[hash];
+				if (memcmp(relative_positions[index], relative, sizeof(relative)) == 0
+					&& memcmp(job->attributes[job->vertex_count + index], attributes, sizeof(job->attributes[0])) == 0)
+					break;
+			}
+			triangle |= index << (8 * j);
+		}
+		job->triangles[first_triangle + i] = triangle;
+	}
+	// Write the bit stream of positions
+	uint32_t* words = job->position_words + job->position_word_count;
+	uint32_t word_count = (3 * meshlet_vertex_count * bit_count + 31) / 32;
+	memset(words, 0, sizeof(uint32_t) * word_count);
+	for (uint32_t i = 0; i != 3 * meshlet_vertex_count; ++i) {
+		uint32_t value = relative_positions[i / 3][i % 3];
+		uint32_t bit = i * bit_count;
+		words[bit / 32] |= value << (bit % 32);
+		if (bit % 32 + bit_count > 32)
+			words[bit / 32 + 1] |= value >> (32 - bit % 32);
+	}
+	job->position_word_count += word_count;
+	job->vertex_count += meshlet_vertex_count;
+}
+
+
+//! Thread function that compresses a range of meshlets. Takes a
+//! meshlet_job_t.
+void run_meshlet_job(void* argument) {
+	meshlet_job_t* job = (meshlet_job_t*) argument;
+	job->result = 0;
+	uint64_t triangle_begin = job->meshlet_begin * VKS_MESHLET_TRIANGLE_COUNT;
+	uint64_t triangle_end = job->meshlet_end * VKS_MESHLET_TRIANGLE_COUNT;
+	triangle_end = (triangle_end < job->triangle_count) ? triangle_end : job->triangle_count;
+	job->meshlets = malloc(sizeof(job->meshlets[0]) * (job->meshlet_end - job->meshlet_begin + 1));
+	job->triangles = malloc(sizeof(uint32_t) * (triangle_end - triangle_begin + 1));
+	if (triangle_begin >= triangle_end)
+		return;
+	FILE* file = fopen(job->file_path, "rb");
+	if (!file) {
+		printf("Failed to open %s for reading on a worker thread.\n", job->file_path);
+		job->result = 1;
+		return;
+	}
+	// TRIANGLE_BATCH_SIZE is a multiple of the meshlet size
+	uint32_t (*positions)[3][2] = malloc(sizeof(positions[0]) * TRIANGLE_BATCH_SIZE);
+	uint16_t (*normals_and_tex_coords)[3][4] = malloc(sizeof(normals_and_tex_coords[0]) * TRIANGLE_BATCH_SIZE);
+	uint8_t* material_indices = malloc(sizeof(uint8_t) * TRIANGLE_BATCH_SIZE);
+	for (uint64_t batch_begin = triangle_begin; batch_begin < triangle_end && !job->result; batch_begin += TRIANGLE_BATCH_SIZE) {
+		uint64_t batch_end = (batch_begin + TRIANGLE_BATCH_SIZE < triangle_end) ? (batch_begin + TRIANGLE_BATCH_SIZE) : triangle_end;
+		size_t batch_size = (size_t) (batch_end - batch_begin);
+		job->result |= vks_fseek(file, job->layout->positions + batch_begin * sizeof(positions[0]))
+			|| fread(positions, sizeof(positions[0]), batch_size, file) != batch_size
+			|| vks_fseek(file, job->layout->normals_and_tex_coords + batch_begin * sizeof(normals_and_tex_coords[0]))
+			|| fread(normals_and_tex_coords, sizeof(normals_and_tex_coords[0]), batch_size, file) != batch_size
+			|| vks_fseek(file, job->layout->material_indices + batch_begin * sizeof(uint8_t))
+			|| fread(material_indices, sizeof(uint8_t), batch_size, file) != batch_size;
+		for (uint64_t i = batch_begin; i < batch_end && !job->result; i += VKS_MESHLET_TRIANGLE_COUNT) {
+			uint32_t count = (uint32_t) ((i + VKS_MESHLET_TRIANGLE_COUNT < batch_end) ? VKS_MESHLET_TRIANGLE_COUNT : (batch_end - i));
+			uint64_t offset = i - batch_begin;
+			compress_meshlet(job, count, positions + offset, normals_and_tex_coords + offset, material_indices + offset, (i - triangle_begin) / VKS_MESHLET_TRIANGLE_COUNT);
+		}
+	}
+	if (job->result)
+		printf("Failed to read triangles from %s on a worker thread.\n", job->file_path);
+	free(positions);
+	free(normals_and_tex_coords);
+	free(material_indices);
+	fclose(file);
+}
+
+
+/*! Compresses the geometry of the given output file, which has all regular
+	sections written already, and writes the sections with meshlets, the
+	final header and the end of file marker.
+	\param header The output header. Its meshlet vertex count is nonzero on
+		input and gets overwritten.
+	\return 0 on success.*/
+int write_meshlets(const optimizer_settings_t* settings, vks_header_t* header, const char* const* material_names) {
+	uint32_t thread_count = settings->thread_count;
+	uint64_t meshlet_count = get_vks_meshlet_count(header->triangle_count);
+	vks_layout_t layout = get_vks_layout(header, material_names);
+	meshlet_job_t* jobs = malloc(sizeof(meshlet_job_t) * thread_count);
+	memset(jobs, 0, sizeof(meshlet_job_t) * thread_count);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		jobs[i].file_path = settings->output_path;
+		jobs[i].layout = &layout;
+		jobs[i].triangle_count = header->triangle_count;
+		jobs[i].meshlet_begin = (meshlet_count * i) / thread_count;
+		jobs[i].meshlet_end = (meshlet_count * (i + 1)) / thread_count;
+	}
+	run_in_parallel(thread_count, run_meshlet_job, jobs, sizeof(meshlet_job_t));
+	// Offset vertex and word indices of meshlets by those of preceding jobs
+	int result = 0;
+	uint64_t vertex_count = 0, word_count = 0, bit_counts[22];
+	memset(bit_counts, 0, sizeof(bit_counts));
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		result |= jobs[i].result;
+		for (uint64_t j = 0; j != jobs[i].meshlet_end - jobs[i].meshlet_begin; ++j) {
+			jobs[i].meshlets[j][0] += (uint32_t) vertex_count;
+			jobs[i].meshlets[j][1] += (uint32_t) word_count;
+		}
+		vertex_count += jobs[i].vertex_count;
+		word_count += jobs[i].position_word_count;
+		for (uint32_t j = 0; j <= 21; ++j)
+			bit_counts[j] += jobs[i].position_bit_counts[j];
+	}
+	if (vertex_count > 0xFFFFFFFFull || word_count > 0x7FFFFFFull) {
+		printf("The compressed geometry has %llu vertices and %llu words of positions but at most 2^32 - 1 and 2^27 - 1 are supported.\n",
+			(unsigned long long) vertex_count, (unsigned long long) word_count);
+		result = 1;
+	}
+	// Write the header and the new sections. One word of padding at the end
+	// of the positions keeps reads of two consecutive words in bounds.
+	header->meshlet_vertex_count = vertex_count;
+	header->meshlet_position_word_count = word_count + 1;
+	layout = get_vks_layout(header, material_names);
+	FILE* file = result ? NULL : fopen(settings->output_path, "r+b");
+	result = result || !file || write_vks_header(file, header, material_names) || vks_fseek(file, layout.meshlets);
+	for (uint32_t i = 0; i != thread_count && !result; ++i)
+		result |= fwrite(jobs[i].meshlets, sizeof(jobs[i].meshlets[0]), jobs[i].meshlet_end - jobs[i].meshlet_begin, file) != jobs[i].meshlet_end - jobs[i].meshlet_begin;
+	for (uint32_t i = 0; i != thread_count && !result; ++i)
+		result |= fwrite(jobs[i].position_words, sizeof(uint32_t), jobs[i].position_word_count, file) != jobs[i].position_word_count;
+	uint32_t padding = 0;
+	result = result || fwrite(&padding, sizeof(padding), 1, file) != 1;
+	for (uint32_t i = 0; i != thread_count && !result; ++i)
+		result |= fwrite(jobs[i].attributes, sizeof(jobs[i].attributes[0]), jobs[i].vertex_count, file) != jobs[i].vertex_count;
+	for (uint32_t i = 0; i != thread_count && !result; ++i) {
+		uint64_t triangle_begin = jobs[i].meshlet_begin * VKS_MESHLET_TRIANGLE_COUNT;
+		uint64_t triangle_end = jobs[i].meshlet_end * VKS_MESHLET_TRIANGLE_COUNT;
+		triangle_end = (triangle_end < header->triangle_count) ? triangle_end : header->triangle_count;
+		if (triangle_begin < triangle_end)
+			result |= fwrite(jobs[i].triangles, sizeof(uint32_t), triangle_end - triangle_begin, file) != triangle_end - triangle_begin;
+	}
+	result = result || write_vks_eof_marker(file);
+	if (file)
+		fclose(file);
+	if (result)
+		printf("Failed to write compressed geometry to %s.\n", settings->output_path);
+	else {
+		uint64_t size = layout.eof_marker - layout.meshlets;
+		printf("Compressed geometry: %llu meshlets, %llu vertices (%.3f per triangle), %.2f bytes per triangle instead of 49.\n",
+			(unsigned long long) meshlet_count, (unsigned long long) vertex_count, (double) vertex_count / (double) header->triangle_count,
+			(double) size / (double) header->triangle_count);
+		printf("Meshlets per bit count of positions:");
+		for (uint32_t i = 0; i <= 21; ++i)
+			if (bit_counts[i] > 0)
+				printf(" %u: %llu", i, (unsigned long long) bit_counts[i]);
+		printf("\n");
+	}
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		free(jobs[i].meshlets);
+		free(jobs[i].triangles);
+		free(jobs[i].position_words);
+		free(jobs[i].attributes);
+	}
+	free(jobs);
+	return result;
+}
+
+
+//! Returns the index of the corner of the given triangle that uses the given
+//! vertex or 3 if there is none
+static inline uint32_t find_corner(const uint32_t triangle[3], uint32_t vertex) {
+	return (triangle[0] == vertex) ? 0 : ((triangle[1] == vertex) ? 1 : ((triangle[2] == vertex) ? 2 : 3));
+}
+
+
+//! Computes the unnormalized normal of the triangle with the given vertices
+static inline void get_triangle_normal(float normal[3], const float p0[3], const float p1[3], const float p2[3]) {
+	float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+
+/*! Evaluates the error quadric q at the given position. Quadrics are sums of
+	squared distances to planes weighted by triangle areas and q[10] is the
+	sum of weights, so the result is a mean squared distance.*/
+static inline double evaluate_quadric(const double q[11], const float p[3]) {
+	double x = p[0], y = p[1], z = p[2];
+	double error = x * (x * q[0] + 2.0 * (y * q[1] + z * q[2] + q[3]))
+		+ y * (y * q[4] + 2.0 * (z * q[5] + q[6]))
+		+ z * (z * q[7] + 2.0 * q[8]) + q[9];
+	return (q[10] > 0.0) ? (error / q[10]) : 0.0;
+}
+
+
+//! A possible collapse of vertex u into vertex v
+typedef struct collapse_s {
+	double cost;
+	uint32_t u, v;
+} collapse_t;
+
+
+//! Comparison function for qsort() sorting collapses by ascending cost
+int compare_collapses(const void* lhs, const void* rhs) {
+	double l = ((const collapse_t*) lhs)->cost, r = ((const collapse_t*) rhs)->cost;
+	return (l < r) ? -1 : ((l > r) ? 1 : 0);
+}
+
+
+//! An undirected edge of a triangle identified by its two vertex indices
+typedef struct simplifier_edge_s {
+	uint64_t key;
+	uint32_t triangle, corner;
+} simplifier_edge_t;
+
+
+//! Comparison function for qsort() grouping equal edges
+int compare_edges(const void* lhs, const void* rhs) {
+	uint64_t l = ((const simplifier_edge_t*) lhs)->key, r = ((const simplifier_edge_t*) rhs)->key;
+	return (l < r) ? -1 : ((l > r) ? 1 : 0);
+}
+
+
+/*! Prepares the simplification of the given triangles: Welds vertices,
+	computes quadrics and locks all vertices on edges that are not shared by
+	exactly two triangles with the same material and continuous texture
+	coordinates. In particular, the boundary of the chunk is locked.*/
+void init_simplifier(simplifier_t* simplifier, uint32_t triangle_count, const uint32_t (*positions)[3][2], const uint16_t (*normals_and_tex_coords)[3][4], const uint8_t* material_indices, const vks_header_t* header) {
+	simplifier_t* s = simplifier;
+	uint32_t corner_count = 3 * triangle_count;
+	s->triangle_count = s->live_count = triangle_count;
+	s->triangles = malloc(sizeof(s->triangles[0]) * triangle_count);
+	s->tex_coords = malloc(sizeof(s->tex_coords[0]) * triangle_count);
+	s->live = malloc(sizeof(uint8_t) * triangle_count);
+	memset(s->live, 1, sizeof(uint8_t) * triangle_count);
+	s->positions = malloc(sizeof(s->positions[0]) * corner_count);
+	s->corners = malloc(sizeof(uint32_t) * corner_count);
+	// Weld vertices with equal position and normal using a hash table with
+	// open addressing
+	uint32_t table_size = 1;
+	while (table_size < 2 * corner_count)
+		table_size *= 2;
+	uint32_t* table = malloc(sizeof(uint32_t) * table_size);
+	memset(table, 0xFF, sizeof(uint32_t) * table_size);
+	s->vertex_count = 0;
+	for (uint32_t i = 0; i != corner_count; ++i) {
+		const uint32_t* packed = positions[i / 3][i % 3];
+		const uint16_t* attributes = normals_and_tex_coords[i / 3][i % 3];
+		uint64_t key = ((uint64_t) packed[1] << 32) | packed[0];
+		key ^= (attributes[0] | ((uint64_t) attributes[1] << 16)) * 0xC2B2AE3D27D4EB4Full;
+		uint32_t slot = (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> 32) & (table_size - 1);
+		for (;; slot = (slot + 1) & (table_size - 1)) {
+			if (table[slot] == 0xFFFFFFFF) {
+				table[slot] = s->vertex_count;
+				s->corners[s->vertex_count] = i;
+				dequantize_position_64_bit(s->positions[s->vertex_count], packed, header->dequantization_factor, header->dequantization_summand);
+				++s->vertex_count;
+				break;
+			}
+			uint32_t corner = s->corners[table[slot]];
+			if (memcmp(positions[corner / 3][corner % 3], packed, sizeof(uint32_t) * 2) == 0
+				&& memcmp(normals_and_tex_coords[corner / 3][corner % 3], attributes, sizeof(uint16_t) * 2) == 0)
+				break;
+		}
+		s->triangles[i / 3][i % 3] = table[slot];
+		s->tex_coords[i / 3][i % 3][0] = attributes[2] * (8.0f / 65535.0f);
+		s->tex_coords[i / 3][i % 3][1] = attributes[3] * (8.0f / 65535.0f);
+	}
+	free(table);
+	// Accumulate quadrics of triangle planes
+	s->quadrics = malloc(sizeof(s->quadrics[0]) * s->vertex_count);
+	memset(s->quadrics, 0, sizeof(s->quadrics[0]) * s->vertex_count);
+	for (uint32_t i = 0; i != triangle_count; ++i) {
+		const uint32_t* t = s->triangles[i];
+		float normal[3];
+		get_triangle_normal(normal, s->positions[t[0]], s->positions[t[1]], s->positions[t[2]]);
+		double length = sqrt((double) normal[0] * normal[0] + (double) normal[1] * normal[1] + (double) normal[2] * normal[2]);
+		if (length == 0.0)
+			continue;
+		double a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+		double d = -(a * s->positions[t[0]][0] + b * s->positions[t[0]][1] + c * s->positions[t[0]][2]);
+		double plane[11] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d, 1.0 };
+		for (uint32_t j = 0; j != 3; ++j)
+			for (uint32_t k = 0; k != 11; ++k)
+				s->quadrics[t[j]][k] += 0.5 * length * plane[k];
+	}
+	// Find edges that do not have exactly two adjacent triangles with equal
+	// material and texture coordinates and lock their vertices
+	s->locked = malloc(sizeof(uint8_t) * s->vertex_count);
+	memset(s->locked, 0, sizeof(uint8_t) * s->vertex_count);
+	simplifier_edge_t* edges = malloc(sizeof(simplifier_edge_t) * corner_count);
+	for (uint32_t i = 0; i != corner_count; ++i) {
+		uint32_t v0 = s->triangles[i / 3][i % 3], v1 = s->triangles[i / 3][(i + 1) % 3];
+		edges[i].key = (v0 < v1) ? (((uint64_t) v0 << 32) | v1) : (((uint64_t) v1 << 32) | v0);
+		edges[i].triangle = i / 3;
+		edges[i].corner = i % 3;
+	}
+	qsort(edges, corner_count, sizeof(simplifier_edge_t), compare_edges);
+	const float tolerance = 3.0f * 8.0f / 65535.0f;
+	for (uint32_t i = 0; i != corner_count;) {
+		uint32_t count = 1;
+		while (i + count != corner_count && edges[i + count].key == edges[i].key)
+			++count;
+		int lock = (count != 2);
+		if (!lock) {
+			const simplifier_edge_t* e[2] = { &edges[i], &edges[i + 1] };
+			lock = (material_indices[e[0]->triangle] != material_indices[e[1]->triangle]);
+			// Compare the texture coordinate difference along the edge
+			uint32_t v0 = (uint32_t) (e[0]->key >> 32), v1 = (uint32_t) e[0]->key;
+			for (uint32_t j = 0; j != 2 && !lock; ++j) {
+				const uint32_t* t[2] = { s->triangles[e[0]->triangle], s->triangles[e[1]->triangle] };
+				const float (*uv[2])[2] = { s->tex_coords[e[0]->triangle], s->tex_coords[e[1]->triangle] };
+				float delta_0 = uv[0][find_corner(t[0], v1)][j] - uv[0][find_corner(t[0], v0)][j];
+				float delta_1 = uv[1][find_corner(t[1], v1)][j] - uv[1][find_corner(t[1], v0)][j];
+				lock = fabsf(delta_0 - delta_1) > tolerance;
+			}
+		}
+		if (lock) {
+			s->locked[edges[i].key >> 32] = 1;
+			s->locked[(uint32_t) edges[i].key] = 1;
+		}
+		i += count;
+	}
+	free(edges);
+}
+
+
+//! Frees all memory of the given simplifier
+void destroy_simplifier(simplifier_t* simplifier) {
+	free(simplifier->triangles);
+	free(simplifier->tex_coords);
+	free(simplifier->live);
+	free(simplifier->positions);
+	free(simplifier->corners);
+	free(simplifier->quadrics);
+	free(simplifier->locked);
+	memset(simplifier, 0, sizeof(*simplifier));
+}
+
+
+/*! Applies half-edge collapses to the given simplifier until at most
+	target_count triangles are live or no further collapse is possible.
+	Collapses are done in passes. Each pass sorts the cheapest collapse of
+	each vertex by its quadric error and performs an independent set of them
+	in that order, such that vertex adjacency only has to be built once per
+	pass. Collapses that would flip a triangle are rejected.
+	\param error The largest root mean square distance of any collapse so
+		far. Updated.*/
+void simplify(simplifier_t* simplifier, uint32_t target_count, float* error) {
+	simplifier_t* s = simplifier;
+	uint32_t* adjacency_offsets = malloc(sizeof(uint32_t) * (s->vertex_count + 1));
+	uint32_t* adjacency = malloc(sizeof(uint32_t) * 3 * s->triangle_count);
+	collapse_t* collapses = malloc(sizeof(collapse_t) * s->vertex_count);
+	uint8_t* touched = malloc(sizeof(uint8_t) * s->vertex_count);
+	while (s->live_count > target_count) {
+		// Build lists of live triangles adjacent to each vertex
+		memset(adjacency_offsets, 0, sizeof(uint32_t) * (s->vertex_count + 1));
+		for (uint32_t i = 0; i != s->triangle_count; ++i)
+			if (s->live[i])
+				for (uint32_t j = 0; j != 3; ++j)
+					++adjacency_offsets[s->triangles[i][j] + 1];
+		for (uint32_t i = 0; i != s->vertex_count; ++i)
+			adjacency_offsets[i + 1] += adjacency_offsets[i];
+		for (uint32_t i = 0; i != s->triangle_count; ++i)
+			if (s->live[i])
+				for (uint32_t j = 0; j != 3; ++j)
+					adjacency[adjacency_offsets[s->triangles[i][j]]++] = i;
+		for (uint32_t i = s->vertex_count; i != 0; --i)
+			adjacency_offsets[i] = adjacency_offsets[i - 1];
+		adjacency_offsets[0] = 0;
+		// Find the cheapest collapse for each vertex that may move
+		uint32_t collapse_count = 0;
+		for (uint32_t u = 0; u != s->vertex_count; ++u) {
+			if (s->locked[u])
+				continue;
+			collapse_t best = { .cost = DBL_MAX, .u = u, .v = u };
+			for (uint32_t i = adjacency_offsets[u]; i != adjacency_offsets[u + 1]; ++i) {
+				for (uint32_t j = 0; j != 3; ++j) {
+					uint32_t v = s->triangles[adjacency[i]][j];
+					if (v == u)
+						continue;
+					double quadric[11];
+					for (uint32_t k = 0; k != 11; ++k)
+						quadric[k] = s->quadrics[u][k] + s->quadrics[v][k];
+					double cost = evaluate_quadric(quadric, s->positions[v]);
+					if (cost < best.cost) {
+						best.cost = cost;
+						best.v = v;
+					}
+				}
+			}
+			if (best.v != u)
+				collapses[collapse_count++] = best;
+		}
+		qsort(collapses, collapse_count, sizeof(collapse_t), compare_collapses);
+		// Perform collapses that do not interfere with one another
+		memset(touched, 0, sizeof(uint8_t) * s->vertex_count);
+		uint32_t performed_count = 0;
+		for (uint32_t i = 0; i != collapse_count && s->live_count > target_count; ++i) {
+			uint32_t u = collapses[i].u, v = collapses[i].v;
+			if (touched[u] || touched[v])
+				continue;
+			// Reject collapses that flip triangles and find a triangle that
+			// relates the texture coordinates of u and v
+			int valid = 1;
+			float tex_coord_delta[2] = { 0.0f, 0.0f };
+			for (uint32_t j = adjacency_offsets[u]; j != adjacency_offsets[u + 1] && valid; ++j) {
+				const uint32_t* t = s->triangles[adjacency[j]];
+				uint32_t corner_u = find_corner(t, u), corner_v = find_corner(t, v);
+				if (corner_v != 3) {
+					for (uint32_t k = 0; k != 2; ++k)
+						tex_coord_delta[k] = s->tex_coords[adjacency[j]][corner_v][k] - s->tex_coords[adjacency[j]][corner_u][k];
+					continue;
+				}
+				const float* p[3] = { s->positions[t[0]], s->positions[t[1]], s->positions[t[2]] };
+				float old_normal[3], new_normal[3];
+				get_triangle_normal(old_normal, p[0], p[1], p[2]);
+				p[corner_u] = s->positions[v];
+				get_triangle_normal(new_normal, p[0], p[1], p[2]);
+				valid = (old_normal[0] * new_normal[0] + old_normal[1] * new_normal[1] + old_normal[2] * new_normal[2]) > 0.0f;
+			}
+			if (!valid)
+				continue;
+			// Move u to v
+			for (uint32_t j = adjacency_offsets[u]; j != adjacency_offsets[u + 1]; ++j) {
+				uint32_t triangle = adjacency[j];
+				uint32_t* t = s->triangles[triangle];
+				uint32_t corner_u = find_corner(t, u);
+				for (uint32_t k = 0; k != 3; ++k)
+					touched[t[k]] = 1;
+				if (find_corner(t, v) != 3) {
+					s->live[triangle] = 0;
+					--s->live_count;
+					continue;
+				}
+				t[corner_u] = v;
+				for (uint32_t k = 0; k != 2; ++k)
+					s->tex_coords[triangle][corner_u][k] += tex_coord_delta[k];
+			}
+			for (uint32_t k = 0; k != 11; ++k)
+				s->quadrics[v][k] += s->quadrics[u][k];
+			float collapse_error = (float) sqrt((collapses[i].cost > 0.0) ? collapses[i].cost : 0.0);
+			(*error) = (collapse_error > (*error)) ? collapse_error : (*error);
+			++performed_count;
+		}
+		if (performed_count == 0)
+			break;
+	}
+	free(adjacency_offsets);
+	free(adjacency);
+	free(collapses);
+	free(touched);
+}
+
+
+//! Appends the live triangles of the given simplifier to the output of the
+//! given job
+void append_lod_triangles(lod_job_t* job, const simplifier_t* s, const uint32_t (*positions)[3][2], const uint16_t (*normals_and_tex_coords)[3][4], const uint8_t* material_indices) {
+	if (job->triangle_count + s->live_count > job->triangle_capacity) {
+		job->triangle_capacity = 2 * job->triangle_capacity + s->live_count;
+		job->positions = realloc(job->positions, sizeof(job->positions[0]) * job->triangle_capacity);
+		job->normals_and_tex_coords = realloc(job->normals_and_tex_coords, sizeof(job->normals_and_tex_coords[0]) * job->triangle_capacity);
+		job->material_indices = realloc(job->material_indices, sizeof(uint8_t) * job->triangle_capacity);
+	}
+	for (uint32_t i = 0; i != s->triangle_count; ++i) {
+		if (!s->live[i])
+			continue;
+		uint64_t output = job->triangle_count++;
+		uint16_t tex_coords[3][2];
+		encode_triangle_tex_coords(tex_coords, s->tex_coords[i]);
+		for (uint32_t j = 0; j != 3; ++j) {
+			uint32_t corner = s->corners[s->triangles[i][j]];
+			memcpy(job->positions[output][j], positions[corner / 3][corner % 3], sizeof(uint32_t) * 2);
+			memcpy(job->normals_and_tex_coords[output][j], normals_and_tex_coords[corner / 3][corner % 3], sizeof(uint16_t) * 2);
+			memcpy(job->normals_and_tex_coords[output][j] + 2, tex_coords[j], sizeof(uint16_t) * 2);
+		}
+		job->material_indices[output] = material_indices[i];
+	}
+}
+
+
+//! Thread function that generates levels of detail for a range of chunks.
+//! Takes a lod_job_t.
+void run_lod_job(void* argument) {
+	lod_job_t* job = (lod_job_t*) argument;
+	job->result = 0;
+	job->lods = malloc(sizeof(vks_chunk_lod_t) * job->level_count * (job->chunk_end - job->chunk_begin + 1));
+	if (job->chunk_begin == job->chunk_end)
+		return;
+	FILE* file = fopen(job->file_path, "rb");
+	if (!file) {
+		printf("Failed to open %s for reading on a worker thread.\n", job->file_path);
+		job->result = 1;
+		return;
+	}
+	uint64_t max_triangle_count = 0;
+	for (uint64_t i = job->chunk_begin; i != job->chunk_end; ++i)
+		max_triangle_count = (job->chunks[i].triangle_count > max_triangle_count) ? job->chunks[i].triangle_count : max_triangle_count;
+	uint32_t (*positions)[3][2] = malloc(sizeof(positions[0]) * max_triangle_count);
+	uint16_t (*normals_and_tex_coords)[3][4] = malloc(sizeof(normals_and_tex_coords[0]) * max_triangle_count);
+	uint8_t* material_indices = malloc(sizeof(uint8_t) * max_triangle_count);
+	for (uint64_t i = job->chunk_begin; i != job->chunk_end && !job->result; ++i) {
+		const vks_chunk_t* chunk = &job->chunks[i];
+		size_t count = (size_t) chunk->triangle_count;
+		job->result |= vks_fseek(file, job->layout->positions + chunk->first_triangle * sizeof(positions[0]))
+			|| fread(positions, sizeof(positions[0]), count, file) != count
+			|| vks_fseek(file, job->layout->normals_and_tex_coords + chunk->first_triangle * sizeof(normals_and_tex_coords[0]))
+			|| fread(normals_and_tex_coords, sizeof(normals_and_tex_coords[0]), count, file) != count
+			|| vks_fseek(file, job->layout->material_indices + chunk->first_triangle * sizeof(uint8_t))
+			|| fread(material_indices, sizeof(uint8_t), count, file) != count;
+		if (job->result)
+			break;
+		// Halve the triangle count from one level to the next
+		simplifier_t simplifier;
+		init_simplifier(&simplifier, (uint32_t) count, positions, normals_and_tex_coords, material_indices, job->header);
+		job->vertex_count += simplifier.vertex_count;
+		for (uint32_t j = 0; j != simplifier.vertex_count; ++j)
+			job->locked_vertex_count += simplifier.locked[j];
+		vks_chunk_lod_t previous = { .first_triangle = UINT64_MAX, .triangle_count = count, .error = 0.0f };
+		for (uint32_t j = 0; j != job->level_count; ++j) {
+			vks_chunk_lod_t lod = previous;
+			simplify(&simplifier, simplifier.live_count / 2, &lod.error);
+			if (simplifier.live_count < previous.triangle_count) {
+				lod.first_triangle = job->triangle_count;
+				lod.triangle_count = simplifier.live_count;
+				append_lod_triangles(job, &simplifier, positions, normals_and_tex_coords, material_indices);
+			}
+			job->lods[(i - job->chunk_begin) * job->level_count + j] = lod;
+			previous = lod;
+		}
+		destroy_simplifier(&simplifier);
+	}
+	if (job->result)
+		printf("Failed to read triangles from %s on a worker thread.\n", job->file_path);
+	free(positions);
+	free(normals_and_tex_coords);
+	free(material_indices);
+	fclose(file);
+}
+
+
+/*! Simplifies each chunk of the given output file, which has all regular
+	sections, the chunks and possibly compressed geometry written already, and
+	writes the sections with levels of detail, the final header and the end
+	of file marker.
+	\param header The output header. Its level count is set on input, its
+		triangle count for levels of detail gets overwritten.
+	\return 0 on success.*/
+int write_lods(const optimizer_settings_t* settings, vks_header_t* header, const char* const* material_names, const vks_chunk_t* chunks) {
+	uint32_t thread_count = settings->thread_count;
+	uint32_t level_count = (uint32_t) header->lod_level_count;
+	vks_layout_t layout = get_vks_layout(header, material_names);
+	lod_job_t* jobs = malloc(sizeof(lod_job_t) * thread_count);
+	memset(jobs, 0, sizeof(lod_job_t) * thread_count);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		jobs[i].file_path = settings->output_path;
+		jobs[i].layout = &layout;
+		jobs[i].header = header;
+		jobs[i].chunks = chunks;
+		jobs[i].chunk_begin = (header->chunk_count * i) / thread_count;
+		jobs[i].chunk_end = (header->chunk_count * (i + 1)) / thread_count;
+		jobs[i].level_count = level_count;
+	}
+	run_in_parallel(thread_count, run_lod_job, jobs, sizeof(lod_job_t));
+	// Make triangle indices absolute and gather statistics
+	int result = 0;
+	uint64_t triangle_count = 0, vertex_count = 0, locked_vertex_count = 0;
+	uint64_t* level_triangle_counts = malloc(sizeof(uint64_t) * level_count);
+	float* level_errors = malloc(sizeof(float) * level_count);
+	memset(level_triangle_counts, 0, sizeof(uint64_t) * level_count);
+	memset(level_errors, 0, sizeof(float) * level_count);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		result |= jobs[i].result;
+		for (uint64_t j = 0; j != jobs[i].chunk_end - jobs[i].chunk_begin && !result; ++j) {
+			for (uint32_t k = 0; k != level_count; ++k) {
+				vks_chunk_lod_t* lod = &jobs[i].lods[j * level_count + k];
+				if (lod->first_triangle == UINT64_MAX)
+					lod->first_triangle = chunks[jobs[i].chunk_begin + j].first_triangle;
+				else
+					lod->first_triangle += header->triangle_count + triangle_count;
+				level_triangle_counts[k] += lod->triangle_count;
+				level_errors[k] = (lod->error > level_errors[k]) ? lod->error : level_errors[k];
+			}
+		}
+		triangle_count += jobs[i].triangle_count;
+		vertex_count += jobs[i].vertex_count;
+		locked_vertex_count += jobs[i].locked_vertex_count;
+	}
+	if (header->triangle_count + triangle_count > 0xFFFFFFFFull) {
+		printf("Levels of detail would increase the triangle count to %llu but at most 2^32 - 1 are supported.\n",
+			(unsigned long long) (header->triangle_count + triangle_count));
+		result = 1;
+	}
+	// Write the header and the new sections
+	header->lod_triangle_count = triangle_count;
+	layout = get_vks_layout(header, material_names);
+	FILE* file = result ? NULL : fopen(settings->output_path, "r+b");
+	result = result || !file || write_vks_header(file, header, material_names) || vks_fseek(file, layout.chunk_lods);
+	for (uint32_t i = 0; i != thread_count && !result; ++i) {
+		uint64_t count = (jobs[i].chunk_end - jobs[i].chunk_begin) * level_count;
+		result |= fwrite(jobs[i].lods, sizeof(vks_chunk_lod_t), count, file) != count;
+	}
+	for (uint32_t i = 0; i != thread_count && !result; ++i)
+		result |= fwrite(jobs[i].positions, sizeof(jobs[i].positions[0]), jobs[i].triangle_count, file) != jobs[i].triangle_count;
+	for (uint32_t i = 0; i != thread_count && !result; ++i)
+		result |= fwrite(jobs[i].normals_and_tex_coords, sizeof(jobs[i].normals_and_tex_coords[0]), jobs[i].triangle_count, file) != jobs[i].triangle_count;
+	for (uint32_t i = 0; i != thread_count && !result; ++i)
+		result |= fwrite(jobs[i].material_indices, sizeof(uint8_t), jobs[i].triangle_count, file) != jobs[i].triangle_count;
+	result = result || write_vks_eof_marker(file);
+	if (file)
+		fclose(file);
+	if (result)
+		printf("Failed to write levels of detail to %s.\n", settings->output_path);
+	else {
+		printf("Levels of detail: %llu triangles in total, %.1f%% of %llu welded vertices locked.\n", (unsigned long long) triangle_count,
+			(vertex_count > 0) ? (100.0 * (double) locked_vertex_count / (double) vertex_count) : 0.0, (unsigned long long) vertex_count);
+		for (uint32_t i = 0; i != level_count; ++i)
+			printf("Level %u: %llu triangles (%.1f%%), maximal error %g\n", i + 1, (unsigned long long) level_triangle_counts[i],
+				100.0 * (double) level_triangle_counts[i] / (double) header->triangle_count, level_errors[i]);
+	}
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		free(jobs[i].lods);
+		free(jobs[i].positions);
+		free(jobs[i].normals_and_tex_coords);
+		free(jobs[i].material_indices);
+	}
+	free(jobs);
+	free(level_triangle_counts);
+	free(level_errors);
+	return result;
+}
+
+
+/*! Loads a complete section of the input file into newly allocated memory.
+	\return The section or NULL on failure.*/
+uint8_t* load_section(FILE* file, uint64_t offset, uint64_t size) {
+	uint8_t* section = malloc(size);
+	if (!section || vks_fseek(file, offset) || fread(section, 1, size, file) != size) {
+		free(section);
+		return NULL;
+	}
+	return section;
+}
+
+
+/*! Permutes one section of the input using worker threads and writes it to
+	the output file.
+	\param chunk_size The chunk size, such that work is split at chunk
+		boundaries.
+	\param jobs Pre-initialized jobs. Everything up to section_offset gets
+		overwritten.
+	\return 0 on success.*/
+int write_section(section_job_t* jobs, uint32_t thread_count, const uint8_t* source, size_t triangle_size, uint64_t triangle_count, uint64_t chunk_size, uint64_t section_offset) {
+	uint64_t granularity = chunk_size ? chunk_size : 1;
+	uint64_t unit_count = (triangle_count + granularity - 1) / granularity;
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		jobs[i].source = source;
+		jobs[i].triangle_size = triangle_size;
+		jobs[i].triangle_begin = ((unit_count * i) / thread_count) * granularity;
+		jobs[i].triangle_end = ((unit_count * (i + 1)) / thread_count) * granularity;
+		jobs[i].triangle_end = (jobs[i].triangle_end < triangle_count) ? jobs[i].triangle_end : triangle_count;
+		jobs[i].section_offset = section_offset;
+	}
+	run_in_parallel(thread_count, run_section_job, jobs, sizeof(section_job_t));
+	int result = 0;
+	for (uint32_t i = 0; i != thread_count; ++i)
+		result |= jobs[i].result;
+	return result;
+}
+
+
+/*! Performs all work of this tool, i.e. reads the input and writes an
+	optimized version of it to the output.
+	\return 0 on success.*/
+int optimize_scene(const optimizer_settings_t* settings) {
+	double start_time = get_tool_time();
+	// Read the input header and validate the file size
+	FILE* input = fopen(settings->input_path, "rb");
+	vks_header_t input_header;
+	char** material_names = NULL;
+	if (!input || read_vks_header(input, &input_header, &material_names)) {
+		printf("Failed to open or read the header of the scene file %s.\n", settings->input_path);
+		if (input) fclose(input);
+		free_vks_material_names(material_names, input_header.material_count);
+		return 1;
+	}
+	vks_layout_t input_layout = get_vks_layout(&input_header, (const char* const*) material_names);
+	uint32_t eof_marker = 0;
+	if (input_header.triangle_count == 0 || input_header.triangle_count > 0xFFFFFFFFull
+		|| vks_fseek(input, input_layout.eof_marker) || fread(&eof_marker, sizeof(eof_marker), 1, input) != 1 || eof_marker != VKS_EOF_MARKER)
+	{
+		printf("The scene file %s is empty, too large or corrupted.\n", settings->input_path);
+		fclose(input);
+		free_vks_material_names(material_names, input_header.material_count);
+		return 1;
+	}
+	uint64_t triangle_count = input_header.triangle_count;
+	uint32_t thread_count = settings->thread_count;
+	// Load positions, compute bounds and the new order
+	uint8_t* section = load_section(input, input_layout.positions, triangle_count * 3 * 2 * sizeof(uint32_t));
+	if (!section) {
+		printf("Failed to read positions from %s.\n", settings->input_path);
+		fclose(input);
+		free_vks_material_names(material_names, input_header.material_count);
+		return 1;
+	}
+	const uint32_t (*positions)[3][2] = (const uint32_t (*)[3][2]) section;
+	uint32_t* order = (settings->order != triangle_order_none) ? malloc(sizeof(uint32_t) * triangle_count) : NULL;
+	float box_min[3], box_max[3];
+	get_bounds_and_order(box_min, box_max, order, positions, &input_header, thread_count);
+	if (settings->order == triangle_order_cache) {
+		uint64_t group_size = settings->chunk_size ? settings->chunk_size : 16384;
+		uint64_t group_count = (triangle_count + group_size - 1) / group_size;
+		tipsify_job_t* jobs = malloc(sizeof(tipsify_job_t) * thread_count);
+		for (uint32_t i = 0; i != thread_count; ++i) {
+			tipsify_job_t job = {
+				.positions = positions, .order = order, .triangle_count = triangle_count, .group_size = group_size,
+				.group_begin = (group_count * i) / thread_count, .group_end = (group_count * (i + 1)) / thread_count,
+				.cache_size = settings->cache_size,
+			};
+			jobs[i] = job;
+		}
+		run_in_parallel(thread_count, run_tipsify_job, jobs, sizeof(tipsify_job_t));
+		free(jobs);
+	}
+	double order_time = get_tool_time();
+	// Define the output header and write it
+	vks_header_t output_header = input_header;
+	output_header.chunk_count = settings->chunk_size ? ((triangle_count + settings->chunk_size - 1) / settings->chunk_size) : 0;
+	// The actual vertex count of compressed geometry is only known later but
+	// it does not affect the size of the header
+	output_header.meshlet_vertex_count = settings->meshlets ? 1 : 0;
+	output_header.lod_level_count = settings->lod_levels;
+	output_header.lod_triangle_count = 0;
+	float quantization_factor[3] = { 0.0f, 0.0f, 0.0f }, quantization_summand[3] = { 0.0f, 0.0f, 0.0f };
+	if (settings->requantize)
+		get_vks_quantization(quantization_factor, quantization_summand, &output_header, box_min, box_max);
+	vks_layout_t output_layout = get_vks_layout(&output_header, (const char* const*) material_names);
+	FILE* output = fopen(settings->output_path, "wb");
+	int result = !output || write_vks_header(output, &output_header, (const char* const*) material_names)
+		|| vks_fseek(output, output_layout.eof_marker) || write_vks_eof_marker(output);
+	if (output)
+		fclose(output);
+	if (result)
+		printf("Failed to open %s or to write its header.\n", settings->output_path);
+	// Write positions and compute chunk boxes
+	vks_chunk_t* chunks = malloc(sizeof(vks_chunk_t) * (output_header.chunk_count + 1));
+	for (uint64_t i = 0; i != output_header.chunk_count; ++i) {
+		chunks[i].first_triangle = i * settings->chunk_size;
+		chunks[i].triangle_count = (chunks[i].first_triangle + settings->chunk_size < triangle_count) ? settings->chunk_size : (triangle_count - chunks[i].first_triangle);
+		for (uint32_t j = 0; j != 3; ++j) {
+			chunks[i].box_min[j] = FLT_MAX;
+			chunks[i].box_max[j] = -FLT_MAX;
+		}
+	}
+	section_job_t* jobs = malloc(sizeof(section_job_t) * thread_count);
+	memset(jobs, 0, sizeof(section_job_t) * thread_count);
+	for (uint32_t i = 0; i != thread_count; ++i) {
+		jobs[i].order = order;
+		jobs[i].file_path = settings->output_path;
+		jobs[i].positions = 1;
+		jobs[i].requantize = settings->requantize;
+		jobs[i].input_header = &input_header;
+		jobs[i].output_header = &output_header;
+		memcpy(jobs[i].quantization_factor, quantization_factor, sizeof(quantization_factor));
+		memcpy(jobs[i].quantization_summand, quantization_summand, sizeof(quantization_summand));
+		jobs[i].chunks = output_header.chunk_count ? chunks : NULL;
+		jobs[i].chunk_size = settings->chunk_size;
+	}
+	result = result || write_section(jobs, thread_count, section, 3 * 2 * sizeof(uint32_t), triangle_count, settings->chunk_size, output_layout.positions);
+	free(section);
+	// Stream the other sections through memory one at a time
+	for (uint32_t i = 0; i != thread_count; ++i)
+		jobs[i].positions = jobs[i].requantize = 0;
+	section = result ? NULL : load_section(input, input_layout.normals_and_tex_coords, triangle_count * 3 * 4 * sizeof(uint16_t));
+	result = result || !section || write_section(jobs, thread_count, section, 3 * 4 * sizeof(uint16_t), triangle_count, settings->chunk_size, output_layout.normals_and_tex_coords);
+	free(section);
+	section = result ? NULL : load_section(input, input_layout.material_indices, triangle_count * sizeof(uint8_t));
+	result = result || !section || write_section(jobs, thread_count, section, sizeof(uint8_t), triangle_count, settings->chunk_size, output_layout.material_indices);
+	free(section);
+	free(jobs);
+	fclose(input);
+	// Write the chunks. Boxes are enlarged by one quantization step such that
+	// they remain conservative when dequantization rounds differently.
+	for (uint64_t i = 0; i != output_header.chunk_count; ++i) {
+		for (uint32_t j = 0; j != 3; ++j) {
+			chunks[i].box_min[j] -= output_header.dequantization_factor[j];
+			chunks[i].box_max[j] += output_header.dequantization_factor[j];
+		}
+	}
+	if (!result && output_header.chunk_count) {
+		output = fopen(settings->output_path, "r+b");
+		result = !output || vks_fseek(output, output_layout.chunks)
+			|| fwrite(chunks, sizeof(vks_chunk_t), output_header.chunk_count, output) != output_header.chunk_count;
+		if (output)
+			fclose(output);
+	}
+	if (result)
+		printf("Failed to copy triangles from %s to %s.\n", settings->input_path, settings->output_path);
+	// Compress geometry based on the output written so far
+	if (!result && settings->meshlets)
+		result = write_meshlets(settings, &output_header, (const char* const*) material_names);
+	// Simplify chunks based on the output written so far
+	if (!result && settings->lod_levels)
+		result = write_lods(settings, &output_header, (const char* const*) material_names, chunks);
+	free_vks_material_names(material_names, input_header.material_count);
+	if (!result) {
+		double end_time = get_tool_time();
+		printf("Wrote %llu triangles in %llu chunks to %s using %u threads.\n", (unsigned long long) triangle_count,
+			(unsigned long long) output_header.chunk_count, settings->output_path, thread_count);
+		printf("Reordering: %.3f s, writing: %.3f s, total: %.3f s.\n", order_time - start_time, end_time - order_time, end_time - start_time);
+		if (settings->requantize)
+			printf("The quantization step changed from (%g, %g, %g) to (%g, %g, %g).\n",
+				input_header.dequantization_factor[0], input_header.dequantization_factor[1], input_header.dequantization_factor[2],
+				output_header.dequantization_factor[0], output_header.dequantization_factor[1], output_header.dequantization_factor[2]);
+	}
+	free(order);
+	free(chunks);
+	return result;
+}
+
+
+int main(int argc, char** argv) {
+	// Parse command line arguments
+	optimizer_settings_t settings = {
+		.order = triangle_order_morton,
+		.requantize = 1,
+		.chunk_size = 16384,
+		.cache_size = 16,
+		.thread_count = get_hardware_thread_count(),
+	};
+	int valid = (argc >= 3);
+	if (valid) {
+		settings.input_path = argv[1];
+		settings.output_path = argv[2];
+		valid = (strcmp(settings.input_path, settings.output_path) != 0);
+	}
+	for (int i = 3; i < argc && valid; ++i) {
+		valid &= (i + 1 < argc);
+		if (!valid) break;
+		if (strcmp(argv[i], "-order") == 0) {
+			settings.order = triangle_order_count;
+			for (uint32_t j = 0; j != triangle_order_count; ++j)
+				if (strcmp(argv[i + 1], g_triangle_order_names[j]) == 0)
+					settings.order = (triangle_order_t) j;
+			valid &= (settings.order != triangle_order_count);
+			++i;
+			continue;
+		}
+		unsigned long long value = 0;
+		valid &= (sscanf(argv[i + 1], "%llu", &value) == 1);
+		if (!valid) break;
+		if (strcmp(argv[i], "-requantize") == 0) settings.requantize = (value != 0);
+		else if (strcmp(argv[i], "-chunk_size") == 0) settings.chunk_size = value;
+		else if (strcmp(argv[i], "-cache_size") == 0) settings.cache_size = (uint32_t) value;
+		else if (strcmp(argv[i], "-threads") == 0) settings.thread_count = (uint32_t) value;
+		else if (strcmp(argv[i], "-meshlets") == 0) settings.meshlets = (value != 0);
+		else if (strcmp(argv[i], "-lod_levels") == 0) settings.lod_levels = (uint32_t) value;
+		else valid = 0;
+		++i;
+	}
+	valid &= (settings.thread_count >= 1 && settings.cache_size >= 3 && settings.chunk_size <= 0xFFFFFFFFull);
+	valid &= (settings.lod_levels == 0 || settings.chunk_size > 0) && settings.lod_levels <= 16;
+	if (!valid) {
+		printf("Usage: vks_opt <input.vks> <output.vks> [options]\n");
+		printf("Options:\n\
+-order       none, morton or cache (default morton). cache applies Tipsify\n\
+             within each chunk after sorting by Morton code.\n\
+-requantize  1 to fit quantization to the tight bounding box, 0 to keep it\n\
+             (default 1)\n\
+-chunk_size  Triangles per chunk. 0 writes a file without chunks (version 1),\n\
+             otherwise chunk bounding boxes are stored (default 16384)\n\
+-cache_size  Vertex cache size assumed by Tipsify (default 16)\n\
+-threads     Number of worker threads (default: hardware thread count)\n\
+-meshlets    1 to additionally write compressed geometry in meshlets of 64\n\
+             triangles (version 3), 0 to skip it (default 0)\n\
+-lod_levels  Number of simplified levels of detail per chunk (version 4). Each\n\
+             level halves the triangle count using quadric edge collapses\n\
+             while the boundary of each chunk stays fixed. Requires chunks,\n\
+             at most 16 (default 0)\n");
+		printf("The input and output path must differ.\n");
+		return 1;
+	}
+	return optimize_scene(&settings);
+}